@@ -0,0 +1,289 @@
+#if defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__))
+#define HAVE_POSIX 1
+#endif
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <sstream>
+#include <string>
+#include <utility>
+
+#include "k_printf.hpp"
+
+/* `k_printf` C++ 接口的微基准测试
+ *
+ * 以同一行 "req %d user %s took %.2f ms\n" 对比 `k_printf_cpp::format_to`、C 接口的 `k_snprintf`、
+ * `k_snprintf_argv`、C 标准库的 `snprintf` 与 `std::ostringstream`。`format_to` 在编译期拆分格式字符串，
+ * 运行期逐项输出；`k_snprintf_argv` 使用相同的实参数组，但在运行期解析格式字符串，两者之差即为解析的开销。
+ * `custom` 一组在格式字符串中加入自定义格式说明符 `%N`，对比以 `spec` 声明（编译期确定回调）
+ * 与以 `custom` 声明（运行期经 `config` 匹配）的 `format_to`。
+ * `table` 一组以 10 与 100 个格式说明符组成 `spec_table`，对比编译期展开的 `match_tuple`、
+ * 运行期构建的 `k_printf_spec_trie` 与线性查找的 `k_printf_match_tuple_helper`，以及不需要匹配的 `format_to`。
+ *
+ * 用法：bench_format [FILTER]，只运行名称中包含 FILTER 的测试。
+ * 请以 Release 方式构建：cmake -DK_PRINTF_BUILD_BENCH=ON -DCMAKE_BUILD_TYPE=Release
+ */
+
+#define ROUND_NUM 7
+
+namespace {
+
+volatile long long bench_sink;
+
+char out[256];
+
+double now_ns() {
+#ifdef HAVE_POSIX
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<double>(ts.tv_sec) * 1e9 + static_cast<double>(ts.tv_nsec);
+#else
+    return static_cast<double>(std::clock()) * (1e9 / CLOCKS_PER_SEC);
+#endif
+}
+
+/* region [custom spec] */
+
+void callback_name(k_printf_buf *buf, const k_printf_spec *spec, va_list *args) {
+    (void)spec;
+    const char *str = va_arg(*args, const char *);
+    buf->fn_puts(buf, str, std::strlen(str));
+}
+
+void callback_name_argv(k_printf_buf *buf, const k_printf_spec *spec, k_printf_args *args) {
+    (void)spec;
+    const k_printf_arg *arg = k_printf_args_next(args);
+    if (nullptr == arg || K_PRINTF_ARG_STR != arg->type) {
+        buf->n = -1;
+        return;
+    }
+    buf->fn_puts(buf, arg->value.s, std::strlen(arg->value.s));
+}
+
+using name_spec = k_printf_cpp::spec<"N", callback_name, 1, callback_name_argv>;
+using name_custom = k_printf_cpp::custom<"N", 1>;
+
+using specs = k_printf_cpp::spec_table<name_spec>;
+
+/* endregion */
+
+/* region [spec table] */
+
+/* 第 I 个格式说明符的类型名，"q000" 到 "q099" */
+template <std::size_t I>
+consteval k_printf_cpp::fixed_string<5> table_spec_name() {
+    const char name[5] = { 'q', static_cast<char>('0' + I / 100), static_cast<char>('0' + I / 10 % 10),
+                           static_cast<char>('0' + I % 10), '\0' };
+    return k_printf_cpp::fixed_string<5>(name);
+}
+
+void callback_tag(k_printf_buf *buf, const k_printf_spec *spec, va_list *args) {
+    (void)spec;
+    char ch = static_cast<char>('0' + va_arg(*args, int) % 10);
+    buf->fn_puts(buf, &ch, 1);
+}
+
+void callback_tag_argv(k_printf_buf *buf, const k_printf_spec *spec, k_printf_args *args) {
+    (void)spec;
+    const k_printf_arg *arg = k_printf_args_next(args);
+    if (nullptr == arg || K_PRINTF_ARG_INT != arg->type) {
+        buf->n = -1;
+        return;
+    }
+    char ch = static_cast<char>('0' + arg->value.i % 10);
+    buf->fn_puts(buf, &ch, 1);
+}
+
+template <std::size_t I>
+using table_spec = k_printf_cpp::spec<table_spec_name<I>(), callback_tag, 1, callback_tag_argv>;
+
+template <std::size_t... I>
+k_printf_cpp::spec_table<table_spec<I>...> make_table(std::index_sequence<I...>);
+
+using table_10  = decltype(make_table(std::make_index_sequence<10> {}));
+using table_100 = decltype(make_table(std::make_index_sequence<100> {}));
+
+/* 运行期的匹配方式，使用 `spec_table` 生成的同一组配置项 */
+const k_printf_spec_callback_tuple *current_tuples;
+const k_printf_spec_trie *current_trie;
+
+const k_printf_spec_callback_tuple *match_tuple_linear(const char **str) {
+    return k_printf_match_tuple_helper(current_tuples, str);
+}
+
+const k_printf_spec_callback_tuple *match_tuple_trie(const char **str) {
+    return k_printf_match_tuple_trie(current_trie, str);
+}
+
+/* 第一个、中间与最后一个格式说明符 */
+template <class Table>
+constexpr const char *table_fmt = std::is_same_v<Table, table_10> ? "a=%q000 b=%q005 c=%q009\n" : "a=%q000 b=%q050 c=%q099\n";
+
+template <class Table>
+void run_table_config(const k_printf_config *config, int iterations) {
+    for (int i = 0; i < iterations; i++)
+        bench_sink = k_snprintf(config, out, sizeof(out), table_fmt<Table>, i, i, i);
+}
+
+template <class Table>
+void bench_table_spec_table(int iterations) {
+    static const k_printf_config config = Table::config();
+    run_table_config<Table>(&config, iterations);
+}
+
+template <class Table>
+void bench_table_trie(int iterations) {
+    k_printf_config config {};
+    config.fn_match_tuple = match_tuple_trie;
+    k_printf_spec_trie *trie = k_printf_spec_trie_create(Table::tuples);
+    current_trie = trie;
+    run_table_config<Table>(&config, iterations);
+    k_printf_spec_trie_destroy(trie);
+}
+
+template <class Table>
+void bench_table_linear(int iterations) {
+    k_printf_config config {};
+    config.fn_match_tuple = match_tuple_linear;
+    current_tuples = Table::tuples;
+    run_table_config<Table>(&config, iterations);
+}
+
+void bench_table_format_to_10(int iterations) {
+    static const k_printf_config config = table_10::config();
+    for (int i = 0; i < iterations; i++)
+        bench_sink = k_printf_cpp::format_to<"a=%q000 b=%q005 c=%q009\n", table_10>(&config, out, sizeof(out), i, i, i);
+}
+
+void bench_table_format_to_100(int iterations) {
+    static const k_printf_config config = table_100::config();
+    for (int i = 0; i < iterations; i++)
+        bench_sink = k_printf_cpp::format_to<"a=%q000 b=%q050 c=%q099\n", table_100>(&config, out, sizeof(out), i, i, i);
+}
+
+/* endregion */
+
+/* region [cases] */
+
+k_printf_config plain_config;
+k_printf_config cached_config;
+const k_printf_config custom_config = specs::config();
+
+void bench_format_to(int iterations) {
+    for (int i = 0; i < iterations; i++)
+        bench_sink = k_printf_cpp::format_to<"req %d user %s took %.2f ms\n">(&plain_config, out, sizeof(out), i, "alice", i * 0.01);
+}
+
+void bench_k_snprintf(int iterations) {
+    for (int i = 0; i < iterations; i++)
+        bench_sink = k_snprintf(&plain_config, out, sizeof(out), "req %d user %s took %.2f ms\n", i, "alice", i * 0.01);
+}
+
+void run_snprintf_argv(const k_printf_config *config, int iterations) {
+    for (int i = 0; i < iterations; i++) {
+        k_printf_arg argv[3];
+        argv[0].type    = K_PRINTF_ARG_INT;
+        argv[0].value.i = i;
+        argv[1].type    = K_PRINTF_ARG_STR;
+        argv[1].value.s = "alice";
+        argv[2].type    = K_PRINTF_ARG_DOUBLE;
+        argv[2].value.d = i * 0.01;
+        bench_sink = k_snprintf_argv(config, out, sizeof(out), "req %d user %s took %.2f ms\n", argv, 3);
+    }
+}
+
+void bench_snprintf_argv(int iterations)        { run_snprintf_argv(&plain_config, iterations); }
+void bench_snprintf_argv_cached(int iterations) { run_snprintf_argv(&cached_config, iterations); }
+
+void bench_libc_snprintf(int iterations) {
+    for (int i = 0; i < iterations; i++)
+        bench_sink = std::snprintf(out, sizeof(out), "req %d user %s took %.2f ms\n", i, "alice", i * 0.01);
+}
+
+void bench_ostringstream(int iterations) {
+    for (int i = 0; i < iterations; i++) {
+        std::ostringstream os;
+        os.setf(std::ios::fixed);
+        os.precision(2);
+        os << "req " << i << " user " << "alice" << " took " << i * 0.01 << " ms\n";
+        bench_sink = static_cast<long long>(os.str().size());
+    }
+}
+
+void bench_custom_spec(int iterations) {
+    for (int i = 0; i < iterations; i++)
+        bench_sink = k_printf_cpp::format_to<"req %d user %N took %.2f ms\n", specs>(&custom_config, out, sizeof(out), i, "alice", i * 0.01);
+}
+
+void bench_custom_runtime(int iterations) {
+    for (int i = 0; i < iterations; i++)
+        bench_sink = k_printf_cpp::format_to<"req %d user %N took %.2f ms\n", name_custom>(&custom_config, out, sizeof(out), i, "alice", i * 0.01);
+}
+
+void bench_custom_k_snprintf(int iterations) {
+    for (int i = 0; i < iterations; i++)
+        bench_sink = k_snprintf(&custom_config, out, sizeof(out), "req %d user %N took %.2f ms\n", i, "alice", i * 0.01);
+}
+
+/* endregion */
+
+struct bench_case {
+    const char *name;
+    void (*fn_run)(int iterations);
+    int iterations;
+};
+
+const bench_case cases[] = {
+    { "mixed/format_to",     bench_format_to,            1000000 },
+    { "mixed/k_snprintf",    bench_k_snprintf,           1000000 },
+    { "mixed/argv",          bench_snprintf_argv,        1000000 },
+    { "mixed/argv_cached",   bench_snprintf_argv_cached, 1000000 },
+    { "mixed/snprintf",      bench_libc_snprintf,        1000000 },
+    { "mixed/ostringstream", bench_ostringstream,        500000  },
+    { "custom/spec",         bench_custom_spec,          1000000 },
+    { "custom/custom",       bench_custom_runtime,       1000000 },
+    { "custom/k_snprintf",   bench_custom_k_snprintf,    1000000 },
+    { "table/10/spec_table", bench_table_spec_table<table_10>,  1000000 },
+    { "table/10/trie",       bench_table_trie<table_10>,        1000000 },
+    { "table/10/linear",     bench_table_linear<table_10>,      1000000 },
+    { "table/10/format_to",  bench_table_format_to_10,          1000000 },
+    { "table/100/spec_table", bench_table_spec_table<table_100>, 1000000 },
+    { "table/100/trie",      bench_table_trie<table_100>,       1000000 },
+    { "table/100/linear",    bench_table_linear<table_100>,     1000000 },
+    { "table/100/format_to", bench_table_format_to_100,         1000000 },
+};
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+
+    const char *filter = (argc > 1) ? argv[1] : nullptr;
+
+    cached_config.cache = k_printf_cache_create(16);
+
+    std::printf("k_printf C++ bench\n");
+    std::printf("%-20s %10s\n", "case", "ns/op");
+
+    for (const bench_case &c : cases) {
+        if (nullptr != filter && nullptr == std::strstr(c.name, filter))
+            continue;
+
+        c.fn_run(c.iterations / 10);
+
+        double best_ns = 0;
+        for (int round = 0; round < ROUND_NUM; round++) {
+            double ns = now_ns();
+            c.fn_run(c.iterations);
+            ns = now_ns() - ns;
+            if (0 == round || ns < best_ns)
+                best_ns = ns;
+        }
+
+        std::printf("%-20s %10.1f\n", c.name, best_ns / c.iterations);
+    }
+
+    k_printf_cache_destroy(cached_config.cache);
+    return 0;
+}
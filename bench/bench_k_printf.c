@@ -0,0 +1,562 @@
+#if defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__))
+#define _POSIX_C_SOURCE 200809L /* clock_gettime, pthread */
+#define HAVE_POSIX 1
+#endif
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "k_printf.h"
+
+#ifdef HAVE_POSIX
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <x86intrin.h>
+#define HAVE_RDTSC 1
+#endif
+
+/* `k_printf` 的微基准测试
+ *
+ * 每项测试重复若干轮，取最快一轮的每次调用耗时。`literal` 一组只格式化夹带一个 `%d` 的长字面量文本，
+ * 用 `k_printf_len` 排除拷贝的开销，报告扫描字面量文本的速度（字节/ns 与字节/TSC 周期）。
+ * 同一份代码会以 `K_PRINTF_NO_SIMD` 再编译一次（`bench_k_printf_no_simd`），两者对比即为 SIMD 扫描前后的差异。
+ *
+ * 最后的 `latency` 一组逐次计时，对比 `k_printf_defer` 与 `k_fprintf` 单次调用耗时的分位数。
+ *
+ * 用法：bench_k_printf [FILTER]，只运行名称中包含 FILTER 的测试。
+ * 请以 Release 方式构建：cmake -DK_PRINTF_BUILD_BENCH=ON -DCMAKE_BUILD_TYPE=Release
+ */
+
+#define ROUND_NUM 7
+
+static volatile long long bench_sink;
+
+static double now_ns(void) {
+#ifdef HAVE_POSIX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+#else
+    return (double)clock() * (1e9 / CLOCKS_PER_SEC);
+#endif
+}
+
+static unsigned long long now_cycles(void) {
+#ifdef HAVE_RDTSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/* region [custom spec] */
+
+static void callback_name(struct k_printf_buf *buf, const struct k_printf_spec *spec, va_list *args) {
+    (void)spec;
+    const char *str = va_arg(*args, const char *);
+    buf->fn_puts(buf, str, strlen(str));
+}
+
+static const struct k_printf_spec_callback_tuple tuples[] = {
+    { "N", callback_name, NULL, NULL, NULL, 1 },
+    { NULL, NULL, NULL, NULL, NULL, 0 },
+};
+
+static const struct k_printf_spec_callback_tuple *match_tuple(const char **str) {
+    return k_printf_match_tuple_helper(tuples, str);
+}
+
+/* endregion */
+
+/* region [spec table] */
+
+/* 5、50、500 个自定义格式说明符，类型名为 "q000" 到 "q499"，分别以线性查找与字典树匹配 */
+static const int spec_table_size[3] = { 5, 50, 500 };
+
+static char spec_names[500][8];
+static struct k_printf_spec_callback_tuple spec_tuples[3][501];
+static struct k_printf_spec_trie *spec_tries[3];
+static char spec_fmt[3][64];
+
+static const struct k_printf_spec_callback_tuple *current_tuples;
+static const struct k_printf_spec_trie *current_trie;
+
+static void callback_tag(struct k_printf_buf *buf, const struct k_printf_spec *spec, va_list *args) {
+    (void)spec;
+    char ch = (char)('0' + va_arg(*args, int) % 10);
+    buf->fn_puts(buf, &ch, 1);
+}
+
+static const struct k_printf_spec_callback_tuple *match_tuple_linear(const char **str) {
+    return k_printf_match_tuple_helper(current_tuples, str);
+}
+
+static const struct k_printf_spec_callback_tuple *match_tuple_trie(const char **str) {
+    return k_printf_match_tuple_trie(current_trie, str);
+}
+
+static void setup_spec_table(void) {
+    for (int i = 0; i < 500; i++)
+        snprintf(spec_names[i], sizeof(spec_names[i]), "q%03d", i);
+
+    for (int k = 0; k < 3; k++) {
+        int size = spec_table_size[k];
+        for (int i = 0; i < size; i++) {
+            struct k_printf_spec_callback_tuple tuple = { spec_names[i], callback_tag, NULL, NULL, NULL, 0 };
+            spec_tuples[k][i] = tuple;
+        }
+        spec_tries[k] = k_printf_spec_trie_create(spec_tuples[k]);
+
+        /* 第一个、中间与最后一个格式说明符，线性查找的最好、一般与最坏情况 */
+        snprintf(spec_fmt[k], sizeof(spec_fmt[k]), "a=%%%s b=%%%s c=%%%s\n",
+                 spec_names[0], spec_names[size / 2], spec_names[size - 1]);
+    }
+}
+
+static void teardown_spec_table(void) {
+    for (int k = 0; k < 3; k++)
+        k_printf_spec_trie_destroy(spec_tries[k]);
+}
+
+/* endregion */
+
+/* region [cases] */
+
+static struct k_printf_config plain_config;
+static struct k_printf_config cached_config;
+static struct k_printf_config custom_config;
+static struct k_printf_config counted_config; /* 统计内存分配，每轮开始前清零 */
+static struct k_printf_alloc_stats alloc_stats;
+static struct k_printf_format *compiled_format;
+
+static char literal_fmt[4][4200];
+static char out[8192];
+
+static void bench_literal(int case_index, int iterations) {
+    long long sum = 0;
+    for (int i = 0; i < iterations; i++)
+        sum += k_printf_len(&plain_config, literal_fmt[case_index], i);
+    bench_sink = sum;
+}
+
+static void bench_literal_16(int iterations)   { bench_literal(0, iterations); }
+static void bench_literal_64(int iterations)   { bench_literal(1, iterations); }
+static void bench_literal_256(int iterations)  { bench_literal(2, iterations); }
+static void bench_literal_4096(int iterations) { bench_literal(3, iterations); }
+
+static void bench_int(int iterations) {
+    for (int i = 0; i < iterations; i++)
+        bench_sink = k_snprintf(&plain_config, out, sizeof(out), "%d %5u %08x %lld %-6hd|", i, (unsigned)i * 7u,
+                                (unsigned)i, (long long)i * 1000003, (short)i);
+}
+
+static void bench_double(int iterations) {
+    for (int i = 0; i < iterations; i++)
+        bench_sink = k_snprintf(&plain_config, out, sizeof(out), "%f %.3e %g %10.2f", i * 0.01, i * 1e-7, i * 3.5, -i / 3.0);
+}
+
+static void bench_string(int iterations) {
+    for (int i = 0; i < iterations; i++)
+        bench_sink = k_snprintf(&plain_config, out, sizeof(out), "%s|%-10s|%.3s|%c", "alice", "bob", "carol", 'a' + i % 26);
+}
+
+/* 每个格式说明符的实参只取一次，见 `printf_callback_c_std_spec` */
+static void bench_dsf(int iterations) {
+    for (int i = 0; i < iterations; i++)
+        bench_sink = k_snprintf(&plain_config, out, sizeof(out), "%d %s %f\n", i, "alice", i * 0.01);
+}
+
+static void bench_dsf_delegated(int iterations) {
+    for (int i = 0; i < iterations; i++)
+        bench_sink = k_snprintf(&plain_config, out, sizeof(out), "%d %s %f %c %p\n", i, "alice", i * 0.01,
+                                'a' + i % 26, (void *)out);
+}
+
+static void bench_delegated(int iterations) {
+    for (int i = 0; i < iterations; i++)
+        bench_sink = k_snprintf(&plain_config, out, sizeof(out), "%p %La", (void *)out, (long double)i);
+}
+
+static void bench_mixed(int iterations) {
+    for (int i = 0; i < iterations; i++)
+        bench_sink = k_snprintf(&plain_config, out, sizeof(out), "req %d user %s took %.2f ms\n", i, "alice", i * 0.01);
+}
+
+static void bench_mixed_cached(int iterations) {
+    for (int i = 0; i < iterations; i++)
+        bench_sink = k_snprintf(&cached_config, out, sizeof(out), "req %d user %s took %.2f ms\n", i, "alice", i * 0.01);
+}
+
+static void bench_mixed_compiled(int iterations) {
+    for (int i = 0; i < iterations; i++)
+        bench_sink = k_snprintf_compiled(compiled_format, out, sizeof(out), i, "alice", i * 0.01);
+}
+
+static void run_mixed_argv(const struct k_printf_config *config, int iterations) {
+    for (int i = 0; i < iterations; i++) {
+        struct k_printf_arg argv[3];
+        argv[0].type    = K_PRINTF_ARG_INT;
+        argv[0].value.i = i;
+        argv[1].type    = K_PRINTF_ARG_STR;
+        argv[1].value.s = "alice";
+        argv[2].type    = K_PRINTF_ARG_DOUBLE;
+        argv[2].value.d = i * 0.01;
+        bench_sink = k_snprintf_argv(config, out, sizeof(out), "req %d user %s took %.2f ms\n", argv, 3);
+    }
+}
+
+static void bench_mixed_argv(int iterations)        { run_mixed_argv(&plain_config, iterations); }
+static void bench_mixed_argv_cached(int iterations) { run_mixed_argv(&cached_config, iterations); }
+
+/* 同一行改用位置参数并调换顺序 */
+static void bench_positional(int iterations) {
+    for (int i = 0; i < iterations; i++)
+        bench_sink = k_snprintf(&plain_config, out, sizeof(out), "user %2$s req %1$d took %3$.2f ms\n", i, "alice", i * 0.01);
+}
+
+static void bench_positional_libc(int iterations) {
+    for (int i = 0; i < iterations; i++)
+        bench_sink = snprintf(out, sizeof(out), "user %2$s req %1$d took %3$.2f ms\n", i, "alice", i * 0.01);
+}
+
+static void bench_mixed_libc(int iterations) {
+    for (int i = 0; i < iterations; i++)
+        bench_sink = snprintf(out, sizeof(out), "req %d user %s took %.2f ms\n", i, "alice", i * 0.01);
+}
+
+static void bench_mixed_len(int iterations) {
+    for (int i = 0; i < iterations; i++)
+        bench_sink = k_printf_len(&plain_config, "req %d user %s took %.2f ms\n", i, "alice", i * 0.01);
+}
+
+static void bench_mixed_asprintf(int iterations) {
+    for (int i = 0; i < iterations; i++) {
+        char *str;
+        bench_sink = k_asprintf(&plain_config, &str, "req %d user %s took %.2f ms\n", i, "alice", i * 0.01);
+        free(str);
+    }
+}
+
+static void bench_alloc_asprintf(int iterations) {
+    for (int i = 0; i < iterations; i++) {
+        char *str;
+        bench_sink = k_asprintf(&counted_config, &str, "req %d user %s took %.2f ms\n", i, "alice", i * 0.01);
+        free(str);
+    }
+}
+
+/* 同一个缓冲区反复清空后使用，如同每个线程各持有一个 */
+static void bench_alloc_strbuf(int iterations) {
+    struct k_printf_strbuf sb = K_PRINTF_STRBUF_INIT;
+    for (int i = 0; i < iterations; i++) {
+        k_printf_strbuf_clear(&sb);
+        bench_sink = k_sbprintf(&counted_config, &sb, "req %d user %s took %.2f ms\n", i, "alice", i * 0.01);
+    }
+    k_printf_strbuf_free(&sb);
+}
+
+/* 每 1000 个字符串重置一次 arena，如同一次请求结束时一起释放 */
+static void bench_alloc_arena(int iterations) {
+    struct k_printf_arena *arena = k_printf_arena_create(0);
+    for (int i = 0; i < iterations; i++) {
+        if (0 == i % 1000)
+            k_printf_arena_reset(arena);
+        bench_sink = (long long)(size_t)k_arena_printf(&counted_config, arena, "req %d user %s took %.2f ms\n",
+                                                       i, "alice", i * 0.01);
+    }
+    k_printf_arena_destroy(arena);
+}
+
+static int discard_puts(struct k_printf_sink *sink, const char *str, size_t len) {
+    (void)sink;
+    (void)str;
+    bench_sink += (long long)len;
+    return 0;
+}
+
+static void bench_mixed_xprintf(int iterations) {
+    struct k_printf_sink sink = { .fn_puts = discard_puts };
+    for (int i = 0; i < iterations; i++)
+        k_xprintf(&plain_config, &sink, "req %d user %s took %.2f ms\n", i, "alice", i * 0.01);
+}
+
+#ifdef HAVE_POSIX
+static void bench_mixed_dprintf(int iterations) {
+    int fd = open("/dev/null", O_WRONLY);
+    for (int i = 0; i < iterations; i++)
+        bench_sink = k_dprintf(&plain_config, fd, "req %d user %s took %.2f ms\n", i, "alice", i * 0.01);
+    close(fd);
+}
+#endif
+
+static void bench_spec_table(int k, int trie, int iterations) {
+    struct k_printf_config config = { 0 };
+    config.fn_match_tuple = trie ? match_tuple_trie : match_tuple_linear;
+    current_tuples = spec_tuples[k];
+    current_trie   = spec_tries[k];
+    for (int i = 0; i < iterations; i++)
+        bench_sink = k_snprintf(&config, out, sizeof(out), spec_fmt[k], i, i, i);
+}
+
+static void bench_linear_5(int iterations)   { bench_spec_table(0, 0, iterations); }
+static void bench_linear_50(int iterations)  { bench_spec_table(1, 0, iterations); }
+static void bench_linear_500(int iterations) { bench_spec_table(2, 0, iterations); }
+static void bench_trie_5(int iterations)     { bench_spec_table(0, 1, iterations); }
+static void bench_trie_50(int iterations)    { bench_spec_table(1, 1, iterations); }
+static void bench_trie_500(int iterations)   { bench_spec_table(2, 1, iterations); }
+
+#ifdef HAVE_POSIX
+
+/* 多个线程向同一个 `FILE` 输出，每次调用的耗时为总耗时除以调用总次数 */
+static FILE *thread_file;
+static int thread_libc;
+
+struct thread_arg {
+    pthread_t thread;
+    int iterations;
+};
+
+static void *fprintf_worker(void *arg) {
+    struct thread_arg *a = (struct thread_arg *)arg;
+    for (int i = 0; i < a->iterations; i++) {
+        if (thread_libc)
+            fprintf(thread_file, "req %d user %s took %.2f ms\n", i, "alice", i * 0.01);
+        else
+            k_fprintf(&plain_config, thread_file, "req %d user %s took %.2f ms\n", i, "alice", i * 0.01);
+    }
+    return NULL;
+}
+
+static void bench_fprintf_threads(int libc, int thread_num, int iterations) {
+    struct thread_arg args[32];
+    thread_libc = libc;
+    for (int t = 0; t < thread_num; t++) {
+        args[t].iterations = iterations / thread_num;
+        pthread_create(&args[t].thread, NULL, fprintf_worker, &args[t]);
+    }
+    for (int t = 0; t < thread_num; t++)
+        pthread_join(args[t].thread, NULL);
+}
+
+static void bench_fprintf_1(int iterations)       { bench_fprintf_threads(0, 1, iterations); }
+static void bench_fprintf_4(int iterations)       { bench_fprintf_threads(0, 4, iterations); }
+static void bench_fprintf_32(int iterations)      { bench_fprintf_threads(0, 32, iterations); }
+static void bench_libc_fprintf_1(int iterations)  { bench_fprintf_threads(1, 1, iterations); }
+static void bench_libc_fprintf_4(int iterations)  { bench_fprintf_threads(1, 4, iterations); }
+static void bench_libc_fprintf_32(int iterations) { bench_fprintf_threads(1, 32, iterations); }
+
+#endif
+
+static void bench_auto_pad(int iterations) {
+    for (int i = 0; i < iterations; i++)
+        bench_sink = k_snprintf(&custom_config, out, sizeof(out), "[%16N|%-16N]", "alice", "bob");
+}
+
+/* endregion */
+
+/* region [latency] */
+
+/* 逐次计时，报告单次调用耗时的分位数；计时本身（一对 `clock_gettime`）的开销也包含在内 */
+#define LATENCY_SAMPLE_NUM 200000
+
+static double latency_samples[LATENCY_SAMPLE_NUM];
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void print_latency(const char *name) {
+    qsort(latency_samples, LATENCY_SAMPLE_NUM, sizeof(double), compare_double);
+    printf("%-18s %10.1f %10.1f %10.1f\n", name,
+           latency_samples[LATENCY_SAMPLE_NUM / 2],
+           latency_samples[LATENCY_SAMPLE_NUM / 100 * 99],
+           latency_samples[LATENCY_SAMPLE_NUM / 1000 * 999]);
+}
+
+/* 生产者一侧 `k_printf_defer` 的耗时；每 128 条记录在计时之外取出一次，队列不会满 */
+static void latency_defer(void) {
+    struct k_printf_queue *queue = k_printf_queue_create(256, 64);
+    struct k_printf_sink sink = { .fn_puts = discard_puts };
+    for (int i = 0; i < LATENCY_SAMPLE_NUM; i++) {
+        double ns = now_ns();
+        k_printf_defer(&plain_config, queue, "req %d user %s took %.2f ms\n", i, "alice", i * 0.01);
+        latency_samples[i] = now_ns() - ns;
+        if (127 == i % 128)
+            k_printf_queue_drain(queue, &sink, SIZE_MAX);
+    }
+    k_printf_queue_destroy(queue);
+    print_latency("defer");
+}
+
+#ifdef HAVE_POSIX
+static void latency_fprintf(void) {
+    for (int i = 0; i < LATENCY_SAMPLE_NUM; i++) {
+        double ns = now_ns();
+        k_fprintf(&plain_config, thread_file, "req %d user %s took %.2f ms\n", i, "alice", i * 0.01);
+        latency_samples[i] = now_ns() - ns;
+    }
+    print_latency("fprintf");
+}
+#endif
+
+static void latency_timer(void) {
+    for (int i = 0; i < LATENCY_SAMPLE_NUM; i++) {
+        double ns = now_ns();
+        latency_samples[i] = now_ns() - ns;
+    }
+    print_latency("timer");
+}
+
+static void run_latency(void) {
+    printf("\n%-18s %10s %10s %10s\n", "latency (ns)", "p50", "p99", "p999");
+    latency_timer();
+    latency_defer();
+#ifdef HAVE_POSIX
+    latency_fprintf();
+#endif
+}
+
+/* endregion */
+
+struct bench_case {
+    const char *name;
+    void (*fn_run)(int iterations);
+    int iterations;
+    size_t bytes;       /* 每次调用扫描的字面量字节数，为 0 则不报告吞吐 */
+};
+
+static struct bench_case cases[] = {
+    { "literal/16",        bench_literal_16,     2000000, 16 },
+    { "literal/64",        bench_literal_64,     2000000, 64 },
+    { "literal/256",       bench_literal_256,    1000000, 256 },
+    { "literal/4096",      bench_literal_4096,   200000,  4096 },
+    { "int",               bench_int,            1000000, 0 },
+    { "double",            bench_double,         1000000, 0 },
+    { "string",            bench_string,         2000000, 0 },
+    { "dsf",               bench_dsf,            1000000, 0 },
+    { "dsf/delegated",     bench_dsf_delegated,  1000000, 0 },
+    { "delegated",         bench_delegated,      500000,  0 },
+    { "mixed",             bench_mixed,          1000000, 0 },
+    { "mixed/cached",      bench_mixed_cached,   1000000, 0 },
+    { "mixed/compiled",    bench_mixed_compiled, 1000000, 0 },
+    { "mixed/argv",        bench_mixed_argv,     1000000, 0 },
+    { "mixed/argv_cached", bench_mixed_argv_cached, 1000000, 0 },
+    { "mixed/libc",        bench_mixed_libc,     1000000, 0 },
+    { "positional",        bench_positional,     1000000, 0 },
+    { "positional/libc",   bench_positional_libc, 1000000, 0 },
+    { "mixed/len",         bench_mixed_len,      1000000, 0 },
+    { "mixed/asprintf",    bench_mixed_asprintf, 1000000, 0 },
+    { "alloc/asprintf",    bench_alloc_asprintf, 1000000, 0 },
+    { "alloc/strbuf",      bench_alloc_strbuf,   1000000, 0 },
+    { "alloc/arena",       bench_alloc_arena,    1000000, 0 },
+    { "mixed/xprintf",     bench_mixed_xprintf,  1000000, 0 },
+#ifdef HAVE_POSIX
+    { "mixed/dprintf",     bench_mixed_dprintf,  500000,  0 },
+    { "fprintf/1",         bench_fprintf_1,      640000,  0 },
+    { "fprintf/4",         bench_fprintf_4,      640000,  0 },
+    { "fprintf/32",        bench_fprintf_32,     640000,  0 },
+    { "fprintf/libc/1",    bench_libc_fprintf_1, 640000,  0 },
+    { "fprintf/libc/4",    bench_libc_fprintf_4, 640000,  0 },
+    { "fprintf/libc/32",   bench_libc_fprintf_32, 640000, 0 },
+#endif
+    { "auto_pad",          bench_auto_pad,       1000000, 0 },
+    { "spec/linear/5",     bench_linear_5,       1000000, 0 },
+    { "spec/linear/50",    bench_linear_50,      1000000, 0 },
+    { "spec/linear/500",   bench_linear_500,     200000,  0 },
+    { "spec/trie/5",       bench_trie_5,         1000000, 0 },
+    { "spec/trie/50",      bench_trie_50,        1000000, 0 },
+    { "spec/trie/500",     bench_trie_500,       1000000, 0 },
+};
+
+static void setup(void) {
+
+    /* 字面量文本不含 `%`，长度各不相同，末尾跟一个 `%d` */
+    static const size_t literal_len[4] = { 16, 64, 256, 4096 };
+    for (int i = 0; i < 4; i++) {
+        for (size_t j = 0; j < literal_len[i]; j++)
+            literal_fmt[i][j] = (char)('a' + j % 26);
+        strcpy(literal_fmt[i] + literal_len[i], "%d");
+    }
+
+    cached_config.cache = k_printf_cache_create(16);
+    custom_config.fn_match_tuple = match_tuple;
+    counted_config.alloc_stats = &alloc_stats;
+    compiled_format = k_printf_compile(&plain_config, "req %d user %s took %.2f ms\n");
+    setup_spec_table();
+#ifdef HAVE_POSIX
+    thread_file = fopen("/dev/null", "w");
+#endif
+}
+
+static void teardown(void) {
+    k_printf_cache_destroy(cached_config.cache);
+    k_printf_format_free(compiled_format);
+    teardown_spec_table();
+#ifdef HAVE_POSIX
+    fclose(thread_file);
+#endif
+}
+
+int main(int argc, char *argv[]) {
+
+    const char *filter = (argc > 1) ? argv[1] : NULL;
+
+    setup();
+
+#ifdef K_PRINTF_NO_SIMD
+    printf("k_printf bench (K_PRINTF_NO_SIMD)\n");
+#else
+    printf("k_printf bench\n");
+#endif
+    printf("%-18s %10s %12s %14s %10s\n", "case", "ns/op", "bytes/ns", "bytes/cycle", "allocs/op");
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        const struct bench_case *c = &cases[i];
+        if (NULL != filter && NULL == strstr(c->name, filter))
+            continue;
+
+        c->fn_run(c->iterations / 10);
+
+        double best_ns = 0;
+        unsigned long long best_cycles = 0;
+        for (int round = 0; round < ROUND_NUM; round++) {
+            memset(&alloc_stats, 0, sizeof(alloc_stats));
+            unsigned long long cycles = now_cycles();
+            double ns = now_ns();
+            c->fn_run(c->iterations);
+            ns = now_ns() - ns;
+            cycles = now_cycles() - cycles;
+            if (0 == round || ns < best_ns) {
+                best_ns     = ns;
+                best_cycles = cycles;
+            }
+        }
+
+        double ns_per_op = best_ns / c->iterations;
+        printf("%-18s %10.1f", c->name, ns_per_op);
+        if (0 != c->bytes) {
+            printf(" %12.2f", (double)c->bytes / ns_per_op);
+            if (0 != best_cycles)
+                printf(" %14.2f", (double)c->bytes * c->iterations / (double)best_cycles);
+        } else if (0 != alloc_stats.alloc_num) {
+            printf(" %12s %14s %10.4f", "", "", (double)alloc_stats.alloc_num / c->iterations);
+        }
+        printf("\n");
+    }
+
+    if (NULL == filter || NULL != strstr("latency", filter))
+        run_latency();
+
+    teardown();
+    return 0;
+}
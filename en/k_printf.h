@@ -5,9 +5,15 @@
 #define K_PRINTF_H
 
 #include <stdio.h>
+#include <stdarg.h>
 #include <stddef.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 struct k_printf_config;
+struct k_printf_cache;
 
 /**
  * \brief Outputs a formatted string to `stdout` and returns its length.
@@ -45,18 +51,161 @@ struct k_printf_spec;
  */
 typedef void (*k_printf_callback_fn)(struct k_printf_buf *buf, const struct k_printf_spec *spec, va_list *args);
 
+/**
+ * \brief Callback that computes the output length of a custom format specifier.
+ *
+ * When only the length of the formatted string is needed (see `k_printf_len`),
+ * `k_printf` calls this instead of the `k_printf_callback_fn`. Compute the length directly
+ * (digit counts, string lengths, padding widths) without producing any characters.
+ *
+ * It must consume exactly the same arguments as the corresponding `k_printf_callback_fn`.
+ *
+ * \param spec Details of the current format specifier.
+ * \param args Pointer to the variable argument list, consume arguments as needed.
+ * \return The output length of the specifier on success, a negative value on failure.
+ */
+typedef int (*k_printf_measure_fn)(const struct k_printf_spec *spec, va_list *args);
+
+/** \brief Type of an argument in an argument array, see `k_printf_arg` */
+enum k_printf_arg_type {
+    K_PRINTF_ARG_INT = 1,     /**< Signed integer, stored in `value.i` */
+    K_PRINTF_ARG_UINT,        /**< Unsigned integer, stored in `value.u` */
+    K_PRINTF_ARG_DOUBLE,      /**< double, stored in `value.d` */
+    K_PRINTF_ARG_LONG_DOUBLE, /**< long double, stored in `value.ld` */
+    K_PRINTF_ARG_STR,         /**< String, stored in `value.s` */
+    K_PRINTF_ARG_PTR,         /**< Pointer, stored in `value.p`; used by `%p`, `%ls` and the `%n` family */
+};
+
+/**
+ * \brief A type-tagged argument, used by the `k_snprintf_argv` family
+ *
+ * Unlike a variable argument list, an argument array can be used any number of times:
+ * capture the arguments once and format them again later without capturing them again.
+ * Integer arguments are truncated according to the length modifier of the specifier,
+ * exactly as if they had been passed through a variable argument list.
+ */
+struct k_printf_arg {
+    enum k_printf_arg_type type;
+    union {
+        long long i;
+        unsigned long long u;
+        double d;
+        long double ld;
+        const char *s;
+        void *p;
+    } value;
+};
+
+/** \brief An argument array and its read position, passed to `k_printf_callback_argv_fn` */
+struct k_printf_args {
+    const struct k_printf_arg *argv;
+    size_t argc;
+    size_t index;
+};
+
+/** \brief Reads the next argument, or returns NULL if all arguments are used up */
+static inline const struct k_printf_arg *k_printf_args_next(struct k_printf_args *args) {
+    return args->index < args->argc ? &args->argv[args->index++] : NULL;
+}
+
+/** \brief Constructs an argument of each type, e.g. `k_printf_arg_int(1)` */
+#define k_printf_arg_int(v)         ((struct k_printf_arg){ K_PRINTF_ARG_INT,         { .i  = (v) } })
+#define k_printf_arg_uint(v)        ((struct k_printf_arg){ K_PRINTF_ARG_UINT,        { .u  = (v) } })
+#define k_printf_arg_double(v)      ((struct k_printf_arg){ K_PRINTF_ARG_DOUBLE,      { .d  = (v) } })
+#define k_printf_arg_long_double(v) ((struct k_printf_arg){ K_PRINTF_ARG_LONG_DOUBLE, { .ld = (v) } })
+#define k_printf_arg_str(v)         ((struct k_printf_arg){ K_PRINTF_ARG_STR,         { .s  = (v) } })
+#define k_printf_arg_ptr(v)         ((struct k_printf_arg){ K_PRINTF_ARG_PTR,         { .p  = (v) } })
+
+/**
+ * \brief Custom format specifier callback taking its arguments from an argument array
+ *
+ * Used by the `k_snprintf_argv` family; otherwise the same as `k_printf_callback_fn`.
+ * Read arguments with `k_printf_args_next(args)` and check their types.
+ * If arguments are missing or have the wrong type, set `buf->n` to -1.
+ *
+ * \param buf  The buffer.
+ * \param spec Details of the current format specifier.
+ * \param args The argument array, read arguments as needed.
+ */
+typedef void (*k_printf_callback_argv_fn)(struct k_printf_buf *buf, const struct k_printf_spec *spec, struct k_printf_args *args);
+
+struct k_printf_capture;
+
+/**
+ * \brief Callback capturing the arguments of a custom format specifier for deferred formatting
+ *
+ * `k_printf_defer` calls it to read arguments from the variable argument list. Consume the same
+ * arguments as the `k_printf_callback_fn` and save them with `k_printf_capture_arg` or
+ * `k_printf_capture_copy`. When the record is rendered later on the consumer thread,
+ * the saved arguments are passed, in order, to the `k_printf_callback_argv_fn`.
+ *
+ * Memory the arguments point to (an array, say) may be gone by render time;
+ * save a copy of it with `k_printf_capture_copy`.
+ *
+ * \param cap  The capture buffer.
+ * \param spec Details of the current format specifier.
+ * \param args Pointer to the variable argument list, consume arguments as needed.
+ * \return 0 on success, non-zero on failure.
+ */
+typedef int (*k_printf_capture_fn)(struct k_printf_capture *cap, const struct k_printf_spec *spec, va_list *args);
+
+/**
+ * \brief Saves one argument, for use in a `k_printf_capture_fn`
+ *
+ * \return 0 on success; -1 if the capture buffer is full or there are too many arguments (more than 64).
+ */
+int k_printf_capture_arg(struct k_printf_capture *cap, const struct k_printf_arg *arg);
+
+/**
+ * \brief Saves a copy of the `len` bytes at `data` as one argument, for use in a `k_printf_capture_fn`
+ *
+ * At render time the argument's `value.s` (for `K_PRINTF_ARG_STR`; the copy is terminated with `'\0'`)
+ * or `value.p` (for `K_PRINTF_ARG_PTR`) points to the copy.
+ *
+ * \return 0 on success; -1 if the capture buffer is full or there are too many arguments.
+ */
+int k_printf_capture_copy(struct k_printf_capture *cap, enum k_printf_arg_type type, const void *data, size_t len);
+
 /** \brief Unified interface for buffer operations, supporting both `char []` and `FILE *` types */
 struct k_printf_buf {
 
     /** \brief Writes a string of specified length to the buffer */
     void (*fn_puts)(struct k_printf_buf *buf, const char *str, size_t len);
 
+    /**
+     * \brief Writes a string of specified length that stays valid until the whole output is finished
+     *
+     * Same effect as `fn_puts`, but the buffer may just keep the `str` pointer and read the content later.
+     * For example, `k_dprintf` uses this to hand literal text of the format string to `writev` without copying.
+     * If the string lives in a temporary buffer of your callback, use `fn_puts` instead.
+     */
+    void (*fn_puts_ref)(struct k_printf_buf *buf, const char *str, size_t len);
+
     /** \brief Writes a formatted string to the buffer (C `printf` format specifiers). */
     void (*fn_printf)(struct k_printf_buf *buf, const char *fmt, ...);
 
     /** \brief Writes a formatted string to the buffer (C `printf` format specifiers). */
     void (*fn_vprintf)(struct k_printf_buf *buf, const char *fmt, va_list args);
 
+    /**
+     * \brief Reserves space that can be written in place
+     *
+     * Returns writable space for at least `len` characters, so you can write directly into it
+     * instead of formatting into a temporary buffer and copying.
+     * After writing, you must call `fn_commit` with the number of characters actually written
+     * (at most `len`). Do not write to the buffer in any other way before committing.
+     *
+     * If the buffer cannot provide the space directly (e.g. a `char []` without enough room left),
+     * a scratch area is returned and its content is written with `fn_puts` semantics on commit;
+     * this makes no difference to you.
+     *
+     * Returns NULL on error; do not call `fn_commit` in that case.
+     */
+    char *(*fn_reserve)(struct k_printf_buf *buf, size_t len);
+
+    /** \brief Commits `used` characters written into the space from `fn_reserve` */
+    void (*fn_commit)(struct k_printf_buf *buf, size_t used);
+
     /**
      * \brief Number of characters printed so far (ignores the actual buffer size).
      *
@@ -153,6 +302,23 @@ struct k_printf_spec {
     const char *end;
 };
 
+/**
+ * \brief Memory allocation statistics, see `k_printf_config->alloc_stats`
+ *
+ * The counters only increase. Compare them before and after a call to find how many allocations the call made.
+ */
+struct k_printf_alloc_stats {
+
+    /** \brief Number of allocations (including growth) */
+    unsigned long long alloc_num;
+
+    /** \brief Bytes allocated (including growth) */
+    unsigned long long alloc_bytes;
+
+    /** \brief Number of allocations refused because of `no_alloc` */
+    unsigned long long refused_num;
+};
+
 /**
  * \brief Configuration for custom format specifiers
  *
@@ -203,11 +369,87 @@ struct k_printf_config {
      *         Otherwise, it should return `NULL` and not move the string pointer.
      */
     k_printf_callback_fn (*fn_match_spec)(const char **str);
+
+    /**
+     * \brief Format string cache, may be NULL.
+     *
+     * Most call sites pass string literals, whose addresses never change while the program runs.
+     * With a cache, the `k_printf` functions use the address of the format string as the key
+     * and cache its compiled form (see `k_printf_compile`), so the same address is parsed only once.
+     *
+     * The cache compares addresses, not contents. If a format string is built dynamically
+     * (the content at an address may change), use a configuration without a cache,
+     * or disable it temporarily with `k_printf_cache_set_enabled`.
+     *
+     * With compilers that provide the GCC atomic builtins (GCC, Clang), configurations sharing one cache
+     * may be used from several threads at once. An evicted compiled format may still be in use by another
+     * thread, so it is freed by a later eviction once every call that started before it has returned.
+     * With other compilers the cache must only be used from one thread.
+     */
+    struct k_printf_cache *cache;
+
+    /**
+     * \brief Matches the format specifier at the start of the string, advancing the pointer
+     *        and returning the matched tuple on success. May be NULL.
+     *
+     * Same purpose as `fn_match_spec`, but returns the whole tuple, so `k_printf` can use
+     * the optional callbacks in it, such as `fn_measure`. If set, `fn_match_spec` is not used.
+     *
+     * `k_printf_match_tuple_helper` or `k_printf_match_tuple_trie` can do the matching for you.
+     */
+    const struct k_printf_spec_callback_tuple *(*fn_match_tuple)(const char **str);
+
+    /**
+     * \brief Memory allocation functions. May be NULL.
+     *
+     * Heap memory used temporarily during formatting (e.g. `fn_reserve` scratch space over 256 characters,
+     * `k_fprintf` output over 1023 characters, positional-argument items beyond the stack capacity),
+     * as well as the string returned by `k_asprintf`, is allocated and freed by these functions.
+     * The string returned by `k_asprintf` should then be freed with `fn_free` as well.
+     * Either all three functions are provided, or all are NULL (the C standard `malloc`, `realloc` and `free` are used).
+     *
+     * Memory that outlives a call (`k_printf_strbuf`, `k_printf_arena` chunks, compiled formats in the cache,
+     * the format table of `k_printf_binlog`, etc.) is freed by the object that owns it, without going through the configuration,
+     * so it is still allocated with the C standard functions, but it is still subject to `no_alloc` and counted in `alloc_stats`.
+     */
+    void *(*fn_malloc)(size_t size);
+    void *(*fn_realloc)(void *ptr, size_t size);
+    void  (*fn_free)(void *ptr);
+
+    /**
+     * \brief Memory allocation statistics. May be NULL.
+     *
+     * Each allocation made by a call using this configuration adds to the counters,
+     * so tests can assert how many allocations a call made.
+     * The counters are not thread-safe; leave this field NULL in configurations shared across threads.
+     */
+    struct k_printf_alloc_stats *alloc_stats;
+
+    /**
+     * \brief Forbid memory allocation
+     *
+     * If nonzero, calls using this configuration never allocate heap memory, which suits real-time threads.
+     * Cases that would allocate behave as follows instead:
+     *
+     * - On a cache miss the format string is not compiled but parsed directly (the result is the same);
+     * - All other cases are treated as errors and return a negative value:
+     *   `k_asprintf` always fails; `k_fprintf` output cannot exceed 1023 characters;
+     *   a format specifier handed to C `printf` cannot produce more than 255 characters through `k_xprintf`,
+     *   or more than 1023 characters through `k_dprintf`;
+     *   `fn_reserve` returns NULL for scratch space over 256 characters;
+     *   a format specifier with `auto_pad` cannot produce more than 255 characters through `k_xprintf`,
+     *   or through `k_dprintf` when right-justified;
+     *   `k_sbprintf` cannot grow the buffer, and `k_arena_printf` can only use chunks the arena already has.
+     *
+     * The `k_snprintf` family writing into `char []`, and `k_printf_len`, only fail when a callback requests
+     * more than 256 characters through `fn_reserve`; the built-in format specifiers never request that much.
+     */
+    int no_alloc;
 };
 
 /**
  * \brief Structure for defining a pair of format specifier and callback,
- * used only by `k_printf_match_spec_helper`
+ * used by `k_printf_match_spec_helper` and the other matching functions
  */
 struct k_printf_spec_callback_tuple {
 
@@ -216,6 +458,36 @@ struct k_printf_spec_callback_tuple {
 
     /** \brief The corresponding callback function */
     k_printf_callback_fn fn_callback;
+
+    /** \brief Callback computing the output length. May be NULL; only used when matched via `k_printf_config->fn_match_tuple` */
+    k_printf_measure_fn fn_measure;
+
+    /**
+     * \brief Callback taking its arguments from an argument array. May be NULL; only used when matched via `k_printf_config->fn_match_tuple`
+     *
+     * If it is not provided, the `k_snprintf_argv` family fails on this specifier.
+     */
+    k_printf_callback_argv_fn fn_callback_argv;
+
+    /**
+     * \brief Callback capturing arguments for deferred formatting. May be NULL; only used when matched via `k_printf_config->fn_match_tuple`
+     *
+     * If it (or `fn_callback_argv`) is not provided, `k_printf_defer` fails on this specifier.
+     */
+    k_printf_capture_fn fn_capture;
+
+    /**
+     * \brief When non-zero, `k_printf` applies the minimum width itself. Only used when matched via `k_printf_config->fn_match_tuple`
+     *
+     * `k_printf` reads a `*` minimum width, runs the callback, then adds spaces before or after its output according to `left_justified`.
+     * The `spec` the callback receives has `use_min_width` set to 0, so the callback neither needs to nor can pad; every other flag (including `zero_padding`) is passed through unchanged.
+     *
+     * When writing to a `char []` or heap memory, right-justified padding is appended and the callback's output is then shifted right in place, with no temporary buffer.
+     * Truncation gives the same result as formatting in full and then truncating. For other outputs, the callback's output is staged on the stack first (on the heap if it is long).
+     *
+     * `fn_capture` still receives the original `spec`; if the minimum width is given by `*`, it should capture that argument as usual.
+     */
+    int auto_pad;
 };
 
 /**
@@ -236,6 +508,85 @@ struct k_printf_spec_callback_tuple {
  */
 k_printf_callback_fn k_printf_match_spec_helper(const struct k_printf_spec_callback_tuple *tuples, const char **str);
 
+/** \brief Same as `k_printf_match_spec_helper`, but returns the matched tuple, for `k_printf_config->fn_match_tuple` */
+const struct k_printf_spec_callback_tuple *k_printf_match_tuple_helper(const struct k_printf_spec_callback_tuple *tuples, const char **str);
+
+struct k_printf_spec_trie;
+
+/**
+ * \brief Build a trie from an array of specifier tuples, for use with `k_printf_match_spec_trie`.
+ *
+ * `k_printf_match_spec_helper` walks every tuple on each match. If you have many specifiers,
+ * build them into a trie once and match with `k_printf_match_spec_trie` instead.
+ * The root of the trie is a jump table indexed by the first character of the type name,
+ * and the children of every other node are stored contiguously.
+ *
+ * `tuples` has the same requirements as for `k_printf_match_spec_helper`.
+ * The trie refers to the tuples, so `tuples` must stay valid until the trie is destroyed.
+ * If several tuples have the same type name, only the first one takes effect.
+ *
+ * \param tuples Array of specifier tuples terminated by `{ NULL, NULL }`.
+ * \return The trie on success, destroy it with `k_printf_spec_trie_destroy`; NULL on failure.
+ */
+struct k_printf_spec_trie *k_printf_spec_trie_create(const struct k_printf_spec_callback_tuple *tuples);
+
+/** \brief Destroy a trie, does nothing if `trie` is NULL. */
+void k_printf_spec_trie_destroy(struct k_printf_spec_trie *trie);
+
+/**
+ * \brief Match a format specifier with a trie and return the corresponding callback if matched.
+ *
+ * This function can replace `k_printf_match_spec_helper` in an implementation of
+ * `k_printf_config->fn_match_spec`, for example:
+ *
+ * ```C
+ * static struct k_printf_spec_trie *my_trie; // created by k_printf_spec_trie_create at startup
+ *
+ * static k_printf_callback_fn match_my_spec(const char **str) {
+ *     return k_printf_match_spec_trie(my_trie, str);
+ * }
+ * ```
+ *
+ * Unlike `k_printf_match_spec_helper`, this function uses longest-match semantics:
+ * if `%k` and `%kk` are both custom specifiers, `%kk` always matches `%kk`,
+ * regardless of the order of the tuples.
+ */
+k_printf_callback_fn k_printf_match_spec_trie(const struct k_printf_spec_trie *trie, const char **str);
+
+/** \brief Same as `k_printf_match_spec_trie`, but returns the matched tuple, for `k_printf_config->fn_match_tuple` */
+const struct k_printf_spec_callback_tuple *k_printf_match_tuple_trie(const struct k_printf_spec_trie *trie, const char **str);
+
+/**
+ * \brief Callback that prints a double in its shortest round-trip form
+ *
+ * Prints the shortest decimal digits that `strtod` reads back as exactly the same value.
+ * Fixed notation is used when the decimal exponent is in [-4, 17), `e` notation otherwise,
+ * e.g. `0.1`, `1e+17`. Width and the `-`, `+`, space and `0` flags are honoured;
+ * precision is ignored.
+ *
+ * The callback is not enabled by default. Register it as a custom specifier, e.g.:
+ *
+ * ```C
+ * struct k_printf_spec_callback_tuple tuples[] = {
+ *     { "Rg", k_printf_callback_double_shortest },
+ * };
+ * ```
+ *
+ * Then `k_printf(&config, "%Rg", 0.1)` prints `0.1`.
+ */
+void k_printf_callback_double_shortest(struct k_printf_buf *buf, const struct k_printf_spec *spec, va_list *args);
+
+/**
+ * \brief Argument array version of `k_printf_callback_double_shortest`, taking a `K_PRINTF_ARG_DOUBLE` argument
+ *
+ * ```C
+ * struct k_printf_spec_callback_tuple tuples[] = {
+ *     { "Rg", k_printf_callback_double_shortest, NULL, k_printf_callback_argv_double_shortest },
+ * };
+ * ```
+ */
+void k_printf_callback_argv_double_shortest(struct k_printf_buf *buf, const struct k_printf_spec *spec, struct k_printf_args *args);
+
 /**
  * \defgroup k_printf
  *
@@ -252,11 +603,41 @@ k_printf_callback_fn k_printf_match_spec_helper(const struct k_printf_spec_callb
  * the range of positive integers that can be represented by `int`.
  * Using `k_sprintf` is equivalent to using `k_snprintf` with `n` set to `INT_MAX`.
  *
+ * `k_snprintf_trunc` is like `k_snprintf`, but stops formatting as soon as the buffer is full:
+ * remaining callbacks are not run and the full output length is not computed.
+ * Use it when you only need the truncated result.
+ * If the output is truncated it returns `n` (any return value not less than `n` means truncation);
+ * otherwise it returns the length of the formatted string.
+ *
+ * `k_printf_len` only computes the length of the formatted string and produces no output.
+ * The lengths of integers and `%s`, and of custom specifiers whose tuple provides `fn_measure`
+ * (matched via `fn_match_tuple`), are computed arithmetically; the output of other specifiers is discarded.
+ * `k_snprintf` with `n` equal to 0 is the same as `k_printf_len`.
+ *
+ * `k_fprintf` formats into memory first and then writes the result with a single `fwrite`,
+ * so the output of one call never interleaves with output from other threads.
+ * If formatting fails, nothing is written.
+ *
+ * `k_dprintf` bypasses stdio and writes straight to a file descriptor (POSIX only).
+ * Literal text of the format string and `%s` arguments are not copied; they are passed
+ * as `struct iovec` segments, together with the rest, to a single `writev`.
+ *
  * The `k_asprintf` function allocates memory using `malloc` to store the formatted string,
  * and returns the string pointer through `get_s`, which the user is responsible for freeing.
+ * The format string is processed only once, so each callback is invoked exactly once.
+ *
+ * POSIX positional arguments are supported, e.g. `k_printf(&config, "%2$s %1$*3$d", 42, "x", 5)`,
+ * so that translated messages can reorder their arguments.
+ * Within one format string, either every specifier uses positional arguments
+ * (including `*m$` widths and precisions) or none does. The referenced numbers must run
+ * from 1 without gaps and must not exceed 64; otherwise it is an error.
+ * A positional custom specifier takes a single number, however many arguments it consumes,
+ * and its tuple must provide `fn_measure`, which `k_printf` uses to skip over its arguments
+ * and locate the ones that follow.
  *
  * \param config The configuration to be used for the output.
  * \param file   The `FILE *` to write the formatted string to.
+ * \param fd     The file descriptor to write the formatted string to.
  * \param buf    The `char []` buffer to write the formatted string to.
  * \param n      The length of the `char []` buffer.
  * \param get_s  The pointer to return the dynamically allocated string.
@@ -269,15 +650,569 @@ k_printf_callback_fn k_printf_match_spec_helper(const struct k_printf_spec_callb
  * @{
  */
 
-int k_fprintf  (const struct k_printf_config *config, FILE *file, const char *fmt, ...);
-int k_vfprintf (const struct k_printf_config *config, FILE *file, const char *fmt, va_list args);
-int k_sprintf  (const struct k_printf_config *config, char *buf, const char *fmt, ...);
-int k_vsprintf (const struct k_printf_config *config, char *buf, const char *fmt, va_list args);
-int k_snprintf (const struct k_printf_config *config, char *buf, size_t n, const char *fmt, ...);
-int k_vsnprintf(const struct k_printf_config *config, char *buf, size_t n, const char *fmt, va_list args);
-int k_asprintf (const struct k_printf_config *config, char **get_s, const char *fmt, ...);
-int k_vasprintf(const struct k_printf_config *config, char **get_s, const char *fmt, va_list args);
+int k_fprintf        (const struct k_printf_config *config, FILE *file, const char *fmt, ...);
+int k_vfprintf       (const struct k_printf_config *config, FILE *file, const char *fmt, va_list args);
+int k_sprintf        (const struct k_printf_config *config, char *buf, const char *fmt, ...);
+int k_vsprintf       (const struct k_printf_config *config, char *buf, const char *fmt, va_list args);
+int k_snprintf       (const struct k_printf_config *config, char *buf, size_t n, const char *fmt, ...);
+int k_vsnprintf      (const struct k_printf_config *config, char *buf, size_t n, const char *fmt, va_list args);
+int k_snprintf_trunc (const struct k_printf_config *config, char *buf, size_t n, const char *fmt, ...);
+int k_vsnprintf_trunc(const struct k_printf_config *config, char *buf, size_t n, const char *fmt, va_list args);
+int k_printf_len     (const struct k_printf_config *config, const char *fmt, ...);
+int k_vprintf_len    (const struct k_printf_config *config, const char *fmt, va_list args);
+int k_asprintf       (const struct k_printf_config *config, char **get_s, const char *fmt, ...);
+int k_vasprintf      (const struct k_printf_config *config, char **get_s, const char *fmt, va_list args);
+
+#if defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__))
+int k_dprintf        (const struct k_printf_config *config, int fd, const char *fmt, ...);
+int k_vdprintf       (const struct k_printf_config *config, int fd, const char *fmt, va_list args);
+#endif
+
+/** @} */
+
+/**
+ * \defgroup k_printf_strbuf
+ *
+ * \brief Reusable string buffer
+ *
+ * `k_printf_strbuf` owns a block of `malloc`-allocated memory and records the written length and the capacity.
+ * `k_sbprintf` appends the formatted result to the end of the buffer, doubling the capacity when space runs out.
+ * `k_printf_strbuf_clear` only empties the content and keeps the memory, so the cost of growing is amortized
+ * across repeated formatting, and no memory is allocated once the capacity stabilizes.
+ * Each thread can keep its own buffer (e.g. `_Thread_local`) and reuse it.
+ *
+ * ```C
+ * struct k_printf_strbuf sb = K_PRINTF_STRBUF_INIT;
+ * for (...) {
+ *     k_printf_strbuf_clear(&sb);
+ *     k_sbprintf(&config, &sb, "%d, %s\n", 1, "hello");
+ *     use(sb.data, sb.len);
+ * }
+ * k_printf_strbuf_free(&sb);
+ * ```
+ *
+ * The string in the buffer is always '\0'-terminated (`data` is NULL before any memory is allocated),
+ * and its total length does not exceed INT_MAX.
+ * If `k_sbprintf` fails, the content appended by that call is discarded and the buffer keeps
+ * its previous content (the capacity may have grown).
+ *
+ * A buffer must not be used by multiple threads at the same time.
+ *
+ * @{
+ */
+
+/** \brief String buffer; the zero value (`K_PRINTF_STRBUF_INIT`) is an empty buffer */
+struct k_printf_strbuf {
+
+    /** \brief The string, '\0'-terminated. NULL before any memory is allocated */
+    char *data;
+
+    /** \brief Length of the string (excluding '\0') */
+    size_t len;
+
+    /** \brief Size of the allocated memory */
+    size_t capacity;
+};
+
+/** \brief Initial value of an empty buffer */
+#define K_PRINTF_STRBUF_INIT { NULL, 0, 0 }
+
+/** \brief Initialize an empty buffer without allocating memory */
+void k_printf_strbuf_init(struct k_printf_strbuf *sb);
+
+/** \brief Free the buffer's memory; the buffer can still be used as an empty buffer afterwards */
+void k_printf_strbuf_free(struct k_printf_strbuf *sb);
+
+/** \brief Empty the buffer's content, keeping the allocated memory */
+void k_printf_strbuf_clear(struct k_printf_strbuf *sb);
+
+/**
+ * \brief Append a string of the given length to the end of the buffer
+ *
+ * \return On success, returns 0; on failure, returns -1 and the buffer is unchanged.
+ */
+int k_printf_strbuf_append(struct k_printf_strbuf *sb, const char *str, size_t len);
+
+/**
+ * \brief Take the string out of the buffer
+ *
+ * The returned string must be `free`d by the user, and the buffer is reset to an empty buffer.
+ *
+ * \param get_len Returns the length of the string, may be NULL
+ * \return On success, returns the string; on failure, returns NULL and the buffer is unchanged.
+ */
+char *k_printf_strbuf_detach(struct k_printf_strbuf *sb, size_t *get_len);
+
+/**
+ * \brief Append the formatted result to the end of the buffer
+ *
+ * \param config Configuration for this output; if NULL, the default configuration is used
+ * \param sb     String buffer
+ * \param fmt    Format string
+ * \return On success, returns the length of the appended string; on failure, returns -1.
+ */
+int k_sbprintf (const struct k_printf_config *config, struct k_printf_strbuf *sb, const char *fmt, ...);
+int k_vsbprintf(const struct k_printf_config *config, struct k_printf_strbuf *sb, const char *fmt, va_list args);
+
+/** @} */
+
+/**
+ * \defgroup k_printf_arena
+ *
+ * \brief Formatting into a memory pool
+ *
+ * If a batch of strings share the same lifetime (e.g. all become invalid once a request is processed),
+ * you can format them all into the same arena and reset or destroy the arena in one go at the end,
+ * without `free`ing them one by one.
+ *
+ * The arena requests memory from the system in chunks. `k_arena_printf` formats directly into the free tail
+ * of the current chunk and advances the pointer when done, without an intermediate buffer
+ * and without a separate `malloc` per string.
+ * When the current chunk cannot hold the string, a new chunk no smaller than `chunk_size`
+ * (and large enough for the string) is taken, and the rest of the old chunk is no longer used.
+ *
+ * `k_printf_arena_reset` invalidates all strings obtained before, but keeps the allocated chunks for later reuse,
+ * so if the arena is reset after each request, no memory is allocated once the capacity stabilizes.
+ *
+ * ```C
+ * struct k_printf_arena *arena = k_printf_arena_create(0);
+ * for (...) {
+ *     char *s1 = k_arena_printf(&config, arena, "%d, %s", 1, "hello");
+ *     char *s2 = k_arena_printf(&config, arena, "%d, %s", 2, "world");
+ *     ...
+ *     k_printf_arena_reset(arena);
+ * }
+ * k_printf_arena_destroy(arena);
+ * ```
+ *
+ * An arena must not be used by multiple threads at the same time.
+ *
+ * @{
+ */
+
+struct k_printf_arena;
+
+/**
+ * \brief Create an arena
+ *
+ * \param chunk_size Size of each chunk requested from the system; if 0, the default (4096) is used
+ * \return On success, returns the arena; on failure, returns NULL.
+ */
+struct k_printf_arena *k_printf_arena_create(size_t chunk_size);
+
+/** \brief Destroy the arena and free all its memory. If `arena` is NULL, does nothing */
+void k_printf_arena_destroy(struct k_printf_arena *arena);
+
+/** \brief Invalidate all strings in the arena, keeping the allocated chunks for later reuse */
+void k_printf_arena_reset(struct k_printf_arena *arena);
+
+/**
+ * \brief Write the formatted result into the arena
+ *
+ * \param config Configuration for this output; if NULL, the default configuration is used
+ * \param arena  The arena
+ * \param fmt    Format string
+ * \return On success, returns a '\0'-terminated string, valid until the arena is reset or destroyed; on failure, returns NULL.
+ */
+char *k_arena_printf (const struct k_printf_config *config, struct k_printf_arena *arena, const char *fmt, ...);
+char *k_varena_printf(const struct k_printf_config *config, struct k_printf_arena *arena, const char *fmt, va_list args);
+
+/** @} */
+
+/**
+ * \defgroup k_printf_sink
+ *
+ * \brief Custom output destinations
+ *
+ * To write formatted output into your own destination (a shared-memory ring, a socket buffer,
+ * a compression stream, ...), implement a `k_printf_sink` and print with `k_xprintf`.
+ * No intermediate `k_asprintf` string and copy are needed.
+ *
+ * Usually `k_printf_sink` is the first member of your own struct,
+ * and the callbacks cast the `sink` pointer back to it:
+ *
+ * ```C
+ * struct my_sink {
+ *     struct k_printf_sink impl;
+ *     struct my_ring *ring;
+ * };
+ *
+ * static int my_sink_puts(struct k_printf_sink *sink, const char *str, size_t len) {
+ *     struct my_ring *ring = ((struct my_sink *)sink)->ring;
+ *     return my_ring_write(ring, str, len);
+ * }
+ *
+ * struct my_sink sink = { .impl = { .fn_puts = my_sink_puts }, .ring = ring };
+ * k_xprintf(&config, &sink.impl, "%d, %s\n", 1, "hello");
+ * ```
+ *
+ * @{
+ */
+
+/** \brief Operations of a custom output destination */
+struct k_printf_sink {
+
+    /**
+     * \brief Writes a string of specified length. Required.
+     *
+     * \return 0 on success; non-zero on failure, after which `k_xprintf` writes nothing more.
+     */
+    int (*fn_puts)(struct k_printf_sink *sink, const char *str, size_t len);
+
+    /**
+     * \brief Reserves space that can be written in place. May be NULL.
+     *
+     * Returns writable space for at least `len` characters. After writing, `k_xprintf` calls
+     * `fn_commit` with the number of characters actually written.
+     * Return NULL if the space cannot be provided right now; `k_xprintf` then uses `fn_puts`.
+     */
+    char *(*fn_reserve)(struct k_printf_sink *sink, size_t len);
+
+    /** \brief Commits `used` characters written into the space from `fn_reserve`. Required if `fn_reserve` is set. */
+    void (*fn_commit)(struct k_printf_sink *sink, size_t used);
+
+    /**
+     * \brief Called when formatting is finished. May be NULL.
+     *
+     * \return 0 on success; non-zero on failure.
+     */
+    int (*fn_flush)(struct k_printf_sink *sink);
+
+    /** \brief Error state; non-zero means an error occurred. Set it to 0 before calling `k_xprintf`. */
+    int error;
+
+    /** \brief Total number of characters written, maintained by `k_xprintf` and accumulated across calls. */
+    unsigned long long count;
+};
+
+/**
+ * \brief Writes a formatted string to a custom output destination
+ *
+ * \return The number of characters written by this call on success;
+ *         -1 on failure, with `sink->error` set to non-zero.
+ *
+ * The count is correct even if it exceeds the range of int.
+ * In that case `k_printf_buf->n` as seen by callbacks stays at INT_MAX.
+ */
+long long k_xprintf (const struct k_printf_config *config, struct k_printf_sink *sink, const char *fmt, ...);
+long long k_vxprintf(const struct k_printf_config *config, struct k_printf_sink *sink, const char *fmt, va_list args);
+
+/** @} */
+
+/**
+ * \defgroup k_printf_argv
+ *
+ * \brief Argument arrays instead of variable argument lists
+ *
+ * Format specifiers take the arguments in `argv` in the order they appear.
+ * A `*` width or precision takes one integer argument of its own.
+ * The argument array is never modified, so the same arguments can be printed again and again,
+ * e.g. a log record captures its arguments once and is rendered later on demand.
+ *
+ * ```C
+ * struct k_printf_arg argv[] = { k_printf_arg_int(1), k_printf_arg_str("hello") };
+ * k_snprintf_argv(&config, buf, sizeof(buf), "%d, %s\n", argv, 2);
+ * ```
+ *
+ * It is an error if arguments are missing, if an argument's type does not match its specifier,
+ * or if a custom specifier has no `fn_callback_argv`. Extra arguments are ignored.
+ * Specifiers may also use positional arguments `%n$` and `*m$`, which take the argument
+ * with that number from `argv` directly; a following non-positional specifier continues
+ * with the argument after it.
+ * If `config` is NULL, only the C `printf` specifiers are supported.
+ *
+ * @{
+ */
+
+/**
+ * \brief Same as `k_snprintf`, but takes the arguments from an argument array
+ *
+ * \return The length of the formatted string on success, a negative value on failure.
+ */
+int k_snprintf_argv(const struct k_printf_config *config, char *buf, size_t n, const char *fmt,
+                    const struct k_printf_arg *argv, size_t argc);
+
+/** \brief Same as `k_xprintf`, but takes the arguments from an argument array */
+long long k_xprintf_argv(const struct k_printf_config *config, struct k_printf_sink *sink, const char *fmt,
+                         const struct k_printf_arg *argv, size_t argc);
+
+/**
+ * \brief A format string already split into items, for `k_snprintf_items` and `k_xprintf_items`
+ *
+ * A literal item has a NULL `spec.type` and covers `[spec.start, spec.end)`; `%%` must already be
+ * reduced to a single `%`. A specifier item holds the same `spec` that `k_printf` would parse, and
+ * `tuple` is its tuple; a NULL `tuple` means a C `printf` specifier.
+ */
+struct k_printf_item {
+    struct k_printf_spec spec;
+    const struct k_printf_spec_callback_tuple *tuple;
+};
+
+/**
+ * \brief Same as `k_snprintf_argv`, but writes the items in `items` instead of parsing a format string
+ *
+ * Meant for callers that split the format string at compile time, such as the C++ `k_printf_cpp::format`.
+ * Specifier items take their arguments in order. Custom specifiers call `tuple->fn_callback_argv`
+ * (padded according to `auto_pad`) without going through the matching or the cache of `config`;
+ * `config` only supplies the allocation settings and may be NULL.
+ */
+int k_snprintf_items(const struct k_printf_config *config, char *buf, size_t n,
+                     const struct k_printf_item *items, size_t item_num,
+                     const struct k_printf_arg *argv, size_t argc);
+
+/** \brief Same as `k_xprintf_argv`, but writes the items in `items`, see `k_snprintf_items` */
+long long k_xprintf_items(const struct k_printf_config *config, struct k_printf_sink *sink,
+                          const struct k_printf_item *items, size_t item_num,
+                          const struct k_printf_arg *argv, size_t argc);
+
+/** @} */
+
+#if defined(__GNUC__) || defined(__clang__)
+
+/**
+ * \defgroup k_printf_defer
+ *
+ * \brief Deferred formatting
+ *
+ * Latency-sensitive threads can skip formatting altogether: `k_printf_defer` only captures the
+ * arguments into a lock-free queue, and a background thread later takes the records out with
+ * `k_printf_queue_drain`, formats them and writes them to a custom output destination:
+ *
+ * ```C
+ * struct k_printf_queue *queue = k_printf_queue_create(1024, 256);
+ *
+ * // any thread
+ * k_printf_defer(&config, queue, "user %s, id %d\n", name, id);
+ *
+ * // background thread
+ * k_printf_queue_drain(queue, &sink.impl, SIZE_MAX);
+ * ```
+ *
+ * The queue consists of fixed-size slots. Each record takes one slot and holds the `config` and
+ * `fmt` pointers plus a compact encoding of the arguments. Integers, floating-point numbers and
+ * pointers are saved by value; `%s` strings are deep-copied (at most precision characters if a
+ * precision is given); custom specifiers save their arguments through the `fn_capture` of their
+ * tuple and are rendered by its `fn_callback_argv`. Hence `config` and `fmt` must stay valid until
+ * the record is rendered; usually they are globals and string literals.
+ * Rendering happens on the consumer thread; if `config` has a cache, the consumer thread uses it too.
+ *
+ * Positional arguments, the `%n` family and `%ls` are not supported.
+ *
+ * When decoding, both the format strings and the arguments come from the data. A format definition
+ * record containing specifiers the writer never produces (the unsupported forms above, or custom
+ * specifiers whose tuple lacks `fn_capture` and `fn_callback_argv`) is treated as invalid data.
+ * Pointer arguments handed to a custom `fn_callback_argv` also come from the data and must not be
+ * dereferenced unless they are copies saved by `fn_capture`; the contents of those copies also come
+ * from the data, so a callback decoding untrusted logs must not rely on lengths stored inside them.
+ *
+ * @{
+ */
+
+struct k_printf_queue;
+
+/**
+ * \brief Creates a deferred formatting queue
+ *
+ * \param slot_num  The number of slots, rounded up to a power of two.
+ * \param slot_size The number of bytes for the argument encoding in each slot,
+ *                   e.g. an int takes 9 bytes, a string its length plus 10 bytes.
+ * \return The queue on success, to be destroyed with `k_printf_queue_destroy`; NULL on failure.
+ */
+struct k_printf_queue *k_printf_queue_create(size_t slot_num, size_t slot_size);
+
+/** \brief Destroys a queue, discarding unrendered records. Does nothing if `queue` is NULL. */
+void k_printf_queue_destroy(struct k_printf_queue *queue);
+
+/**
+ * \brief Captures the arguments into the queue. May be called from many threads at once.
+ *
+ * \return 0 on success; -1 if the queue is full, the argument encoding does not fit into a slot,
+ *         or a specifier cannot be deferred.
+ */
+int k_printf_defer (const struct k_printf_config *config, struct k_printf_queue *queue, const char *fmt, ...);
+int k_vprintf_defer(const struct k_printf_config *config, struct k_printf_queue *queue, const char *fmt, va_list args);
+
+/**
+ * \brief Takes up to `max` records out of the queue in order, formats them and writes them to `sink`.
+ *        Only one thread may call it at a time.
+ *
+ * Each record is output as if by one call to `k_xprintf`.
+ *
+ * \return The number of records rendered, 0 if the queue is empty.
+ */
+size_t k_printf_queue_drain(struct k_printf_queue *queue, struct k_printf_sink *sink, size_t max);
 
 /** @} */
 
 #endif
+
+/**
+ * \defgroup k_printf_binlog
+ *
+ * \brief Binary log
+ *
+ * `k_printf_binlog` does no formatting: it writes only a format ID plus a compact encoding of the
+ * arguments to a custom output destination. `k_printf_binlog_decode` (or the command-line tool
+ * `k_printf_decode`) turns the stream back into text offline:
+ *
+ * ```C
+ * struct k_printf_binlog *log = k_printf_binlog_create(&config, &sink.impl);
+ * k_printf_binlog(log, "user %s, id %d\n", name, id);
+ * k_printf_binlog_destroy(log);
+ *
+ * // offline decoding, with the same config
+ * k_printf_binlog_decode(&config, data, len, &out.impl);
+ * ```
+ *
+ * Each format string gets an ID keyed by its address. A format definition record is written the
+ * first time it is seen; after that every record holds only the ID and the arguments. Integers and
+ * pointers are encoded as varints, floating-point numbers as their raw bytes, and `%s` strings as a
+ * length plus their contents (at most precision characters if a precision is given). Custom
+ * specifiers save their arguments through the `fn_capture` of their tuple and are decoded by its
+ * `fn_callback_argv`. Hence `fmt` must stay valid and unchanged until the writer is destroyed;
+ * usually it is a string literal.
+ *
+ * Floating-point numbers are stored in host byte order, so the decoder must use the same byte order
+ * and `long double` format as the writer. `%p` decodes to the original address value.
+ * Positional arguments, the `%n` family and `%ls` are not supported.
+ *
+ * Streams concatenated back to back (e.g. a file appended to several times) still decode correctly.
+ *
+ * @{
+ */
+
+struct k_printf_binlog;
+
+/**
+ * \brief Create a binary log writer. A writer must not be used from several threads at once
+ *
+ * \param config The config used to capture arguments; if NULL, only C `printf` specifiers are supported
+ * \param sink   The output destination, which must stay valid until the writer is destroyed
+ * \return On success, the writer, to be destroyed with `k_printf_binlog_destroy`; on failure, NULL.
+ */
+struct k_printf_binlog *k_printf_binlog_create(const struct k_printf_config *config, struct k_printf_sink *sink);
+
+/** \brief Destroy a writer; does nothing if `log` is NULL */
+void k_printf_binlog_destroy(struct k_printf_binlog *log);
+
+/**
+ * \brief Write one binary log record; `sink->fn_flush` is called once at the end of each call
+ *
+ * \return On success, the number of bytes written by this call; on failure, -1, and `sink->error`
+ *         is also set to a non-zero value if output failed.
+ */
+long long k_printf_binlog (struct k_printf_binlog *log, const char *fmt, ...);
+long long k_vprintf_binlog(struct k_printf_binlog *log, const char *fmt, va_list args);
+
+/**
+ * \brief Turn an in-memory binary log back into text written to `sink`; each record is output as if
+ *        by one call to `k_xprintf`
+ *
+ * \param config The config used for rendering; its custom specifiers should match the writer's
+ * \return On success, the number of records decoded; if the data is malformed or output fails, -1,
+ *         with the preceding records already output.
+ */
+long long k_printf_binlog_decode(const struct k_printf_config *config, const void *data, size_t len,
+                                 struct k_printf_sink *sink);
+
+/** @} */
+
+/**
+ * \defgroup k_printf_format
+ *
+ * \brief Precompiled format strings
+ *
+ * Every `k_printf` call scans the format string and extracts and matches every specifier.
+ * If the same format string is used again and again, compile it once with `k_printf_compile`
+ * and output with the `k_printf_exec` family. These functions no longer parse the format string,
+ * they only write the literal text and call the callbacks matched at compile time.
+ *
+ * A compiled format is immutable and may be used from several threads at the same time.
+ * The format string is copied during compilation, so the original may be modified or freed.
+ * The `config` used for compilation and the callbacks it matched must stay valid
+ * until the compiled format is freed.
+ *
+ * The output is identical to that of the corresponding `k_printf` function.
+ *
+ * @{
+ */
+
+struct k_printf_format;
+
+/**
+ * \brief Compile a format string.
+ *
+ * \param config Configuration used for compilation (NULL for default).
+ * \param fmt    The format string.
+ * \return The compiled format on success, free it with `k_printf_format_free`; NULL on failure.
+ */
+struct k_printf_format *k_printf_compile(const struct k_printf_config *config, const char *fmt);
+
+/** \brief Free a compiled format, does nothing if `format` is NULL. */
+void k_printf_format_free(struct k_printf_format *format);
+
+/**
+ * \brief Output with a compiled format, usage is the same as the corresponding `k_printf` function.
+ *
+ * `k_printf_exec` writes to `stdout`.
+ */
+int k_printf_exec       (const struct k_printf_format *format, ...);
+int k_fprintf_compiled  (const struct k_printf_format *format, FILE *file, ...);
+int k_vfprintf_compiled (const struct k_printf_format *format, FILE *file, va_list args);
+int k_snprintf_compiled (const struct k_printf_format *format, char *buf, size_t n, ...);
+int k_vsnprintf_compiled(const struct k_printf_format *format, char *buf, size_t n, va_list args);
+
+/** @} */
+
+/**
+ * \defgroup k_printf_cache
+ *
+ * \brief Format string cache
+ *
+ * The cache maps format string addresses to their compiled form, see `k_printf_config->cache`.
+ * It has a fixed capacity and is direct-mapped: every address maps to one slot,
+ * and an entry is evicted when another format string needs its slot.
+ *
+ * @{
+ */
+
+/** \brief Cache statistics */
+struct k_printf_cache_stats {
+
+    /** \brief Number of hits */
+    unsigned long long hits;
+
+    /** \brief Number of misses */
+    unsigned long long misses;
+
+    /** \brief Number of evictions */
+    unsigned long long evictions;
+};
+
+/**
+ * \brief Create a format string cache.
+ *
+ * \param capacity The capacity, rounded up to a power of 2.
+ * \return The cache on success, destroy it with `k_printf_cache_destroy`; NULL on failure.
+ */
+struct k_printf_cache *k_printf_cache_create(size_t capacity);
+
+/** \brief Destroy a cache, does nothing if `cache` is NULL. Must not run concurrently with calls using the cache. */
+void k_printf_cache_destroy(struct k_printf_cache *cache);
+
+/** \brief Drop all compiled formats in the cache, statistics are kept. Must not run concurrently with calls using the cache. */
+void k_printf_cache_clear(struct k_printf_cache *cache);
+
+/** \brief Enable or disable the cache, while disabled the format strings are parsed directly. */
+void k_printf_cache_set_enabled(struct k_printf_cache *cache, int enabled);
+
+/** \brief Get the cache statistics. */
+void k_printf_cache_get_stats(const struct k_printf_cache *cache, struct k_printf_cache_stats *get_stats);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
@@ -0,0 +1,673 @@
+#ifndef K_PRINTF_HPP
+#define K_PRINTF_HPP
+
+#if __cplusplus < 202002L
+#error "k_printf.hpp requires C++20"
+#endif
+
+#include <array>
+#include <climits>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "k_printf.h"
+
+/**
+ * \brief C++ interface of `k_printf`
+ *
+ * The global namespace already has the function `k_printf`, so the C++ interface lives in the
+ * namespace `k_printf_cpp`.
+ *
+ * The format string is passed as a template argument and parsed at compile time: compilation fails
+ * if the number of arguments or an argument type does not match the specifiers, or if the format
+ * string is invalid. Once their types are resolved at compile time, the arguments are converted to
+ * `k_printf_arg`, without a variable argument list. The format string is split into literals and
+ * specifiers at compile time and output item by item through the `k_xprintf_items` family at run
+ * time, without being parsed again:
+ *
+ * ```C++
+ * using arr = k_printf_cpp::custom<"arr", 2>;
+ *
+ * k_printf_cpp::format<"%s = %arr\n", arr>(&config, &sink, name, data, 5);
+ * ```
+ *
+ * Custom specifiers must be declared with `custom` (name and number of arguments consumed), be
+ * registered in `config`, and provide `fn_callback_argv`. Like `k_printf_match_tuple_helper`, the
+ * compile-time parser matches the first declared specifier whose name fits; when a `spec_table` is
+ * passed it uses the longest match, like `k_printf_match_tuple_trie`. `config` should match the
+ * same way.
+ *
+ * When every custom specifier is declared with `spec` or `spec_table`, the callbacks are known at
+ * compile time and the items record their entries directly; at run time neither the match function
+ * of `config` nor the cache is consulted. If any specifier is declared with `custom`, its callback
+ * is not known at compile time, and output goes through the `k_xprintf_argv` family instead, with
+ * `config` parsing the format string at run time; since the address of the format string is unique
+ * across the program, a cache in `config` parses it only on the first call.
+ *
+ * Format strings are stricter than in the C interface: positional arguments are not supported,
+ * unrecognized specifiers are errors, and a literal `%` must be written `%%`.
+ */
+namespace k_printf_cpp {
+
+/** \brief A string literal usable as a template argument */
+template <std::size_t N>
+struct fixed_string {
+    char data[N] {};
+
+    consteval fixed_string(const char (&str)[N]) {
+        for (std::size_t i = 0; i < N; i++)
+            data[i] = str[i];
+    }
+
+    constexpr std::string_view view() const {
+        return std::string_view(data, N - 1);
+    }
+};
+
+/**
+ * \brief Declare a custom format specifier
+ *
+ * \tparam Name The name of the specifier, e.g. `"arr"`
+ * \tparam Argc The number of arguments it consumes. Arguments are converted to `k_printf_arg` by type:
+ *              signed integers to `K_PRINTF_ARG_INT`, unsigned integers to `K_PRINTF_ARG_UINT`,
+ *              floating-point numbers to `K_PRINTF_ARG_DOUBLE` or `K_PRINTF_ARG_LONG_DOUBLE`,
+ *              `char *` and `std::string` to `K_PRINTF_ARG_STR`, other pointers to `K_PRINTF_ARG_PTR`.
+ */
+template <fixed_string Name, std::size_t Argc>
+struct custom {
+    static_assert(1 < sizeof(Name.data), "k_printf: the name of a format specifier must not be empty");
+
+    static constexpr std::string_view name = Name.view();
+    static constexpr std::size_t argc = Argc;
+};
+
+/**
+ * \brief Declare a custom format specifier with its callbacks, for use in `spec_table`
+ *
+ * See `k_printf_spec_callback_tuple` for the callbacks and `AutoPad`, and `custom` for `Argc`.
+ */
+template <fixed_string Name, k_printf_callback_fn Callback, std::size_t Argc = 0,
+          k_printf_callback_argv_fn CallbackArgv = nullptr, k_printf_measure_fn Measure = nullptr,
+          k_printf_capture_fn Capture = nullptr, bool AutoPad = false>
+struct spec : custom<Name, Argc> {
+    static constexpr k_printf_spec_callback_tuple tuple { Name.data, Callback, Measure, CallbackArgv, Capture, AutoPad };
+};
+
+namespace detail {
+
+struct custom_info {
+    std::string_view name;
+    std::size_t argc;
+    const k_printf_spec_callback_tuple *tuple; /* its entry when declared with `spec`, nullptr when declared with `custom` */
+    bool has_tuple;
+};
+
+inline constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+/* Trie node, as in `k_printf_spec_trie`: the children of a node are stored contiguously,
+ * sorted by their edge character */
+struct trie_node {
+    std::size_t tuple;       /* index of the tuple ending at this node, or npos */
+    std::size_t first_child;
+    std::size_t child_num;
+    unsigned char ch;
+};
+
+/* Build a trie of the type names at compile time; `M` is the node count, i.e. the total length of
+ * the names plus 1.
+ *
+ * Same algorithm as `k_printf_spec_trie_create`: sort the names, then build breadth-first.
+ * For duplicate names the earlier one wins.
+ */
+template <std::size_t M, std::size_t N>
+consteval std::array<trie_node, M> build_trie(const std::array<custom_info, N> &specs) {
+
+    std::array<std::size_t, N> sorted {};
+    for (std::size_t i = 0; i < N; i++)
+        sorted[i] = i;
+    for (std::size_t i = 1; i < N; i++) {
+        for (std::size_t j = i; 0 < j && specs[sorted[j]].name < specs[sorted[j - 1]].name; j--)
+            std::swap(sorted[j], sorted[j - 1]);
+    }
+
+    std::array<trie_node, M> nodes {};
+    std::array<std::size_t, M> depth_of {};
+    std::array<std::size_t, M> lo_of {};
+
+    /* before a node is expanded, its `child_num` holds the length of its range in `sorted` */
+    nodes[0] = trie_node { npos, 0, N, '\0' };
+
+    std::size_t created = 1;
+    for (std::size_t idx = 0; idx < created; idx++) {
+        std::size_t depth = depth_of[idx];
+        std::size_t lo    = lo_of[idx];
+        std::size_t hi    = lo + nodes[idx].child_num;
+
+        auto name = [&](std::size_t k) { return specs[sorted[k]].name; };
+
+        nodes[idx].tuple = (0 != depth && lo < hi && name(lo).size() == depth) ? sorted[lo] : npos;
+        while (lo < hi && name(lo).size() == depth)
+            lo++;
+
+        nodes[idx].first_child = created;
+        nodes[idx].child_num   = 0;
+
+        while (lo < hi) {
+            unsigned char ch = static_cast<unsigned char>(name(lo)[depth]);
+
+            std::size_t end = lo + 1;
+            while (end < hi && static_cast<unsigned char>(name(end)[depth]) == ch)
+                end++;
+
+            nodes[created]    = trie_node { npos, 0, end - lo, ch };
+            depth_of[created] = depth + 1;
+            lo_of[created]    = lo;
+
+            created++;
+            nodes[idx].child_num++;
+            lo = end;
+        }
+    }
+
+    return nodes;
+}
+
+template <std::size_t N>
+consteval std::size_t trie_node_num(const std::array<custom_info, N> &specs) {
+    std::size_t num = 1;
+    for (const custom_info &info : specs)
+        num += info.name.size();
+    return num;
+}
+
+} // namespace detail
+
+/**
+ * \brief A config generated at compile time from a set of format specifiers
+ *
+ * As with `k_printf_spec_trie`, the specifiers form a trie with longest-match semantics, and for
+ * duplicate names the earlier one wins. The difference is that the trie is built at compile time and
+ * the matcher `match_tuple` is unrolled into per-level character comparisons instead of walking a
+ * node array:
+ *
+ * ```C++
+ * using my_specs = k_printf_cpp::spec_table<
+ *     k_printf_cpp::spec<"arr", arr_callback, 2, arr_callback_argv>,
+ *     k_printf_cpp::spec<"ip",  ip_callback,  1, ip_callback_argv>>;
+ *
+ * static const k_printf_config config = my_specs::config();
+ *
+ * k_printf(&config, "%arr %ip\n", data, 5, addr);
+ * k_printf_cpp::format<"%arr %ip\n", my_specs>(&config, &sink, data, 5, addr);
+ * ```
+ *
+ * When passed to `format`, compile-time parsing uses the longest match as well.
+ */
+template <class... Specs>
+struct spec_table {
+    static_assert(0 < sizeof...(Specs), "k_printf: a spec table needs at least one format specifier");
+
+    static constexpr std::array<detail::custom_info, sizeof...(Specs)> customs {
+        detail::custom_info { Specs::name, Specs::argc, &Specs::tuple, true }...
+    };
+
+    /** \brief The tuple array, terminated by `{ NULL, NULL }`, usable with `k_printf_match_tuple_helper` etc. */
+    static constexpr k_printf_spec_callback_tuple tuples[] { Specs::tuple..., { nullptr, nullptr, nullptr, nullptr, nullptr, 0 } };
+
+    static constexpr auto trie = detail::build_trie<detail::trie_node_num(customs)>(customs);
+
+    /** \brief For `k_printf_config->fn_match_tuple` */
+    static const k_printf_spec_callback_tuple *match_tuple(const char **str) {
+        return match_node<0>(*str, str, nullptr, nullptr);
+    }
+
+    /** \brief For `k_printf_config->fn_match_spec` */
+    static k_printf_callback_fn match_spec(const char **str) {
+        const k_printf_spec_callback_tuple *tuple = match_tuple(str);
+        return (nullptr != tuple) ? tuple->fn_callback : nullptr;
+    }
+
+    /** \brief A config using these specifiers, with all other fields empty */
+    static constexpr k_printf_config config() {
+        k_printf_config config {};
+        config.fn_match_tuple = match_tuple;
+        return config;
+    }
+
+private:
+    /* Node `I` has been matched and `s` points to the next character; `matched` is the longest match so far */
+    template <std::size_t I>
+    static const k_printf_spec_callback_tuple *match_node(const char *s, const char **str,
+                                                          const k_printf_spec_callback_tuple *matched,
+                                                          const char *matched_end) {
+        if constexpr (detail::npos != trie[I].tuple) {
+            matched     = &tuples[trie[I].tuple];
+            matched_end = s;
+        }
+        return match_children<I>(s, str, matched, matched_end, std::make_index_sequence<trie[I].child_num> {});
+    }
+
+    template <std::size_t I, std::size_t... K>
+    static const k_printf_spec_callback_tuple *match_children(const char *s, const char **str,
+                                                              const k_printf_spec_callback_tuple *matched,
+                                                              const char *matched_end, std::index_sequence<K...>) {
+        [[maybe_unused]] const unsigned char ch = static_cast<unsigned char>(*s);
+        const k_printf_spec_callback_tuple *r = nullptr;
+
+        if (((trie[trie[I].first_child + K].ch == ch
+              && (r = match_node<trie[I].first_child + K>(s + 1, str, matched, matched_end), true)) || ...))
+            return r;
+
+        if (nullptr != matched)
+            *str = matched_end;
+        return matched;
+    }
+};
+
+namespace detail {
+
+/* Kind of argument a specifier expects */
+enum class arg_kind {
+    integer,       /* integer: `%d`, `%c`, `*` etc. */
+    floating,      /* floating point, output as double */
+    long_floating, /* floating point, output as long double */
+    string,        /* string: `%s` */
+    pointer,       /* pointer: `%p` and `%ls` */
+    int_pointer,   /* pointer to integer: the `%n` family */
+    custom_arg,    /* argument of a custom specifier, converted by type */
+};
+
+consteval bool is_digit(char ch) {
+    return '0' <= ch && ch <= '9';
+}
+
+/* Parse the length modifier and conversion of a C `printf` specifier; returns false if invalid */
+consteval bool parse_c_std_spec(std::string_view fmt, std::size_t &i, arg_kind &kind) {
+
+    std::string_view length;
+    for (std::string_view mod : { "hh", "ll", "h", "l", "j", "z", "t", "L" }) {
+        if (fmt.substr(i).starts_with(mod)) {
+            length = mod;
+            break;
+        }
+    }
+    i += length.size();
+    if (fmt.size() <= i)
+        return false;
+
+    const char conv = fmt[i++];
+    const std::string_view ints = "diouxX";
+    const std::string_view floats = "eEfFgGaA";
+
+    if (std::string_view::npos != ints.find(conv)) {
+        kind = arg_kind::integer;
+        return "L" != length;
+    }
+    if ('n' == conv) {
+        kind = arg_kind::int_pointer;
+        return "L" != length;
+    }
+    if (std::string_view::npos != floats.find(conv)) {
+        kind = ("L" == length) ? arg_kind::long_floating : arg_kind::floating;
+        return length.empty() || "l" == length || "L" == length;
+    }
+    if ('c' == conv) {
+        kind = arg_kind::integer;
+        return length.empty() || "l" == length;
+    }
+    if ('s' == conv) {
+        kind = ("l" == length) ? arg_kind::pointer : arg_kind::string;
+        return length.empty() || "l" == length;
+    }
+    if ('p' == conv) {
+        kind = arg_kind::pointer;
+        return length.empty();
+    }
+    return false;
+}
+
+/* Parse a decimal integer, clamping values beyond int to INT_MAX, like `extract_non_negative_int` */
+consteval int parse_int(std::string_view fmt, std::size_t &i) {
+    long long v = 0;
+    while (i < fmt.size() && is_digit(fmt[i])) {
+        v = v * 10 + (fmt[i++] - '0');
+        if (INT_MAX < v)
+            v = INT_MAX;
+    }
+    return static_cast<int>(v);
+}
+
+/* Parse the format string, writing the kind of each argument to `kinds` (may be nullptr);
+ * returns the number of arguments, or npos if invalid.
+ *
+ * Custom specifiers use the first match in order, or the longest match if `longest` is true.
+ * If `items` is given, the split items are written to it as well, with pointers into `base`, the
+ * storage of the format string in the program; the number of items is returned through
+ * `get_item_num` (may be nullptr).
+ */
+consteval std::size_t parse_format(std::string_view fmt, const custom_info *customs, std::size_t custom_num,
+                                   bool longest, arg_kind *kinds, const char *base = nullptr,
+                                   k_printf_item *items = nullptr, std::size_t *get_item_num = nullptr) {
+
+    std::size_t argc = 0;
+    auto push = [&](arg_kind kind) {
+        if (nullptr != kinds)
+            kinds[argc] = kind;
+        argc++;
+    };
+
+    std::size_t item_num = 0;
+    auto push_item = [&](const k_printf_spec &spec, const k_printf_spec_callback_tuple *tuple) {
+        if (nullptr != items)
+            items[item_num] = k_printf_item { spec, tuple };
+        item_num++;
+    };
+
+    /* literal text `[literal, i)`, emitted when a specifier or `%%` is reached */
+    std::size_t literal = 0;
+    auto push_literal = [&](std::size_t end) {
+        if (literal == end)
+            return;
+        k_printf_spec spec {};
+        if (nullptr != items) {
+            spec.start = base + literal;
+            spec.end   = base + end;
+        }
+        push_item(spec, nullptr);
+    };
+
+    std::size_t i = 0;
+    while (i < fmt.size()) {
+        if ('%' != fmt[i]) {
+            i++;
+            continue;
+        }
+
+        push_literal(i);
+        const std::size_t start = i++;
+
+        /* `%%` outputs its second `%`, which starts the next literal */
+        if (i < fmt.size() && '%' == fmt[i]) {
+            literal = i++;
+            continue;
+        }
+
+        /* positional arguments `%n$` and `*m$` are not supported */
+        std::size_t j = i;
+        while (j < fmt.size() && is_digit(fmt[j]))
+            j++;
+        if (j < fmt.size() && '$' == fmt[j])
+            return npos;
+
+        k_printf_spec spec {};
+        spec.min_width = -1;
+        spec.precision = -1;
+
+        for (; i < fmt.size(); i++) {
+            if      ('-' == fmt[i]) spec.left_justified   = 1;
+            else if ('+' == fmt[i]) spec.sign_prepended   = 1;
+            else if (' ' == fmt[i]) spec.space_padded     = 1;
+            else if ('0' == fmt[i]) spec.zero_padding     = 1;
+            else if ('#' == fmt[i]) spec.alternative_form = 1;
+            else break;
+        }
+
+        if (i < fmt.size() && '*' == fmt[i]) {
+            i++;
+            spec.use_min_width = 1;
+            push(arg_kind::integer);
+        } else if (i < fmt.size() && is_digit(fmt[i])) {
+            spec.use_min_width = 1;
+            spec.min_width     = parse_int(fmt, i);
+        }
+
+        if (i < fmt.size() && '.' == fmt[i]) {
+            i++;
+            spec.use_precision = 1;
+            if (i < fmt.size() && '*' == fmt[i]) {
+                i++;
+                push(arg_kind::integer);
+            } else {
+                spec.precision = parse_int(fmt, i);
+            }
+        }
+
+        if (i < fmt.size() && '$' == fmt[i])
+            return npos;
+
+        const std::size_t type = i;
+
+        /* like `k_printf`, custom specifiers are matched first */
+        std::size_t matched = npos;
+        for (std::size_t k = 0; k < custom_num; k++) {
+            if ( ! fmt.substr(i).starts_with(customs[k].name))
+                continue;
+            if (npos == matched || (longest && customs[matched].name.size() < customs[k].name.size()))
+                matched = k;
+            if ( ! longest)
+                break;
+        }
+
+        if (npos != matched) {
+            i += customs[matched].name.size();
+            for (std::size_t k = 0; k < customs[matched].argc; k++)
+                push(arg_kind::custom_arg);
+        } else {
+            arg_kind kind = arg_kind::integer;
+            if ( ! parse_c_std_spec(fmt, i, kind))
+                return npos;
+            push(kind);
+        }
+
+        if (nullptr != items) {
+            spec.start = base + start;
+            spec.type  = base + type;
+            spec.end   = base + i;
+        }
+        push_item(spec, (npos != matched) ? customs[matched].tuple : nullptr);
+        literal = i;
+    }
+
+    push_literal(fmt.size());
+
+    if (nullptr != get_item_num)
+        *get_item_num = item_num;
+    return argc;
+}
+
+/* The custom specifiers declared by each entry of `Customs` in `format` */
+template <class T>
+consteval custom_info custom_info_of() {
+    if constexpr (requires { T::tuple; })
+        return custom_info { T::name, T::argc, &T::tuple, true };
+    else
+        return custom_info { T::name, T::argc, nullptr, false };
+}
+
+template <class T>
+struct custom_list {
+    static constexpr std::array<custom_info, 1> customs { custom_info_of<T>() };
+    static constexpr bool longest = false;
+};
+
+template <class... Specs>
+struct custom_list<spec_table<Specs...>> {
+    static constexpr std::array<custom_info, sizeof...(Specs)> customs = spec_table<Specs...>::customs;
+    static constexpr bool longest = true;
+};
+
+template <class... Customs>
+consteval auto join_customs() {
+    std::array<custom_info, (custom_list<Customs>::customs.size() + ... + 0)> customs {};
+    [[maybe_unused]] std::size_t i = 0;
+    ((void)[&] {
+        for (const custom_info &info : custom_list<Customs>::customs)
+            customs[i++] = info;
+    }(), ...);
+    return customs;
+}
+
+/* Compile-time parse result of a format string; uses the longest match if `Customs` has a `spec_table` */
+template <fixed_string Fmt, class... Customs>
+struct format_info {
+    static constexpr auto customs = join_customs<Customs...>();
+    static constexpr bool longest = (custom_list<Customs>::longest || ... || false);
+
+    static constexpr std::size_t parsed = parse_format(Fmt.view(), customs.data(), customs.size(), longest, nullptr);
+    static constexpr bool ok = npos != parsed;
+    static constexpr std::size_t argc = ok ? parsed : 0;
+
+    static constexpr std::array<arg_kind, argc> kinds = []() consteval {
+        std::array<arg_kind, argc> kinds {};
+        if constexpr (0 < argc)
+            parse_format(Fmt.view(), customs.data(), customs.size(), longest, kinds.data());
+        return kinds;
+    }();
+
+    /* when every custom specifier is declared with `spec`, the callbacks are known at compile time
+     * and the pre-split items are output directly at run time */
+    static constexpr bool static_dispatch = []() consteval {
+        for (const custom_info &info : customs) {
+            if ( ! info.has_tuple)
+                return false;
+        }
+        return true;
+    }();
+
+    static constexpr std::size_t item_num = []() consteval {
+        std::size_t item_num = 0;
+        parse_format(Fmt.view(), customs.data(), customs.size(), longest, nullptr, nullptr, nullptr, &item_num);
+        return item_num;
+    }();
+
+    static constexpr std::array<k_printf_item, ok ? item_num : 0> items = []() consteval {
+        std::array<k_printf_item, ok ? item_num : 0> items {};
+        if constexpr (ok && 0 < item_num)
+            parse_format(Fmt.view(), customs.data(), customs.size(), longest, nullptr, Fmt.data, items.data());
+        return items;
+    }();
+};
+
+template <class T>
+inline constexpr bool is_string_v = std::is_same_v<T, const char *> || std::is_same_v<T, char *>
+                                 || std::is_same_v<T, std::string>;
+
+template <class T>
+inline constexpr bool is_pointer_v = std::is_same_v<T, std::nullptr_t>
+                                  || (std::is_pointer_v<T> && ! std::is_function_v<std::remove_pointer_t<T>>);
+
+template <arg_kind Kind, class T>
+inline constexpr bool accepts_v =
+    (arg_kind::integer == Kind)       ? std::is_integral_v<T> :
+    (arg_kind::floating == Kind)      ? std::is_floating_point_v<T> :
+    (arg_kind::long_floating == Kind) ? std::is_floating_point_v<T> :
+    (arg_kind::string == Kind)        ? is_string_v<T> || std::is_same_v<T, std::nullptr_t> :
+    (arg_kind::pointer == Kind)       ? is_pointer_v<T> :
+    (arg_kind::int_pointer == Kind)   ? std::is_pointer_v<T> && std::is_integral_v<std::remove_pointer_t<T>>
+                                        && ! std::is_const_v<std::remove_pointer_t<T>> :
+    std::is_arithmetic_v<T> || is_string_v<T> || is_pointer_v<T>;
+
+/* Convert an argument to `k_printf_arg` by its kind and type */
+template <arg_kind Kind, class T>
+void make_arg(k_printf_arg &arg, const T &v) {
+    static_assert(accepts_v<Kind, T>, "k_printf: argument type does not match its format specifier");
+
+    if constexpr (std::is_integral_v<T>) {
+        if constexpr (std::is_signed_v<T>) {
+            arg.type    = K_PRINTF_ARG_INT;
+            arg.value.i = static_cast<long long>(v);
+        } else {
+            arg.type    = K_PRINTF_ARG_UINT;
+            arg.value.u = static_cast<unsigned long long>(v);
+        }
+    } else if constexpr (std::is_floating_point_v<T>) {
+        if constexpr (arg_kind::long_floating == Kind
+                      || (arg_kind::custom_arg == Kind && std::is_same_v<T, long double>)) {
+            arg.type     = K_PRINTF_ARG_LONG_DOUBLE;
+            arg.value.ld = static_cast<long double>(v);
+        } else {
+            arg.type    = K_PRINTF_ARG_DOUBLE;
+            arg.value.d = static_cast<double>(v);
+        }
+    } else if constexpr (std::is_same_v<T, std::string>) {
+        arg.type    = K_PRINTF_ARG_STR;
+        arg.value.s = v.c_str();
+    } else if constexpr (arg_kind::string == Kind || (arg_kind::custom_arg == Kind && is_string_v<T>)) {
+        arg.type    = K_PRINTF_ARG_STR;
+        arg.value.s = v;
+    } else if constexpr (std::is_same_v<T, std::nullptr_t>) {
+        arg.type    = K_PRINTF_ARG_PTR;
+        arg.value.p = nullptr;
+    } else {
+        arg.type    = K_PRINTF_ARG_PTR;
+        arg.value.p = const_cast<void *>(static_cast<const volatile void *>(v));
+    }
+}
+
+template <class Info, std::size_t... I, class... Args>
+void make_args(k_printf_arg *argv, std::index_sequence<I...>, const Args &...args) {
+    (make_arg<Info::kinds[I], std::decay_t<const Args &>>(argv[I], args), ...);
+}
+
+template <class Info, class... Args>
+consteval bool check_args() {
+    static_assert(Info::ok, "k_printf: invalid format string");
+    static_assert( ! Info::ok || Info::argc == sizeof...(Args), "k_printf: argument count does not match the format string");
+    return true;
+}
+
+} // namespace detail
+
+/**
+ * \brief Write the formatted string to a custom output destination, like `k_xprintf`
+ *
+ * \tparam Fmt     The format string
+ * \tparam Customs The custom specifiers used in the format string, see `custom`, `spec` and `spec_table`
+ * \param config   The config for this output; if NULL, only C `printf` specifiers are supported
+ * \return On success, the number of characters written; on failure, -1, with `sink->error` set non-zero.
+ */
+template <fixed_string Fmt, class... Customs, class... Args>
+long long format(const k_printf_config *config, k_printf_sink *sink, const Args &...args) {
+    using info = detail::format_info<Fmt, Customs...>;
+    static_assert(detail::check_args<info, Args...>());
+
+    if constexpr (info::ok && info::argc == sizeof...(Args)) {
+        k_printf_arg argv[sizeof...(Args) + 1];
+        detail::make_args<info>(argv, std::index_sequence_for<Args...> {}, args...);
+        if constexpr (info::static_dispatch)
+            return k_xprintf_items(config, sink, info::items.data(), info::items.size(), argv, sizeof...(Args));
+        else
+            return k_xprintf_argv(config, sink, Fmt.data, argv, sizeof...(Args));
+    } else {
+        return -1;
+    }
+}
+
+/**
+ * \brief Write the formatted string to `buf`, like `k_snprintf`
+ *
+ * \return On success, the length of the formatted string; on failure, a negative value.
+ */
+template <fixed_string Fmt, class... Customs, class... Args>
+int format_to(const k_printf_config *config, char *buf, std::size_t n, const Args &...args) {
+    using info = detail::format_info<Fmt, Customs...>;
+    static_assert(detail::check_args<info, Args...>());
+
+    if constexpr (info::ok && info::argc == sizeof...(Args)) {
+        k_printf_arg argv[sizeof...(Args) + 1];
+        detail::make_args<info>(argv, std::index_sequence_for<Args...> {}, args...);
+        if constexpr (info::static_dispatch)
+            return k_snprintf_items(config, buf, n, info::items.data(), info::items.size(), argv, sizeof...(Args));
+        else
+            return k_snprintf_argv(config, buf, n, Fmt.data, argv, sizeof...(Args));
+    } else {
+        return -1;
+    }
+}
+
+} // namespace k_printf_cpp
+
+#endif
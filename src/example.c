@@ -103,30 +103,17 @@ static void printf_callback_spec_c(struct k_printf_buf *buf, const struct k_prin
 
     char ch = (char)va_arg(*args, int);
 
-    /* 第二步，向缓冲区输出内容 */
-
-    if (repeat == 1) {
-        buf->fn_puts(buf, &ch, 1);
-        return;
-    }
+    /* 第二步，向缓冲区输出内容
+     *
+     * 用 `fn_reserve` 预留空间后直接在其中写入，不必先写入临时缓冲区再分批拷贝。
+     */
 
-    char ch_buf[64];
-
-    if (repeat <= sizeof(ch_buf)) {
-        memset(ch_buf, ch, repeat);
-        buf->fn_puts(buf, ch_buf, repeat);
+    char *dst = buf->fn_reserve(buf, (size_t)repeat);
+    if (NULL == dst)
         return;
-    }
 
-    memset(ch_buf, ch, sizeof(ch_buf));
-
-    int putc_num = 0;
-    while (putc_num + sizeof(ch_buf) <= repeat) {
-        buf->fn_puts(buf, ch_buf, sizeof(ch_buf));
-        putc_num += sizeof(ch_buf);
-    }
-    if (putc_num < repeat)
-        buf->fn_puts(buf, ch_buf, repeat - putc_num);
+    memset(dst, ch, (size_t)repeat);
+    buf->fn_commit(buf, (size_t)repeat);
 }
 
 /* 本示例教你如何匹配自定义格式说明符：
@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <float.h>
 #include <limits.h>
 #include <stdarg.h>
 #include <stdlib.h>
@@ -7,6 +8,120 @@
 
 #include "k_printf.h"
 
+/* 在 double 为 IEEE 754 双精度浮点数的平台上，使用本地实现格式化浮点数 */
+#if FLT_RADIX == 2 && DBL_MANT_DIG == 53 && DBL_MIN_EXP == -1021 && DBL_MAX_EXP == 1024
+#define K_PRINTF_NATIVE_DOUBLE 1
+#endif
+
+/* 在 x86 上使用 SSE2 / AVX2 扫描格式字符串中的字面量文本，可通过定义 `K_PRINTF_NO_SIMD` 禁用 */
+#if !defined(K_PRINTF_NO_SIMD) && defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+#define K_PRINTF_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+/* 在 POSIX 平台上提供直接写入文件描述符的 `k_dprintf` */
+#if defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__))
+#define K_PRINTF_POSIX 1
+#include <errno.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+/* 在支持 GCC 原子操作内建函数的编译器上提供延迟格式化的无锁队列，格式字符串缓存也可以在多个线程中共享 */
+#if defined(__GNUC__) || defined(__clang__)
+#define K_PRINTF_ATOMIC 1
+#endif
+
+/* region [alloc] */
+
+/* 记录一次分配请求，若配置禁止分配则拒绝。允许分配时返回 0 */
+static int alloc_check(const struct k_printf_config *config, size_t size) {
+
+    if (NULL == config)
+        return 0;
+
+    struct k_printf_alloc_stats *stats = config->alloc_stats;
+
+    if (config->no_alloc) {
+        if (NULL != stats)
+            stats->refused_num++;
+        return -1;
+    }
+
+    if (NULL != stats) {
+        stats->alloc_num++;
+        stats->alloc_bytes += size;
+    }
+    return 0;
+}
+
+/* 按配置分配格式化过程中使用的内存，使用配置的分配器（若有） */
+static void *config_malloc(const struct k_printf_config *config, size_t size) {
+
+    if (0 != alloc_check(config, size))
+        return NULL;
+
+    if (NULL != config && NULL != config->fn_malloc)
+        return config->fn_malloc(size);
+
+    return malloc(size);
+}
+
+static void *config_realloc(const struct k_printf_config *config, void *ptr, size_t size) {
+
+    if (0 != alloc_check(config, size))
+        return NULL;
+
+    if (NULL != config && NULL != config->fn_realloc)
+        return config->fn_realloc(ptr, size);
+
+    return realloc(ptr, size);
+}
+
+static void config_free(const struct k_printf_config *config, void *ptr) {
+
+    if (NULL != config && NULL != config->fn_free)
+        config->fn_free(ptr);
+    else
+        free(ptr);
+}
+
+/* endregion */
+
+/* region [reserve_scratch] */
+
+/* `fn_reserve` 的临时空间
+ *
+ * 缓冲区无法直接提供可写空间时（例如 `char []` 剩余空间不足需要截断），`fn_reserve` 返回临时空间，
+ * 之后在 `fn_commit` 中再用 `fn_puts` 将其内容写入缓冲区。较短时使用内嵌的 `block`，较长时使用堆内存。
+ */
+struct reserve_scratch {
+    const struct k_printf_config *config;
+    char *data;
+    char block[256];
+};
+
+static char *scratch_reserve(struct reserve_scratch *scratch, size_t len) {
+
+    if (len <= sizeof(scratch->block))
+        scratch->data = scratch->block;
+    else
+        scratch->data = config_malloc(scratch->config, len);
+
+    return scratch->data;
+}
+
+static void scratch_commit(struct reserve_scratch *scratch, struct k_printf_buf *buf, size_t used) {
+
+    buf->fn_puts(buf, scratch->data, used);
+
+    if (scratch->data != scratch->block)
+        config_free(scratch->config, scratch->data);
+    scratch->data = NULL;
+}
+
+/* endregion */
+
 /* region [str_buf] */
 
 struct str_buf {
@@ -14,6 +129,12 @@ struct str_buf {
     char *buffer;
     int str_len;
     int max_len;
+
+    /* 截断模式：缓冲区写满后置 `n` 为 -1 以提前结束格式化，并置 `truncated` 为 1 */
+    unsigned int trunc_mode : 1;
+    unsigned int truncated  : 1;
+
+    struct reserve_scratch scratch;
 };
 
 static void str_buf_puts(struct k_printf_buf *buf, const char *str, size_t len) {
@@ -40,6 +161,12 @@ static void str_buf_puts(struct k_printf_buf *buf, const char *str, size_t len)
 
     str_buf->buffer[str_buf->str_len] = '\0';
 
+    if (str_buf->trunc_mode) {
+        str_buf->truncated = 1;
+        buf->n = -1;
+        return;
+    }
+
     if (len <= INT_MAX) {
         buf->n += (int)len;
         if (buf->n < 0)
@@ -66,6 +193,11 @@ static void str_buf_vprintf(struct k_printf_buf *buf, const char *fmt, va_list a
         str_buf->str_len += r;
         buf->n += r;
     }
+    else if (str_buf->trunc_mode) {
+        str_buf->str_len = str_buf->max_len;
+        str_buf->truncated = 1;
+        buf->n = -1;
+    }
     else {
         str_buf->str_len = str_buf->max_len;
         buf->n += r;
@@ -81,16 +213,54 @@ static void str_buf_printf(struct k_printf_buf *buf, const char *fmt, ...) {
     va_end(args);
 }
 
-static void init_str_buf(struct str_buf *str_buf, char *buf, size_t capacity) {
+static char *str_buf_reserve(struct k_printf_buf *buf, size_t len) {
+
+    struct str_buf *str_buf = (struct str_buf *)buf;
+
+    /* 剩余空间足够时直接写入 `char []`，否则写入临时空间，提交时再截断 */
+    if (-1 != buf->n && len <= (size_t)(str_buf->max_len - str_buf->str_len)) {
+        str_buf->scratch.data = NULL;
+        return &str_buf->buffer[str_buf->str_len];
+    }
+
+    char *data = scratch_reserve(&str_buf->scratch, len);
+    if (NULL == data)
+        buf->n = -1;
+
+    return data;
+}
+
+static void str_buf_commit(struct k_printf_buf *buf, size_t used) {
+
+    struct str_buf *str_buf = (struct str_buf *)buf;
+
+    if (NULL != str_buf->scratch.data) {
+        scratch_commit(&str_buf->scratch, buf, used);
+        return;
+    }
+
+    str_buf->str_len += (int)used;
+    str_buf->buffer[str_buf->str_len] = '\0';
+    buf->n += (int)used;
+}
+
+static void init_str_buf(struct str_buf *str_buf, const struct k_printf_config *config, char *buf, size_t capacity) {
 
     static char buf_[1] = { '\0' };
 
-    str_buf->impl.fn_puts    = str_buf_puts,
-    str_buf->impl.fn_printf  = str_buf_printf,
-    str_buf->impl.fn_vprintf = str_buf_vprintf,
-    str_buf->impl.n          = 0;
+    str_buf->impl.fn_puts     = str_buf_puts,
+    str_buf->impl.fn_puts_ref = str_buf_puts,
+    str_buf->impl.fn_printf   = str_buf_printf,
+    str_buf->impl.fn_vprintf  = str_buf_vprintf,
+    str_buf->impl.fn_reserve  = str_buf_reserve,
+    str_buf->impl.fn_commit   = str_buf_commit,
+    str_buf->impl.n           = 0;
+    str_buf->trunc_mode       = 0;
+    str_buf->truncated        = 0;
+    str_buf->scratch.config   = config;
+    str_buf->scratch.data     = NULL;
 
-    if (1 < capacity && capacity <= INT_MAX) {
+    if (0 < capacity && capacity <= INT_MAX) {
         str_buf->buffer  = buf;
         str_buf->str_len = 0;
         str_buf->max_len = (int)capacity - 1;
@@ -105,560 +275,5710 @@ static void init_str_buf(struct str_buf *str_buf, char *buf, size_t capacity) {
 
 /* endregion */
 
-/* region [file_buf] */
+/* region [arena] */
 
-struct file_buf {
+/* arena 中的一块内存，`data` 中前 `used` 个字节已被占用 */
+struct arena_chunk {
+    struct arena_chunk *next;
+    size_t size;
+    size_t used;
+    char data[];
+};
+
+/* 按块增长的 bump-pointer 内存池
+ *
+ * 字符串总是写在当前块（`chunk` 链表头）的空闲尾部，写完后才推进 `used`。
+ * 当前块放不下时另取一块作为新的当前块，旧块剩余的空间不再使用。
+ * 重置时所有块都移到 `spare` 链表中，之后取块时优先复用，避免反复 `malloc`。
+ */
+struct k_printf_arena {
+    struct arena_chunk *chunk;
+    struct arena_chunk *spare;
+    size_t chunk_size;
+};
+
+/* 取一块空闲空间不少于 `size` 的块作为新的当前块，失败时返回 NULL
+ *
+ * 块归 arena 所有，释放时不经过配置，因此总是用 `malloc` 分配，只按 `config` 检查是否允许分配。
+ */
+static struct arena_chunk *arena_push_chunk(struct k_printf_arena *arena, const struct k_printf_config *config,
+                                            size_t size) {
+
+    struct arena_chunk **p = &arena->spare;
+    while (NULL != *p && (*p)->size < size)
+        p = &(*p)->next;
+
+    struct arena_chunk *chunk = *p;
+    if (NULL != chunk) {
+        *p = chunk->next;
+    } else {
+        if (size < arena->chunk_size)
+            size = arena->chunk_size;
+        if (SIZE_MAX - sizeof(struct arena_chunk) < size)
+            return NULL;
+        if (0 != alloc_check(config, sizeof(struct arena_chunk) + size))
+            return NULL;
+
+        chunk = malloc(sizeof(struct arena_chunk) + size);
+        if (NULL == chunk)
+            return NULL;
+        chunk->size = size;
+    }
+
+    chunk->used  = 0;
+    chunk->next  = arena->chunk;
+    arena->chunk = chunk;
+    return chunk;
+}
+
+/* 将当前块中从 `str` 开始、长为 `len` 的字符串挪到一块容量不少于 `size` 的新块中
+ *
+ * 若字符串独占当前块，则直接 `realloc` 当前块。
+ * 返回新的字符串地址，新块的空闲空间通过 `get_capacity` 返回。失败时返回 NULL，原字符串保持不变。
+ */
+static char *arena_grow(struct k_printf_arena *arena, const struct k_printf_config *config,
+                        char *str, size_t len, size_t size, size_t *get_capacity) {
+
+    struct arena_chunk *chunk = arena->chunk;
+
+    if (0 == chunk->used && str == chunk->data) {
+        if (size < arena->chunk_size)
+            size = arena->chunk_size;
+        if (SIZE_MAX - sizeof(struct arena_chunk) < size)
+            return NULL;
+        if (0 != alloc_check(config, sizeof(struct arena_chunk) + size))
+            return NULL;
+
+        chunk = realloc(chunk, sizeof(struct arena_chunk) + size);
+        if (NULL == chunk)
+            return NULL;
+
+        chunk->size  = size;
+        arena->chunk = chunk;
+    } else {
+        if (NULL == (chunk = arena_push_chunk(arena, config, size)))
+            return NULL;
+        memcpy(chunk->data, str, len);
+    }
+
+    *get_capacity = chunk->size;
+    return chunk->data;
+}
+
+/* endregion */
+
+/* region [mem_buf] */
+
+/* 可增长的内存缓冲区
+ *
+ * 初始时写入调用方提供的缓冲区（通常在栈上），写满后才改用 `malloc` 分配的堆内存，
+ * 之后按两倍容量增长。
+ *
+ * 堆内存按 `config` 分配。若 `init_buffer` 为 NULL，则缓冲区是调用方持有的堆内存（见 `attach_mem_buf`），
+ * 释放时不经过配置，因此扩容时直接使用 `realloc`，只按 `config` 检查是否允许分配。
+ * 若 `arena` 不为 NULL，则缓冲区位于 arena 当前块的尾部，扩容时改从 arena 取块。
+ */
+struct mem_buf {
     struct k_printf_buf impl;
-    FILE *file;
+    const struct k_printf_config *config;
+    char *buffer;
+    size_t str_len;
+    size_t capacity;
+    char *init_buffer;
+    struct k_printf_arena *arena;
 };
 
-static void file_buf_puts(struct k_printf_buf *buf, const char *str, size_t len) {
+/* 确保缓冲区至少还能写入 `len` 个字符（不含 '\0'），失败时返回 -1 */
+static int mem_buf_reserve(struct mem_buf *mem_buf, size_t len) {
+
+    size_t need = mem_buf->str_len + len + 1;
+    if (need <= mem_buf->capacity)
+        return 0;
+
+    if ((size_t)INT_MAX + 1 < need)
+        return -1;
+
+    size_t capacity = mem_buf->capacity * 2;
+    if (capacity < need)
+        capacity = need;
+    if ((size_t)INT_MAX + 1 < capacity)
+        capacity = (size_t)INT_MAX + 1;
+
+    const struct k_printf_config *config = mem_buf->config;
+
+    char *buffer;
+    if (NULL != mem_buf->arena) {
+        buffer = arena_grow(mem_buf->arena, config, mem_buf->buffer, mem_buf->str_len, capacity, &capacity);
+        if (NULL == buffer)
+            return -1;
+    } else if (NULL == mem_buf->init_buffer) {
+        if (0 != alloc_check(config, capacity))
+            return -1;
+        buffer = realloc(mem_buf->buffer, capacity);
+        if (NULL == buffer)
+            return -1;
+    } else if (mem_buf->buffer == mem_buf->init_buffer) {
+        buffer = config_malloc(config, capacity);
+        if (NULL == buffer)
+            return -1;
+        memcpy(buffer, mem_buf->buffer, mem_buf->str_len);
+    } else {
+        buffer = config_realloc(config, mem_buf->buffer, capacity);
+        if (NULL == buffer)
+            return -1;
+    }
+
+    mem_buf->buffer   = buffer;
+    mem_buf->capacity = capacity;
+    return 0;
+}
+
+static void mem_buf_puts(struct k_printf_buf *buf, const char *str, size_t len) {
     if (-1 == buf->n)
         return;
 
-    struct file_buf *file_buf = (struct file_buf *)buf;
+    struct mem_buf *mem_buf = (struct mem_buf *)buf;
 
-    size_t r = fwrite(str, sizeof(char), len, file_buf->file);
-    if (INT_MAX < r) {
+    if (0 != mem_buf_reserve(mem_buf, len)) {
         buf->n = -1;
         return;
     }
 
-    buf->n += (int)r;
-    if (buf->n < 0)
-        buf->n = -1;
+    memcpy(&mem_buf->buffer[mem_buf->str_len], str, len * sizeof(char));
+    mem_buf->str_len += len;
+    mem_buf->buffer[mem_buf->str_len] = '\0';
+
+    buf->n += (int)len;
 }
 
-static void file_buf_vprintf(struct k_printf_buf *buf, const char *fmt, va_list args) {
+static void mem_buf_vprintf(struct k_printf_buf *buf, const char *fmt, va_list args) {
     if (-1 == buf->n)
         return;
 
-    struct file_buf *file_buf = (struct file_buf *)buf;
+    struct mem_buf *mem_buf = (struct mem_buf *)buf;
+
+    /* 先尝试直接写入剩余空间，放不下时再扩容重写，此时需要再次读取 `args` */
+    va_list args_copy;
+    va_copy(args_copy, args);
+    size_t remain = mem_buf->capacity - mem_buf->str_len;
+    int r = vsnprintf(&mem_buf->buffer[mem_buf->str_len], remain, fmt, args_copy);
+    va_end(args_copy);
 
-    int r = vfprintf(file_buf->file, fmt, args);
     if (r < 0) {
         buf->n = -1;
         return;
     }
 
+    if (remain <= (size_t)r) {
+        if (0 != mem_buf_reserve(mem_buf, (size_t)r)) {
+            buf->n = -1;
+            return;
+        }
+        vsnprintf(&mem_buf->buffer[mem_buf->str_len], (size_t)r + 1, fmt, args);
+    }
+
+    mem_buf->str_len += (size_t)r;
     buf->n += r;
-    if (buf->n < 0)
-        buf->n = -1;
 }
 
-static void file_buf_printf(struct k_printf_buf *buf, const char *fmt, ...) {
+static void mem_buf_printf(struct k_printf_buf *buf, const char *fmt, ...) {
     va_list args;
     va_start(args, fmt);
-    file_buf_vprintf(buf, fmt, args);
+    mem_buf_vprintf(buf, fmt, args);
     va_end(args);
 }
 
-static void init_file_buf(struct file_buf *buf, FILE *file) {
+static char *mem_buf_reserve_fn(struct k_printf_buf *buf, size_t len) {
+
+    struct mem_buf *mem_buf = (struct mem_buf *)buf;
+
+    if (-1 == buf->n)
+        return NULL;
+
+    if (0 != mem_buf_reserve(mem_buf, len)) {
+        buf->n = -1;
+        return NULL;
+    }
+
+    return &mem_buf->buffer[mem_buf->str_len];
+}
+
+static void mem_buf_commit(struct k_printf_buf *buf, size_t used) {
+
+    struct mem_buf *mem_buf = (struct mem_buf *)buf;
+
+    mem_buf->str_len += used;
+    mem_buf->buffer[mem_buf->str_len] = '\0';
+    buf->n += (int)used;
+}
+
+/* 在 `malloc` 分配的内存上继续追加，`buffer` 中已有 `str_len` 个字符，扩容时使用 `realloc` */
+static void attach_mem_buf(struct mem_buf *mem_buf, const struct k_printf_config *config,
+                           char *buffer, size_t str_len, size_t capacity) {
+    assert(NULL != buffer && str_len < capacity);
+
+    mem_buf->impl.fn_puts     = mem_buf_puts,
+    mem_buf->impl.fn_puts_ref = mem_buf_puts,
+    mem_buf->impl.fn_printf   = mem_buf_printf,
+    mem_buf->impl.fn_vprintf  = mem_buf_vprintf,
+    mem_buf->impl.fn_reserve  = mem_buf_reserve_fn,
+    mem_buf->impl.fn_commit   = mem_buf_commit,
+    mem_buf->impl.n           = 0;
+    mem_buf->config           = config;
+    mem_buf->buffer           = buffer;
+    mem_buf->str_len          = str_len;
+    mem_buf->capacity         = capacity;
+    mem_buf->init_buffer      = NULL;
+    mem_buf->arena            = NULL;
+}
+
+static void init_mem_buf(struct mem_buf *mem_buf, const struct k_printf_config *config,
+                         char *init_buffer, size_t init_capacity) {
+    assert(NULL != init_buffer && 0 < init_capacity);
 
-    buf->impl.fn_puts    = file_buf_puts,
-    buf->impl.fn_printf  = file_buf_printf,
-    buf->impl.fn_vprintf = file_buf_vprintf,
-    buf->impl.n          = 0;
-    buf->file            = file;
+    attach_mem_buf(mem_buf, config, init_buffer, 0, init_capacity);
+    mem_buf->init_buffer = init_buffer;
+
+    mem_buf->buffer[0] = '\0';
+}
+
+/* 释放缓冲区占用的堆内存 */
+static void free_mem_buf(struct mem_buf *mem_buf) {
+    if (mem_buf->buffer != mem_buf->init_buffer)
+        config_free(mem_buf->config, mem_buf->buffer);
+}
+
+/* 取出缓冲区中的字符串，返回按 `config` 分配的内存，由调用方负责释放。失败时返回 NULL */
+static char *mem_buf_detach(struct mem_buf *mem_buf) {
+
+    if (mem_buf->buffer != mem_buf->init_buffer)
+        return mem_buf->buffer;
+
+    char *s = config_malloc(mem_buf->config, mem_buf->str_len + 1);
+    if (NULL != s)
+        memcpy(s, mem_buf->buffer, mem_buf->str_len + 1);
+
+    return s;
 }
 
 /* endregion */
 
-/* region [c_std_spec] */
+/* region [file_buf] */
 
-/* 处理 C `printf` 中 `%n` 一族的格式说明符
+/* 写入 `FILE *` 的缓冲区
  *
- * 函数假定传入的格式说明符类型是正确的。
+ * 格式化的结果先积攒在内存中（较短时在栈上，过长时改用堆内存），
+ * 最后由 `file_buf_flush` 一次性 `fwrite` 到文件。
+ * 这样每次 `k_fprintf` 只获取一次 stdio 的锁，同一次调用输出的内容也不会与其他线程的输出交错。
  */
-static void printf_callback_c_std_spec_n(struct k_printf_buf *buf, const struct k_printf_spec *spec, va_list *args) {
+struct file_buf {
+    struct mem_buf mem_buf;
+    FILE *file;
+    char block[1024];
+};
 
-    const char c1 = spec->type[0];
-    const char c2 = spec->type[1];
+static void init_file_buf(struct file_buf *buf, const struct k_printf_config *config, FILE *file) {
+    init_mem_buf(&buf->mem_buf, config, buf->block, sizeof(buf->block));
+    buf->file = file;
+}
 
-    int n = buf->n;
+/* 将积攒的内容写入文件并释放缓冲区，返回 `str_len`，失败时返回 -1 */
+static int file_buf_flush(struct file_buf *buf, int str_len) {
 
-    if (c1=='n') {
-        *(va_arg(*args, int *)) = (int)n; /* %n */
-    } else if (c1=='j') {
-        *(va_arg(*args, intmax_t *)) = (intmax_t)n; /* %jn */
-    } else if (c1=='t') {
-        *(va_arg(*args, ptrdiff_t *)) = (ptrdiff_t)n; /* %tn */
-    } else if (c1=='z') {
-        *(va_arg(*args, size_t *)) = (size_t)n; /* %zn */
-    } else if (c1=='l') {
-        if (c2=='l') {
-            *(va_arg(*args, long long *)) = (long long)n; /* %lln */
-        } else {
-            *(va_arg(*args, long *)) = (long)n; /* %ln */
-        }
-    } else {
-        if (c2 == 'h') {
-            *(va_arg(*args, unsigned char *)) = (unsigned char)n; /* %hhn */
-        } else {
-            *(va_arg(*args, short *)) = (short)n; /* %hn */
-        }
+    struct mem_buf *mem_buf = &buf->mem_buf;
+
+    if (0 < str_len) {
+        if (mem_buf->str_len != fwrite(mem_buf->buffer, sizeof(char), mem_buf->str_len, buf->file))
+            str_len = -1;
     }
+
+    free_mem_buf(mem_buf);
+    return str_len;
 }
 
-/* 处理 C `printf` 中除了 `%n` 一族以外所有的格式说明符
+/* endregion */
+
+/* region [fd_buf] */
+
+#if defined(K_PRINTF_POSIX)
+
+/* 单次 `writev` 最多提交的片段数量 */
+#if defined(IOV_MAX) && IOV_MAX < 64
+#define FD_BUF_IOV_NUM IOV_MAX
+#else
+#define FD_BUF_IOV_NUM 64
+#endif
+
+/* 写入文件描述符的缓冲区
  *
- * 函数假定传入的格式说明符类型是正确的。
+ * 缓冲区只收集 `struct iovec` 片段：`fn_puts_ref` 写入的内容（格式字符串中的字面量文本、`%s` 的实参）
+ * 直接引用原字符串，其余内容才拷贝到 `scratch` 中。格式化结束时由 `fd_buf_flush` 调用一次 `writev`。
+ * 片段数量或 `scratch` 用尽时会提前提交已收集的片段。
  */
-static void printf_callback_c_std_spec(struct k_printf_buf *buf, const struct k_printf_spec *spec, va_list *args) {
+struct fd_buf {
+    struct k_printf_buf impl;
+    const struct k_printf_config *config;
+    int fd;
+    int iov_num;
+    size_t scratch_len;
+    char *reserved;
+    struct iovec iov[FD_BUF_IOV_NUM];
+    char scratch[1024];
+};
 
-    /* 将格式说明符交回给 C `printf` 处理，之后按需消耗掉不定长参数列表的实参 */
+/* 将已收集的片段全部写入文件描述符，处理部分写入和信号中断。失败时返回 -1 */
+static int fd_buf_write(struct fd_buf *fd_buf) {
 
-    char fmt_buf[80];
-    char *fmt = fmt_buf;
+    struct iovec *iov = fd_buf->iov;
+    int iov_num = fd_buf->iov_num;
 
-    int len = (int)(spec->end - spec->start);
-    if (sizeof(fmt_buf) < len + 1) {
-        if (NULL == (fmt = malloc(len + 1))) {
-            buf->n = -1;
+    fd_buf->iov_num = 0;
+    fd_buf->scratch_len = 0;
+
+    while (0 < iov_num) {
+        ssize_t r = writev(fd_buf->fd, iov, iov_num);
+        if (r < 0) {
+            if (EINTR == errno)
+                continue;
+            return -1;
+        }
+
+        size_t written = (size_t)r;
+        while (0 < iov_num && iov->iov_len <= written) {
+            written -= iov->iov_len;
+            iov++;
+            iov_num--;
+        }
+        if (0 < iov_num) {
+            iov->iov_base = (char *)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+
+    return 0;
+}
+
+/* 追加一个片段，与上一个片段首尾相接时直接合并 */
+static void fd_buf_push(struct fd_buf *fd_buf, const char *str, size_t len) {
+
+    if (0 < fd_buf->iov_num) {
+        struct iovec *last = &fd_buf->iov[fd_buf->iov_num - 1];
+        if ((char *)last->iov_base + last->iov_len == str) {
+            last->iov_len += len;
             return;
         }
     }
 
-    memcpy(fmt, spec->start, len);
-    fmt[len] = '\0';
+    fd_buf->iov[fd_buf->iov_num].iov_base = (void *)str;
+    fd_buf->iov[fd_buf->iov_num].iov_len  = len;
+    fd_buf->iov_num++;
+}
 
-    va_list args_copy;
-    va_copy(args_copy, *args);
-    buf->fn_vprintf(buf, fmt, args_copy);
-    va_end(args_copy);
+static void fd_buf_add_n(struct k_printf_buf *buf, size_t len) {
+    if (len <= INT_MAX) {
+        buf->n += (int)len;
+        if (buf->n < 0)
+            buf->n = -1;
+    } else {
+        buf->n = -1;
+    }
+}
 
-    if (fmt != fmt_buf)
-        free(fmt);
+static void fd_buf_puts_ref(struct k_printf_buf *buf, const char *str, size_t len) {
+    if (-1 == buf->n || 0 == len)
+        return;
 
-    if (spec->use_min_width && -1 == spec->min_width)
-        va_arg(*args, int);
-    if (spec->use_precision && -1 == spec->precision)
-        va_arg(*args, int);
+    struct fd_buf *fd_buf = (struct fd_buf *)buf;
 
-    switch(spec->type[0]) {
-        case 'a': case 'A': case 'e': case 'E':
-        case 'f': case 'F': case 'g': case 'G':
-            va_arg(*args, double);
-            break;
-        case 'c': case 'd': case 'i': case 'h':
-            va_arg(*args, int);
-            break;
-        case 'o': case 'u': case 'x': case 'X':
-            va_arg(*args, unsigned int);
-            break;
-        case 'j':
-            switch (spec->type[1]) {
-                case 'd': case 'i':
-                    va_arg(*args, intmax_t);
-                    break;
-                case 'x': case 'X':
-                case 'o': case 'u':
-                    va_arg(*args, uintmax_t);
-                    break;
-            }
-            break;
-        case 'l':
-            switch (spec->type[1]) {
-                case 'a': case 'A': case 'e': case 'E':
-                case 'f': case 'F': case 'g': case 'G':
-                    va_arg(*args, double);
-                    break;
-                case 'c':
-                    va_arg(*args, int);
-                    break;
+    if (FD_BUF_IOV_NUM == fd_buf->iov_num && 0 != fd_buf_write(fd_buf)) {
+        buf->n = -1;
+        return;
+    }
+
+    fd_buf_push(fd_buf, str, len);
+    fd_buf_add_n(buf, len);
+}
+
+static void fd_buf_puts(struct k_printf_buf *buf, const char *str, size_t len) {
+    if (-1 == buf->n || 0 == len)
+        return;
+
+    struct fd_buf *fd_buf = (struct fd_buf *)buf;
+
+    if (sizeof(fd_buf->scratch) - fd_buf->scratch_len < len || FD_BUF_IOV_NUM == fd_buf->iov_num) {
+        if (0 != fd_buf_write(fd_buf)) {
+            buf->n = -1;
+            return;
+        }
+    }
+
+    if (sizeof(fd_buf->scratch) < len) {
+        /* `str` 在返回后可能失效，不能只记录引用，故立即写出 */
+        fd_buf_push(fd_buf, str, len);
+        if (0 != fd_buf_write(fd_buf)) {
+            buf->n = -1;
+            return;
+        }
+    } else {
+        char *dst = &fd_buf->scratch[fd_buf->scratch_len];
+        memcpy(dst, str, len);
+        fd_buf->scratch_len += len;
+        fd_buf_push(fd_buf, dst, len);
+    }
+
+    fd_buf_add_n(buf, len);
+}
+
+static void fd_buf_vprintf(struct k_printf_buf *buf, const char *fmt, va_list args) {
+    if (-1 == buf->n)
+        return;
+
+    struct fd_buf *fd_buf = (struct fd_buf *)buf;
+
+    if (FD_BUF_IOV_NUM == fd_buf->iov_num && 0 != fd_buf_write(fd_buf)) {
+        buf->n = -1;
+        return;
+    }
+
+    /* 先尝试格式化到 `scratch` 的剩余空间，放不下时再另行分配内存 */
+    va_list args_copy;
+    va_copy(args_copy, args);
+    size_t remain = sizeof(fd_buf->scratch) - fd_buf->scratch_len;
+    int r = vsnprintf(&fd_buf->scratch[fd_buf->scratch_len], remain, fmt, args_copy);
+    va_end(args_copy);
+
+    if (r < 0) {
+        buf->n = -1;
+        return;
+    }
+
+    if ((size_t)r < remain) {
+        if (0 < r) {
+            fd_buf_push(fd_buf, &fd_buf->scratch[fd_buf->scratch_len], (size_t)r);
+            fd_buf->scratch_len += (size_t)r;
+        }
+        fd_buf_add_n(buf, (size_t)r);
+        return;
+    }
+
+    char *str = config_malloc(fd_buf->config, (size_t)r + 1);
+    if (NULL == str) {
+        buf->n = -1;
+        return;
+    }
+
+    vsnprintf(str, (size_t)r + 1, fmt, args);
+    fd_buf_puts(buf, str, (size_t)r);
+    config_free(fd_buf->config, str);
+}
+
+static void fd_buf_printf(struct k_printf_buf *buf, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    fd_buf_vprintf(buf, fmt, args);
+    va_end(args);
+}
+
+static char *fd_buf_reserve(struct k_printf_buf *buf, size_t len) {
+
+    struct fd_buf *fd_buf = (struct fd_buf *)buf;
+
+    /* 较短时直接写入 `scratch`，超出 `scratch` 容量时才另行分配内存 */
+    if (sizeof(fd_buf->scratch) < len) {
+        fd_buf->reserved = config_malloc(fd_buf->config, len);
+        if (NULL == fd_buf->reserved)
+            buf->n = -1;
+        return fd_buf->reserved;
+    }
+
+    if (sizeof(fd_buf->scratch) - fd_buf->scratch_len < len || FD_BUF_IOV_NUM == fd_buf->iov_num) {
+        if (0 != fd_buf_write(fd_buf))
+            buf->n = -1;
+    }
+
+    fd_buf->reserved = NULL;
+    return &fd_buf->scratch[fd_buf->scratch_len];
+}
+
+static void fd_buf_commit(struct k_printf_buf *buf, size_t used) {
+
+    struct fd_buf *fd_buf = (struct fd_buf *)buf;
+
+    if (NULL != fd_buf->reserved) {
+        fd_buf_puts(buf, fd_buf->reserved, used);
+        config_free(fd_buf->config, fd_buf->reserved);
+        fd_buf->reserved = NULL;
+        return;
+    }
+
+    if (-1 == buf->n || 0 == used)
+        return;
+
+    fd_buf_push(fd_buf, &fd_buf->scratch[fd_buf->scratch_len], used);
+    fd_buf->scratch_len += used;
+    fd_buf_add_n(buf, used);
+}
+
+static void init_fd_buf(struct fd_buf *buf, const struct k_printf_config *config, int fd) {
+
+    buf->impl.fn_puts     = fd_buf_puts,
+    buf->impl.fn_puts_ref = fd_buf_puts_ref,
+    buf->impl.fn_printf   = fd_buf_printf,
+    buf->impl.fn_vprintf  = fd_buf_vprintf,
+    buf->impl.fn_reserve  = fd_buf_reserve,
+    buf->impl.fn_commit   = fd_buf_commit,
+    buf->impl.n           = 0;
+    buf->config           = config;
+    buf->fd               = fd;
+    buf->iov_num          = 0;
+    buf->scratch_len      = 0;
+    buf->reserved         = NULL;
+}
+
+/* 提交剩余的片段，返回 `str_len`，失败时返回 -1 */
+static int fd_buf_flush(struct fd_buf *buf, int str_len) {
+
+    if (str_len < 0)
+        return -1;
+
+    if (0 != fd_buf_write(buf))
+        return -1;
+
+    return str_len;
+}
+
+#endif
+
+/* endregion */
+
+/* region [sink_buf] */
+
+/* 将用户实现的 `k_printf_sink` 适配为 `k_printf_buf`
+ *
+ * 字符数量在 `count` 中以 64 位累计，`impl.n` 则停留在 INT_MAX，不会因溢出而被视为出错。
+ */
+struct sink_buf {
+    struct k_printf_buf impl;
+    struct k_printf_sink *sink;
+    unsigned long long count;
+    struct reserve_scratch scratch;
+};
+
+static void sink_buf_fail(struct sink_buf *sink_buf) {
+    if (0 == sink_buf->sink->error)
+        sink_buf->sink->error = 1;
+    sink_buf->impl.n = -1;
+}
+
+static void sink_buf_add_n(struct sink_buf *sink_buf, size_t len) {
+    sink_buf->count += len;
+    sink_buf->sink->count += len;
+
+    if ((size_t)(INT_MAX - sink_buf->impl.n) < len)
+        sink_buf->impl.n = INT_MAX;
+    else
+        sink_buf->impl.n += (int)len;
+}
+
+static void sink_buf_puts(struct k_printf_buf *buf, const char *str, size_t len) {
+    if (-1 == buf->n)
+        return;
+
+    struct sink_buf *sink_buf = (struct sink_buf *)buf;
+    struct k_printf_sink *sink = sink_buf->sink;
+
+    if (0 != sink->fn_puts(sink, str, len)) {
+        sink_buf_fail(sink_buf);
+        return;
+    }
+
+    sink_buf_add_n(sink_buf, len);
+}
+
+static void sink_buf_vprintf(struct k_printf_buf *buf, const char *fmt, va_list args) {
+    if (-1 == buf->n)
+        return;
+
+    struct sink_buf *sink_buf = (struct sink_buf *)buf;
+    struct k_printf_sink *sink = sink_buf->sink;
+
+    /* 先格式化到栈上的缓冲区，放不下时再直接写入 `fn_reserve` 预留的空间，或另行分配内存 */
+    char block[256];
+
+    va_list args_copy;
+    va_copy(args_copy, args);
+    int r = vsnprintf(block, sizeof(block), fmt, args_copy);
+    va_end(args_copy);
+
+    if (r < 0) {
+        sink_buf_fail(sink_buf);
+        return;
+    }
+
+    if ((size_t)r < sizeof(block)) {
+        sink_buf_puts(buf, block, (size_t)r);
+        return;
+    }
+
+    if (NULL != sink->fn_reserve) {
+        char *dst = sink->fn_reserve(sink, (size_t)r + 1);
+        if (NULL != dst) {
+            vsnprintf(dst, (size_t)r + 1, fmt, args);
+            sink->fn_commit(sink, (size_t)r);
+            sink_buf_add_n(sink_buf, (size_t)r);
+            return;
+        }
+    }
+
+    char *str = config_malloc(sink_buf->scratch.config, (size_t)r + 1);
+    if (NULL == str) {
+        sink_buf_fail(sink_buf);
+        return;
+    }
+
+    vsnprintf(str, (size_t)r + 1, fmt, args);
+    sink_buf_puts(buf, str, (size_t)r);
+    config_free(sink_buf->scratch.config, str);
+}
+
+static void sink_buf_printf(struct k_printf_buf *buf, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    sink_buf_vprintf(buf, fmt, args);
+    va_end(args);
+}
+
+static char *sink_buf_reserve(struct k_printf_buf *buf, size_t len) {
+
+    struct sink_buf *sink_buf = (struct sink_buf *)buf;
+    struct k_printf_sink *sink = sink_buf->sink;
+
+    /* 优先使用输出目标提供的空间，否则写入临时空间，提交时再调用 `fn_puts` */
+    if (-1 != buf->n && NULL != sink->fn_reserve) {
+        char *data = sink->fn_reserve(sink, len);
+        if (NULL != data) {
+            sink_buf->scratch.data = NULL;
+            return data;
+        }
+    }
+
+    char *data = scratch_reserve(&sink_buf->scratch, len);
+    if (NULL == data)
+        sink_buf_fail(sink_buf);
+
+    return data;
+}
+
+static void sink_buf_commit(struct k_printf_buf *buf, size_t used) {
+
+    struct sink_buf *sink_buf = (struct sink_buf *)buf;
+
+    if (NULL != sink_buf->scratch.data) {
+        scratch_commit(&sink_buf->scratch, buf, used);
+        return;
+    }
+
+    sink_buf->sink->fn_commit(sink_buf->sink, used);
+    sink_buf_add_n(sink_buf, used);
+}
+
+static void init_sink_buf(struct sink_buf *buf, const struct k_printf_config *config, struct k_printf_sink *sink) {
+
+    buf->impl.fn_puts     = sink_buf_puts,
+    buf->impl.fn_puts_ref = sink_buf_puts,
+    buf->impl.fn_printf   = sink_buf_printf,
+    buf->impl.fn_vprintf  = sink_buf_vprintf,
+    buf->impl.fn_reserve  = sink_buf_reserve,
+    buf->impl.fn_commit   = sink_buf_commit,
+    buf->impl.n           = 0;
+    buf->sink             = sink;
+    buf->count            = 0;
+    buf->scratch.config   = config;
+    buf->scratch.data     = NULL;
+}
+
+/* 格式化结束后刷新输出目标，返回写入的字符数，出错时返回 -1 */
+static long long sink_buf_finish(struct sink_buf *buf) {
+
+    struct k_printf_sink *sink = buf->sink;
+
+    if (-1 == buf->impl.n)
+        sink_buf_fail(buf);
+
+    if (NULL != sink->fn_flush && 0 != sink->fn_flush(sink))
+        sink_buf_fail(buf);
+
+    if (0 != sink->error)
+        return -1;
+
+    return (long long)buf->count;
+}
+
+/* endregion */
+
+/* region [count_buf] */
+
+/* 只计数的缓冲区，不保存任何内容，用于计算格式化后的字符串长度 */
+struct count_buf {
+    struct k_printf_buf impl;
+    struct reserve_scratch scratch;
+};
+
+static void count_buf_puts(struct k_printf_buf *buf, const char *str, size_t len) {
+    (void)str;
+
+    if (-1 == buf->n)
+        return;
+
+    if (len <= INT_MAX) {
+        buf->n += (int)len;
+        if (buf->n < 0)
+            buf->n = -1;
+    } else {
+        buf->n = -1;
+    }
+}
+
+static void count_buf_vprintf(struct k_printf_buf *buf, const char *fmt, va_list args) {
+    if (-1 == buf->n)
+        return;
+
+    int r = vsnprintf(NULL, 0, fmt, args);
+    if (r < 0) {
+        buf->n = -1;
+        return;
+    }
+
+    count_buf_puts(buf, NULL, (size_t)r);
+}
+
+static void count_buf_printf(struct k_printf_buf *buf, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    count_buf_vprintf(buf, fmt, args);
+    va_end(args);
+}
+
+/* 回调仍可能通过 `fn_reserve` 写入内容，故提供临时空间，提交时只计数 */
+static char *count_buf_reserve(struct k_printf_buf *buf, size_t len) {
+
+    struct count_buf *count_buf = (struct count_buf *)buf;
+
+    char *data = scratch_reserve(&count_buf->scratch, len);
+    if (NULL == data)
+        buf->n = -1;
+
+    return data;
+}
+
+static void count_buf_commit(struct k_printf_buf *buf, size_t used) {
+
+    struct count_buf *count_buf = (struct count_buf *)buf;
+
+    scratch_commit(&count_buf->scratch, buf, used);
+}
+
+static void init_count_buf(struct count_buf *buf, const struct k_printf_config *config) {
+
+    buf->impl.fn_puts     = count_buf_puts,
+    buf->impl.fn_puts_ref = count_buf_puts,
+    buf->impl.fn_printf   = count_buf_printf,
+    buf->impl.fn_vprintf  = count_buf_vprintf,
+    buf->impl.fn_reserve  = count_buf_reserve,
+    buf->impl.fn_commit   = count_buf_commit,
+    buf->impl.n           = 0;
+    buf->scratch.config   = config;
+    buf->scratch.data     = NULL;
+}
+
+static int is_count_buf(const struct k_printf_buf *buf) {
+    return count_buf_puts == buf->fn_puts;
+}
+
+/* endregion */
+
+/* region [bignum] */
+
+/* 浮点数精确转换为十进制时使用的大整数，以 2^32 为基数，低位在前
+ *
+ * double 转换过程中出现的整数不超过 2^1200，40 个 32 位的数位足以容纳。
+ */
+#define BIG_CAPACITY 40
+
+struct big {
+    int len;
+    uint32_t d[BIG_CAPACITY];
+};
+
+static void big_set_u64(struct big *a, uint64_t v) {
+    a->d[0] = (uint32_t)v;
+    a->d[1] = (uint32_t)(v >> 32);
+    a->len  = (0 != a->d[1]) ? 2 : (0 != a->d[0]) ? 1 : 0;
+}
+
+static void big_copy(struct big *dst, const struct big *src) {
+    dst->len = src->len;
+    memcpy(dst->d, src->d, sizeof(uint32_t) * src->len);
+}
+
+static void big_mul_small(struct big *a, uint32_t m) {
+
+    uint64_t carry = 0;
+
+    int i;
+    for (i = 0; i < a->len; ++i) {
+        uint64_t t = (uint64_t)a->d[i] * m + carry;
+        a->d[i] = (uint32_t)t;
+        carry   = t >> 32;
+    }
+    if (0 != carry)
+        a->d[a->len++] = (uint32_t)carry;
+}
+
+static void big_mul_pow10(struct big *a, int n) {
+
+    static const uint32_t pow10[9] = {
+        1u, 10u, 100u, 1000u, 10000u, 100000u, 1000000u, 10000000u, 100000000u
+    };
+
+    for (; 9 <= n; n -= 9)
+        big_mul_small(a, 1000000000u);
+    if (0 < n)
+        big_mul_small(a, pow10[n]);
+}
+
+static void big_shl(struct big *a, int bits) {
+    if (0 == a->len)
+        return;
+
+    int limbs = bits / 32;
+    int shift = bits % 32;
+
+    if (0 != shift) {
+        uint32_t carry = 0;
+
+        int i;
+        for (i = 0; i < a->len; ++i) {
+            uint32_t t = a->d[i];
+            a->d[i] = (t << shift) | carry;
+            carry   = t >> (32 - shift);
+        }
+        if (0 != carry)
+            a->d[a->len++] = carry;
+    }
+
+    if (0 != limbs) {
+        memmove(&a->d[limbs], a->d, sizeof(uint32_t) * a->len);
+        memset(a->d, 0, sizeof(uint32_t) * limbs);
+        a->len += limbs;
+    }
+}
+
+static int big_cmp(const struct big *a, const struct big *b) {
+
+    if (a->len != b->len)
+        return (a->len < b->len) ? -1 : 1;
+
+    int i;
+    for (i = a->len - 1; 0 <= i; --i) {
+        if (a->d[i] != b->d[i])
+            return (a->d[i] < b->d[i]) ? -1 : 1;
+    }
+    return 0;
+}
+
+/* `sum = a + b` */
+static void big_add(struct big *sum, const struct big *a, const struct big *b) {
+
+    if (a->len < b->len) {
+        const struct big *t = a;
+        a = b;
+        b = t;
+    }
+
+    uint64_t carry = 0;
+
+    int i;
+    for (i = 0; i < a->len; ++i) {
+        uint64_t t = (uint64_t)a->d[i] + (i < b->len ? b->d[i] : 0) + carry;
+        sum->d[i] = (uint32_t)t;
+        carry     = t >> 32;
+    }
+    sum->len = a->len;
+    if (0 != carry)
+        sum->d[sum->len++] = (uint32_t)carry;
+}
+
+/* `a -= q * b`，要求结果非负 */
+static void big_sub_mul(struct big *a, const struct big *b, uint32_t q) {
+
+    uint64_t borrow = 0;
+
+    int i;
+    for (i = 0; i < a->len; ++i) {
+        uint64_t t = (i < b->len ? (uint64_t)b->d[i] * q : 0) + borrow;
+        uint32_t lo = (uint32_t)t;
+        borrow = (t >> 32) + (a->d[i] < lo);
+        a->d[i] -= lo;
+    }
+
+    while (0 < a->len && 0 == a->d[a->len - 1])
+        a->len--;
+}
+
+/* 要求 `a < 10 * b`，且 `b` 的最高位数位不小于 2^27。返回商 `a / b`，并将 `a` 替换为余数 */
+static int big_div_digit(struct big *a, const struct big *b) {
+
+    if (a->len < b->len)
+        return 0;
+
+    /* 用最高的 64 位估算商，估算值不大于真实的商，且最多小 1 */
+    uint64_t top = a->d[b->len - 1];
+    if (a->len > b->len)
+        top |= (uint64_t)a->d[b->len] << 32;
+
+    uint32_t q = (uint32_t)(top / ((uint64_t)b->d[b->len - 1] + 1));
+    if (0 != q)
+        big_sub_mul(a, b, q);
+
+    while (0 <= big_cmp(a, b)) {
+        big_sub_mul(a, b, 1);
+        q++;
+    }
+    return (int)q;
+}
+
+/* 将各个大整数同时左移，使 `s` 的最高位数位落在 `[2^27, 2^28)` 内，以满足 `big_div_digit` 的要求 */
+static void big_normalize(struct big *s, struct big *r, struct big *m1, struct big *m2) {
+
+    int top_bits = 0;
+
+    uint32_t top = s->d[s->len - 1];
+    for (; 0 != top; top >>= 1)
+        top_bits++;
+
+    int bits = (28 - top_bits + 32) % 32;
+
+    big_shl(s, bits);
+    big_shl(r, bits);
+    if (NULL != m1)
+        big_shl(m1, bits);
+    if (NULL != m2)
+        big_shl(m2, bits);
+}
+
+/* endregion */
+
+/* region [c_std_spec] */
+
+/* 处理 C `printf` 中 `%n` 一族的格式说明符
+ *
+ * 函数假定传入的格式说明符类型是正确的。
+ */
+static void printf_callback_c_std_spec_n(struct k_printf_buf *buf, const struct k_printf_spec *spec, va_list *args) {
+
+    const char c1 = spec->type[0];
+    const char c2 = spec->type[1];
+
+    int n = buf->n;
+
+    if (c1=='n') {
+        *(va_arg(*args, int *)) = (int)n; /* %n */
+    } else if (c1=='j') {
+        *(va_arg(*args, intmax_t *)) = (intmax_t)n; /* %jn */
+    } else if (c1=='t') {
+        *(va_arg(*args, ptrdiff_t *)) = (ptrdiff_t)n; /* %tn */
+    } else if (c1=='z') {
+        *(va_arg(*args, size_t *)) = (size_t)n; /* %zn */
+    } else if (c1=='l') {
+        if (c2=='l') {
+            *(va_arg(*args, long long *)) = (long long)n; /* %lln */
+        } else {
+            *(va_arg(*args, long *)) = (long)n; /* %ln */
+        }
+    } else {
+        if (c2 == 'h') {
+            *(va_arg(*args, unsigned char *)) = (unsigned char)n; /* %hhn */
+        } else {
+            *(va_arg(*args, short *)) = (short)n; /* %hn */
+        }
+    }
+}
+
+/* 预先填好的空格与 '0'，可以直接以 `fn_puts_ref` 写入缓冲区，不必每次都 memset */
+#define FILL_BLOCK_SIZE 64
+
+static const char fill_spaces[FILL_BLOCK_SIZE] =
+    "                                                                ";
+static const char fill_zeros[FILL_BLOCK_SIZE] =
+    "0000000000000000000000000000000000000000000000000000000000000000";
+
+/* 往缓冲区写入 `n` 个字符 `ch`
+ *
+ * 空格与 '0' 引用静态的预填充块，能够引用内存的缓冲区（例如 `fd_buf`）因而不必拷贝。
+ */
+static void buf_fill(struct k_printf_buf *buf, char ch, size_t n) {
+
+    const char *block;
+    char block_[FILL_BLOCK_SIZE];
+
+    if (' ' == ch) {
+        block = fill_spaces;
+    } else if ('0' == ch) {
+        block = fill_zeros;
+    } else {
+        memset(block_, ch, n < sizeof(block_) ? n : sizeof(block_));
+        block = block_;
+    }
+
+    while (FILL_BLOCK_SIZE < n && -1 != buf->n) {
+        if (block == block_)
+            buf->fn_puts(buf, block, FILL_BLOCK_SIZE);
+        else
+            buf->fn_puts_ref(buf, block, FILL_BLOCK_SIZE);
+        n -= FILL_BLOCK_SIZE;
+    }
+    if (0 < n) {
+        if (block == block_)
+            buf->fn_puts(buf, block, n);
+        else
+            buf->fn_puts_ref(buf, block, n);
+    }
+}
+
+/* 按 `spec` 的最小宽度与对齐方式输出 `len` 个字符 `str`，`spec` 中的 `*` 须已处理
+ *
+ * 若 `is_ref` 为 1，则 `str` 在输出结束前保持有效，可以用 `fn_puts_ref` 引用而不拷贝。
+ * 填充的内容较短时在 `fn_reserve` 预留的空间中一次拼好，否则填充与内容分别写入。
+ */
+static void put_padded(struct k_printf_buf *buf, const struct k_printf_spec *spec, const char *str, size_t len, int is_ref) {
+
+    size_t pad_num = 0;
+    if (spec->use_min_width && len < (size_t)spec->min_width)
+        pad_num = (size_t)spec->min_width - len;
+
+    if (0 == pad_num) {
+        if (is_ref)
+            buf->fn_puts_ref(buf, str, len);
+        else
+            buf->fn_puts(buf, str, len);
+        return;
+    }
+
+    if (len + pad_num <= 128) {
+        char *dst = buf->fn_reserve(buf, len + pad_num);
+        if (NULL == dst)
+            return;
+
+        if (spec->left_justified) {
+            memcpy(dst, str, len);
+            memset(dst + len, ' ', pad_num);
+        } else {
+            memset(dst, ' ', pad_num);
+            memcpy(dst + pad_num, str, len);
+        }
+        buf->fn_commit(buf, len + pad_num);
+        return;
+    }
+
+    if ( ! spec->left_justified)
+        buf_fill(buf, ' ', pad_num);
+
+    if (is_ref)
+        buf->fn_puts_ref(buf, str, len);
+    else
+        buf->fn_puts(buf, str, len);
+
+    if (spec->left_justified)
+        buf_fill(buf, ' ', pad_num);
+}
+
+/* `%s` 的实参为 NULL 时输出的内容，与 glibc 一致 */
+static const char null_str[] = "(null)";
+
+/* 求字符串 `str` 的长度，若指定了精度则至多读取 `precision` 个字符
+ *
+ * `str` 为 NULL 时按输出 `null_str` 计算：与 glibc 一致，精度容纳不下整个 `null_str` 时输出空串。
+ */
+static size_t spec_str_len(const struct k_printf_spec *spec, const char *str) {
+
+    if (NULL == str) {
+        const size_t len = sizeof(null_str) - 1;
+        return ( ! spec->use_precision || len <= (size_t)spec->precision) ? len : 0;
+    }
+
+    if ( ! spec->use_precision)
+        return strlen(str);
+
+    const char *nul = memchr(str, '\0', (size_t)spec->precision);
+    return (NULL != nul) ? (size_t)(nul - str) : (size_t)spec->precision;
+}
+
+/* 将 `*` 指定的最小宽度写回 `spec`，负的最小宽度被视为左对齐修饰加上其绝对值 */
+static void set_spec_width(struct k_printf_spec *spec, int width) {
+    if (width < 0) {
+        spec->left_justified = 1;
+        width = (INT_MIN == width) ? INT_MAX : -width;
+    }
+    spec->min_width = width;
+}
+
+/* 将 `.*` 指定的精度写回 `spec`，负的精度被视为未指定精度 */
+static void set_spec_precision(struct k_printf_spec *spec, int precision) {
+    if (precision < 0)
+        spec->use_precision = 0;
+    else
+        spec->precision = precision;
+}
+
+/* 从不定长参数列表中读取 `*` 指定的最小宽度与精度，将其写回 `spec`
+ *
+ * 处理后 `spec` 中不再有值为 -1 的最小宽度或精度。
+ */
+static void resolve_spec_args(struct k_printf_spec *spec, va_list *args) {
+
+    if (spec->use_min_width && -1 == spec->min_width)
+        set_spec_width(spec, va_arg(*args, int));
+
+    if (spec->use_precision && -1 == spec->precision)
+        set_spec_precision(spec, va_arg(*args, int));
+}
+
+/* 两位十进制数字的查找表，`digit_pairs[2 * i]` 开始的两个字符是 i 的十进制表示（补齐到两位） */
+static const char digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/* 返回非零整数的二进制位数 */
+static int bit_length(uintmax_t v) {
+#if (defined(__GNUC__) || defined(__clang__)) && UINTMAX_MAX == ULLONG_MAX
+    return (int)(sizeof(unsigned long long) * CHAR_BIT) - __builtin_clzll(v);
+#else
+    int n = 0;
+    for (; 0 != v; v >>= 1)
+        n++;
+    return n;
+#endif
+}
+
+/* 返回整数的十进制位数，0 有 1 位
+ *
+ * 先由二进制位数估算出十进制位数 `t`（`1233 / 4096` 约为 `log10(2)`），
+ * 再与 10 的幂比较一次修正估算误差，避免逐位除以 10。
+ */
+static int count_decimal_digits(uintmax_t v) {
+#if UINTMAX_MAX == 0xffffffffffffffff
+    static const uintmax_t pow10[20] = {
+        1u, 10u, 100u, 1000u, 10000u, 100000u, 1000000u, 10000000u, 100000000u, 1000000000u,
+        10000000000u, 100000000000u, 1000000000000u, 10000000000000u, 100000000000000u,
+        1000000000000000u, 10000000000000000u, 100000000000000000u, 1000000000000000000u,
+        10000000000000000000u,
+    };
+
+    int t = bit_length(v | 1) * 1233 >> 12;
+    return t + 1 - (v < pow10[t]);
+#else
+    int n = 1;
+    for (; 10 <= v; v /= 10)
+        n++;
+    return n;
+#endif
+}
+
+/* 将整数以 `conv`（`d` `i` `u` `o` `x` `X` 之一）指定的进制写入到 `[p, p + digit_num)` */
+static void write_int_digits(char *p, int digit_num, char conv, uintmax_t v) {
+
+    char *ch = p + digit_num;
+
+    switch (conv) {
+        case 'x': case 'X': {
+            const char *hex = ('x' == conv) ? "0123456789abcdef" : "0123456789ABCDEF";
+            while (p < ch) {
+                *--ch = hex[v & 0xf];
+                v >>= 4;
+            }
+            break;
+        }
+        case 'o':
+            while (p < ch) {
+                *--ch = (char)('0' + (v & 7));
+                v >>= 3;
+            }
+            break;
+        default:
+            while (100 <= v) {
+                unsigned int r = (unsigned int)(v % 100);
+                v /= 100;
+                ch -= 2;
+                memcpy(ch, &digit_pairs[2 * r], 2);
+            }
+            if (10 <= v) {
+                ch -= 2;
+                memcpy(ch, &digit_pairs[2 * v], 2);
+            } else if (p < ch) {
+                *--ch = (char)('0' + v);
+            }
+            break;
+    }
+}
+
+/* 整数输出中各部分的长度 */
+struct int_layout {
+    char sign;
+    const char *prefix;
+    int prefix_len;
+    int digit_num;
+    size_t zero_num;
+    size_t len;     /* 符号、前缀、补零与数字的总长度，不含填充 */
+    size_t pad_num;
+};
+
+/* 依次计算符号、前缀、数字、补零和填充的长度 */
+static void layout_int(struct int_layout *layout, const struct k_printf_spec *spec, char conv, uintmax_t v, int negative) {
+
+    char sign = '\0';
+    if ('d' == conv || 'i' == conv) {
+        if (negative)
+            sign = '-';
+        else if (spec->sign_prepended)
+            sign = '+';
+        else if (spec->space_padded)
+            sign = ' ';
+    }
+
+    const char *prefix = "";
+    int prefix_len = 0;
+    if (spec->alternative_form && 0 != v && ('x' == conv || 'X' == conv)) {
+        prefix     = ('x' == conv) ? "0x" : "0X";
+        prefix_len = 2;
+    }
+
+    int digit_num;
+    if (0 == v)
+        digit_num = (spec->use_precision && 0 == spec->precision) ? 0 : 1;
+    else if ('x' == conv || 'X' == conv)
+        digit_num = (bit_length(v) + 3) / 4;
+    else if ('o' == conv)
+        digit_num = (bit_length(v) + 2) / 3;
+    else
+        digit_num = count_decimal_digits(v);
+
+    size_t zero_num = 0;
+    if (spec->use_precision && digit_num < spec->precision)
+        zero_num = (size_t)(spec->precision - digit_num);
+
+    /* `#o` 要求输出的第一个数字是 0 */
+    if ('o' == conv && spec->alternative_form && 0 == zero_num && (0 == digit_num || 0 != v))
+        zero_num = 1;
+
+    size_t len = (sign ? 1 : 0) + (size_t)prefix_len + zero_num + (size_t)digit_num;
+
+    size_t pad_num = 0;
+    if (spec->use_min_width && len < (size_t)spec->min_width)
+        pad_num = (size_t)spec->min_width - len;
+
+    /* 零填充只在右对齐且未指定精度时生效，填充的零位于符号与前缀之后 */
+    if (pad_num && ! spec->left_justified && spec->zero_padding && ! spec->use_precision) {
+        zero_num += pad_num;
+        len      += pad_num;
+        pad_num   = 0;
+    }
+
+    layout->sign       = sign;
+    layout->prefix     = prefix;
+    layout->prefix_len = prefix_len;
+    layout->digit_num  = digit_num;
+    layout->zero_num   = zero_num;
+    layout->len        = len;
+    layout->pad_num    = pad_num;
+}
+
+/* 按 C `printf` 的规则格式化一个整数，写入到缓冲区
+ *
+ * `spec` 中的 `*` 应已被 `resolve_spec_args` 处理。
+ * `conv` 是转换指示符（`d` `i` `u` `o` `x` `X` 之一），`v` 是整数的绝对值，`negative` 表示是否为负数。
+ */
+static void put_int(struct k_printf_buf *buf, const struct k_printf_spec *spec, char conv, uintmax_t v, int negative) {
+
+    struct int_layout layout;
+    layout_int(&layout, spec, conv, v, negative);
+
+    const char sign       = layout.sign;
+    const char *prefix    = layout.prefix;
+    const int prefix_len  = layout.prefix_len;
+    const int digit_num   = layout.digit_num;
+    const size_t zero_num = layout.zero_num;
+    const size_t len      = layout.len;
+    const size_t pad_num  = layout.pad_num;
+
+    /* 若结果不长，则直接在缓冲区预留的空间中拼接好 */
+
+    char out[128];
+    if (len + pad_num <= sizeof(out)) {
+        char *dst = buf->fn_reserve(buf, len + pad_num);
+        if (NULL == dst)
+            return;
+
+        char *p = dst;
+        if ( ! spec->left_justified) {
+            memset(p, ' ', pad_num);
+            p += pad_num;
+        }
+        if (sign)
+            *p++ = sign;
+        memcpy(p, prefix, (size_t)prefix_len);
+        p += prefix_len;
+        memset(p, '0', zero_num);
+        p += zero_num;
+        write_int_digits(p, digit_num, conv, v);
+        p += digit_num;
+        if (spec->left_justified) {
+            memset(p, ' ', pad_num);
+            p += pad_num;
+        }
+        buf->fn_commit(buf, (size_t)(p - dst));
+        return;
+    }
+
+    if ( ! spec->left_justified)
+        buf_fill(buf, ' ', pad_num);
+
+    char *p = out;
+    if (sign)
+        *p++ = sign;
+    memcpy(p, prefix, (size_t)prefix_len);
+    p += prefix_len;
+    if (0 < p - out)
+        buf->fn_puts(buf, out, (size_t)(p - out));
+
+    buf_fill(buf, '0', zero_num);
+
+    write_int_digits(out, digit_num, conv, v);
+    if (0 < digit_num)
+        buf->fn_puts(buf, out, (size_t)digit_num);
+
+    if (spec->left_justified)
+        buf_fill(buf, ' ', pad_num);
+}
+
+/* 按整数格式说明符的长度修饰读取一个实参，返回其绝对值，并通过 `get_negative` 返回其是否为负 */
+static uintmax_t fetch_int_arg(const struct k_printf_spec *spec, va_list *args, int *get_negative) {
+
+    const char c1   = spec->type[0];
+    const char c2   = spec->type[1];
+    const char conv = spec->end[-1];
+
+    uintmax_t v;
+    int negative = 0;
+
+    if ('d' == conv || 'i' == conv) {
+        intmax_t i;
+        if (c1 == 'h')
+            i = (c2 == 'h') ? (signed char)va_arg(*args, int) : (short)va_arg(*args, int);
+        else if (c1 == 'l')
+            i = (c2 == 'l') ? va_arg(*args, long long) : va_arg(*args, long);
+        else if (c1 == 'j')
+            i = va_arg(*args, intmax_t);
+        else if (c1 == 'z')
+            i = (intmax_t)(ptrdiff_t)va_arg(*args, size_t);
+        else if (c1 == 't')
+            i = va_arg(*args, ptrdiff_t);
+        else
+            i = va_arg(*args, int);
+
+        negative = i < 0;
+        v = negative ? (uintmax_t)0 - (uintmax_t)i : (uintmax_t)i;
+    } else {
+        if (c1 == 'h')
+            v = (c2 == 'h') ? (unsigned char)va_arg(*args, unsigned int) : (unsigned short)va_arg(*args, unsigned int);
+        else if (c1 == 'l')
+            v = (c2 == 'l') ? va_arg(*args, unsigned long long) : va_arg(*args, unsigned long);
+        else if (c1 == 'j')
+            v = va_arg(*args, uintmax_t);
+        else if (c1 == 'z')
+            v = va_arg(*args, size_t);
+        else if (c1 == 't')
+            v = (size_t)va_arg(*args, ptrdiff_t);
+        else
+            v = va_arg(*args, unsigned int);
+    }
+
+    *get_negative = negative;
+    return v;
+}
+
+/* 处理 C `printf` 中的整数格式说明符，即 `%d` `%i` `%u` `%o` `%x` `%X`，以及它们的所有长度修饰
+ *
+ * 整数在本地直接格式化，不再交由 C `printf` 处理。
+ * 函数假定传入的格式说明符类型是正确的。
+ */
+static void printf_callback_c_std_spec_int(struct k_printf_buf *buf, const struct k_printf_spec *spec, va_list *args) {
+
+    struct k_printf_spec spec_ = *spec;
+    resolve_spec_args(&spec_, args);
+
+    int negative;
+    uintmax_t v = fetch_int_arg(spec, args, &negative);
+
+    put_int(buf, &spec_, spec->end[-1], v, negative);
+}
+
+/* 计算整数格式说明符的输出长度，不产生字符 */
+static int measure_c_std_spec_int(const struct k_printf_spec *spec, va_list *args) {
+
+    struct k_printf_spec spec_ = *spec;
+    resolve_spec_args(&spec_, args);
+
+    int negative;
+    uintmax_t v = fetch_int_arg(spec, args, &negative);
+
+    struct int_layout layout;
+    layout_int(&layout, &spec_, spec->end[-1], v, negative);
+
+    size_t len = layout.len + layout.pad_num;
+    return (len <= INT_MAX) ? (int)len : -1;
+}
+
+/* 暂存要写入缓冲区的零碎内容，攒成一批后再调用一次 `fn_puts` */
+struct put_stage {
+    struct k_printf_buf *buf;
+    size_t len;
+    char data[256];
+};
+
+static void stage_flush(struct put_stage *stage) {
+    if (0 < stage->len) {
+        stage->buf->fn_puts(stage->buf, stage->data, stage->len);
+        stage->len = 0;
+    }
+}
+
+static void stage_puts(struct put_stage *stage, const char *str, size_t len) {
+
+    if (sizeof(stage->data) - stage->len < len) {
+        stage_flush(stage);
+        if (sizeof(stage->data) < len) {
+            stage->buf->fn_puts(stage->buf, str, len);
+            return;
+        }
+    }
+
+    memcpy(&stage->data[stage->len], str, len);
+    stage->len += len;
+}
+
+static void stage_fill(struct put_stage *stage, char ch, size_t n) {
+
+    if (sizeof(stage->data) - stage->len < n) {
+        stage_flush(stage);
+        if (sizeof(stage->data) < n) {
+            buf_fill(stage->buf, ch, n);
+            return;
+        }
+    }
+
+    memset(&stage->data[stage->len], ch, n);
+    stage->len += n;
+}
+
+#if defined(K_PRINTF_NATIVE_DOUBLE)
+
+/* 一个 double 的精确十进制展开至多有 767 位有效数字，再多的数字都是 0 */
+#define DOUBLE_DIGITS_CAPACITY 800
+
+/* 估算 `[2^(b-1), 2^b)` 内的数的十进制指数 `floor(log10(v))`，误差不超过 1 */
+static int estimate_exp10(int b) {
+    int x = (b - 1) * 1233;
+    return (0 <= x) ? x / 4096 : -((-x + 4095) / 4096);
+}
+
+/* 生成正有限浮点数 `f * 2^e` 的十进制数字，结果舍入到指定的位数
+ *
+ * 若 `frac_digits` 非负，则结果精确到小数点后 `frac_digits` 位（定点形式），
+ * 否则结果保留 `sig_digits` 位有效数字（指数形式）。
+ * 舍入时采用精确的大整数运算，恰好居中时舍入到偶数，与 glibc 在默认舍入模式下的输出一致。
+ *
+ * 函数返回写入 `digits` 的数字个数 `nd`，末尾的 0 会被省略，之后的数字均视为 0。
+ * `*get_k` 为第一个数字的十进制指数，即结果为 `d[0].d[1]d[2]... * 10^k`。
+ * 若舍入时进位使第一个数字的指数增加了 1，则 `*get_carried` 为 1，否则为 0。
+ * 若在定点形式下结果为 0，则返回 0。
+ */
+static int gen_digits(uint64_t f, int e, int frac_digits, int sig_digits, char *digits, int *get_k, int *get_carried) {
+
+    struct big r, s, t;
+    big_set_u64(&r, f);
+    big_set_u64(&s, 1);
+    if (0 <= e)
+        big_shl(&r, e);
+    else
+        big_shl(&s, -e);
+
+    /* 缩放使 `r / s` 落在 `[1, 10)` 内 */
+
+    int k = estimate_exp10(e + bit_length(f));
+    if (0 <= k)
+        big_mul_pow10(&s, k);
+    else
+        big_mul_pow10(&r, -k);
+
+    big_copy(&t, &s);
+    big_mul_small(&t, 10);
+    if (0 <= big_cmp(&r, &t)) {
+        s = t;
+        k++;
+    } else if (big_cmp(&r, &s) < 0) {
+        big_mul_small(&r, 10);
+        k--;
+    }
+
+    big_normalize(&s, &r, NULL, NULL);
+
+    *get_k = k;
+    *get_carried = 0;
+
+    int count = (0 <= frac_digits) ? k + 1 + frac_digits : sig_digits;
+    if (count < 0)
+        return 0;
+
+    /* 要保留的最高位比第一个数字还高一位，结果要么是 0，要么是 10^-frac_digits */
+    if (0 == count) {
+        big_copy(&t, &s);
+        big_mul_small(&t, 5);
+        if (0 < big_cmp(&r, &t)) {
+            digits[0] = '1';
+            *get_k = k + 1;
+            *get_carried = 1;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (DOUBLE_DIGITS_CAPACITY < count)
+        count = DOUBLE_DIGITS_CAPACITY;
+
+    /* 逐位生成数字，之后比较余数的两倍与 `s`，以决定是否进位，`c` 为 -2 表示余数为 0 */
+    int nd = 0;
+    int c;
+    if (s.len <= 2) {
+
+        /* 规范化后 `s < 2^60`，`r < 10 * s` 可以直接用 64 位整数运算，这覆盖了大多数常见的数值 */
+        uint64_t s64 = s.d[0] | (2 == s.len ? (uint64_t)s.d[1] << 32 : 0);
+        uint64_t r64 = (0 == r.len) ? 0 : r.d[0] | (2 <= r.len ? (uint64_t)r.d[1] << 32 : 0);
+#if defined(__SIZEOF_INT128__)
+        /* 每次用一次 128 位除法生成至多 19 位数字，`r * 10^18 < 2^124` 不会溢出 */
+        static const uint64_t pow10[20] = {
+            1u, 10u, 100u, 1000u, 10000u, 100000u, 1000000u, 10000000u, 100000000u, 1000000000u,
+            10000000000u, 100000000000u, 1000000000000u, 10000000000000u, 100000000000000u,
+            1000000000000000u, 10000000000000000u, 100000000000000000u, 1000000000000000000u,
+            10000000000000000000u,
+        };
+        int n = (count < 19) ? count : 19;
+        unsigned __int128 x = (unsigned __int128)r64 * pow10[n - 1];
+        for (;;) {
+            uint64_t q = (uint64_t)(x / s64);
+            r64 = (uint64_t)(x % s64);
+            memset(&digits[nd], '0', (size_t)n);
+            write_int_digits(&digits[nd], n, 'd', q);
+            nd += n;
+            if (0 == r64 || nd == count)
+                break;
+            n = (count - nd < 19) ? count - nd : 19;
+            x = (unsigned __int128)r64 * pow10[n];
+        }
+#else
+        for (;;) {
+            uint64_t d = r64 / s64;
+            r64 -= d * s64;
+            digits[nd++] = (char)('0' + d);
+            if (0 == r64 || nd == count)
+                break;
+            r64 *= 10;
+        }
+#endif
+        c = (0 == r64) ? -2 : (2 * r64 > s64) - (2 * r64 < s64);
+    } else {
+        for (;;) {
+            digits[nd++] = (char)('0' + big_div_digit(&r, &s));
+            if (0 == r.len || nd == count)
+                break;
+            big_mul_small(&r, 10);
+        }
+        if (0 == r.len) {
+            c = -2;
+        } else {
+            big_shl(&r, 1);
+            c = big_cmp(&r, &s);
+        }
+    }
+
+    if (-2 != c) {
+        if (0 < c || (0 == c && (digits[nd - 1] - '0') % 2)) {
+            while (0 < nd && '9' == digits[nd - 1])
+                nd--;
+            if (0 == nd) {
+                digits[nd++] = '1';
+                *get_k = k + 1;
+                *get_carried = 1;
+            } else {
+                digits[nd - 1]++;
+            }
+        }
+    }
+
+    while (0 < nd && '0' == digits[nd - 1])
+        nd--;
+
+    return nd;
+}
+
+/* 生成正有限浮点数 `f * 2^e` 的最短十进制表示，该表示被读回时能精确还原为原值
+ *
+ * 采用 Steele & White / Burger & Dybvig 的算法，返回值及 `*get_k` 的含义同 `gen_digits`。
+ */
+static int gen_shortest_digits(uint64_t f, int e, char *digits, int *get_k) {
+
+    /* 原值与相邻两个浮点数的中点是能还原为原值的边界，`mp / s` 与 `mm / s` 分别是到上下边界的距离。
+     * 尾数恰为 2^52 时，下方相邻浮点数的间隔只有上方的一半。
+     */
+    int even     = (0 == (f & 1));
+    int boundary = ((uint64_t)1 << 52) == f && -1074 < e;
+
+    struct big r, s, mp, mm, t;
+    big_set_u64(&r,  f);
+    big_set_u64(&s,  1);
+    big_set_u64(&mp, 1);
+    big_set_u64(&mm, 1);
+
+    if (0 <= e) {
+        big_shl(&r,  e + 1 + boundary);
+        big_shl(&s,  1 + boundary);
+        big_shl(&mp, e + boundary);
+        big_shl(&mm, e);
+    } else {
+        big_shl(&r,  1 + boundary);
+        big_shl(&s,  1 - e + boundary);
+        big_shl(&mp, boundary);
+    }
+
+    /* 缩放使上边界 `(r + mp) / s` 落在 `(0.1, 1]` 内，具体开闭取决于尾数奇偶 */
+
+    int k = estimate_exp10(e + bit_length(f)) + 1;
+    if (0 <= k) {
+        big_mul_pow10(&s, k);
+    } else {
+        big_mul_pow10(&r,  -k);
+        big_mul_pow10(&mp, -k);
+        big_mul_pow10(&mm, -k);
+    }
+
+    for (;;) {
+        big_add(&t, &r, &mp);
+        int c = big_cmp(&t, &s);
+        if (c < 0 || ( ! even && 0 == c))
+            break;
+        big_mul_small(&s, 10);
+        k++;
+    }
+    for (;;) {
+        big_add(&t, &r, &mp);
+        big_mul_small(&t, 10);
+        int c = big_cmp(&t, &s);
+        if (0 < c || (even && 0 == c))
+            break;
+        big_mul_small(&r,  10);
+        big_mul_small(&mp, 10);
+        big_mul_small(&mm, 10);
+        k--;
+    }
+
+    big_normalize(&s, &r, &mp, &mm);
+
+    *get_k = k - 1;
+
+    int nd = 0;
+    for (;;) {
+        big_mul_small(&r,  10);
+        big_mul_small(&mp, 10);
+        big_mul_small(&mm, 10);
+
+        int d = big_div_digit(&r, &s);
+
+        int c1 = big_cmp(&r, &mm);
+        int low = c1 < 0 || (even && 0 == c1);
+
+        big_add(&t, &r, &mp);
+        int c2 = big_cmp(&t, &s);
+        int high = 0 < c2 || (even && 0 == c2);
+
+        if ( ! low && ! high) {
+            digits[nd++] = (char)('0' + d);
+            continue;
+        }
+
+        if (low && high) {
+            big_copy(&t, &r);
+            big_shl(&t, 1);
+            if (0 <= big_cmp(&t, &s))
+                d++;
+        } else if (high) {
+            d++;
+        }
+
+        digits[nd++] = (char)('0' + d);
+        break;
+    }
+
+    while (0 < nd && '0' == digits[nd - 1])
+        nd--;
+
+    return nd;
+}
+
+/* 将十进制数字 `d[0].d[1]d[2]... * 10^k` 以定点或指数形式写入缓冲区
+ *
+ * `exp_form` 表示是否使用指数形式，`frac` 为小数点后的位数，
+ * `digits` 中第 `nd` 位之后的数字视为 0，`nd` 为 0 表示值为 0。
+ */
+static void put_float_digits(struct k_printf_buf *buf, const struct k_printf_spec *spec, char sign, int upper,
+                             int exp_form, const char *digits, int nd, int k, int frac) {
+
+    int has_point = (0 < frac || spec->alternative_form);
+
+    char exp_buf[8];
+    int  exp_len = 0;
+    if (exp_form) {
+        int x = (0 == nd) ? 0 : k;
+        exp_buf[exp_len++] = upper ? 'E' : 'e';
+        exp_buf[exp_len++] = (x < 0) ? '-' : '+';
+        if (x < 0)
+            x = -x;
+        if (100 <= x)
+            exp_buf[exp_len++] = (char)('0' + x / 100);
+        memcpy(&exp_buf[exp_len], &digit_pairs[2 * (x % 100)], 2);
+        exp_len += 2;
+    }
+
+    size_t int_len = ( ! exp_form && 0 < nd && 0 <= k) ? (size_t)k + 1 : 1;
+    size_t len = (sign ? 1 : 0) + int_len + (has_point ? 1 + (size_t)frac : 0) + (size_t)exp_len;
+
+    size_t pad_num = 0;
+    if (spec->use_min_width && len < (size_t)spec->min_width)
+        pad_num = (size_t)spec->min_width - len;
+
+    struct put_stage stage;
+    stage.buf = buf;
+    stage.len = 0;
+
+    if ( ! spec->left_justified && ! spec->zero_padding)
+        stage_fill(&stage, ' ', pad_num);
+    if (sign)
+        stage_puts(&stage, &sign, 1);
+    if ( ! spec->left_justified && spec->zero_padding)
+        stage_fill(&stage, '0', pad_num);
+
+    /* 整数部分，以及小数部分的第一个数字在 `digits` 中的下标 */
+    int idx;
+    if (exp_form) {
+        stage_puts(&stage, (0 < nd) ? digits : "0", 1);
+        idx = 1;
+    } else if (0 < nd && 0 <= k) {
+        size_t n = (size_t)(nd < k + 1 ? nd : k + 1);
+        stage_puts(&stage, digits, n);
+        stage_fill(&stage, '0', int_len - n);
+        idx = k + 1;
+    } else {
+        stage_puts(&stage, "0", 1);
+        idx = k + 1;
+    }
+
+    if (has_point) {
+        stage_puts(&stage, ".", 1);
+
+        size_t remain = (size_t)frac;
+
+        /* 小数点后、第一个数字之前的 0 */
+        if (idx < 0 && 0 < nd) {
+            size_t n = (size_t)-idx < remain ? (size_t)-idx : remain;
+            stage_fill(&stage, '0', n);
+            remain -= n;
+            idx = 0;
+        }
+        if (0 <= idx && idx < nd) {
+            size_t n = (size_t)(nd - idx) < remain ? (size_t)(nd - idx) : remain;
+            stage_puts(&stage, &digits[idx], n);
+            remain -= n;
+        }
+        stage_fill(&stage, '0', remain);
+    }
+
+    stage_puts(&stage, exp_buf, (size_t)exp_len);
+
+    if (spec->left_justified)
+        stage_fill(&stage, ' ', pad_num);
+
+    stage_flush(&stage);
+}
+
+/* 输出无穷或非数，零填充修饰对其无效 */
+static void put_float_special(struct k_printf_buf *buf, const struct k_printf_spec *spec, char sign, int upper, int is_nan) {
+
+    char out[4];
+    size_t len = 0;
+    if (sign)
+        out[len++] = sign;
+    memcpy(&out[len], is_nan ? (upper ? "NAN" : "nan") : (upper ? "INF" : "inf"), 3);
+    len += 3;
+
+    size_t pad_num = 0;
+    if (spec->use_min_width && len < (size_t)spec->min_width)
+        pad_num = (size_t)spec->min_width - len;
+
+    if ( ! spec->left_justified)
+        buf_fill(buf, ' ', pad_num);
+    buf->fn_puts(buf, out, len);
+    if (spec->left_justified)
+        buf_fill(buf, ' ', pad_num);
+}
+
+/* 将 double 拆分为符号、尾数 `f` 与指数 `e`，使其绝对值为 `f * 2^e`
+ *
+ * 返回 0 表示有限值，1 表示无穷，2 表示非数。
+ */
+static int decompose_double(double v, int *get_negative, uint64_t *get_f, int *get_e) {
+
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+
+    int      bexp = (int)((bits >> 52) & 0x7ff);
+    uint64_t frac = bits & (((uint64_t)1 << 52) - 1);
+
+    *get_negative = (int)(bits >> 63);
+
+    if (0x7ff == bexp)
+        return (0 == frac) ? 1 : 2;
+
+    if (0 == bexp) {
+        *get_f = frac;
+        *get_e = -1074;
+    } else {
+        *get_f = frac | ((uint64_t)1 << 52);
+        *get_e = bexp - 1075;
+    }
+    return 0;
+}
+
+static char float_sign(const struct k_printf_spec *spec, int negative) {
+    if (negative)
+        return '-';
+    if (spec->sign_prepended)
+        return '+';
+    if (spec->space_padded)
+        return ' ';
+    return '\0';
+}
+
+/* 按 C `printf` 的规则格式化一个 double，写入到缓冲区
+ *
+ * `spec` 中的 `*` 应已被 `resolve_spec_args` 处理，`conv` 是转换指示符（`eEfFgG` 之一）。
+ */
+static void put_double(struct k_printf_buf *buf, const struct k_printf_spec *spec, char conv, double v) {
+
+    int negative;
+    uint64_t f;
+    int e;
+    int kind = decompose_double(v, &negative, &f, &e);
+
+    char sign  = float_sign(spec, negative);
+    int  upper = ('E' == conv || 'F' == conv || 'G' == conv);
+
+    if (0 != kind) {
+        put_float_special(buf, spec, sign, upper, 2 == kind);
+        return;
+    }
+
+    int precision = spec->use_precision ? spec->precision : 6;
+
+    char digits[DOUBLE_DIGITS_CAPACITY];
+    int  nd = 0;
+    int  k  = 0;
+    int  carried = 0;
+
+    switch (conv) {
+        case 'f': case 'F':
+            if (0 != f)
+                nd = gen_digits(f, e, precision, 0, digits, &k, &carried);
+            put_float_digits(buf, spec, sign, upper, 0, digits, nd, k, precision);
+            break;
+
+        case 'e': case 'E': {
+            int sig = (INT_MAX == precision) ? INT_MAX : precision + 1;
+            if (0 != f)
+                nd = gen_digits(f, e, -1, sig, digits, &k, &carried);
+            put_float_digits(buf, spec, sign, upper, 1, digits, nd, k, precision);
+            break;
+        }
+
+        default: {
+            /* `%g` 先按有效数字位数舍入，再根据舍入后的指数选择定点或指数形式。
+             * 除非使用了 `#` 修饰，否则去掉小数部分末尾的 0。
+             */
+            if (0 == precision)
+                precision = 1;
+            if (0 != f)
+                nd = gen_digits(f, e, -1, precision, digits, &k, &carried);
+
+            int x = (0 == nd) ? 0 : k;
+            int exp_form = ! (x < precision && -4 <= x);
+
+            int frac = exp_form ? precision - 1 : precision - 1 - x;
+
+            /* glibc 按舍入前的指数计算小数位数，若进位使指数恰好增加到 `precision`，
+             * 则它改用指数形式，但仍保留按定点形式算出的 0 位小数，例如 `%#.2g` 输出 99.5 得到 `1.e+02`。
+             * 这里保持与 glibc 一致。
+             */
+            if (exp_form && carried && x == precision)
+                frac = 0;
+            if ( ! spec->alternative_form) {
+                int needed = exp_form ? nd - 1 : nd - 1 - x;
+                if (needed < 0)
+                    needed = 0;
+                if (needed < frac)
+                    frac = needed;
+            }
+            put_float_digits(buf, spec, sign, upper, exp_form, digits, nd, x, frac);
+            break;
+        }
+    }
+}
+
+/* 以最短的、能精确还原为原值的十进制形式输出一个 double，规则见 `k_printf_callback_double_shortest` */
+static void put_double_shortest(struct k_printf_buf *buf, const struct k_printf_spec *spec, double v) {
+
+    int negative;
+    uint64_t f;
+    int e;
+    int kind = decompose_double(v, &negative, &f, &e);
+
+    char sign = float_sign(spec, negative);
+
+    if (0 != kind) {
+        put_float_special(buf, spec, sign, 0, 2 == kind);
+        return;
+    }
+
+    char digits[DOUBLE_DIGITS_CAPACITY];
+    int  nd = 0;
+    int  k  = 0;
+    if (0 != f)
+        nd = gen_shortest_digits(f, e, digits, &k);
+
+    int exp_form = ! (-4 <= k && k < 17);
+
+    int frac = exp_form ? nd - 1 : nd - 1 - k;
+    if (frac < 0)
+        frac = 0;
+
+    put_float_digits(buf, spec, sign, 0, exp_form, digits, nd, k, frac);
+}
+
+/* 处理 C `printf` 中的浮点数格式说明符 `%f` `%F` `%e` `%E` `%g` `%G`，以及带 `l` 修饰的版本
+ *
+ * 浮点数在本地直接格式化，不再交由 C `printf` 处理。
+ * 函数假定传入的格式说明符类型是正确的。
+ */
+static void printf_callback_c_std_spec_double(struct k_printf_buf *buf, const struct k_printf_spec *spec, va_list *args) {
+
+    struct k_printf_spec spec_ = *spec;
+    resolve_spec_args(&spec_, args);
+
+    put_double(buf, &spec_, spec->end[-1], va_arg(*args, double));
+}
+
+#endif
+
+void k_printf_callback_double_shortest(struct k_printf_buf *buf, const struct k_printf_spec *spec, va_list *args) {
+
+    struct k_printf_spec spec_ = *spec;
+    resolve_spec_args(&spec_, args);
+
+    double v = va_arg(*args, double);
+
+#if defined(K_PRINTF_NATIVE_DOUBLE)
+    put_double_shortest(buf, &spec_, v);
+#else
+    buf->fn_printf(buf, "%*.17g", spec_.left_justified ? -spec_.min_width : spec_.min_width, v);
+#endif
+}
+
+/* 实参在不定长参数列表中的类型，决定如何从不定长参数列表中读取它 */
+enum arg_kind {
+    ARG_KIND_NONE = 0,
+    ARG_KIND_INT,
+    ARG_KIND_LONG,
+    ARG_KIND_LLONG,
+    ARG_KIND_INTMAX,
+    ARG_KIND_SIZE,
+    ARG_KIND_PTRDIFF,
+    ARG_KIND_DOUBLE,
+    ARG_KIND_LDOUBLE,
+    ARG_KIND_STR,
+    ARG_KIND_PTR,
+    ARG_KIND_CUSTOM,
+};
+
+/* 按 C `printf` 格式说明符的长度修饰与转换类型，得到其实参类型 */
+static enum arg_kind c_std_arg_kind(const struct k_printf_spec *spec) {
+
+    const char c1 = spec->type[0];
+    const char c2 = spec->type[1];
+
+    switch (spec->end[-1]) {
+        case 'd': case 'i': case 'o': case 'u':
+        case 'x': case 'X':
+            if (c1 == 'l')
+                return (c2 == 'l') ? ARG_KIND_LLONG : ARG_KIND_LONG;
+            if (c1 == 'j') return ARG_KIND_INTMAX;
+            if (c1 == 'z') return ARG_KIND_SIZE;
+            if (c1 == 't') return ARG_KIND_PTRDIFF;
+            return ARG_KIND_INT;
+
+        case 'c':
+            return ARG_KIND_INT;
+
+        case 'e': case 'E': case 'f': case 'F':
+        case 'g': case 'G': case 'a': case 'A':
+            return (c1 == 'L') ? ARG_KIND_LDOUBLE : ARG_KIND_DOUBLE;
+
+        case 's':
+            return (c1 == 'l') ? ARG_KIND_PTR : ARG_KIND_STR;
+
+        default: /* %p 与 %n 一族 */
+            return ARG_KIND_PTR;
+    }
+}
+
+/* 从不定长参数列表中读取一个 C `printf` 格式说明符的实参，转换为 `k_printf_arg`，失败时返回 -1 */
+static int fetch_arg(enum arg_kind kind, va_list *args, struct k_printf_arg *arg) {
+
+    switch (kind) {
+        case ARG_KIND_INT:     arg->type = K_PRINTF_ARG_INT;  arg->value.i = va_arg(*args, int);       break;
+        case ARG_KIND_LONG:    arg->type = K_PRINTF_ARG_INT;  arg->value.i = va_arg(*args, long);      break;
+        case ARG_KIND_LLONG:   arg->type = K_PRINTF_ARG_INT;  arg->value.i = va_arg(*args, long long); break;
+        case ARG_KIND_INTMAX:  arg->type = K_PRINTF_ARG_INT;  arg->value.i = va_arg(*args, intmax_t);  break;
+        case ARG_KIND_PTRDIFF: arg->type = K_PRINTF_ARG_INT;  arg->value.i = va_arg(*args, ptrdiff_t); break;
+        case ARG_KIND_SIZE:    arg->type = K_PRINTF_ARG_UINT; arg->value.u = va_arg(*args, size_t);    break;
+
+        case ARG_KIND_DOUBLE:  arg->type = K_PRINTF_ARG_DOUBLE;      arg->value.d  = va_arg(*args, double);      break;
+        case ARG_KIND_LDOUBLE: arg->type = K_PRINTF_ARG_LONG_DOUBLE; arg->value.ld = va_arg(*args, long double); break;
+
+        case ARG_KIND_STR: arg->type = K_PRINTF_ARG_STR; arg->value.s = va_arg(*args, const char *); break;
+        case ARG_KIND_PTR: arg->type = K_PRINTF_ARG_PTR; arg->value.p = va_arg(*args, void *);       break;
+
+        default:
+            return -1;
+    }
+
+    return 0;
+}
+
+/* 按整数格式说明符的长度修饰转换实参，效果同经由 `va_arg` 读取，返回其绝对值，并通过 `get_negative` 返回其是否为负 */
+static uintmax_t convert_int_arg(const struct k_printf_spec *spec, const struct k_printf_arg *arg, int *get_negative) {
+
+    const char c1   = spec->type[0];
+    const char c2   = spec->type[1];
+    const char conv = spec->end[-1];
+
+    uintmax_t v;
+    int negative = 0;
+
+    if ('d' == conv || 'i' == conv) {
+        long long a = arg->value.i;
+        intmax_t i;
+        if (c1 == 'h')
+            i = (c2 == 'h') ? (signed char)a : (short)a;
+        else if (c1 == 'l')
+            i = (c2 == 'l') ? a : (long)a;
+        else if (c1 == 'j')
+            i = (intmax_t)a;
+        else if (c1 == 'z' || c1 == 't')
+            i = (ptrdiff_t)a;
+        else
+            i = (int)a;
+
+        negative = i < 0;
+        v = negative ? (uintmax_t)0 - (uintmax_t)i : (uintmax_t)i;
+    } else {
+        unsigned long long a = arg->value.u;
+        if (c1 == 'h')
+            v = (c2 == 'h') ? (unsigned char)a : (unsigned short)a;
+        else if (c1 == 'l')
+            v = (c2 == 'l') ? a : (unsigned long)a;
+        else if (c1 == 'j')
+            v = (uintmax_t)a;
+        else if (c1 == 'z' || c1 == 't')
+            v = (size_t)a;
+        else
+            v = (unsigned int)a;
+    }
+
+    *get_negative = negative;
+    return v;
+}
+
+/* 将格式说明符重新拼成 C `printf` 的格式字符串，最小宽度与精度以数字写出（尚未处理的 `*` 仍写作 `*`）
+ *
+ * 重复的标志与多余的前导 0 都不会保留，C `printf` 格式说明符的类型部分不超过 3 个字符，
+ * 因此 `fmt_buf` 至少需要 40 个字符。
+ */
+static void build_c_std_fmt(const struct k_printf_spec *spec, char *fmt_buf) {
+
+    char *p = fmt_buf;
+    *p++ = '%';
+    if (spec->left_justified)   *p++ = '-';
+    if (spec->sign_prepended)   *p++ = '+';
+    if (spec->space_padded)     *p++ = ' ';
+    if (spec->zero_padding)     *p++ = '0';
+    if (spec->alternative_form) *p++ = '#';
+
+    if (spec->use_min_width) {
+        if (-1 == spec->min_width) {
+            *p++ = '*';
+        } else {
+            int digit_num = count_decimal_digits((uintmax_t)spec->min_width);
+            write_int_digits(p, digit_num, 'd', (uintmax_t)spec->min_width);
+            p += digit_num;
+        }
+    }
+
+    if (spec->use_precision) {
+        *p++ = '.';
+        if (-1 == spec->precision) {
+            *p++ = '*';
+        } else {
+            int digit_num = count_decimal_digits((uintmax_t)spec->precision);
+            write_int_digits(p, digit_num, 'd', (uintmax_t)spec->precision);
+            p += digit_num;
+        }
+    }
+
+    size_t type_len = (size_t)(spec->end - spec->type);
+    memcpy(p, spec->type, type_len);
+    p[type_len] = '\0';
+}
+
+/* 按已读取的实参输出一个 C `printf` 格式说明符（`%n` 一族除外），`spec` 中的 `*` 须已处理
+ *
+ * 整数、`%c`、`%s` 与（启用本地实现时的）浮点数在本地直接格式化，其余交回给 C `printf` 处理。
+ * 实参类型与格式说明符不符时返回 -1。
+ */
+static int put_c_std_arg(struct k_printf_buf *buf, const struct k_printf_spec *spec, const struct k_printf_arg *arg) {
+
+    const char c1   = spec->type[0];
+    const char conv = spec->end[-1];
+
+    char fmt_buf[40];
+
+    switch (conv) {
+        case 'd': case 'i': case 'o': case 'u':
+        case 'x': case 'X': {
+            if (K_PRINTF_ARG_INT != arg->type && K_PRINTF_ARG_UINT != arg->type)
+                return -1;
+
+            int negative;
+            uintmax_t v = convert_int_arg(spec, arg, &negative);
+            put_int(buf, spec, conv, v, negative);
+            return 0;
+        }
+
+        case 'e': case 'E': case 'f': case 'F':
+        case 'g': case 'G': case 'a': case 'A':
+            if ('L' == c1) {
+                if (K_PRINTF_ARG_LONG_DOUBLE != arg->type)
+                    return -1;
+                build_c_std_fmt(spec, fmt_buf);
+                buf->fn_printf(buf, fmt_buf, arg->value.ld);
+                return 0;
+            }
+            if (K_PRINTF_ARG_DOUBLE != arg->type)
+                return -1;
+#if defined(K_PRINTF_NATIVE_DOUBLE)
+            if ('a' != conv && 'A' != conv) {
+                put_double(buf, spec, conv, arg->value.d);
+                return 0;
+            }
+#endif
+            build_c_std_fmt(spec, fmt_buf);
+            buf->fn_printf(buf, fmt_buf, arg->value.d);
+            return 0;
+
+        case 'c':
+            if (K_PRINTF_ARG_INT != arg->type && K_PRINTF_ARG_UINT != arg->type)
+                return -1;
+            if ('l' != c1) {
+                char ch = (char)(unsigned char)arg->value.i;
+                put_padded(buf, spec, &ch, 1, 0);
+                return 0;
+            }
+            build_c_std_fmt(spec, fmt_buf);
+            buf->fn_printf(buf, fmt_buf, (int)arg->value.i);
+            return 0;
+
+        case 's':
+            if ('l' == c1) {
+                if (K_PRINTF_ARG_PTR != arg->type)
+                    return -1;
+                build_c_std_fmt(spec, fmt_buf);
+                buf->fn_printf(buf, fmt_buf, arg->value.p);
+                return 0;
+            }
+            if (K_PRINTF_ARG_STR != arg->type)
+                return -1;
+            put_padded(buf, spec, (NULL != arg->value.s) ? arg->value.s : null_str,
+                       spec_str_len(spec, arg->value.s), 1);
+            return 0;
+
+        case 'p':
+            if (K_PRINTF_ARG_PTR != arg->type)
+                return -1;
+            build_c_std_fmt(spec, fmt_buf);
+            buf->fn_printf(buf, fmt_buf, arg->value.p);
+            return 0;
+    }
+
+    return -1;
+}
+
+/* 判断格式说明符是否由 `put_c_std_arg` 在本地格式化，而不是交回给 C `printf` */
+static int is_native_c_std_spec(const struct k_printf_spec *spec) {
+
+    switch (spec->end[-1]) {
+        case 'd': case 'i': case 'o': case 'u':
+        case 'x': case 'X':
+            return 1;
+
+        case 'c': case 's':
+            return 'l' != spec->type[0];
+
+#if defined(K_PRINTF_NATIVE_DOUBLE)
+        case 'e': case 'E': case 'f': case 'F':
+        case 'g': case 'G':
+            return 'L' != spec->type[0];
+#endif
+
+        default:
+            return 0;
+    }
+}
+
+/* 处理 C `printf` 中除了 `%n` 一族以外所有的格式说明符
+ *
+ * 能在本地格式化的格式说明符，每个实参（包括 `*` 指定的最小宽度与精度）只从不定长参数列表中读取一次，
+ * 读取为 `k_printf_arg` 后交给 `put_c_std_arg` 输出。
+ * 其余格式说明符（`%p` `%a` `%ls` `%lc` 以及 `L` 修饰的浮点数等）仍由 C `printf` 解析原格式说明符并读取实参，
+ * 之后再跳过这些实参：若改为读取实参后再拼出格式字符串交给 `fn_printf`，反而更慢。
+ * 函数假定传入的格式说明符类型是正确的。
+ */
+static void printf_callback_c_std_spec(struct k_printf_buf *buf, const struct k_printf_spec *spec, va_list *args) {
+
+    struct k_printf_arg arg;
+
+    if (is_native_c_std_spec(spec)) {
+        struct k_printf_spec spec_ = *spec;
+        resolve_spec_args(&spec_, args);
+
+        if (0 != fetch_arg(c_std_arg_kind(spec), args, &arg) || 0 != put_c_std_arg(buf, &spec_, &arg))
+            buf->n = -1;
+        return;
+    }
+
+    char fmt_buf[80];
+
+    /* 过长的格式说明符（多是重复的标志或多余的前导 0）重新拼成等价的短格式，不必另行分配内存 */
+    size_t len = (size_t)(spec->end - spec->start);
+    if (len < sizeof(fmt_buf)) {
+        memcpy(fmt_buf, spec->start, len);
+        fmt_buf[len] = '\0';
+    } else {
+        build_c_std_fmt(spec, fmt_buf);
+    }
+
+    va_list args_copy;
+    va_copy(args_copy, *args);
+    buf->fn_vprintf(buf, fmt_buf, args_copy);
+    va_end(args_copy);
+
+    if (spec->use_min_width && -1 == spec->min_width)
+        va_arg(*args, int);
+    if (spec->use_precision && -1 == spec->precision)
+        va_arg(*args, int);
+
+    fetch_arg(c_std_arg_kind(spec), args, &arg);
+}
+
+/* `%s` 的回调
+ *
+ * 实参字符串以 `fn_puts_ref` 引用，不拷贝其内容；指定了最小宽度时由 `put_padded` 补齐。
+ */
+static void printf_callback_c_std_spec_s(struct k_printf_buf *buf, const struct k_printf_spec *spec, va_list *args) {
+
+    if ( ! spec->use_min_width && ! spec->use_precision) {
+        const char *str = va_arg(*args, const char *);
+        if (NULL != str) {
+            buf->fn_puts_ref(buf, str, strlen(str));
+            return;
+        }
+
+        struct k_printf_arg arg;
+        arg.type    = K_PRINTF_ARG_STR;
+        arg.value.s = str;
+        put_c_std_arg(buf, spec, &arg);
+        return;
+    }
+
+    struct k_printf_spec spec_ = *spec;
+    resolve_spec_args(&spec_, args);
+
+    struct k_printf_arg arg;
+    arg.type    = K_PRINTF_ARG_STR;
+    arg.value.s = va_arg(*args, const char *);
+    put_c_std_arg(buf, &spec_, &arg);
+}
+
+/* 计算 `%s` 的输出长度，不产生字符 */
+static int measure_c_std_spec_s(const struct k_printf_spec *spec, va_list *args) {
+
+    struct k_printf_spec spec_ = *spec;
+    resolve_spec_args(&spec_, args);
+
+    const char *str = va_arg(*args, const char *);
+
+    size_t len = spec_str_len(&spec_, str);
+
+    if (spec_.use_min_width && len < (size_t)spec_.min_width)
+        len = (size_t)spec_.min_width;
+
+    return (len <= INT_MAX) ? (int)len : -1;
+}
+
+/* 返回 C `printf` 格式说明符的回调对应的长度计算函数，若没有则返回 NULL */
+static k_printf_measure_fn match_c_std_measure(k_printf_callback_fn fn_callback) {
+
+    if (printf_callback_c_std_spec_int == fn_callback)
+        return measure_c_std_spec_int;
+    if (printf_callback_c_std_spec_s == fn_callback)
+        return measure_c_std_spec_s;
+
+    return NULL;
+}
+
+/* 匹配 C `printf` 格式说明符，若匹配成功则移动字符串指针，并返回对应的回调
+ *
+ * C `printf` 支持的格式说明符详见：https://zh.cppreference.com/w/c/io/fprintf
+ */
+static k_printf_callback_fn match_c_std_spec(const char **str) {
+
+    /* 通过打表的方式，给每个 C `printf` 格式说明符分配回调 */
+
+    switch ((*str)[0]) {
+        case 'd': case 'i': case 'o': case 'u':
+        case 'x': case 'X':
+            *str += 1;
+            return printf_callback_c_std_spec_int;
+
+#if defined(K_PRINTF_NATIVE_DOUBLE)
+        case 'e': case 'E': case 'f': case 'F':
+        case 'g': case 'G':
+            *str += 1;
+            return printf_callback_c_std_spec_double;
+
+        case 'a': case 'A': case 'c':
+        case 'p':
+            *str += 1;
+            return printf_callback_c_std_spec;
+#else
+        case 'a': case 'A': case 'c':
+        case 'e': case 'E': case 'f': case 'F':
+        case 'g': case 'G': case 'p':
+            *str += 1;
+            return printf_callback_c_std_spec;
+#endif
+
+        case 's':
+            *str += 1;
+            return printf_callback_c_std_spec_s;
+
+        case 'n':
+            *str += 1;
+            return printf_callback_c_std_spec_n;
+
+        case 'h': {
+            switch ((*str)[1]) {
                 case 'd': case 'i':
-                    va_arg(*args, long);
-                    break;
-                case 'o': case 'u': case 'x': case 'X':
-                    va_arg(*args, unsigned long);
+                case 'o': case 'u':
+                case 'x': case 'X':
+                    *str += 2;
+                    return printf_callback_c_std_spec_int;
+                case 'n':
+                    *str += 2;
+                    return printf_callback_c_std_spec_n;
+                case 'h':
+                    switch ((*str)[2]) {
+                        case 'd': case 'i':
+                        case 'o': case 'u':
+                        case 'x': case 'X':
+                            *str += 3;
+                            return printf_callback_c_std_spec_int;
+                        case 'n':
+                            *str += 3;
+                            return printf_callback_c_std_spec_n;
+                    }
                     break;
+            }
+            break;
+        }
+
+        case 'l': {
+            switch ((*str)[1]) {
+                case 'd': case 'i': case 'o': case 'u':
+                case 'x': case 'X':
+                    *str += 2;
+                    return printf_callback_c_std_spec_int;
+#if defined(K_PRINTF_NATIVE_DOUBLE)
+                case 'e': case 'E': case 'f': case 'F':
+                case 'g': case 'G':
+                    *str += 2;
+                    return printf_callback_c_std_spec_double;
+                case 'a': case 'A': case 'c':
                 case 's':
-                    va_arg(*args, wchar_t *);
-                    break;
+                    *str += 2;
+                    return printf_callback_c_std_spec;
+#else
+                case 'a': case 'A': case 'c':
+                case 'e': case 'E': case 'f': case 'F':
+                case 'g': case 'G': case 's':
+                    *str += 2;
+                    return printf_callback_c_std_spec;
+#endif
+                case 'n':
+                    *str += 2;
+                    return printf_callback_c_std_spec_n;
                 case 'l':
-                    switch (spec->type[2]) {
+                    switch ((*str)[2]) {
                         case 'd': case 'i':
-                            va_arg(*args, long long);
-                            break;
                         case 'o': case 'u':
                         case 'x': case 'X':
-                            va_arg(*args, unsigned long long);
-                            break;
+                            *str += 3;
+                            return printf_callback_c_std_spec_int;
+                        case 'n':
+                            *str += 3;
+                            return printf_callback_c_std_spec_n;
                     }
                     break;
             }
             break;
-        case 'L': va_arg(*args, long double); break;
-        case 'p': va_arg(*args, void *);      break;
-        case 's': va_arg(*args, char *);      break;
-        case 't': va_arg(*args, ptrdiff_t);   break;
-        case 'z': va_arg(*args, size_t);      break;
+        }
+        case 'L':
+            switch ((*str)[1]) {
+                case 'a': case 'A': case 'e': case 'E':
+                case 'f': case 'F': case 'g': case 'G':
+                    *str += 2;
+                    return printf_callback_c_std_spec;
+            }
+            break;
+
+        case 'j': case 't': case 'z':
+            switch ((*str)[1]) {
+                case 'd': case 'i':
+                case 'o': case 'u':
+                case 'x': case 'X':
+                    *str += 2;
+                    return printf_callback_c_std_spec_int;
+                case 'n':
+                    *str += 2;
+                    return printf_callback_c_std_spec_n;
+            }
+            break;
+    }
+
+    return NULL;
+}
+
+/* endregion */
+
+/* region [c_std_spec_argv] */
+
+/* 从实参数组中读取 `*` 指定的最小宽度与精度，将其写回 `spec`，实参不足或类型不符时返回 -1 */
+static int resolve_spec_argv(struct k_printf_spec *spec, struct k_printf_args *args) {
+
+    if (spec->use_min_width && -1 == spec->min_width) {
+        const struct k_printf_arg *arg = k_printf_args_next(args);
+        if (NULL == arg || (K_PRINTF_ARG_INT != arg->type && K_PRINTF_ARG_UINT != arg->type))
+            return -1;
+        set_spec_width(spec, (int)arg->value.i);
+    }
+
+    if (spec->use_precision && -1 == spec->precision) {
+        const struct k_printf_arg *arg = k_printf_args_next(args);
+        if (NULL == arg || (K_PRINTF_ARG_INT != arg->type && K_PRINTF_ARG_UINT != arg->type))
+            return -1;
+        set_spec_precision(spec, (int)arg->value.i);
+    }
+
+    return 0;
+}
+
+/* 处理 C `printf` 的所有格式说明符，实参取自实参数组
+ *
+ * 实参的类型须与格式说明符相符：整数格式说明符接受 `K_PRINTF_ARG_INT` 或 `K_PRINTF_ARG_UINT`，
+ * 浮点数格式说明符接受 `K_PRINTF_ARG_DOUBLE`（`L` 修饰时为 `K_PRINTF_ARG_LONG_DOUBLE`），
+ * `%c` 接受整数，`%s` 接受 `K_PRINTF_ARG_STR`，`%p` `%ls` 与 `%n` 一族接受 `K_PRINTF_ARG_PTR`。
+ * 实参不足或类型不符时视为出错。
+ */
+static void printf_argv_c_std_spec(struct k_printf_buf *buf, const struct k_printf_spec *spec, struct k_printf_args *args) {
+
+    struct k_printf_spec spec_ = *spec;
+    if (0 != resolve_spec_argv(&spec_, args))
+        goto fail;
+
+    const struct k_printf_arg *arg = k_printf_args_next(args);
+    if (NULL == arg)
+        goto fail;
+
+    const char c1 = spec->type[0];
+
+    switch (spec->end[-1]) {
+        case 'n': {
+            if (K_PRINTF_ARG_PTR != arg->type || NULL == arg->value.p)
+                goto fail;
+
+            const char c2 = spec->type[1];
+            int n = buf->n;
+            void *p = arg->value.p;
+            if (c1=='n') {
+                *(int *)p = (int)n;
+            } else if (c1=='j') {
+                *(intmax_t *)p = (intmax_t)n;
+            } else if (c1=='t') {
+                *(ptrdiff_t *)p = (ptrdiff_t)n;
+            } else if (c1=='z') {
+                *(size_t *)p = (size_t)n;
+            } else if (c1=='l') {
+                if (c2=='l') {
+                    *(long long *)p = (long long)n;
+                } else {
+                    *(long *)p = (long)n;
+                }
+            } else {
+                if (c2 == 'h') {
+                    *(unsigned char *)p = (unsigned char)n;
+                } else {
+                    *(short *)p = (short)n;
+                }
+            }
+            return;
+        }
+
+        default:
+            if (0 == put_c_std_arg(buf, &spec_, arg))
+                return;
+            break;
+    }
+
+fail:
+    buf->n = -1;
+}
+
+void k_printf_callback_argv_double_shortest(struct k_printf_buf *buf, const struct k_printf_spec *spec, struct k_printf_args *args) {
+
+    struct k_printf_spec spec_ = *spec;
+    if (0 != resolve_spec_argv(&spec_, args)) {
+        buf->n = -1;
+        return;
+    }
+
+    const struct k_printf_arg *arg = k_printf_args_next(args);
+    if (NULL == arg || K_PRINTF_ARG_DOUBLE != arg->type) {
+        buf->n = -1;
+        return;
+    }
+
+#if defined(K_PRINTF_NATIVE_DOUBLE)
+    put_double_shortest(buf, &spec_, arg->value.d);
+#else
+    buf->fn_printf(buf, "%*.17g", spec_.left_justified ? -spec_.min_width : spec_.min_width, arg->value.d);
+#endif
+}
+
+/* endregion */
+
+/* region [user_spec] */
+
+const struct k_printf_spec_callback_tuple *k_printf_match_tuple_helper(const struct k_printf_spec_callback_tuple *tuples, const char **str) {
+
+    const struct k_printf_spec_callback_tuple *spec = tuples;
+    for (; NULL != spec->spec_type; ++spec) {
+
+        const char *p_str  = *str;
+        const char *p_spec = spec->spec_type;
+        for (; '\0' != *p_spec; ++p_str, ++p_spec) {
+            if (*p_str != *p_spec)
+                goto next_spec;
+        }
+
+        *str += p_spec - spec->spec_type;
+        return spec;
+
+    next_spec:;
+    }
+
+    return NULL;
+}
+
+k_printf_callback_fn k_printf_match_spec_helper(const struct k_printf_spec_callback_tuple *tuples, const char **str) {
+    const struct k_printf_spec_callback_tuple *tuple = k_printf_match_tuple_helper(tuples, str);
+    return (NULL != tuple) ? tuple->fn_callback : NULL;
+}
+
+/* 字典树的节点
+ *
+ * 每个节点的所有子节点在节点数组中连续存放，并按边上的字符升序排列。
+ */
+struct trie_node {
+
+    /* 以该节点结尾的格式说明符，若没有则为 NULL */
+    const struct k_printf_spec_callback_tuple *tuple;
+
+    /* 第一个子节点的下标，以及子节点的数量 */
+    uint32_t first_child;
+    uint32_t child_num;
+
+    /* 从父节点到该节点的边上的字符 */
+    unsigned char ch;
+};
+
+struct k_printf_spec_trie {
+
+    /* 根节点的跳转表，下标为类型名的首个字符，值为对应子节点的下标，0 表示没有该子节点 */
+    uint32_t root_table[256];
+
+    /* 节点数组，0 号节点为根节点 */
+    struct trie_node nodes[];
+};
+
+static int compare_tuples(const void *a, const void *b) {
+
+    const struct k_printf_spec_callback_tuple *t1 = *(const struct k_printf_spec_callback_tuple * const *)a;
+    const struct k_printf_spec_callback_tuple *t2 = *(const struct k_printf_spec_callback_tuple * const *)b;
+
+    int r = strcmp(t1->spec_type, t2->spec_type);
+    if (0 != r)
+        return r;
+
+    /* 类型名相同时，保持数组中的原有顺序，使排在前面的配置项生效 */
+    return (t1 > t2) - (t1 < t2);
+}
+
+struct k_printf_spec_trie *k_printf_spec_trie_create(const struct k_printf_spec_callback_tuple *tuples) {
+    assert(NULL != tuples);
+
+    size_t tuple_num = 0;
+    size_t node_num  = 1;
+
+    const struct k_printf_spec_callback_tuple *tuple = tuples;
+    for (; NULL != tuple->spec_type; ++tuple) {
+        tuple_num++;
+        node_num += strlen(tuple->spec_type);
+    }
+
+    if (UINT32_MAX < node_num)
+        return NULL;
+
+    struct k_printf_spec_trie *trie = malloc(sizeof(struct k_printf_spec_trie) + sizeof(struct trie_node) * node_num);
+    if (NULL == trie)
+        return NULL;
+
+    const struct k_printf_spec_callback_tuple **sorted = malloc(sizeof(*sorted) * (tuple_num + 1));
+    if (NULL == sorted) {
+        free(trie);
+        return NULL;
+    }
+
+    size_t i;
+    for (i = 0; i < tuple_num; ++i)
+        sorted[i] = &tuples[i];
+
+    qsort(sorted, tuple_num, sizeof(*sorted), compare_tuples);
+
+    /* 按层次遍历建树，使每个节点的子节点连续存放。
+     *
+     * 排序后，共享同一前缀的配置项在 `sorted` 中是连续的一段。
+     * 每个已创建但未展开的节点，对应 `sorted` 中的一段，以及该节点的深度 `depth`。
+     * 展开节点时，按第 `depth` 个字符将这一段划分为若干小段，每一小段对应一个子节点。
+     * 展开前，节点的 `child_num` 暂存着这一段的长度。
+     */
+    struct trie_node *nodes = trie->nodes;
+    memset(trie->root_table, 0, sizeof(trie->root_table));
+
+    nodes[0].tuple       = NULL;
+    nodes[0].first_child = 0;
+    nodes[0].child_num   = (uint32_t)tuple_num;
+    nodes[0].ch          = '\0';
+
+    /* 另用两个数组记录每个节点的深度，以及节点对应的一段的起点 */
+    size_t *depth_of = malloc(sizeof(size_t) * node_num * 2);
+    if (NULL == depth_of) {
+        free(sorted);
+        free(trie);
+        return NULL;
+    }
+    size_t *lo_of = depth_of + node_num;
+    depth_of[0] = 0;
+    lo_of[0]    = 0;
+
+    size_t created = 1;
+    size_t idx;
+    for (idx = 0; idx < created; ++idx) {
+
+        size_t depth = depth_of[idx];
+        size_t lo    = lo_of[idx];
+        size_t hi    = lo + nodes[idx].child_num;
+
+        /* 长度恰为 `depth` 的类型名在该节点结束，排序后它们排在这一段的最前面 */
+        nodes[idx].tuple = NULL;
+        if (0 != depth) {
+            if (lo < hi && '\0' == sorted[lo]->spec_type[depth])
+                nodes[idx].tuple = sorted[lo];
+        }
+        while (lo < hi && '\0' == sorted[lo]->spec_type[depth])
+            lo++;
+
+        nodes[idx].first_child = (uint32_t)created;
+        nodes[idx].child_num   = 0;
+
+        while (lo < hi) {
+            unsigned char ch = (unsigned char)sorted[lo]->spec_type[depth];
+
+            size_t end = lo + 1;
+            while (end < hi && (unsigned char)sorted[end]->spec_type[depth] == ch)
+                end++;
+
+            struct trie_node *child = &nodes[created];
+            child->tuple       = NULL;
+            child->first_child = 0;
+            child->child_num   = (uint32_t)(end - lo);
+            child->ch          = ch;
+            depth_of[created]  = depth + 1;
+            lo_of[created]     = lo;
+
+            if (0 == idx)
+                trie->root_table[ch] = (uint32_t)created;
+
+            created++;
+            nodes[idx].child_num++;
+            lo = end;
+        }
+    }
+
+    free(depth_of);
+    free(sorted);
+    return trie;
+}
+
+void k_printf_spec_trie_destroy(struct k_printf_spec_trie *trie) {
+    free(trie);
+}
+
+const struct k_printf_spec_callback_tuple *k_printf_match_tuple_trie(const struct k_printf_spec_trie *trie, const char **str) {
+
+    const char *s = *str;
+
+    uint32_t idx = trie->root_table[(unsigned char)*s];
+    if (0 == idx)
+        return NULL;
+
+    const struct k_printf_spec_callback_tuple *matched = NULL;
+    const char *matched_end = NULL;
+
+    for (;;) {
+        const struct trie_node *node = &trie->nodes[idx];
+        ++s;
+
+        if (NULL != node->tuple) {
+            matched     = node->tuple;
+            matched_end = s;
+        }
+
+        const struct trie_node *child = &trie->nodes[node->first_child];
+        const struct trie_node *end   = child + node->child_num;
+        for (; child < end; ++child) {
+            if (child->ch >= (unsigned char)*s)
+                break;
+        }
+
+        if (child == end || child->ch != (unsigned char)*s)
+            break;
+
+        idx = (uint32_t)(child - trie->nodes);
+    }
+
+    if (NULL == matched)
+        return NULL;
+
+    *str = matched_end;
+    return matched;
+}
+
+k_printf_callback_fn k_printf_match_spec_trie(const struct k_printf_spec_trie *trie, const char **str) {
+    const struct k_printf_spec_callback_tuple *tuple = k_printf_match_tuple_trie(trie, str);
+    return (NULL != tuple) ? tuple->fn_callback : NULL;
+}
+
+/* endregion */
+
+/* region [scan_literal] */
+
+#if defined(K_PRINTF_SIMD_X86)
+
+/* 以下函数使用对齐的向量读取，可能读到字符串结尾之后、但与结尾位于同一对齐块内的字节。
+ * 对齐的读取不会跨越内存页，所以这是安全的，但需要告知 AddressSanitizer 与 ThreadSanitizer 不要检查这些读取，
+ * 这些字节可能属于已释放或正被其他线程写入的内存。
+ */
+#if defined(__clang__) || defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address, no_sanitize_thread))
+#else
+#define NO_SANITIZE_ADDRESS
+#endif
+
+NO_SANITIZE_ADDRESS
+static const char *scan_literal_sse2(const char *p) {
+
+    const __m128i pct  = _mm_set1_epi8('%');
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t misalign = (uintptr_t)p & 15;
+    const __m128i *v = (const __m128i *)(p - misalign);
+
+    __m128i x = _mm_load_si128(v);
+    unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, pct), _mm_cmpeq_epi8(x, zero)));
+    mask &= ~0u << misalign;
+
+    while (0 == mask) {
+        x = _mm_load_si128(++v);
+        mask = (unsigned int)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, pct), _mm_cmpeq_epi8(x, zero)));
+    }
+
+    return (const char *)v + __builtin_ctz(mask);
+}
+
+NO_SANITIZE_ADDRESS __attribute__((target("avx2")))
+static const char *scan_literal_avx2(const char *p) {
+
+    const __m256i pct  = _mm256_set1_epi8('%');
+    const __m256i zero = _mm256_setzero_si256();
+
+    size_t misalign = (uintptr_t)p & 31;
+    const __m256i *v = (const __m256i *)(p - misalign);
+
+    __m256i x = _mm256_load_si256(v);
+    unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(x, pct), _mm256_cmpeq_epi8(x, zero)));
+    mask &= ~0u << misalign;
+
+    while (0 == mask) {
+        x = _mm256_load_si256(++v);
+        mask = (unsigned int)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(x, pct), _mm256_cmpeq_epi8(x, zero)));
+    }
+
+    return (const char *)v + __builtin_ctz(mask);
+}
+
+#endif
+
+/* 返回字符串中第一个 `%` 或 `\0` 的位置
+ *
+ * 格式字符串大多是较长的字面量文本中夹杂着少量格式说明符。
+ * 在 x86 上，函数在运行时根据 CPU 是否支持 AVX2，选择每次比较 32 或 16 个字节，否则逐字节扫描。
+ */
+static const char *scan_literal(const char *p) {
+
+    if ('%' == *p || '\0' == *p)
+        return p;
+
+#if defined(K_PRINTF_SIMD_X86)
+    if (__builtin_cpu_supports("avx2"))
+        return scan_literal_avx2(p);
+    else
+        return scan_literal_sse2(p);
+#else
+    while ('\0' != *p && '%' != *p)
+        ++p;
+    return p;
+#endif
+}
+
+/* endregion */
+
+/* region [format] */
+
+/* 提取字符串开头的非负 int 值（若超过上限则返回 INT_MAX），并移动字符串指针跳过数字
+ *
+ * 函数假定字符串开头存在非负的数字。
+ */
+static int extract_non_negative_int(const char **str) {
+
+    unsigned long long num = 0;
+
+    const char *ch = *str;
+    for (; '0' <= *ch && *ch <= '9'; ch++) {
+        num = num * 10 + (*ch - '0');
+
+        if (INT_MAX <= num) {
+            while ('0' <= *ch && *ch <= '9')
+                ch++;
+
+            num = INT_MAX;
+            break;
+        }
+    }
+
+    *str = ch;
+    return (int)num;
+}
+
+/* 格式说明符除回调以外的可选处理函数，均可为 NULL */
+struct spec_hooks {
+    k_printf_measure_fn fn_measure;
+    k_printf_callback_argv_fn fn_callback_argv;
+    k_printf_capture_fn fn_capture;
+    int auto_pad;
+};
+
+/* 格式说明符中 POSIX 位置参数的序号（从 1 开始），0 表示未使用位置参数
+ *
+ * `arg` 对应 `%n$`，`min_width` 与 `precision` 分别对应 `*m$` 与 `.*m$`。
+ */
+struct spec_pos {
+    int arg;
+    int min_width;
+    int precision;
+};
+
+/* 若字符串开头是 `n$` 形式的位置参数序号，则移动字符串指针跳过它，并返回序号，否则返回 0 */
+static int extract_pos(const char **str) {
+
+    const char *ch = *str;
+    if ( ! ('1' <= *ch && *ch <= '9'))
+        return 0;
+
+    int pos = extract_non_negative_int(&ch);
+    if ('$' != *ch)
+        return 0;
+
+    *str = ch + 1;
+    return pos;
+}
+
+/* 提取格式说明符，若提取成功则移动字符串指针，并返回对应的回调，
+ * 其余处理函数通过 `get_hooks` 返回，位置参数序号通过 `get_pos` 返回
+ *
+ * 函数假定字符串的起始为 `%` 符号。
+ */
+static k_printf_callback_fn extract_spec(const struct k_printf_config *config, const char **str,
+                                         struct k_printf_spec *get_spec, struct spec_hooks *get_hooks,
+                                         struct spec_pos *get_pos) {
+
+    const char *ch = *str + 1;
+
+    struct k_printf_spec spec;
+    spec.start = *str;
+
+    struct spec_pos pos;
+    pos.arg       = extract_pos(&ch);
+    pos.min_width = 0;
+    pos.precision = 0;
+
+    spec.left_justified   = 0;
+    spec.sign_prepended   = 0;
+    spec.space_padded     = 0;
+    spec.zero_padding     = 0;
+    spec.alternative_form = 0;
+    for (;;) {
+        switch (*ch) {
+            case '-': ch++; spec.left_justified   = 1; continue;
+            case '+': ch++; spec.sign_prepended   = 1; continue;
+            case ' ': ch++; spec.space_padded     = 1; continue;
+            case '0': ch++; spec.zero_padding     = 1; continue;
+            case '#': ch++; spec.alternative_form = 1; continue;
+        }
+        break;
+    }
+
+    if ('1' <= *ch && *ch <= '9') {
+        spec.use_min_width = 1;
+        spec.min_width     = extract_non_negative_int(&ch);
+    } else if ('*' == *ch) {
+        ch++;
+        spec.use_min_width = 1;
+        spec.min_width     = -1;
+        pos.min_width      = extract_pos(&ch);
+    } else {
+        spec.use_min_width = 0;
+        spec.min_width     = -1;
+    }
+
+    if ('.' == *ch) {
+        ch++;
+        if ('0' <= *ch && *ch <= '9') {
+            spec.use_precision = 1;
+            spec.precision     = extract_non_negative_int(&ch);
+        } else if ('*' == *ch) {
+            ch++;
+            spec.use_precision = 1;
+            spec.precision     = -1;
+            pos.precision      = extract_pos(&ch);
+        } else {
+            spec.use_precision = 1;
+            spec.precision     = 0;
+        }
+    } else {
+        spec.use_precision = 0;
+        spec.precision     = -1;
+    }
+
+    spec.type = ch;
+
+    k_printf_callback_fn fn_callback = NULL;
+    struct spec_hooks hooks = { NULL, NULL, NULL, 0 };
+    if (NULL != config && NULL != config->fn_match_tuple) {
+        const struct k_printf_spec_callback_tuple *tuple = config->fn_match_tuple(&ch);
+        if (NULL != tuple) {
+            fn_callback            = tuple->fn_callback;
+            hooks.fn_measure       = tuple->fn_measure;
+            hooks.fn_callback_argv = tuple->fn_callback_argv;
+            hooks.fn_capture       = tuple->fn_capture;
+            hooks.auto_pad         = tuple->auto_pad;
+        }
+    } else if (NULL != config && NULL != config->fn_match_spec) {
+        fn_callback = config->fn_match_spec(&ch);
+    }
+    if (NULL == fn_callback) {
+        if (NULL == (fn_callback = match_c_std_spec(&ch)))
+            return NULL;
+        hooks.fn_measure       = match_c_std_measure(fn_callback);
+        hooks.fn_callback_argv = printf_argv_c_std_spec;
+    }
+
+    spec.end = ch;
+
+    *str = ch;
+    *get_spec = spec;
+    *get_hooks = hooks;
+    *get_pos = pos;
+    return fn_callback;
+}
+
+/* 由 `k_printf` 代为补齐最小宽度的格式说明符（见 `k_printf_spec_callback_tuple->auto_pad`）的输出状态
+ *
+ * 左对齐时，回调直接写入缓冲区，之后再补上空格。
+ * 右对齐时，`str_buf` 与 `mem_buf` 的内容是连续的，回调同样直接写入，之后补上空格，
+ * 再把回调的输出在原地右移，空出的开头填充空格；其余缓冲区写入后无法修改，回调先写入 `stage`。
+ */
+struct pad_frame {
+    struct k_printf_buf *buf;
+    struct k_printf_buf *out;   /* 回调实际写入的缓冲区 */
+    size_t width;
+    unsigned int left_justified : 1;
+    unsigned int trunc_mode     : 1;
+    int n;                      /* 回调执行前 `buf` 的 `n` */
+    size_t start;               /* 回调执行前连续缓冲区的内容长度 */
+    struct mem_buf stage;
+    char stage_block[256];
+};
+
+/* 返回缓冲区分配临时内存时使用的配置 */
+static const struct k_printf_config *buf_config(const struct k_printf_buf *buf) {
+
+    if (sink_buf_puts == buf->fn_puts)
+        return ((const struct sink_buf *)buf)->scratch.config;
+#if defined(K_PRINTF_POSIX)
+    if (fd_buf_puts == buf->fn_puts)
+        return ((const struct fd_buf *)buf)->config;
+#endif
+
+    return NULL;
+}
+
+/* 开始输出需要补齐的格式说明符，返回回调应写入的缓冲区
+ *
+ * `spec` 的最小宽度须已确定，函数记下它后清除 `spec` 的 `use_min_width`，回调因而不会再补齐。
+ */
+static struct k_printf_buf *pad_begin(struct pad_frame *frame, struct k_printf_buf *buf, struct k_printf_spec *spec) {
+
+    frame->buf            = buf;
+    frame->out            = buf;
+    frame->width          = (size_t)spec->min_width;
+    frame->left_justified = spec->left_justified;
+    frame->trunc_mode     = 0;
+    frame->n              = buf->n;
+
+    spec->use_min_width = 0;
+    spec->min_width     = -1;
+
+    if (str_buf_puts == buf->fn_puts) {
+        /* 截断模式下回调的输出可能写不下，此时仍需要知道其完整长度才能算出补齐的空格数，故暂时关闭截断模式 */
+        struct str_buf *str_buf = (struct str_buf *)buf;
+        frame->start         = (size_t)str_buf->str_len;
+        frame->trunc_mode    = str_buf->trunc_mode;
+        str_buf->trunc_mode  = 0;
+        return buf;
+    }
+
+    if (mem_buf_puts == buf->fn_puts) {
+        frame->start = ((struct mem_buf *)buf)->str_len;
+        return buf;
+    }
+
+    /* `sink_buf` 的 `n` 可能停留在 INT_MAX，无法据此算出回调的输出长度，故左对齐时也要先写入 `stage` */
+    if (is_count_buf(buf) || (frame->left_justified && sink_buf_puts != buf->fn_puts))
+        return buf;
+
+    init_mem_buf(&frame->stage, buf_config(buf), frame->stage_block, sizeof(frame->stage_block));
+    frame->out = &frame->stage.impl;
+    return frame->out;
+}
+
+/* 把区域 `[base, base + len)` 的内容右移 `pad_num` 个字符，空出的开头填充空格，移出区域的部分被丢弃 */
+static void shift_pad(char *base, size_t len, size_t pad_num) {
+
+    if (pad_num < len) {
+        memmove(base + pad_num, base, len - pad_num);
+        memset(base, ' ', pad_num);
+    } else {
+        memset(base, ' ', len);
+    }
+}
+
+/* 结束输出需要补齐的格式说明符，补齐回调的输出 */
+static void pad_end(struct pad_frame *frame) {
+
+    struct k_printf_buf *buf = frame->buf;
+
+    if (frame->out != buf) {
+        struct mem_buf *stage = &frame->stage;
+        if (-1 == stage->impl.n) {
+            buf->n = -1;
+        } else {
+            size_t pad_num = (stage->str_len < frame->width) ? frame->width - stage->str_len : 0;
+            if ( ! frame->left_justified)
+                buf_fill(buf, ' ', pad_num);
+            buf->fn_puts(buf, stage->buffer, stage->str_len);
+            if (frame->left_justified)
+                buf_fill(buf, ' ', pad_num);
+        }
+        free_mem_buf(stage);
+        return;
+    }
+
+    struct str_buf *str_buf = (str_buf_puts == buf->fn_puts) ? (struct str_buf *)buf : NULL;
+
+    size_t len = (size_t)(buf->n - frame->n);
+    if (-1 != buf->n && len < frame->width) {
+        size_t pad_num = frame->width - len;
+        buf_fill(buf, ' ', pad_num);
+
+        if ( ! frame->left_justified && -1 != buf->n) {
+            if (NULL != str_buf) {
+                shift_pad(&str_buf->buffer[frame->start], (size_t)str_buf->str_len - frame->start, pad_num);
+            } else if (mem_buf_puts == buf->fn_puts) {
+                struct mem_buf *mem_buf = (struct mem_buf *)buf;
+                shift_pad(&mem_buf->buffer[frame->start], mem_buf->str_len - frame->start, pad_num);
+            }
+        }
+    }
+
+    if (NULL != str_buf) {
+        /* 恢复截断模式，补齐后的输出写不下时才视为缓冲区已满 */
+        str_buf->trunc_mode = frame->trunc_mode;
+        if (str_buf->trunc_mode && -1 != buf->n
+            && (size_t)str_buf->str_len - frame->start < (size_t)(buf->n - frame->n)) {
+            str_buf->truncated = 1;
+            buf->n = -1;
+        }
+    }
+}
+
+/* 执行格式说明符的回调，不考虑代为补齐
+ *
+ * 若缓冲区只是计数，且格式说明符提供了长度计算函数，则直接累加其计算出的长度，不再执行回调。
+ */
+static void run_spec_callback(struct k_printf_buf *buf, k_printf_callback_fn fn_callback, const struct spec_hooks *hooks,
+                              const struct k_printf_spec *spec, va_list *args) {
+
+    if (NULL != hooks->fn_measure && is_count_buf(buf)) {
+        int len = hooks->fn_measure(spec, args);
+        if (len < 0)
+            buf->n = -1;
+        else
+            count_buf_puts(buf, NULL, (size_t)len);
+        return;
+    }
+
+    fn_callback(buf, spec, args);
+}
+
+/* 执行要求由 `k_printf` 代为补齐的格式说明符的回调：先读取 `*` 指定的最小宽度，再执行回调并补齐其输出
+ *
+ * 与 `invoke_spec` 分开，`pad_frame` 因而不会占用常见路径的栈空间，`invoke_spec` 也能保持内联。
+ */
+static void invoke_spec_padded(struct k_printf_buf *buf, k_printf_callback_fn fn_callback, const struct spec_hooks *hooks,
+                               const struct k_printf_spec *spec, va_list *args) {
+
+    struct k_printf_spec spec_ = *spec;
+    if (-1 == spec_.min_width)
+        set_spec_width(&spec_, va_arg(*args, int));
+
+    struct pad_frame frame;
+    struct k_printf_buf *out = pad_begin(&frame, buf, &spec_);
+    run_spec_callback(out, fn_callback, hooks, &spec_, args);
+    pad_end(&frame);
+}
+
+/* 执行格式说明符的回调，格式说明符要求由 `k_printf` 代为补齐时交给 `invoke_spec_padded` */
+static void invoke_spec(struct k_printf_buf *buf, k_printf_callback_fn fn_callback, const struct spec_hooks *hooks,
+                        const struct k_printf_spec *spec, va_list *args) {
+
+    if (hooks->auto_pad && spec->use_min_width)
+        invoke_spec_padded(buf, fn_callback, hooks, spec, args);
+    else
+        run_spec_callback(buf, fn_callback, hooks, spec, args);
+}
+
+/* 读取实参数组中序号为 `pos` 的整数实参，用作 `*m$` 指定的最小宽度或精度，失败时返回 -1 */
+static int fetch_pos_int_argv(const struct k_printf_args *args, int pos, int *get_value) {
+
+    if ((size_t)pos > args->argc)
+        return -1;
+
+    const struct k_printf_arg *arg = &args->argv[pos - 1];
+    if (K_PRINTF_ARG_INT != arg->type && K_PRINTF_ARG_UINT != arg->type)
+        return -1;
+
+    *get_value = (int)arg->value.i;
+    return 0;
+}
+
+/* 以实参数组执行格式说明符的回调，格式说明符未提供实参数组版本的回调时视为出错
+ *
+ * 使用位置参数时，先按序号取出 `*m$` 指定的最小宽度与精度，再将读取位置移到 `%n$` 指定的实参。
+ * 若格式说明符要求由 `k_printf` 代为补齐，则 `*` 指定的最小宽度由 `k_printf` 读取。
+ */
+static void invoke_spec_argv(struct k_printf_buf *buf, const struct spec_hooks *hooks,
+                             const struct k_printf_spec *spec, const struct spec_pos *pos,
+                             struct k_printf_args *args) {
+
+    if (NULL == hooks->fn_callback_argv)
+        goto fail;
+
+    const int padded = hooks->auto_pad && spec->use_min_width;
+
+    if ( ! padded && 0 == pos->arg && 0 == pos->min_width && 0 == pos->precision) {
+        hooks->fn_callback_argv(buf, spec, args);
+        return;
+    }
+
+    struct k_printf_spec spec_ = *spec;
+    int value;
+
+    if (padded && 0 == pos->min_width && -1 == spec_.min_width) {
+        const struct k_printf_arg *arg = k_printf_args_next(args);
+        if (NULL == arg || (K_PRINTF_ARG_INT != arg->type && K_PRINTF_ARG_UINT != arg->type))
+            goto fail;
+        set_spec_width(&spec_, (int)arg->value.i);
+    }
+
+    if (0 != pos->min_width) {
+        if (0 != fetch_pos_int_argv(args, pos->min_width, &value))
+            goto fail;
+        set_spec_width(&spec_, value);
+    }
+
+    if (0 != pos->precision) {
+        if (0 != fetch_pos_int_argv(args, pos->precision, &value))
+            goto fail;
+        set_spec_precision(&spec_, value);
+    }
+
+    if (0 != pos->arg)
+        args->index = (size_t)pos->arg - 1;
+
+    if (padded) {
+        struct pad_frame frame;
+        struct k_printf_buf *out = pad_begin(&frame, buf, &spec_);
+        hooks->fn_callback_argv(out, &spec_, args);
+        pad_end(&frame);
+        return;
+    }
+
+    hooks->fn_callback_argv(buf, &spec_, args);
+    return;
+
+fail:
+    buf->n = -1;
+}
+
+/* 预编译格式字符串中的一项，要么是一段字面量文本，要么是一个格式说明符
+ *
+ * 若 `fn_callback` 为 NULL，则该项是字面量文本，文本范围是 `[spec.start, spec.end)`，
+ * 否则该项是格式说明符，`spec`、`fn_callback`、`hooks` 与 `pos` 即为 `extract_spec` 的提取结果。
+ */
+struct format_item {
+    k_printf_callback_fn fn_callback;
+    struct spec_hooks hooks;
+    struct spec_pos pos;
+    struct k_printf_spec spec;
+};
+
+/* 按照与 `x_printf` 相同的规则，将格式字符串拆分为字面量文本与格式说明符，返回拆分出的项数
+ *
+ * 函数只往 `items` 中写入前 `item_cap` 项，超出的项只计数。`item_cap` 为 0 时，函数只统计项数。
+ */
+static size_t parse_format(const struct k_printf_config *config, const char *fmt,
+                           struct format_item *items, size_t item_cap) {
+
+    size_t item_num = 0;
+
+    const char *s = fmt;
+    const char *p = s;
+    for (;;) {
+        p = scan_literal(p);
+
+        if (s < p) {
+            if (item_num < item_cap) {
+                items[item_num].fn_callback = NULL;
+                items[item_num].spec.start  = s;
+                items[item_num].spec.end    = p;
+            }
+            item_num++;
+        }
+
+        if ('\0' == *p)
+            break;
+
+        if ('%' == *(p + 1)) {
+            s = p + 1;
+            p = p + 2;
+            continue;
+        }
+
+        s = p;
+
+        struct k_printf_spec spec;
+        struct spec_hooks hooks;
+        struct spec_pos pos;
+        k_printf_callback_fn fn_callback = extract_spec(config, &s, &spec, &hooks, &pos);
+        if (NULL != fn_callback) {
+            if (item_num < item_cap) {
+                items[item_num].fn_callback = fn_callback;
+                items[item_num].hooks       = hooks;
+                items[item_num].pos         = pos;
+                items[item_num].spec        = spec;
+            }
+            item_num++;
+            p = s;
+        } else {
+            p = s + 1;
+        }
+    }
+
+    return item_num;
+}
+
+struct k_printf_format {
+
+    /* 编译时使用的配置 */
+    const struct k_printf_config *config;
+
+    /* 格式项的数量 */
+    size_t item_num;
+
+    /* 格式项，其后紧跟着格式字符串的副本，各项的 `spec` 均指向该副本 */
+    struct format_item items[];
+};
+
+/* 位置参数序号的上限 */
+#define POS_ARG_MAX 64
+
+/* 不使用堆内存时，`x_printf_pos` 能处理的格式项数量上限 */
+#define POS_ITEM_NUM 32
+
+/* 位置参数表中的一项
+ *
+ * C `printf` 格式说明符的实参被读取为 `arg`，之后可以直接交给 `printf_argv_c_std_spec` 处理。
+ * 自定义格式说明符的实参无从得知其类型，只记下指向该实参的不定长参数列表 `args`，
+ * 再用其 `fn_measure` 消耗掉它所需的实参，以便读取后续的位置参数。
+ */
+struct pos_arg {
+    enum arg_kind kind;
+    const struct format_item *item;
+    struct k_printf_arg arg;
+    va_list args;
+};
+
+/* 判断格式说明符是否为 C `printf` 格式说明符 */
+static int is_c_std_hooks(const struct spec_hooks *hooks) {
+    return printf_argv_c_std_spec == hooks->fn_callback_argv;
+}
+
+/* 在位置参数表中登记序号为 `pos` 的实参，同一序号被多次引用时要求类型一致，失败时返回 -1 */
+static int claim_pos_arg(struct pos_arg *table, int *arg_num, int pos,
+                         enum arg_kind kind, const struct format_item *item) {
+
+    if (POS_ARG_MAX < pos)
+        return -1;
+
+    struct pos_arg *slot = &table[pos - 1];
+    if (ARG_KIND_NONE == slot->kind) {
+        slot->kind = kind;
+        slot->item = item;
+    } else if (kind != slot->kind) {
+        return -1;
+    } else if (ARG_KIND_CUSTOM == kind && item->fn_callback != slot->item->fn_callback) {
+        return -1;
+    }
+
+    if (*arg_num < pos)
+        *arg_num = pos;
+    return 0;
+}
+
+/* 遍历一遍格式项，建立位置参数表，并通过 `get_arg_num` 返回实参数量，失败时返回 -1
+ *
+ * 要求所有格式说明符都使用位置参数，`*` 也要写成 `*m$`，且序号 1 到实参数量之间不能有空缺，
+ * 否则无法确定每个实参的类型，也就无法在不定长参数列表中定位其后的实参。
+ */
+static int build_pos_table(const struct format_item *items, size_t item_num,
+                           struct pos_arg *table, int *get_arg_num) {
+
+    for (int i = 0; i < POS_ARG_MAX; i++)
+        table[i].kind = ARG_KIND_NONE;
+
+    int arg_num = 0;
+
+    const struct format_item *item = items;
+    const struct format_item *end  = items + item_num;
+    for (; item < end; ++item) {
+        if (NULL == item->fn_callback)
+            continue;
+
+        const struct k_printf_spec *spec = &item->spec;
+        const struct spec_pos *pos = &item->pos;
+
+        if (0 == pos->arg)
+            return -1;
+        if (spec->use_min_width && -1 == spec->min_width && 0 == pos->min_width)
+            return -1;
+        if (spec->use_precision && -1 == spec->precision && 0 == pos->precision)
+            return -1;
+
+        enum arg_kind kind;
+        if (is_c_std_hooks(&item->hooks))
+            kind = c_std_arg_kind(spec);
+        else if (NULL != item->hooks.fn_measure)
+            kind = ARG_KIND_CUSTOM;
+        else
+            return -1;
+
+        if (0 != claim_pos_arg(table, &arg_num, pos->arg, kind, item))
+            return -1;
+        if (0 != pos->min_width && 0 != claim_pos_arg(table, &arg_num, pos->min_width, ARG_KIND_INT, item))
+            return -1;
+        if (0 != pos->precision && 0 != claim_pos_arg(table, &arg_num, pos->precision, ARG_KIND_INT, item))
+            return -1;
+    }
+
+    for (int i = 0; i < arg_num; i++) {
+        if (ARG_KIND_NONE == table[i].kind)
+            return -1;
+    }
+
+    *get_arg_num = arg_num;
+    return 0;
+}
+
+/* 从不定长参数列表中读取位置参数表中的一项，失败时返回 -1 */
+static int fetch_pos_arg(struct pos_arg *slot, va_list *args) {
+
+    switch (slot->kind) {
+        case ARG_KIND_CUSTOM: {
+            va_copy(slot->args, *args);
+
+            /* `*m$` 指定的值此时可能尚未读取，用 0 占位，只为让 `fn_measure` 消耗与回调相同的实参 */
+            struct k_printf_spec spec = slot->item->spec;
+            if (0 != slot->item->pos.min_width)
+                spec.min_width = 0;
+            if (0 != slot->item->pos.precision)
+                spec.precision = 0;
+
+            if (slot->item->hooks.fn_measure(&spec, args) < 0)
+                return -1;
+            return 0;
+        }
+
+        default:
+            return fetch_arg(slot->kind, args, &slot->arg);
+    }
+}
+
+/* 按预编译的格式项格式化写入字符串到缓冲区，格式说明符使用 POSIX 位置参数
+ *
+ * 先遍历一遍格式项建立位置参数表，再按序号顺序遍历一遍不定长参数列表，读取所有实参，
+ * 之后每个格式说明符都能直接取到其实参，不必为每个说明符重新遍历不定长参数列表。
+ */
+static int x_printf_items_pos(const struct format_item *items, size_t item_num, struct k_printf_buf *buf, va_list args) {
+
+    struct pos_arg table[POS_ARG_MAX];
+    int arg_num;
+    if (0 != build_pos_table(items, item_num, table, &arg_num)) {
+        buf->n = -1;
+        return -1;
+    }
+
+    va_list args_copy;
+    va_copy(args_copy, args);
+
+    int fetched = 0;
+    for (; fetched < arg_num; fetched++) {
+        if (0 != fetch_pos_arg(&table[fetched], &args_copy)) {
+            if (ARG_KIND_CUSTOM == table[fetched].kind)
+                va_end(table[fetched].args);
+            buf->n = -1;
+            break;
+        }
+    }
+
+    va_end(args_copy);
+
+    const struct format_item *item = items;
+    const struct format_item *end  = items + item_num;
+    for (; item < end && -1 != buf->n; ++item) {
+        if (NULL == item->fn_callback) {
+            buf->fn_puts_ref(buf, item->spec.start, item->spec.end - item->spec.start);
+            continue;
+        }
+
+        struct k_printf_spec spec = item->spec;
+        if (0 != item->pos.min_width)
+            set_spec_width(&spec, (int)table[item->pos.min_width - 1].arg.value.i);
+        if (0 != item->pos.precision)
+            set_spec_precision(&spec, (int)table[item->pos.precision - 1].arg.value.i);
+
+        struct pos_arg *slot = &table[item->pos.arg - 1];
+        if (ARG_KIND_CUSTOM == slot->kind) {
+            va_list slot_args;
+            va_copy(slot_args, slot->args);
+            invoke_spec(buf, item->fn_callback, &item->hooks, &spec, &slot_args);
+            va_end(slot_args);
+        } else {
+            struct k_printf_args slot_args = { &slot->arg, 1, 0 };
+            printf_argv_c_std_spec(buf, &spec, &slot_args);
+        }
+    }
+
+    for (int i = 0; i < fetched; i++) {
+        if (ARG_KIND_CUSTOM == table[i].kind)
+            va_end(table[i].args);
+    }
+
+    return buf->n;
+}
+
+/* 判断格式说明符是否使用了位置参数 */
+static int is_pos_spec(const struct spec_pos *pos) {
+    return 0 != pos->arg || 0 != pos->min_width || 0 != pos->precision;
+}
+
+/* 按预编译的格式项格式化写入字符串到缓冲区，并返回格式化后的字符串长度
+ *
+ * 与 `x_printf` 的输出完全一致，但不再扫描字面量文本，也不再提取和匹配格式说明符。
+ */
+static int x_printf_items(const struct format_item *items, size_t item_num, struct k_printf_buf *buf, va_list args) {
+
+    va_list args_copy;
+    va_copy(args_copy, args);
+
+    const struct format_item *item = items;
+    const struct format_item *end  = items + item_num;
+    int spec_num = 0;
+    for (; item < end && -1 != buf->n; ++item) {
+        if (NULL == item->fn_callback) {
+            buf->fn_puts_ref(buf, item->spec.start, item->spec.end - item->spec.start);
+            continue;
+        }
+
+        /* 格式说明符要么都使用位置参数，要么都不使用，由第一个格式说明符决定 */
+        if (is_pos_spec(&item->pos)) {
+            if (0 == spec_num)
+                x_printf_items_pos(item, end - item, buf, args_copy);
+            else
+                buf->n = -1;
+            break;
+        }
+
+        invoke_spec(buf, item->fn_callback, &item->hooks, &item->spec, &args_copy);
+        spec_num++;
+    }
+
+    va_end(args_copy);
+    return buf->n;
+}
+
+/* 同 `x_printf_items`，但实参取自实参数组 */
+static int x_printf_items_argv(const struct format_item *items, size_t item_num, struct k_printf_buf *buf,
+                               struct k_printf_args *args) {
+
+    const struct format_item *item = items;
+    const struct format_item *end  = items + item_num;
+    for (; item < end && -1 != buf->n; ++item) {
+        if (NULL == item->fn_callback)
+            buf->fn_puts_ref(buf, item->spec.start, item->spec.end - item->spec.start);
+        else
+            invoke_spec_argv(buf, &item->hooks, &item->spec, &item->pos, args);
+    }
+
+    return buf->n;
+}
+
+/* endregion */
+
+/* region [k_printf_cache] */
+
+/* 缓存使用的原子操作。编译器不支持原子操作内建函数时退化为普通读写，此时缓存不能在多个线程中共享 */
+#if defined(K_PRINTF_ATOMIC)
+#define CACHE_LOAD(p)     __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define CACHE_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+#define CACHE_ADD(p, v)   ((void)__atomic_fetch_add((p), (v), __ATOMIC_SEQ_CST))
+#define CACHE_SUB(p, v)   ((void)__atomic_fetch_sub((p), (v), __ATOMIC_SEQ_CST))
+#else
+#define CACHE_LOAD(p)     (*(p))
+#define CACHE_STORE(p, v) ((void)(*(p) = (v)))
+#define CACHE_ADD(p, v)   ((void)(*(p) += (v)))
+#define CACHE_SUB(p, v)   ((void)(*(p) -= (v)))
+#endif
+
+/* 缓存的一项，放入槽位后不再修改，被淘汰后挂到 `retired` 链表上，等到没有线程可能使用它时再释放 */
+struct cache_entry {
+    const char *fmt;
+    struct k_printf_format *format;
+    struct cache_entry *next;
+};
+
+/* 格式字符串缓存
+ *
+ * 多个线程可以同时使用同一个缓存，除 `mask` 外的字段都以原子操作访问。
+ * 槽位中保存的是指向 `cache_entry` 的指针，以 CAS 替换。被替换的项可能仍在其他线程中使用，
+ * 因此不立即释放，而是按两个纪元回收：
+ *
+ * - 线程使用缓存前在当前纪元 `epoch` 的 `readers` 上计数，格式化结束后撤销；
+ * - 被淘汰的项挂到 `retired` 链表上；
+ * - 每次淘汰后尝试推进纪元：若上一纪元已没有线程，说明推进到当前纪元前挂起的项（`pending`）
+ *   已不可能被任何线程使用，将其释放，再把 `retired` 移入 `pending`，切换到另一个纪元。
+ *
+ * 同一时刻只有一个线程推进纪元（`reclaiming`），`pending` 只由该线程访问。
+ */
+struct k_printf_cache {
+    int enabled;
+    int epoch;
+    int reclaiming;
+    size_t mask;
+    size_t readers[2];
+    struct cache_entry *retired;
+    struct cache_entry *pending;
+    struct k_printf_cache_stats stats;
+    struct cache_entry *slots[];
+};
+
+static int cache_cas_entry(struct cache_entry **p, struct cache_entry *expected, struct cache_entry *desired) {
+#if defined(K_PRINTF_ATOMIC)
+    return __atomic_compare_exchange_n(p, &expected, desired, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#else
+    if (*p != expected)
+        return 0;
+    *p = desired;
+    return 1;
+#endif
+}
+
+static struct cache_entry *cache_exchange_entry(struct cache_entry **p, struct cache_entry *desired) {
+#if defined(K_PRINTF_ATOMIC)
+    return __atomic_exchange_n(p, desired, __ATOMIC_SEQ_CST);
+#else
+    struct cache_entry *old = *p;
+    *p = desired;
+    return old;
+#endif
+}
+
+static int cache_try_lock(int *flag) {
+#if defined(K_PRINTF_ATOMIC)
+    return 0 == __atomic_exchange_n(flag, 1, __ATOMIC_SEQ_CST);
+#else
+    if (*flag)
+        return 0;
+    *flag = 1;
+    return 1;
+#endif
+}
+
+struct k_printf_cache *k_printf_cache_create(size_t capacity) {
+
+    size_t slot_num = 1;
+    while (slot_num < capacity && slot_num <= SIZE_MAX / 2 / sizeof(struct cache_entry *))
+        slot_num *= 2;
+
+    struct k_printf_cache *cache = malloc(sizeof(struct k_printf_cache) + sizeof(struct cache_entry *) * slot_num);
+    if (NULL == cache)
+        return NULL;
+
+    cache->enabled    = 1;
+    cache->epoch      = 0;
+    cache->reclaiming = 0;
+    cache->mask       = slot_num - 1;
+    cache->readers[0] = 0;
+    cache->readers[1] = 0;
+    cache->retired    = NULL;
+    cache->pending    = NULL;
+    memset(&cache->stats, 0, sizeof(cache->stats));
+    for (size_t i = 0; i < slot_num; i++)
+        cache->slots[i] = NULL;
+
+    return cache;
+}
+
+static void free_cache_entries(struct cache_entry *entry) {
+    while (NULL != entry) {
+        struct cache_entry *next = entry->next;
+        k_printf_format_free(entry->format);
+        free(entry);
+        entry = next;
+    }
+}
+
+void k_printf_cache_clear(struct k_printf_cache *cache) {
+    assert(NULL != cache);
+
+    for (size_t i = 0; i <= cache->mask; i++)
+        free_cache_entries(cache_exchange_entry(&cache->slots[i], NULL));
+
+    free_cache_entries(cache_exchange_entry(&cache->retired, NULL));
+    free_cache_entries(cache->pending);
+    cache->pending = NULL;
+}
+
+void k_printf_cache_destroy(struct k_printf_cache *cache) {
+    if (NULL == cache)
+        return;
+
+    k_printf_cache_clear(cache);
+    free(cache);
+}
+
+void k_printf_cache_set_enabled(struct k_printf_cache *cache, int enabled) {
+    assert(NULL != cache);
+
+    CACHE_STORE(&cache->enabled, (0 != enabled));
+}
+
+void k_printf_cache_get_stats(const struct k_printf_cache *cache, struct k_printf_cache_stats *get_stats) {
+    assert(NULL != cache);
+    assert(NULL != get_stats);
+
+    get_stats->hits      = CACHE_LOAD(&cache->stats.hits);
+    get_stats->misses    = CACHE_LOAD(&cache->stats.misses);
+    get_stats->evictions = CACHE_LOAD(&cache->stats.evictions);
+}
+
+/* 开始使用缓存，返回所在的纪元，用完后以该纪元调用 `cache_leave` */
+static int cache_enter(struct k_printf_cache *cache) {
+
+    for (;;) {
+        int epoch = CACHE_LOAD(&cache->epoch);
+        CACHE_ADD(&cache->readers[epoch], 1);
+
+        /* 计数后纪元没有变化，推进纪元的线程必然能看到这次计数 */
+        if (epoch == CACHE_LOAD(&cache->epoch))
+            return epoch;
+
+        CACHE_SUB(&cache->readers[epoch], 1);
+    }
+}
+
+static void cache_leave(struct k_printf_cache *cache, int epoch) {
+    CACHE_SUB(&cache->readers[epoch], 1);
+}
+
+/* 将被淘汰的项挂到 `retired` 链表上，并尝试推进纪元，释放不再可能被使用的项 */
+static void retire_cache_entry(struct k_printf_cache *cache, struct cache_entry *entry) {
+
+    struct cache_entry *head;
+    do {
+        head = CACHE_LOAD(&cache->retired);
+        entry->next = head;
+    } while ( ! cache_cas_entry(&cache->retired, head, entry));
+
+    if ( ! cache_try_lock(&cache->reclaiming))
+        return;
+
+    int epoch = CACHE_LOAD(&cache->epoch);
+    if (0 == CACHE_LOAD(&cache->readers[1 - epoch])) {
+        free_cache_entries(cache->pending);
+        cache->pending = cache_exchange_entry(&cache->retired, NULL);
+        CACHE_STORE(&cache->epoch, 1 - epoch);
+    }
+
+    CACHE_STORE(&cache->reclaiming, 0);
+}
+
+/* 从配置的缓存中查找格式字符串的预编译结果，若未命中则编译并放入缓存
+ *
+ * 缓存是直接映射的，每个格式字符串地址只对应一个槽位，槽位被占用时淘汰旧的编译结果。
+ * 若配置没有缓存、缓存被禁用、或是编译失败，则返回 NULL，调用方应直接解析格式字符串。
+ * 多个线程可以同时查找；若另一个线程抢先替换了同一槽位，本次也返回 NULL。
+ *
+ * 返回非 NULL 时，调用方在用完预编译结果后，须以 `get_epoch` 得到的纪元调用 `cache_leave`。
+ */
+static const struct k_printf_format *cache_lookup(const struct k_printf_config *config, const char *fmt,
+                                                  int *get_epoch) {
+
+    struct k_printf_cache *cache = config->cache;
+    if (NULL == cache || ! CACHE_LOAD(&cache->enabled))
+        return NULL;
+
+    uintptr_t h = (uintptr_t)fmt;
+    h ^= h >> 16;
+    h *= 0x45d9f3bu;
+    h ^= h >> 16;
+
+    int epoch = cache_enter(cache);
+
+    struct cache_entry **slot = &cache->slots[h & cache->mask];
+    struct cache_entry *entry = CACHE_LOAD(slot);
+    if (NULL != entry && fmt == entry->fmt && config == entry->format->config) {
+        CACHE_ADD(&cache->stats.hits, 1);
+        *get_epoch = epoch;
+        return entry->format;
+    }
+
+    CACHE_ADD(&cache->stats.misses, 1);
+
+    struct cache_entry *new_entry = NULL;
+
+    /* 禁止分配时不编译，调用方直接解析格式字符串 */
+    if (config->no_alloc || 0 != alloc_check(config, sizeof(struct cache_entry))
+        || NULL == (new_entry = malloc(sizeof(struct cache_entry))))
+        goto miss;
+
+    new_entry->fmt    = fmt;
+    new_entry->format = k_printf_compile(config, fmt);
+    new_entry->next   = NULL;
+    if (NULL == new_entry->format) {
+        free(new_entry);
+        goto miss;
+    }
+
+    if ( ! cache_cas_entry(slot, entry, new_entry)) {
+        free_cache_entries(new_entry);
+        goto miss;
+    }
+
+    if (NULL != entry) {
+        CACHE_ADD(&cache->stats.evictions, 1);
+        retire_cache_entry(cache, entry);
+    }
+
+    *get_epoch = epoch;
+    return new_entry->format;
+
+miss:
+    cache_leave(cache, epoch);
+    return NULL;
+}
+
+/* endregion */
+
+/* region [x_printf] */
+
+/* 格式化写入字符串到缓冲区，格式说明符使用 POSIX 位置参数
+ *
+ * 先将格式字符串拆分为格式项（项数不多时存放在栈上），再交给 `x_printf_items_pos` 处理。
+ */
+static int x_printf_pos(const struct k_printf_config *config, struct k_printf_buf *buf, const char *fmt, va_list args) {
+
+    struct format_item block[POS_ITEM_NUM];
+    struct format_item *items = block;
+
+    size_t item_num = parse_format(config, fmt, block, POS_ITEM_NUM);
+    if (POS_ITEM_NUM < item_num) {
+        if (NULL == (items = config_malloc(config, sizeof(struct format_item) * item_num))) {
+            buf->n = -1;
+            return -1;
+        }
+        parse_format(config, fmt, items, item_num);
+    }
+
+    x_printf_items_pos(items, item_num, buf, args);
+
+    if (items != block)
+        config_free(config, items);
+
+    return buf->n;
+}
+
+/* 格式化写入字符串到缓冲区，并返回格式化后的字符串长度
+ *
+ * 本函数为 `k_printf` 家族所有函数的核心实现。
+ */
+static int x_printf(const struct k_printf_config *config, struct k_printf_buf *buf, const char *fmt, va_list args) {
+
+    if (NULL != config && NULL != config->cache) {
+        int epoch;
+        const struct k_printf_format *format = cache_lookup(config, fmt, &epoch);
+        if (NULL != format) {
+            x_printf_items(format->items, format->item_num, buf, args);
+            cache_leave(config->cache, epoch);
+            return buf->n;
+        }
+    }
+
+    /* 形参 `args` 可能是数组退化成的指针，对其取地址得不到 `va_list *`，故先拷贝一份 */
+    va_list args_copy;
+    va_copy(args_copy, args);
+
+    int spec_num = 0;
+
+    const char *s = fmt;
+    const char *p = s;
+    for (;;) {
+        /* 出错后（或截断模式下缓冲区已满）后续的输出都没有意义，提前结束 */
+        if (-1 == buf->n)
+            break;
+
+        p = scan_literal(p);
+
+        if (s < p)
+            buf->fn_puts_ref(buf, s, p - s);
+
+        if ('\0' == *p)
+            break;
+
+        if ('%' == *(p + 1)) {
+            s = p + 1;
+            p = p + 2;
+            continue;
+        }
+
+        s = p;
+
+        struct k_printf_spec spec;
+        struct spec_hooks hooks;
+        struct spec_pos pos;
+        k_printf_callback_fn fn_callback = extract_spec(config, &s, &spec, &hooks, &pos);
+        if (NULL != fn_callback) {
+            /* 格式说明符要么都使用位置参数，要么都不使用，由第一个格式说明符决定 */
+            if (is_pos_spec(&pos)) {
+                if (0 == spec_num)
+                    x_printf_pos(config, buf, p, args_copy);
+                else
+                    buf->n = -1;
+                break;
+            }
+
+            invoke_spec(buf, fn_callback, &hooks, &spec, &args_copy);
+            spec_num++;
+            p = s;
+        } else {
+            p = s + 1;
+        }
+    }
+
+    va_end(args_copy);
+    return buf->n;
+}
+
+/* 同 `x_printf`，但实参取自实参数组，格式说明符按出现顺序依次取用实参 */
+static int x_printf_argv(const struct k_printf_config *config, struct k_printf_buf *buf, const char *fmt,
+                         struct k_printf_args *args) {
+
+    if (NULL != config && NULL != config->cache) {
+        int epoch;
+        const struct k_printf_format *format = cache_lookup(config, fmt, &epoch);
+        if (NULL != format) {
+            x_printf_items_argv(format->items, format->item_num, buf, args);
+            cache_leave(config->cache, epoch);
+            return buf->n;
+        }
+    }
+
+    const char *s = fmt;
+    const char *p = s;
+    for (;;) {
+        if (-1 == buf->n)
+            break;
+
+        p = scan_literal(p);
+
+        if (s < p)
+            buf->fn_puts_ref(buf, s, p - s);
+
+        if ('\0' == *p)
+            break;
+
+        if ('%' == *(p + 1)) {
+            s = p + 1;
+            p = p + 2;
+            continue;
+        }
+
+        s = p;
+
+        struct k_printf_spec spec;
+        struct spec_hooks hooks;
+        struct spec_pos pos;
+        k_printf_callback_fn fn_callback = extract_spec(config, &s, &spec, &hooks, &pos);
+        if (NULL != fn_callback) {
+            invoke_spec_argv(buf, &hooks, &spec, &pos, args);
+            p = s;
+        } else {
+            p = s + 1;
+        }
+    }
+
+    return buf->n;
+}
+
+/* endregion */
+
+/* region [k_printf] */
+
+int k_printf(const struct k_printf_config *config, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int r = k_vfprintf(config, stdout, fmt, args);
+    va_end(args);
+
+    return r;
+}
+
+int k_fprintf(const struct k_printf_config *config, FILE *file, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int r = k_vfprintf(config, file, fmt, args);
+    va_end(args);
+
+    return r;
+}
+
+int k_vfprintf(const struct k_printf_config *config, FILE *file, const char *fmt, va_list args) {
+    assert(NULL != file);
+    assert(NULL != fmt);
+
+    if (NULL == config)
+        return vfprintf(file, fmt, args);
+
+    struct file_buf file_buf;
+    init_file_buf(&file_buf, config, file);
+
+    int r = x_printf(config, (struct k_printf_buf *)&file_buf, fmt, args);
+    return file_buf_flush(&file_buf, r);
+}
+
+#if defined(K_PRINTF_POSIX)
+
+int k_dprintf(const struct k_printf_config *config, int fd, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int r = k_vdprintf(config, fd, fmt, args);
+    va_end(args);
+
+    return r;
+}
+
+int k_vdprintf(const struct k_printf_config *config, int fd, const char *fmt, va_list args) {
+    assert(0 <= fd);
+    assert(NULL != fmt);
+
+    struct fd_buf fd_buf;
+    init_fd_buf(&fd_buf, config, fd);
+
+    int r;
+    if (NULL == config) {
+        fd_buf_vprintf((struct k_printf_buf *)&fd_buf, fmt, args);
+        r = fd_buf.impl.n;
+    } else {
+        r = x_printf(config, (struct k_printf_buf *)&fd_buf, fmt, args);
+    }
+
+    return fd_buf_flush(&fd_buf, r);
+}
+
+#endif
+
+long long k_xprintf(const struct k_printf_config *config, struct k_printf_sink *sink, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    long long r = k_vxprintf(config, sink, fmt, args);
+    va_end(args);
+
+    return r;
+}
+
+long long k_vxprintf(const struct k_printf_config *config, struct k_printf_sink *sink, const char *fmt, va_list args) {
+    assert(NULL != sink);
+    assert(NULL != sink->fn_puts);
+    assert(NULL == sink->fn_reserve || NULL != sink->fn_commit);
+    assert(NULL != fmt);
+
+    if (0 != sink->error)
+        return -1;
+
+    struct sink_buf sink_buf;
+    init_sink_buf(&sink_buf, config, sink);
+
+    if (NULL == config)
+        sink_buf_vprintf((struct k_printf_buf *)&sink_buf, fmt, args);
+    else
+        x_printf(config, (struct k_printf_buf *)&sink_buf, fmt, args);
+
+    return sink_buf_finish(&sink_buf);
+}
+
+int k_sprintf(const struct k_printf_config *config, char *buf, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int r = k_vsprintf(config, buf, fmt, args);
+    va_end(args);
+
+    return r;
+}
+
+int k_vsprintf(const struct k_printf_config *config, char *buf, const char *fmt, va_list args) {
+    return k_vsnprintf(config, buf, INT_MAX, fmt, args);
+}
+
+int k_snprintf(const struct k_printf_config *config, char *buf, size_t n, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int r = k_vsnprintf(config, buf, n, fmt, args);
+    va_end(args);
+
+    return r;
+}
+
+int k_vsnprintf(const struct k_printf_config *config, char *buf, size_t n, const char *fmt, va_list args) {
+    assert(NULL != fmt);
+
+    if (NULL == config)
+        return vsnprintf(buf, n, fmt, args);
+
+    /* 缓冲区大小为 0 时只需要计算长度 */
+    if (0 == n)
+        return k_vprintf_len(config, fmt, args);
+
+    struct str_buf str_buf;
+    init_str_buf(&str_buf, config, buf, n);
+
+    return x_printf(config, (struct k_printf_buf *)&str_buf, fmt, args);
+}
+
+int k_printf_len(const struct k_printf_config *config, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int r = k_vprintf_len(config, fmt, args);
+    va_end(args);
+
+    return r;
+}
+
+int k_vprintf_len(const struct k_printf_config *config, const char *fmt, va_list args) {
+    assert(NULL != fmt);
+
+    if (NULL == config)
+        return vsnprintf(NULL, 0, fmt, args);
+
+    struct count_buf count_buf;
+    init_count_buf(&count_buf, config);
+
+    return x_printf(config, (struct k_printf_buf *)&count_buf, fmt, args);
+}
+
+int k_snprintf_trunc(const struct k_printf_config *config, char *buf, size_t n, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int r = k_vsnprintf_trunc(config, buf, n, fmt, args);
+    va_end(args);
+
+    return r;
+}
+
+int k_vsnprintf_trunc(const struct k_printf_config *config, char *buf, size_t n, const char *fmt, va_list args) {
+    assert(NULL != fmt);
+
+    struct str_buf str_buf;
+    init_str_buf(&str_buf, config, buf, n);
+    str_buf.trunc_mode = 1;
+
+    int r;
+    if (NULL == config) {
+        str_buf_vprintf((struct k_printf_buf *)&str_buf, fmt, args);
+        r = str_buf.impl.n;
+    } else {
+        r = x_printf(config, (struct k_printf_buf *)&str_buf, fmt, args);
+    }
+
+    if (str_buf.truncated)
+        return (n <= INT_MAX) ? (int)n : INT_MAX;
+
+    return r;
+}
+
+int k_asprintf(const struct k_printf_config *config, char **get_s, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int r = k_vasprintf(config, get_s, fmt, args);
+    va_end(args);
+
+    return r;
+}
+
+int k_vasprintf(const struct k_printf_config *config, char **get_s, const char *fmt, va_list args) {
+    assert(NULL != get_s);
+    assert(NULL != fmt);
+
+    /* 先写入栈上的缓冲区，放不下时才分配堆内存，格式字符串只需处理一遍 */
+    char init_buffer[256];
+    struct mem_buf mem_buf;
+    init_mem_buf(&mem_buf, config, init_buffer, sizeof(init_buffer));
+
+    int str_len;
+    if (NULL == config) {
+        mem_buf_vprintf((struct k_printf_buf *)&mem_buf, fmt, args);
+        str_len = mem_buf.impl.n;
+    } else {
+        str_len = x_printf(config, (struct k_printf_buf *)&mem_buf, fmt, args);
+    }
+
+    if (str_len <= 0 || str_len == INT_MAX) {
+        free_mem_buf(&mem_buf);
+        return -1;
+    }
+
+    char *buf = mem_buf_detach(&mem_buf);
+    if (NULL == buf) {
+        free_mem_buf(&mem_buf);
+        return -1;
+    }
+
+    *get_s = buf;
+    return str_len;
+}
+
+/* endregion */
+
+/* region [k_printf_strbuf] */
+
+/* 字符串缓冲区首次分配的容量 */
+#define STRBUF_INIT_CAPACITY 64
+
+void k_printf_strbuf_init(struct k_printf_strbuf *sb) {
+    assert(NULL != sb);
+
+    sb->data     = NULL;
+    sb->len      = 0;
+    sb->capacity = 0;
+}
+
+void k_printf_strbuf_free(struct k_printf_strbuf *sb) {
+    assert(NULL != sb);
+
+    free(sb->data);
+    k_printf_strbuf_init(sb);
+}
+
+void k_printf_strbuf_clear(struct k_printf_strbuf *sb) {
+    assert(NULL != sb);
+
+    sb->len = 0;
+    if (NULL != sb->data)
+        sb->data[0] = '\0';
+}
+
+/* 确保还能追加 `len` 个字符（不含 '\0'），失败时返回 -1，缓冲区保持不变 */
+static int strbuf_reserve(struct k_printf_strbuf *sb, const struct k_printf_config *config, size_t len) {
+
+    if (SIZE_MAX - sb->len - 1 < len)
+        return -1;
+
+    size_t need = sb->len + len + 1;
+    if (need <= sb->capacity)
+        return 0;
+
+    size_t capacity = (0 == sb->capacity) ? STRBUF_INIT_CAPACITY : sb->capacity;
+    while (capacity < need && capacity <= SIZE_MAX / 2)
+        capacity *= 2;
+    if (capacity < need)
+        capacity = need;
+
+    if (0 != alloc_check(config, capacity))
+        return -1;
+
+    char *data = realloc(sb->data, capacity);
+    if (NULL == data)
+        return -1;
+
+    sb->data     = data;
+    sb->capacity = capacity;
+    return 0;
+}
+
+int k_printf_strbuf_append(struct k_printf_strbuf *sb, const char *str, size_t len) {
+    assert(NULL != sb);
+    assert(NULL != str || 0 == len);
+
+    if (0 != strbuf_reserve(sb, NULL, len))
+        return -1;
+
+    if (0 < len)
+        memcpy(sb->data + sb->len, str, len);
+    sb->len += len;
+    sb->data[sb->len] = '\0';
+    return 0;
+}
+
+char *k_printf_strbuf_detach(struct k_printf_strbuf *sb, size_t *get_len) {
+    assert(NULL != sb);
+
+    if (0 != strbuf_reserve(sb, NULL, 0))
+        return NULL;
+
+    char *s = sb->data;
+    if (NULL != get_len)
+        *get_len = sb->len;
+
+    s[sb->len] = '\0';
+    k_printf_strbuf_init(sb);
+    return s;
+}
+
+int k_sbprintf(const struct k_printf_config *config, struct k_printf_strbuf *sb, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int r = k_vsbprintf(config, sb, fmt, args);
+    va_end(args);
+
+    return r;
+}
+
+int k_vsbprintf(const struct k_printf_config *config, struct k_printf_strbuf *sb, const char *fmt, va_list args) {
+    assert(NULL != sb);
+    assert(NULL != fmt);
+
+    if (0 != strbuf_reserve(sb, config, 0))
+        return -1;
+
+    /* 直接在 `sb` 的内存上追加，不经过栈上的中间缓冲区 */
+    struct mem_buf mem_buf;
+    attach_mem_buf(&mem_buf, config, sb->data, sb->len, sb->capacity);
+
+    int str_len;
+    if (NULL == config) {
+        mem_buf_vprintf((struct k_printf_buf *)&mem_buf, fmt, args);
+        str_len = mem_buf.impl.n;
+    } else {
+        str_len = x_printf(config, (struct k_printf_buf *)&mem_buf, fmt, args);
+    }
+
+    /* 扩容后的内存归 `sb` 所有；失败时丢弃本次追加的内容 */
+    sb->data     = mem_buf.buffer;
+    sb->capacity = mem_buf.capacity;
+
+    if (str_len < 0 || str_len == INT_MAX) {
+        sb->data[sb->len] = '\0';
+        return -1;
+    }
+
+    sb->len = mem_buf.str_len;
+    return str_len;
+}
+
+/* endregion */
+
+/* region [k_printf_arena] */
+
+/* arena 默认的块大小 */
+#define ARENA_CHUNK_SIZE 4096
+
+struct k_printf_arena *k_printf_arena_create(size_t chunk_size) {
+
+    struct k_printf_arena *arena = malloc(sizeof(struct k_printf_arena));
+    if (NULL == arena)
+        return NULL;
+
+    arena->chunk      = NULL;
+    arena->spare      = NULL;
+    arena->chunk_size = (0 == chunk_size) ? ARENA_CHUNK_SIZE : chunk_size;
+    return arena;
+}
+
+static void free_arena_chunks(struct arena_chunk *chunk) {
+    while (NULL != chunk) {
+        struct arena_chunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+}
+
+void k_printf_arena_destroy(struct k_printf_arena *arena) {
+
+    if (NULL == arena)
+        return;
+
+    free_arena_chunks(arena->chunk);
+    free_arena_chunks(arena->spare);
+    free(arena);
+}
+
+void k_printf_arena_reset(struct k_printf_arena *arena) {
+    assert(NULL != arena);
+
+    while (NULL != arena->chunk) {
+        struct arena_chunk *chunk = arena->chunk;
+        arena->chunk = chunk->next;
+        chunk->next  = arena->spare;
+        arena->spare = chunk;
+    }
+}
+
+char *k_arena_printf(const struct k_printf_config *config, struct k_printf_arena *arena, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    char *s = k_varena_printf(config, arena, fmt, args);
+    va_end(args);
+
+    return s;
+}
+
+char *k_varena_printf(const struct k_printf_config *config, struct k_printf_arena *arena, const char *fmt, va_list args) {
+    assert(NULL != arena);
+    assert(NULL != fmt);
+
+    struct arena_chunk *chunk = arena->chunk;
+    if (NULL == chunk || chunk->used == chunk->size) {
+        if (NULL == (chunk = arena_push_chunk(arena, config, 1)))
+            return NULL;
+    }
+
+    /* 直接写在当前块的尾部，成功后才推进 `used`，失败时写入的内容自然作废 */
+    struct mem_buf mem_buf;
+    attach_mem_buf(&mem_buf, config, chunk->data + chunk->used, 0, chunk->size - chunk->used);
+    mem_buf.arena = arena;
+    mem_buf.buffer[0] = '\0';
+
+    int str_len;
+    if (NULL == config) {
+        mem_buf_vprintf((struct k_printf_buf *)&mem_buf, fmt, args);
+        str_len = mem_buf.impl.n;
+    } else {
+        str_len = x_printf(config, (struct k_printf_buf *)&mem_buf, fmt, args);
+    }
+
+    if (str_len < 0 || str_len == INT_MAX)
+        return NULL;
+
+    /* 扩容时字符串被挪到了新的当前块的开头 */
+    arena->chunk->used += mem_buf.str_len + 1;
+    return mem_buf.buffer;
+}
+
+/* endregion */
+
+/* region [k_printf_format] */
+
+struct k_printf_format *k_printf_compile(const struct k_printf_config *config, const char *fmt) {
+    assert(NULL != fmt);
+
+    size_t item_num = parse_format(config, fmt, NULL, 0);
+    size_t fmt_len  = strlen(fmt);
+    size_t size     = sizeof(struct k_printf_format) + sizeof(struct format_item) * item_num + fmt_len + 1;
+
+    if (0 != alloc_check(config, size))
+        return NULL;
+
+    struct k_printf_format *format = malloc(size);
+    if (NULL == format)
+        return NULL;
+
+    char *fmt_copy = (char *)&format->items[item_num];
+    memcpy(fmt_copy, fmt, fmt_len + 1);
+
+    format->config   = config;
+    format->item_num = parse_format(config, fmt_copy, format->items, item_num);
+
+    return format;
+}
+
+void k_printf_format_free(struct k_printf_format *format) {
+    free(format);
+}
+
+int k_printf_exec(const struct k_printf_format *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int r = k_vfprintf_compiled(format, stdout, args);
+    va_end(args);
+
+    return r;
+}
+
+int k_fprintf_compiled(const struct k_printf_format *format, FILE *file, ...) {
+    va_list args;
+    va_start(args, file);
+    int r = k_vfprintf_compiled(format, file, args);
+    va_end(args);
+
+    return r;
+}
+
+int k_vfprintf_compiled(const struct k_printf_format *format, FILE *file, va_list args) {
+    assert(NULL != format);
+    assert(NULL != file);
+
+    struct file_buf file_buf;
+    init_file_buf(&file_buf, format->config, file);
+
+    int r = x_printf_items(format->items, format->item_num, (struct k_printf_buf *)&file_buf, args);
+    return file_buf_flush(&file_buf, r);
+}
+
+int k_snprintf_compiled(const struct k_printf_format *format, char *buf, size_t n, ...) {
+    va_list args;
+    va_start(args, n);
+    int r = k_vsnprintf_compiled(format, buf, n, args);
+    va_end(args);
+
+    return r;
+}
+
+int k_vsnprintf_compiled(const struct k_printf_format *format, char *buf, size_t n, va_list args) {
+    assert(NULL != format);
+
+    struct str_buf str_buf;
+    init_str_buf(&str_buf, format->config, buf, n);
+
+    return x_printf_items(format->items, format->item_num, (struct k_printf_buf *)&str_buf, args);
+}
+
+/* endregion */
+
+/* region [k_printf_argv] */
+
+int k_snprintf_argv(const struct k_printf_config *config, char *buf, size_t n, const char *fmt,
+                    const struct k_printf_arg *argv, size_t argc) {
+    assert(NULL != fmt);
+    assert(NULL != argv || 0 == argc);
+
+    struct k_printf_args args = { argv, argc, 0 };
+
+    /* 缓冲区大小为 0 时只需要计算长度 */
+    if (0 == n) {
+        struct count_buf count_buf;
+        init_count_buf(&count_buf, config);
+
+        return x_printf_argv(config, (struct k_printf_buf *)&count_buf, fmt, &args);
+    }
+
+    struct str_buf str_buf;
+    init_str_buf(&str_buf, config, buf, n);
+
+    return x_printf_argv(config, (struct k_printf_buf *)&str_buf, fmt, &args);
+}
+
+long long k_xprintf_argv(const struct k_printf_config *config, struct k_printf_sink *sink, const char *fmt,
+                         const struct k_printf_arg *argv, size_t argc) {
+    assert(NULL != sink);
+    assert(NULL != sink->fn_puts);
+    assert(NULL == sink->fn_reserve || NULL != sink->fn_commit);
+    assert(NULL != fmt);
+    assert(NULL != argv || 0 == argc);
+
+    if (0 != sink->error)
+        return -1;
+
+    struct k_printf_args args = { argv, argc, 0 };
+
+    struct sink_buf sink_buf;
+    init_sink_buf(&sink_buf, config, sink);
+
+    x_printf_argv(config, (struct k_printf_buf *)&sink_buf, fmt, &args);
+
+    return sink_buf_finish(&sink_buf);
+}
+
+/* 依次输出已拆分好的格式项，实参取自实参数组 */
+static int x_printf_item_list(const struct k_printf_item *items, size_t item_num, struct k_printf_buf *buf,
+                              struct k_printf_args *args) {
+
+    static const struct spec_pos no_pos = { 0, 0, 0 };
+
+    const struct k_printf_item *item = items;
+    const struct k_printf_item *end  = items + item_num;
+    for (; item < end && -1 != buf->n; ++item) {
+        if (NULL == item->spec.type) {
+            buf->fn_puts_ref(buf, item->spec.start, item->spec.end - item->spec.start);
+        } else if (NULL == item->tuple) {
+            printf_argv_c_std_spec(buf, &item->spec, args);
+        } else {
+            const struct k_printf_spec_callback_tuple *tuple = item->tuple;
+            struct spec_hooks hooks = { tuple->fn_measure, tuple->fn_callback_argv, tuple->fn_capture, tuple->auto_pad };
+            invoke_spec_argv(buf, &hooks, &item->spec, &no_pos, args);
+        }
+    }
+
+    return buf->n;
+}
+
+int k_snprintf_items(const struct k_printf_config *config, char *buf, size_t n,
+                     const struct k_printf_item *items, size_t item_num,
+                     const struct k_printf_arg *argv, size_t argc) {
+    assert(NULL != items || 0 == item_num);
+    assert(NULL != argv || 0 == argc);
+
+    struct k_printf_args args = { argv, argc, 0 };
+
+    if (0 == n) {
+        struct count_buf count_buf;
+        init_count_buf(&count_buf, config);
+
+        return x_printf_item_list(items, item_num, (struct k_printf_buf *)&count_buf, &args);
     }
+
+    struct str_buf str_buf;
+    init_str_buf(&str_buf, config, buf, n);
+
+    return x_printf_item_list(items, item_num, (struct k_printf_buf *)&str_buf, &args);
+}
+
+long long k_xprintf_items(const struct k_printf_config *config, struct k_printf_sink *sink,
+                          const struct k_printf_item *items, size_t item_num,
+                          const struct k_printf_arg *argv, size_t argc) {
+    assert(NULL != sink);
+    assert(NULL != sink->fn_puts);
+    assert(NULL == sink->fn_reserve || NULL != sink->fn_commit);
+    assert(NULL != items || 0 == item_num);
+    assert(NULL != argv || 0 == argc);
+
+    if (0 != sink->error)
+        return -1;
+
+    struct k_printf_args args = { argv, argc, 0 };
+
+    struct sink_buf sink_buf;
+    init_sink_buf(&sink_buf, config, sink);
+
+    x_printf_item_list(items, item_num, (struct k_printf_buf *)&sink_buf, &args);
+
+    return sink_buf_finish(&sink_buf);
 }
 
-/* 匹配 C `printf` 格式说明符，若匹配成功则移动字符串指针，并返回对应的回调
+/* endregion */
+
+/* region [k_printf_capture] */
+
+/* 捕获实参的数量上限 */
+#define CAPTURE_ARG_MAX 64
+
+/* 实参编码中类型字节的标记位，表示其后跟着实参内容的副本，而不是实参的值 */
+#define CAPTURE_ARG_COPY 0x80
+
+/* 副本的起始地址按此对齐，渲染时可以直接将其当作数组等类型访问 */
+#define CAPTURE_COPY_ALIGN 16
+
+/* 捕获实参时使用的缓冲区
  *
- * C `printf` 支持的格式说明符详见：https://zh.cppreference.com/w/c/io/fprintf
+ * 每个实参被编码为一个类型字节加上其值的原始字节，例如 int 只占 9 个字节。
+ * 需要深拷贝的实参（例如 `%s` 的字符串）则编码为类型字节、`size_t` 长度与内容副本，
+ * 副本前按需填充若干字节，使其地址对齐到 `CAPTURE_COPY_ALIGN`。
  */
-static k_printf_callback_fn match_c_std_spec(const char **str) {
+struct k_printf_capture {
+    char *data;
+    size_t len;
+    size_t capacity;
+    size_t argc;
+    int failed;
+    int full;   /* 因空间不足而失败 */
+    int stream; /* 使用流式编码，见 region [k_printf_binlog] */
+};
 
-    /* 通过打表的方式，给每个 C `printf` 格式说明符分配回调 */
+static void init_capture(struct k_printf_capture *cap, char *data, size_t capacity) {
+    cap->data     = data;
+    cap->len      = 0;
+    cap->capacity = capacity;
+    cap->argc     = 0;
+    cap->failed   = 0;
+    cap->full     = 0;
+    cap->stream   = 0;
+}
 
-    switch ((*str)[0]) {
-        case 'a': case 'A': case 'c': case 'd':
-        case 'e': case 'E': case 'f': case 'F':
-        case 'g': case 'G': case 'i': case 'o':
-        case 'p': case 's': case 'u': case 'x':
-        case 'X':
-            *str += 1;
-            return printf_callback_c_std_spec;
+/* 从缓冲区中分配 `len` 个字节用于写入一个实参，空间不足或实参过多时置失败标记并返回 NULL */
+static unsigned char *capture_alloc(struct k_printf_capture *cap, size_t len) {
 
-        case 'n':
-            *str += 1;
-            return printf_callback_c_std_spec_n;
+    if ( ! cap->failed && cap->capacity - cap->len < len)
+        cap->full = 1;
 
-        case 'h': {
-            switch ((*str)[1]) {
-                case 'd': case 'i':
-                case 'o': case 'u':
-                case 'x': case 'X':
-                    *str += 2;
-                    return printf_callback_c_std_spec;
-                case 'n':
-                    *str += 2;
-                    return printf_callback_c_std_spec_n;
-                case 'h':
-                    switch ((*str)[2]) {
-                        case 'd': case 'i':
-                        case 'o': case 'u':
-                        case 'x': case 'X':
-                            *str += 3;
-                            return printf_callback_c_std_spec;
-                        case 'n':
-                            *str += 3;
-                            return printf_callback_c_std_spec_n;
-                    }
-                    break;
-            }
+    if (cap->failed || CAPTURE_ARG_MAX <= cap->argc || cap->capacity - cap->len < len) {
+        cap->failed = 1;
+        return NULL;
+    }
+
+    unsigned char *p = (unsigned char *)cap->data + cap->len;
+    cap->len += len;
+    cap->argc++;
+    return p;
+}
+
+/* 副本类实参的编码起始于 `p` 时，其副本相对于 `p` 的偏移 */
+static size_t capture_copy_offset(const unsigned char *p) {
+    uintptr_t addr = (uintptr_t)(p + 1 + sizeof(size_t));
+    return 1 + sizeof(size_t) + (size_t)((CAPTURE_COPY_ALIGN - addr % CAPTURE_COPY_ALIGN) % CAPTURE_COPY_ALIGN);
+}
+
+/* 实参的值在编码中占用的字节数 */
+static size_t capture_value_size(enum k_printf_arg_type type) {
+    switch (type) {
+        case K_PRINTF_ARG_INT:         return sizeof(long long);
+        case K_PRINTF_ARG_UINT:        return sizeof(unsigned long long);
+        case K_PRINTF_ARG_DOUBLE:      return sizeof(double);
+        case K_PRINTF_ARG_LONG_DOUBLE: return sizeof(long double);
+        case K_PRINTF_ARG_STR:         return sizeof(const char *);
+        case K_PRINTF_ARG_PTR:         return sizeof(void *);
+    }
+    return 0;
+}
+
+/* varint 编码的字节数，每字节保存 7 位 */
+static size_t varint_size(unsigned long long v) {
+    size_t size = 1;
+    for (; 0x80 <= v; v >>= 7)
+        size++;
+    return size;
+}
+
+static unsigned char *put_varint(unsigned char *p, unsigned long long v) {
+    for (; 0x80 <= v; v >>= 7)
+        *p++ = (unsigned char)(v | 0x80);
+    *p++ = (unsigned char)v;
+    return p;
+}
+
+/* 从 `*p` 读取一个 varint 并前移 `*p`，数据不完整或超出 64 位时返回 -1 */
+static int get_varint(const unsigned char **p, const unsigned char *end, unsigned long long *get_v) {
+
+    unsigned long long v = 0;
+    for (unsigned int shift = 0; shift < 64; shift += 7) {
+        if (*p == end)
+            return -1;
+        unsigned char byte = *(*p)++;
+        v |= (unsigned long long)(byte & 0x7f) << shift;
+        if (0 == (byte & 0x80)) {
+            *get_v = v;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* 流式编码一个实参：整数与指针编码为 varint（有符号整数先做 zigzag 变换），浮点数保存原始字节，
+ * 非 NULL 的字符串转为副本，NULL 只保存类型字节。
+ */
+static int capture_stream_arg(struct k_printf_capture *cap, const struct k_printf_arg *arg) {
+
+    unsigned long long v;
+    switch (arg->type) {
+        case K_PRINTF_ARG_INT:
+            v = ((unsigned long long)arg->value.i << 1) ^ (0 > arg->value.i ? ~0ull : 0ull);
+            break;
+        case K_PRINTF_ARG_UINT:
+            v = arg->value.u;
+            break;
+        case K_PRINTF_ARG_PTR:
+            v = (uintptr_t)arg->value.p;
             break;
+        case K_PRINTF_ARG_STR:
+            if (NULL != arg->value.s)
+                return k_printf_capture_copy(cap, K_PRINTF_ARG_STR, arg->value.s, strlen(arg->value.s));
+            /* fallthrough */
+        case K_PRINTF_ARG_DOUBLE:
+        case K_PRINTF_ARG_LONG_DOUBLE: {
+            size_t size = (K_PRINTF_ARG_STR == arg->type) ? 0 : capture_value_size(arg->type);
+            unsigned char *p = capture_alloc(cap, 1 + size);
+            if (NULL == p)
+                return -1;
+            p[0] = (unsigned char)arg->type;
+            memcpy(p + 1, &arg->value, size);
+            return 0;
         }
+        default:
+            cap->failed = 1;
+            return -1;
+    }
 
-        case 'l': {
-            switch ((*str)[1]) {
-                case 'a': case 'A': case 'c': case 'd':
-                case 'e': case 'E': case 'f': case 'F':
-                case 'g': case 'G': case 'i': case 'o':
-                case 's': case 'u': case 'x': case 'X':
-                    *str += 2;
-                    return printf_callback_c_std_spec;
-                case 'n':
-                    *str += 2;
-                    return printf_callback_c_std_spec_n;
-                case 'l':
-                    switch ((*str)[2]) {
-                        case 'd': case 'i':
-                        case 'o': case 'u':
-                        case 'x': case 'X':
-                            *str += 3;
-                            return printf_callback_c_std_spec;
-                        case 'n':
-                            *str += 3;
-                            return printf_callback_c_std_spec_n;
-                    }
-                    break;
+    unsigned char *p = capture_alloc(cap, 1 + varint_size(v));
+    if (NULL == p)
+        return -1;
+
+    p[0] = (unsigned char)arg->type;
+    put_varint(p + 1, v);
+    return 0;
+}
+
+int k_printf_capture_arg(struct k_printf_capture *cap, const struct k_printf_arg *arg) {
+    assert(NULL != cap);
+    assert(NULL != arg);
+
+    if (cap->stream)
+        return capture_stream_arg(cap, arg);
+
+    size_t size = capture_value_size(arg->type);
+    if (0 == size) {
+        cap->failed = 1;
+        return -1;
+    }
+
+    unsigned char *p = capture_alloc(cap, 1 + size);
+    if (NULL == p)
+        return -1;
+
+    /* 联合体的各成员都从偏移 0 开始，拷贝前 `size` 个字节即得到该成员的值 */
+    p[0] = (unsigned char)arg->type;
+    memcpy(p + 1, &arg->value, size);
+    return 0;
+}
+
+int k_printf_capture_copy(struct k_printf_capture *cap, enum k_printf_arg_type type, const void *data, size_t len) {
+    assert(NULL != cap);
+    assert(K_PRINTF_ARG_STR == type || K_PRINTF_ARG_PTR == type);
+    assert(NULL != data || 0 == len);
+
+    /* 流式编码中副本不对齐、不补 '\0'，由解码方处理 */
+    if (cap->stream) {
+        size_t head = 1 + varint_size(len);
+        if (SIZE_MAX - head < len) {
+            cap->failed = 1;
+            return -1;
+        }
+
+        unsigned char *p = capture_alloc(cap, head + len);
+        if (NULL == p)
+            return -1;
+
+        p[0] = (unsigned char)(type | CAPTURE_ARG_COPY);
+        p = put_varint(p + 1, len);
+        if (0 < len)
+            memcpy(p, data, len);
+        return 0;
+    }
+
+    size_t extra  = (K_PRINTF_ARG_STR == type) ? 1 : 0;
+    size_t offset = capture_copy_offset((unsigned char *)cap->data + cap->len);
+    if (SIZE_MAX - offset - extra < len) {
+        cap->failed = 1;
+        return -1;
+    }
+
+    unsigned char *p = capture_alloc(cap, offset + len + extra);
+    if (NULL == p)
+        return -1;
+
+    p[0] = (unsigned char)(type | CAPTURE_ARG_COPY);
+    memcpy(p + 1, &len, sizeof(size_t));
+    if (0 < len)
+        memcpy(p + offset, data, len);
+    if (extra)
+        p[offset + len] = '\0';
+    return 0;
+}
+
+#if defined(K_PRINTF_ATOMIC)
+
+/* 将捕获的实参解码为实参数组，副本类实参的指针指向 `data` 中的副本，返回实参数量，只用于延迟格式化的队列 */
+static size_t decode_capture(const char *data, size_t argc, struct k_printf_arg *argv) {
+
+    const unsigned char *p = (const unsigned char *)data;
+
+    for (size_t i = 0; i < argc; i++) {
+        struct k_printf_arg *arg = &argv[i];
+        unsigned char tag = *p;
+
+        arg->type = (enum k_printf_arg_type)(tag & ~CAPTURE_ARG_COPY);
+        memset(&arg->value, 0, sizeof(arg->value));
+
+        if (tag & CAPTURE_ARG_COPY) {
+            size_t len;
+            memcpy(&len, p + 1, sizeof(size_t));
+            p += capture_copy_offset(p);
+            if (K_PRINTF_ARG_STR == arg->type) {
+                arg->value.s = (const char *)p;
+                p += len + 1;
+            } else {
+                arg->value.p = (void *)p;
+                p += len;
             }
+        } else {
+            size_t size = capture_value_size(arg->type);
+            memcpy(&arg->value, p + 1, size);
+            p += 1 + size;
+        }
+    }
+
+    return argc;
+}
+
+#endif
+
+/* 判断格式说明符能否被捕获
+ *
+ * 位置参数、`%n` 一族与 `%ls` 无法延迟处理；自定义格式说明符须同时提供 `fn_capture` 与 `fn_callback_argv`。
+ */
+static int is_capturable_spec(const struct k_printf_spec *spec, const struct spec_hooks *hooks,
+                              const struct spec_pos *pos) {
+
+    if (is_pos_spec(pos))
+        return 0;
+
+    if ( ! is_c_std_hooks(hooks))
+        return NULL != hooks->fn_capture && NULL != hooks->fn_callback_argv;
+
+    const char conv = spec->end[-1];
+    return 'n' != conv && ! ('s' == conv && ARG_KIND_STR != c_std_arg_kind(spec));
+}
+
+/* 判断格式字符串中的格式说明符是否都能被捕获
+ *
+ * 解码二进制日志时，格式字符串来自数据本身，须先经过本函数检查，
+ * 否则伪造的 `%n` 或 `%ls` 会让渲染时写入或读取数据指定的地址。
+ */
+static int is_capturable_fmt(const struct k_printf_config *config, const char *fmt) {
+
+    const char *p = fmt;
+    for (;;) {
+        p = scan_literal(p);
+
+        if ('\0' == *p)
+            return 1;
+
+        if ('%' == *(p + 1)) {
+            p = p + 2;
+            continue;
+        }
+
+        const char *s = p;
+
+        struct k_printf_spec spec;
+        struct spec_hooks hooks;
+        struct spec_pos pos;
+        if (NULL == extract_spec(config, &s, &spec, &hooks, &pos)) {
+            p = s + 1;
+            continue;
+        }
+
+        if ( ! is_capturable_spec(&spec, &hooks, &pos))
+            return 0;
+        p = s;
+    }
+}
+
+/* 捕获一个格式说明符的实参，格式说明符须能被捕获（见 `is_capturable_spec`）
+ *
+ * C `printf` 格式说明符的实参由 `k_printf` 读取，`%s` 的字符串被深拷贝（有精度时最多拷贝精度个字符）。
+ * 自定义格式说明符交由其 `fn_capture` 处理。
+ */
+static int capture_spec(struct k_printf_capture *cap, const struct k_printf_spec *spec,
+                        const struct spec_hooks *hooks, va_list *args) {
+
+    if ( ! is_c_std_hooks(hooks))
+        return hooks->fn_capture(cap, spec, args);
+
+    struct k_printf_arg arg;
+    int precision = spec->use_precision ? spec->precision : -1;
+
+    if (spec->use_min_width && -1 == spec->min_width) {
+        arg.type    = K_PRINTF_ARG_INT;
+        arg.value.i = va_arg(*args, int);
+        if (0 != k_printf_capture_arg(cap, &arg))
+            return -1;
+    }
+
+    if (spec->use_precision && -1 == spec->precision) {
+        precision   = va_arg(*args, int);
+        arg.type    = K_PRINTF_ARG_INT;
+        arg.value.i = precision;
+        if (0 != k_printf_capture_arg(cap, &arg))
+            return -1;
+    }
+
+    enum arg_kind kind = c_std_arg_kind(spec);
+
+    fetch_arg(kind, args, &arg);
+
+    if (ARG_KIND_STR == kind && NULL != arg.value.s) {
+        const char *str = arg.value.s;
+        const char *nul = (precision < 0) ? NULL : memchr(str, '\0', (size_t)precision);
+        size_t len = (precision < 0) ? strlen(str) : (NULL != nul) ? (size_t)(nul - str) : (size_t)precision;
+        return k_printf_capture_copy(cap, K_PRINTF_ARG_STR, str, len);
+    }
+
+    return k_printf_capture_arg(cap, &arg);
+}
+
+/* 按格式字符串依次捕获所有实参，失败时返回 -1，不支持位置参数 */
+static int capture_args(const struct k_printf_config *config, const char *fmt, va_list args,
+                        struct k_printf_capture *cap) {
+
+    va_list args_copy;
+    va_copy(args_copy, args);
+
+    int r = 0;
+
+    const char *p = fmt;
+    for (;;) {
+        p = scan_literal(p);
+
+        if ('\0' == *p)
             break;
+
+        if ('%' == *(p + 1)) {
+            p = p + 2;
+            continue;
         }
-        case 'L':
-            switch ((*str)[1]) {
-                case 'a': case 'A': case 'e': case 'E':
-                case 'f': case 'F': case 'g': case 'G':
-                    *str += 2;
-                    return printf_callback_c_std_spec;
-            }
+
+        const char *s = p;
+
+        struct k_printf_spec spec;
+        struct spec_hooks hooks;
+        struct spec_pos pos;
+        k_printf_callback_fn fn_callback = extract_spec(config, &s, &spec, &hooks, &pos);
+        if (NULL == fn_callback) {
+            p = s + 1;
+            continue;
+        }
+
+        if ( ! is_capturable_spec(&spec, &hooks, &pos) || 0 != capture_spec(cap, &spec, &hooks, &args_copy)) {
+            r = -1;
             break;
+        }
+        p = s;
+    }
 
-        case 'j': case 't': case 'z':
-            switch ((*str)[1]) {
-                case 'd': case 'i':
-                case 'o': case 'u':
-                case 'x': case 'X':
-                    *str += 2;
-                    return printf_callback_c_std_spec;
-                case 'n':
-                    *str += 2;
-                    return printf_callback_c_std_spec_n;
+    va_end(args_copy);
+    return (0 != r || cap->failed) ? -1 : 0;
+}
+
+/* endregion */
+
+/* region [k_printf_queue] */
+
+#if defined(K_PRINTF_ATOMIC)
+
+/* 队列中的一个槽位，其后紧跟着 `slot_size` 字节的实参编码
+ *
+ * `seq` 是槽位的序号：等于入队位置时槽位空闲，等于入队位置加 1 时槽位中有待处理的记录。
+ */
+struct queue_cell {
+    size_t seq;
+    const struct k_printf_config *config;
+    const char *fmt;
+    size_t argc;
+    int discarded;
+};
+
+/* 有界多生产者单消费者无锁队列，算法同 Dmitry Vyukov 的有界 MPMC 队列
+ *
+ * 生产者以 CAS 竞争 `enqueue_pos`，之后独占所得槽位写入记录，最后发布 `seq`。
+ * 消费者只有一个，`dequeue_pos` 无需原子操作。两者分处不同缓存行，避免伪共享。
+ */
+struct k_printf_queue {
+    size_t enqueue_pos;
+    char pad[64 - sizeof(size_t)];
+    size_t dequeue_pos;
+    size_t mask;
+    size_t slot_size;
+    size_t stride;
+    char *cells;
+};
+
+static struct queue_cell *queue_cell_at(const struct k_printf_queue *queue, size_t pos) {
+    return (struct queue_cell *)(queue->cells + (pos & queue->mask) * queue->stride);
+}
+
+struct k_printf_queue *k_printf_queue_create(size_t slot_num, size_t slot_size) {
+    assert(0 < slot_num);
+
+    size_t cell_num = 1;
+    while (cell_num < slot_num && cell_num <= SIZE_MAX / 2)
+        cell_num *= 2;
+
+    /* 每个槽位占整数个缓存行，相邻槽位的生产者互不干扰 */
+    if (SIZE_MAX - sizeof(struct queue_cell) - 63 < slot_size)
+        return NULL;
+    size_t stride = (sizeof(struct queue_cell) + slot_size + 63) / 64 * 64;
+    if (SIZE_MAX / stride < cell_num)
+        return NULL;
+
+    struct k_printf_queue *queue = malloc(sizeof(struct k_printf_queue));
+    if (NULL == queue)
+        return NULL;
+
+    if (NULL == (queue->cells = malloc(cell_num * stride))) {
+        free(queue);
+        return NULL;
+    }
+
+    queue->enqueue_pos = 0;
+    queue->dequeue_pos = 0;
+    queue->mask        = cell_num - 1;
+    queue->slot_size   = slot_size;
+    queue->stride      = stride;
+
+    for (size_t i = 0; i < cell_num; i++)
+        queue_cell_at(queue, i)->seq = i;
+
+    return queue;
+}
+
+void k_printf_queue_destroy(struct k_printf_queue *queue) {
+
+    if (NULL == queue)
+        return;
+
+    free(queue->cells);
+    free(queue);
+}
+
+/* 为生产者占用一个空闲槽位，并通过 `get_pos` 返回入队位置，队列已满时返回 NULL */
+static struct queue_cell *queue_claim(struct k_printf_queue *queue, size_t *get_pos) {
+
+    size_t pos = __atomic_load_n(&queue->enqueue_pos, __ATOMIC_RELAXED);
+    for (;;) {
+        struct queue_cell *cell = queue_cell_at(queue, pos);
+        size_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+
+        if (seq == pos) {
+            if (__atomic_compare_exchange_n(&queue->enqueue_pos, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                *get_pos = pos;
+                return cell;
             }
-            break;
+        } else if ((intptr_t)(seq - pos) < 0) {
+            return NULL;
+        } else {
+            pos = __atomic_load_n(&queue->enqueue_pos, __ATOMIC_RELAXED);
+        }
     }
+}
 
-    return NULL;
+int k_printf_defer(const struct k_printf_config *config, struct k_printf_queue *queue, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int r = k_vprintf_defer(config, queue, fmt, args);
+    va_end(args);
+
+    return r;
 }
 
-/* endregion */
+int k_vprintf_defer(const struct k_printf_config *config, struct k_printf_queue *queue, const char *fmt, va_list args) {
+    assert(NULL != queue);
+    assert(NULL != fmt);
 
-/* region [user_spec] */
+    size_t pos;
+    struct queue_cell *cell = queue_claim(queue, &pos);
+    if (NULL == cell)
+        return -1;
 
-k_printf_callback_fn k_printf_match_spec_helper(const struct k_printf_spec_callback_tuple *tuples, const char **str) {
+    struct k_printf_capture cap;
+    init_capture(&cap, (char *)(cell + 1), queue->slot_size);
 
-    const struct k_printf_spec_callback_tuple *spec = tuples;
-    for (; NULL != spec->spec_type; ++spec) {
+    int r = capture_args(config, fmt, args, &cap);
 
-        const char *p_str  = *str;
-        const char *p_spec = spec->spec_type;
-        for (; '\0' != *p_spec; ++p_str, ++p_spec) {
-            if (*p_str != *p_spec)
-                goto next_spec;
-        }
+    /* 即使捕获失败也要发布槽位，否则消费者会一直停在这里；消费者会跳过被丢弃的记录 */
+    cell->config    = config;
+    cell->fmt       = fmt;
+    cell->argc      = cap.argc;
+    cell->discarded = (0 != r);
 
-        *str += p_spec - spec->spec_type;
-        return spec->fn_callback;
+    __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+    return r;
+}
 
-    next_spec:;
+size_t k_printf_queue_drain(struct k_printf_queue *queue, struct k_printf_sink *sink, size_t max) {
+    assert(NULL != queue);
+    assert(NULL != sink);
+
+    size_t record_num = 0;
+    while (record_num < max) {
+        size_t pos = queue->dequeue_pos;
+        struct queue_cell *cell = queue_cell_at(queue, pos);
+        if (__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) != pos + 1)
+            break;
+
+        if ( ! cell->discarded) {
+            struct k_printf_arg argv[CAPTURE_ARG_MAX];
+            size_t argc = decode_capture((const char *)(cell + 1), cell->argc, argv);
+            k_xprintf_argv(cell->config, sink, cell->fmt, argv, argc);
+            record_num++;
+        }
+
+        __atomic_store_n(&cell->seq, pos + queue->mask + 1, __ATOMIC_RELEASE);
+        queue->dequeue_pos = pos + 1;
     }
 
-    return NULL;
+    return record_num;
 }
 
+#endif
+
 /* endregion */
 
-/* region [x_printf] */
+/* region [k_printf_binlog] */
 
-/* 提取字符串开头的非负 int 值（若超过上限则返回 INT_MAX），并移动字符串指针跳过数字
+/* 二进制日志流的头部，每个写入端在第一次写入时输出一次 */
+#define BINLOG_MAGIC "KPB1"
+#define BINLOG_MAGIC_LEN 4
+
+/* 格式定义记录：类型字节、varint 格式 ID、varint 长度、格式字符串 */
+#define BINLOG_RECORD_FORMAT 'F'
+
+/* 实参记录：类型字节、varint 格式 ID、varint 长度、流式编码的实参 */
+#define BINLOG_RECORD_ARGS 'R'
+
+/* 记录头的最大长度：类型字节与两个 varint */
+#define BINLOG_HEAD_MAX (1 + 2 * 10)
+
+struct binlog_entry {
+    const char *fmt;
+    size_t id;
+};
+
+/* 二进制日志的写入端
  *
- * 函数假定字符串开头存在非负的数字。
+ * 格式字符串以地址为键分配 ID，记录在开放寻址的哈希表中，ID 在整个流中保持不变。
+ * 实参先以流式编码写入 `scratch`，记录头再写在实参之前预留的空间中，使整条记录只调用一次 `fn_puts`。
  */
-static int extract_non_negative_int(const char **str) {
+struct k_printf_binlog {
+    const struct k_printf_config *config;
+    struct k_printf_sink *sink;
+    int started;
+    size_t fmt_num;
+    size_t mask;
+    struct binlog_entry *entries;
+    char *scratch;
+    size_t scratch_size;
+};
 
-    unsigned long long num = 0;
+struct k_printf_binlog *k_printf_binlog_create(const struct k_printf_config *config, struct k_printf_sink *sink) {
+    assert(NULL != sink);
+    assert(NULL != sink->fn_puts);
 
-    const char *ch = *str;
-    for (; '0' <= *ch && *ch <= '9'; ch++) {
-        num = num * 10 + (*ch - '0');
+    struct k_printf_binlog *log = malloc(sizeof(struct k_printf_binlog));
+    if (NULL == log)
+        return NULL;
 
-        if (INT_MAX <= num) {
-            while ('0' <= *ch && *ch <= '9')
-                ch++;
+    log->config       = config;
+    log->sink         = sink;
+    log->started      = 0;
+    log->fmt_num      = 0;
+    log->mask         = 63;
+    log->entries      = calloc(log->mask + 1, sizeof(struct binlog_entry));
+    log->scratch_size = 256;
+    log->scratch      = malloc(log->scratch_size);
 
-            num = INT_MAX;
-            break;
-        }
+    if (NULL == log->entries || NULL == log->scratch) {
+        k_printf_binlog_destroy(log);
+        return NULL;
     }
 
-    *str = ch;
-    return (int)num;
+    return log;
 }
 
-/* 提取格式说明符，若提取成功则移动字符串指针，并返回对应的回调
- *
- * 函数假定字符串的起始为 `%` 符号。
- */
-static k_printf_callback_fn extract_spec(const struct k_printf_config *config, const char **str, struct k_printf_spec *get_spec) {
+void k_printf_binlog_destroy(struct k_printf_binlog *log) {
 
-    const char *ch = *str + 1;
+    if (NULL == log)
+        return;
 
-    struct k_printf_spec spec;
-    spec.start = *str;
+    free(log->entries);
+    free(log->scratch);
+    free(log);
+}
 
-    spec.left_justified   = 0;
-    spec.sign_prepended   = 0;
-    spec.space_padded     = 0;
-    spec.zero_padding     = 0;
-    spec.alternative_form = 0;
-    for (;;) {
-        switch (*ch) {
-            case '-': ch++; spec.left_justified   = 1; continue;
-            case '+': ch++; spec.sign_prepended   = 1; continue;
-            case ' ': ch++; spec.space_padded     = 1; continue;
-            case '0': ch++; spec.zero_padding     = 1; continue;
-            case '#': ch++; spec.alternative_form = 1; continue;
-        }
-        break;
-    }
+static size_t binlog_slot(const struct k_printf_binlog *log, const char *fmt) {
+    uintptr_t h = (uintptr_t)fmt;
+    h ^= h >> 16;
+    h *= 0x45d9f3bu;
+    h ^= h >> 16;
+    return (size_t)h & log->mask;
+}
 
-    if ('1' <= *ch && *ch <= '9') {
-        spec.use_min_width = 1;
-        spec.min_width     = extract_non_negative_int(&ch);
-    } else if ('*' == *ch) {
-        ch++;
-        spec.use_min_width = 1;
-        spec.min_width     = -1;
-    } else {
-        spec.use_min_width = 0;
-        spec.min_width     = -1;
-    }
+/* 哈希表容量翻倍，失败时返回 -1，原表保持不变 */
+static int binlog_grow_entries(struct k_printf_binlog *log) {
 
-    if ('.' == *ch) {
-        ch++;
-        if ('0' <= *ch && *ch <= '9') {
-            spec.use_precision = 1;
-            spec.precision     = extract_non_negative_int(&ch);
-        } else if ('*' == *ch) {
-            ch++;
-            spec.use_precision = 1;
-            spec.precision     = -1;
-        } else {
-            return NULL;
-        }
-    } else {
-        spec.use_precision = 0;
-        spec.precision     = -1;
-    }
+    size_t entry_num = log->mask + 1;
+    if (SIZE_MAX / 2 / sizeof(struct binlog_entry) < entry_num)
+        return -1;
 
-    spec.type = ch;
+    if (0 != alloc_check(log->config, entry_num * 2 * sizeof(struct binlog_entry)))
+        return -1;
 
-    k_printf_callback_fn fn_callback;
-    if (NULL == (fn_callback = config->fn_match_spec(&ch)) &&
-        NULL == (fn_callback = match_c_std_spec(&ch)))
-        return NULL;
+    struct binlog_entry *old = log->entries;
+    struct binlog_entry *entries = calloc(entry_num * 2, sizeof(struct binlog_entry));
+    if (NULL == entries)
+        return -1;
 
-    spec.end = ch;
+    log->entries = entries;
+    log->mask    = entry_num * 2 - 1;
 
-    *str = ch;
-    *get_spec = spec;
-    return fn_callback;
+    for (size_t i = 0; i < entry_num; i++) {
+        if (NULL == old[i].fmt)
+            continue;
+        size_t slot = binlog_slot(log, old[i].fmt);
+        while (NULL != entries[slot].fmt)
+            slot = (slot + 1) & log->mask;
+        entries[slot] = old[i];
+    }
+
+    free(old);
+    return 0;
 }
 
-/* 格式化写入字符串到缓冲区，并返回格式化后的字符串长度
- *
- * 本函数为 `k_printf` 家族所有函数的核心实现。
- */
-static int x_printf(const struct k_printf_config *config, struct k_printf_buf *buf, const char *fmt, va_list args) {
+/* 实参编码空间翻倍，失败时返回 -1 */
+static int binlog_grow_scratch(struct k_printf_binlog *log) {
 
-    const char *s = fmt;
-    const char *p = s;
-    for (;;) {
-        while ('\0' != *p && '%' != *p)
-            ++p;
+    if (SIZE_MAX / 2 < log->scratch_size)
+        return -1;
+    if (0 != alloc_check(log->config, log->scratch_size * 2))
+        return -1;
 
-        if (s < p)
-            buf->fn_puts(buf, s, p - s);
+    char *scratch = realloc(log->scratch, log->scratch_size * 2);
+    if (NULL == scratch)
+        return -1;
 
-        if ('\0' == *p)
-            break;
+    log->scratch       = scratch;
+    log->scratch_size *= 2;
+    return 0;
+}
 
-        if ('%' == *(p + 1)) {
-            s = p + 1;
-            p = p + 2;
-            continue;
-        }
+static int binlog_write(struct k_printf_binlog *log, const void *data, size_t len) {
 
-        s = p;
+    struct k_printf_sink *sink = log->sink;
 
-        struct k_printf_spec spec;
-        k_printf_callback_fn fn_callback = extract_spec(config, &s, &spec);
-        if (NULL != fn_callback) {
-            fn_callback(buf, &spec, &args);
-            p = s;
-        } else {
-            p = s + 1;
-        }
+    if (0 != sink->fn_puts(sink, (const char *)data, len)) {
+        if (0 == sink->error)
+            sink->error = 1;
+        return -1;
     }
 
-    return buf->n;
+    sink->count += len;
+    return 0;
 }
 
-/* endregion */
+/* 查找格式字符串的 ID，首次出现的格式字符串会被分配新的 ID，并写入其格式定义记录 */
+static int binlog_fmt_id(struct k_printf_binlog *log, const char *fmt, size_t *get_id) {
 
-/* region [k_printf] */
+    size_t slot = binlog_slot(log, fmt);
+    for (; NULL != log->entries[slot].fmt; slot = (slot + 1) & log->mask) {
+        if (fmt == log->entries[slot].fmt) {
+            *get_id = log->entries[slot].id;
+            return 0;
+        }
+    }
 
-int k_printf(const struct k_printf_config *config, const char *fmt, ...) {
-    va_list args;
-    va_start(args, fmt);
-    int r = k_vfprintf(config, stdout, fmt, args);
-    va_end(args);
+    /* 装载率保持在 3/4 以下，探测总能遇到空槽位 */
+    if ((log->mask + 1) / 4 * 3 <= log->fmt_num + 1) {
+        if (0 != binlog_grow_entries(log))
+            return -1;
+        slot = binlog_slot(log, fmt);
+        while (NULL != log->entries[slot].fmt)
+            slot = (slot + 1) & log->mask;
+    }
 
-    return r;
+    size_t len = strlen(fmt);
+
+    unsigned char head[BINLOG_HEAD_MAX];
+    head[0] = BINLOG_RECORD_FORMAT;
+    unsigned char *end = put_varint(put_varint(head + 1, log->fmt_num), len);
+
+    if (0 != binlog_write(log, head, (size_t)(end - head)) || 0 != binlog_write(log, fmt, len))
+        return -1;
+
+    log->entries[slot].fmt = fmt;
+    log->entries[slot].id  = log->fmt_num;
+    *get_id = log->fmt_num++;
+    return 0;
 }
 
-int k_fprintf(const struct k_printf_config *config, FILE *file, const char *fmt, ...) {
+long long k_printf_binlog(struct k_printf_binlog *log, const char *fmt, ...) {
     va_list args;
     va_start(args, fmt);
-    int r = k_vfprintf(config, file, fmt, args);
+    long long r = k_vprintf_binlog(log, fmt, args);
     va_end(args);
 
     return r;
 }
 
-int k_vfprintf(const struct k_printf_config *config, FILE *file, const char *fmt, va_list args) {
-    assert(NULL != file);
+long long k_vprintf_binlog(struct k_printf_binlog *log, const char *fmt, va_list args) {
+    assert(NULL != log);
     assert(NULL != fmt);
 
-    if (NULL == config)
-        return vfprintf(file, fmt, args);
+    struct k_printf_sink *sink = log->sink;
+    if (0 != sink->error)
+        return -1;
 
-    struct file_buf file_buf;
-    init_file_buf(&file_buf, file);
+    unsigned long long count = sink->count;
 
-    return x_printf(config, (struct k_printf_buf *)&file_buf, fmt, args);
-}
+    if ( ! log->started) {
+        if (0 != binlog_write(log, BINLOG_MAGIC, BINLOG_MAGIC_LEN))
+            return -1;
+        log->started = 1;
+    }
 
-int k_sprintf(const struct k_printf_config *config, char *buf, const char *fmt, ...) {
-    va_list args;
-    va_start(args, fmt);
-    int r = k_vsprintf(config, buf, fmt, args);
-    va_end(args);
+    size_t id;
+    if (0 != binlog_fmt_id(log, fmt, &id))
+        return -1;
 
-    return r;
-}
+    /* 实参编码放不下时扩大空间重新捕获，`capture_args` 不会消耗 `args` */
+    struct k_printf_capture cap;
+    for (;;) {
+        init_capture(&cap, log->scratch + BINLOG_HEAD_MAX, log->scratch_size - BINLOG_HEAD_MAX);
+        cap.stream = 1;
 
-int k_vsprintf(const struct k_printf_config *config, char *buf, const char *fmt, va_list args) {
-    return k_vsnprintf(config, buf, INT_MAX, fmt, args);
-}
+        if (0 == capture_args(log->config, fmt, args, &cap))
+            break;
+        if ( ! cap.full || 0 != binlog_grow_scratch(log))
+            return -1;
+    }
 
-int k_snprintf(const struct k_printf_config *config, char *buf, size_t n, const char *fmt, ...) {
-    va_list args;
-    va_start(args, fmt);
-    int r = k_vsnprintf(config, buf, n, fmt, args);
-    va_end(args);
+    unsigned char head[BINLOG_HEAD_MAX];
+    head[0] = BINLOG_RECORD_ARGS;
+    size_t head_len = (size_t)(put_varint(put_varint(head + 1, id), cap.len) - head);
 
-    return r;
+    char *record = log->scratch + BINLOG_HEAD_MAX - head_len;
+    memcpy(record, head, head_len);
+
+    if (0 != binlog_write(log, record, head_len + cap.len))
+        return -1;
+
+    if (NULL != sink->fn_flush && 0 != sink->fn_flush(sink)) {
+        if (0 == sink->error)
+            sink->error = 1;
+        return -1;
+    }
+
+    return (long long)(sink->count - count);
 }
 
-int k_vsnprintf(const struct k_printf_config *config, char *buf, size_t n, const char *fmt, va_list args) {
-    assert(NULL != fmt);
+/* 将流式编码的实参解码为实参数组
+ *
+ * 副本被拷贝到 `copies` 中按 `CAPTURE_COPY_ALIGN` 对齐的位置，字符串末尾补上 '\0'，
+ * 因此 `copies` 至少要有编码长度加 `CAPTURE_ARG_MAX * CAPTURE_COPY_ALIGN` 字节。数据不合法时返回 -1。
+ */
+static int decode_stream_capture(const unsigned char *p, const unsigned char *end, char *copies,
+                                 struct k_printf_arg *argv, size_t *get_argc) {
 
-    if (NULL == config)
-        return vsnprintf(buf, n, fmt, args);
+    size_t argc = 0;
+    char *dst = copies;
 
-    struct str_buf str_buf;
-    init_str_buf(&str_buf, buf, n);
+    while (p < end) {
+        if (CAPTURE_ARG_MAX == argc)
+            return -1;
 
-    return x_printf(config, (struct k_printf_buf *)&str_buf, fmt, args);
-}
+        struct k_printf_arg *arg = &argv[argc++];
+        unsigned char tag = *p++;
+        unsigned long long v;
 
-int k_asprintf(const struct k_printf_config *config, char **get_s, const char *fmt, ...) {
-    va_list args;
-    va_start(args, fmt);
-    int r = k_vasprintf(config, get_s, fmt, args);
-    va_end(args);
+        arg->type = (enum k_printf_arg_type)(tag & ~CAPTURE_ARG_COPY);
+        memset(&arg->value, 0, sizeof(arg->value));
 
-    return r;
+        if (tag & CAPTURE_ARG_COPY) {
+            if (K_PRINTF_ARG_STR != arg->type && K_PRINTF_ARG_PTR != arg->type)
+                return -1;
+            if (0 != get_varint(&p, end, &v) || (unsigned long long)(end - p) < v)
+                return -1;
+
+            dst += (CAPTURE_COPY_ALIGN - (uintptr_t)dst % CAPTURE_COPY_ALIGN) % CAPTURE_COPY_ALIGN;
+            if (0 < v)
+                memcpy(dst, p, (size_t)v);
+            p += v;
+
+            if (K_PRINTF_ARG_STR == arg->type) {
+                dst[v] = '\0';
+                arg->value.s = dst;
+                dst += v + 1;
+            } else {
+                arg->value.p = dst;
+                dst += v;
+            }
+            continue;
+        }
+
+        switch (arg->type) {
+            case K_PRINTF_ARG_INT:
+                if (0 != get_varint(&p, end, &v))
+                    return -1;
+                arg->value.i = (long long)(v >> 1) ^ -(long long)(v & 1);
+                break;
+            case K_PRINTF_ARG_UINT:
+                if (0 != get_varint(&p, end, &v))
+                    return -1;
+                arg->value.u = v;
+                break;
+            case K_PRINTF_ARG_PTR:
+                if (0 != get_varint(&p, end, &v))
+                    return -1;
+                arg->value.p = (void *)(uintptr_t)v;
+                break;
+            case K_PRINTF_ARG_STR:
+                arg->value.s = NULL;
+                break;
+            case K_PRINTF_ARG_DOUBLE:
+            case K_PRINTF_ARG_LONG_DOUBLE: {
+                size_t size = capture_value_size(arg->type);
+                if ((size_t)(end - p) < size)
+                    return -1;
+                memcpy(&arg->value, p, size);
+                p += size;
+                break;
+            }
+            default:
+                return -1;
+        }
+    }
+
+    *get_argc = argc;
+    return 0;
 }
 
-int k_vasprintf(const struct k_printf_config *config, char **get_s, const char *fmt, va_list args) {
-    assert(NULL != get_s);
-    assert(NULL != fmt);
+long long k_printf_binlog_decode(const struct k_printf_config *config, const void *data, size_t len,
+                                 struct k_printf_sink *sink) {
+    assert(NULL != data || 0 == len);
+    assert(NULL != sink);
 
-    va_list args_copy;
-    va_copy(args_copy, args);
-    int str_len = k_vsnprintf(config, NULL, 0, fmt, args_copy);
-    va_end(args_copy);
+    const unsigned char *p   = (const unsigned char *)data;
+    const unsigned char *end = p + len;
 
-    if (str_len <= 0 || str_len == INT_MAX)
-        return -1;
+    char **fmts     = NULL;
+    size_t fmt_num  = 0;
+    size_t fmt_cap  = 0;
+    char *copies    = NULL;
+    size_t copies_size = 0;
 
-    char *buf = malloc(str_len + 1);
-    if (NULL == buf)
-        return -1;
+    long long record_num = 0;
+    int failed = 0;
 
-    if (str_len != k_vsnprintf(config, buf, str_len + 1, fmt, args)) {
-        free(buf);
+    /* 流必须以头部开始；多个流首尾相接时，每遇到一个头部就清空格式表 */
+    if (len < BINLOG_MAGIC_LEN || 0 != memcmp(p, BINLOG_MAGIC, BINLOG_MAGIC_LEN))
         return -1;
+
+    while (p < end && ! failed) {
+        unsigned long long id;
+        unsigned long long size;
+
+        if ((size_t)(end - p) >= BINLOG_MAGIC_LEN && 0 == memcmp(p, BINLOG_MAGIC, BINLOG_MAGIC_LEN)) {
+            p += BINLOG_MAGIC_LEN;
+            while (0 < fmt_num)
+                free(fmts[--fmt_num]);
+            continue;
+        }
+
+        unsigned char kind = *p++;
+        if ((BINLOG_RECORD_FORMAT != kind && BINLOG_RECORD_ARGS != kind)
+            || 0 != get_varint(&p, end, &id) || 0 != get_varint(&p, end, &size)
+            || (unsigned long long)(end - p) < size) {
+            failed = 1;
+            break;
+        }
+
+        if (BINLOG_RECORD_FORMAT == kind) {
+            /* 格式 ID 按首次出现的顺序分配 */
+            if (id != fmt_num) {
+                failed = 1;
+                break;
+            }
+
+            if (fmt_num == fmt_cap) {
+                size_t cap = (0 == fmt_cap) ? 64 : fmt_cap * 2;
+                char **tmp = realloc(fmts, cap * sizeof(char *));
+                if (NULL == tmp) {
+                    failed = 1;
+                    break;
+                }
+                fmts    = tmp;
+                fmt_cap = cap;
+            }
+
+            char *fmt = malloc((size_t)size + 1);
+            if (NULL == fmt) {
+                failed = 1;
+                break;
+            }
+            memcpy(fmt, p, (size_t)size);
+            fmt[size] = '\0';
+            fmts[fmt_num++] = fmt;
+
+            /* 拒绝写入端不会产生的格式字符串 */
+            if ( ! is_capturable_fmt(config, fmt)) {
+                failed = 1;
+                break;
+            }
+
+        } else {
+            if (fmt_num <= id) {
+                failed = 1;
+                break;
+            }
+
+            size_t need = (size_t)size + CAPTURE_ARG_MAX * CAPTURE_COPY_ALIGN;
+            if (copies_size < need) {
+                char *tmp = realloc(copies, need);
+                if (NULL == tmp) {
+                    failed = 1;
+                    break;
+                }
+                copies      = tmp;
+                copies_size = need;
+            }
+
+            struct k_printf_arg argv[CAPTURE_ARG_MAX];
+            size_t argc;
+            if (0 != decode_stream_capture(p, p + size, copies, argv, &argc)
+                || 0 > k_xprintf_argv(config, sink, fmts[id], argv, argc)) {
+                failed = 1;
+                break;
+            }
+            record_num++;
+        }
+
+        p += size;
     }
 
-    *get_s = buf;
-    return str_len;
+    while (0 < fmt_num)
+        free(fmts[--fmt_num]);
+    free(fmts);
+    free(copies);
+
+    return failed ? -1 : record_num;
 }
 
 /* endregion */
@@ -2,9 +2,15 @@
 #define K_PRINTF_H
 
 #include <stdio.h>
+#include <stdarg.h>
 #include <stddef.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 struct k_printf_config;
+struct k_printf_cache;
 
 /**
  * \brief 将格式化字符串写入到标准输出流 `stdout`，并返回格式化后的字符串长度
@@ -51,18 +57,153 @@ struct k_printf_spec;
  */
 typedef void (*k_printf_callback_fn)(struct k_printf_buf *buf, const struct k_printf_spec *spec, va_list *args);
 
+/**
+ * \brief 计算自定义格式说明符输出长度的回调
+ *
+ * 只需要计算格式化后的字符串长度时（见 `k_printf_len`），`k_printf` 会调用它来代替 `k_printf_callback_fn`，
+ * 你可以直接算出输出长度（例如数字位数、字符串长度与填充宽度），而不必真正产生字符。
+ *
+ * 你应与对应的 `k_printf_callback_fn` 消耗完全相同的实参。
+ *
+ * \param spec 提供当前格式说明符的详细信息
+ * \param args 指向不定长参数列表的指针，你应按需消耗列表中的实参
+ * \return 若成功，返回该格式说明符的输出长度；若失败，返回负值。
+ */
+typedef int (*k_printf_measure_fn)(const struct k_printf_spec *spec, va_list *args);
+
+/** \brief 实参数组中实参的类型，见 `k_printf_arg` */
+enum k_printf_arg_type {
+    K_PRINTF_ARG_INT = 1,     /**< 有符号整数，存放在 `value.i` */
+    K_PRINTF_ARG_UINT,        /**< 无符号整数，存放在 `value.u` */
+    K_PRINTF_ARG_DOUBLE,      /**< double，存放在 `value.d` */
+    K_PRINTF_ARG_LONG_DOUBLE, /**< long double，存放在 `value.ld` */
+    K_PRINTF_ARG_STR,         /**< 字符串，存放在 `value.s` */
+    K_PRINTF_ARG_PTR,         /**< 指针，存放在 `value.p`，用于 `%p`、`%ls` 与 `%n` 一族 */
+};
+
+/**
+ * \brief 带类型标记的实参，用于 `k_snprintf_argv` 一族的函数
+ *
+ * 与不定长参数列表不同，实参数组可以被反复使用：保存一次实参，之后可以多次格式化输出，
+ * 无需重新收集实参。整数实参按格式说明符的长度修饰截断，效果与经由不定长参数列表传递相同。
+ */
+struct k_printf_arg {
+    enum k_printf_arg_type type;
+    union {
+        long long i;
+        unsigned long long u;
+        double d;
+        long double ld;
+        const char *s;
+        void *p;
+    } value;
+};
+
+/** \brief 实参数组及其读取位置，传递给 `k_printf_callback_argv_fn` */
+struct k_printf_args {
+    const struct k_printf_arg *argv;
+    size_t argc;
+    size_t index;
+};
+
+/** \brief 读取下一个实参，若实参已用完，返回 NULL */
+static inline const struct k_printf_arg *k_printf_args_next(struct k_printf_args *args) {
+    return args->index < args->argc ? &args->argv[args->index++] : NULL;
+}
+
+/** \brief 构造各类型的实参，例如 `k_printf_arg_int(1)` */
+#define k_printf_arg_int(v)         ((struct k_printf_arg){ K_PRINTF_ARG_INT,         { .i  = (v) } })
+#define k_printf_arg_uint(v)        ((struct k_printf_arg){ K_PRINTF_ARG_UINT,        { .u  = (v) } })
+#define k_printf_arg_double(v)      ((struct k_printf_arg){ K_PRINTF_ARG_DOUBLE,      { .d  = (v) } })
+#define k_printf_arg_long_double(v) ((struct k_printf_arg){ K_PRINTF_ARG_LONG_DOUBLE, { .ld = (v) } })
+#define k_printf_arg_str(v)         ((struct k_printf_arg){ K_PRINTF_ARG_STR,         { .s  = (v) } })
+#define k_printf_arg_ptr(v)         ((struct k_printf_arg){ K_PRINTF_ARG_PTR,         { .p  = (v) } })
+
+/**
+ * \brief 自定义格式说明符的回调函数，实参取自实参数组
+ *
+ * 用于 `k_snprintf_argv` 一族的函数，作用同 `k_printf_callback_fn`。
+ * 你应通过 `k_printf_args_next(args)` 按需读取实参，并检查其类型。
+ * 实参不足或类型不符时，应置 `buf->n` 为 -1。
+ *
+ * \param buf  缓冲区
+ * \param spec 提供当前格式说明符的详细信息
+ * \param args 实参数组，你应按需读取其中的实参
+ */
+typedef void (*k_printf_callback_argv_fn)(struct k_printf_buf *buf, const struct k_printf_spec *spec, struct k_printf_args *args);
+
+struct k_printf_capture;
+
+/**
+ * \brief 延迟格式化时捕获自定义格式说明符实参的回调
+ *
+ * `k_printf_defer` 调用它从不定长参数列表中读取实参，你应消耗与 `k_printf_callback_fn` 相同的实参，
+ * 并通过 `k_printf_capture_arg` 或 `k_printf_capture_copy` 将其保存下来。
+ * 之后在消费者线程中渲染时，这些实参按保存的顺序交给 `k_printf_callback_argv_fn`。
+ *
+ * 实参所指向的内容在渲染时可能已经失效，例如数组，应使用 `k_printf_capture_copy` 保存其副本。
+ *
+ * \param cap  捕获缓冲区
+ * \param spec 提供当前格式说明符的详细信息
+ * \param args 指向不定长参数列表的指针，你应按需消耗列表中的实参
+ * \return 若成功，返回 0；若失败，返回非 0 值。
+ */
+typedef int (*k_printf_capture_fn)(struct k_printf_capture *cap, const struct k_printf_spec *spec, va_list *args);
+
+/**
+ * \brief 保存一个实参，用于 `k_printf_capture_fn`
+ *
+ * \return 若成功，返回 0；若捕获缓冲区空间不足或实参过多（超过 64 个），返回 -1。
+ */
+int k_printf_capture_arg(struct k_printf_capture *cap, const struct k_printf_arg *arg);
+
+/**
+ * \brief 保存 `data` 开始的 `len` 个字节的副本，作为一个实参，用于 `k_printf_capture_fn`
+ *
+ * 渲染时该实参的 `value.s`（`type` 为 `K_PRINTF_ARG_STR`，副本末尾会补上 `'\0'`）
+ * 或 `value.p`（`type` 为 `K_PRINTF_ARG_PTR`）指向副本。
+ *
+ * \return 若成功，返回 0；若捕获缓冲区空间不足或实参过多，返回 -1。
+ */
+int k_printf_capture_copy(struct k_printf_capture *cap, enum k_printf_arg_type type, const void *data, size_t len);
+
 /** \brief 缓冲区接口，对 `char []` 和 `FILE *` 两类缓冲区统一的操作接口 */
 struct k_printf_buf {
 
     /** \brief 往缓冲区中写入指定长度的字符串 */
     void (*fn_puts)(struct k_printf_buf *buf, const char *str, size_t len);
 
+    /**
+     * \brief 往缓冲区中写入指定长度的字符串，该字符串在本次格式化输出结束前始终有效
+     *
+     * 效果与 `fn_puts` 相同，但缓冲区可以只记录 `str` 指针，推迟到输出结束时再读取其内容。
+     * 例如 `k_dprintf` 借此将格式字符串中的字面量文本直接交给 `writev`，不做拷贝。
+     * 若字符串位于你在回调中准备的临时缓冲区中，应使用 `fn_puts`。
+     */
+    void (*fn_puts_ref)(struct k_printf_buf *buf, const char *str, size_t len);
+
     /** \brief 往缓冲区格式化写入格式化字符串（格式说明符同 C `printf`） */
     void (*fn_printf)(struct k_printf_buf *buf, const char *fmt, ...);
 
     /** \brief 往缓冲区格式化写入格式化字符串（格式说明符同 C `printf`） */
     void (*fn_vprintf)(struct k_printf_buf *buf, const char *fmt, va_list args);
 
+    /**
+     * \brief 预留可直接写入的空间
+     *
+     * 返回至少能容纳 `len` 个字符的可写空间，你可以直接在其中写入内容，不必先写入临时缓冲区再拷贝。
+     * 写完后必须调用 `fn_commit` 提交实际写入的字符数量（不超过 `len`），提交之前不要再写入缓冲区。
+     *
+     * 若缓冲区无法直接提供空间（例如 `char []` 剩余空间不足），返回的是临时空间，
+     * 提交时其内容会按 `fn_puts` 的规则写入缓冲区，对你而言没有区别。
+     *
+     * 若出错则返回 NULL，此时不要调用 `fn_commit`。
+     */
+    char *(*fn_reserve)(struct k_printf_buf *buf, size_t len);
+
+    /** \brief 提交 `fn_reserve` 预留的空间中实际写入的 `used` 个字符 */
+    void (*fn_commit)(struct k_printf_buf *buf, size_t used);
+
     /**
      * \brief 到目前为止已经打印出的字符数量（忽略缓冲区实际大小）
      *
@@ -155,6 +296,23 @@ struct k_printf_spec {
     const char *end;
 };
 
+/**
+ * \brief 内存分配统计，见 `k_printf_config->alloc_stats`
+ *
+ * 计数只增不减。对比调用前后的计数，即可得知一次调用分配了多少次内存。
+ */
+struct k_printf_alloc_stats {
+
+    /** \brief 分配（含扩容）的次数 */
+    unsigned long long alloc_num;
+
+    /** \brief 分配（含扩容）的字节数 */
+    unsigned long long alloc_bytes;
+
+    /** \brief 因 `no_alloc` 而被拒绝的分配次数 */
+    unsigned long long refused_num;
+};
+
 /**
  * \brief 自定义格式说明符的配置
  *
@@ -195,9 +353,79 @@ struct k_printf_config {
      *         否则函数应返回 NULL，且不移动字符串指针。
      */
     k_printf_callback_fn (*fn_match_spec)(const char **str);
+
+    /**
+     * \brief 格式字符串缓存，可为 NULL
+     *
+     * 多数调用处传递的格式字符串是字符串字面量，其地址在程序运行期间不变。
+     * 若配置了缓存，`k_printf` 一族的函数会以格式字符串的地址为键，
+     * 缓存其预编译结果（见 `k_printf_compile`），之后再遇到同一地址时不再解析格式字符串。
+     *
+     * 缓存只比较地址，不比较内容。若格式字符串是动态构造的（同一地址上的内容会变化），
+     * 请使用不带缓存的配置，或用 `k_printf_cache_set_enabled` 暂时禁用缓存。
+     *
+     * 在支持 GCC 原子操作内建函数的编译器（GCC、Clang）上，多个线程可以同时使用带有同一缓存的配置。
+     * 被淘汰的预编译结果可能仍在其他线程中使用，因此等到此前开始的调用都结束后，才在之后的某次淘汰中释放。
+     * 在其他编译器上，缓存只能在一个线程中使用。
+     */
+    struct k_printf_cache *cache;
+
+    /**
+     * \brief 匹配字符串开头的格式说明符，若匹配成功则移动字符串指针，并返回对应的配置项，可为 NULL
+     *
+     * 与 `fn_match_spec` 作用相同，但返回整个配置项，`k_printf` 因而能使用配置项中的可选回调，
+     * 例如 `fn_measure`。若提供了本函数，则不再使用 `fn_match_spec`。
+     *
+     * 你可以使用 `k_printf_match_tuple_helper` 或 `k_printf_match_tuple_trie` 完成匹配工作。
+     */
+    const struct k_printf_spec_callback_tuple *(*fn_match_tuple)(const char **str);
+
+    /**
+     * \brief 分配内存的函数，可为 NULL
+     *
+     * 格式化过程中临时使用的堆内存（例如 `fn_reserve` 超过 256 个字符的临时空间、
+     * `k_fprintf` 超过 1023 个字符的输出、超出栈上容量的位置参数格式项），
+     * 以及 `k_asprintf` 返回的字符串，都由这组函数分配与释放。
+     * 此时 `k_asprintf` 返回的字符串也应使用 `fn_free` 释放。
+     * 三个函数要么都提供，要么都为 NULL（使用 C 标准库的 `malloc`、`realloc` 与 `free`）。
+     *
+     * 跨越多次调用的内存（`k_printf_strbuf`、`k_printf_arena` 的块，缓存中的预编译结果，
+     * `k_printf_binlog` 的格式表等）由其所属的对象释放，释放时不经过配置，
+     * 因此仍使用 C 标准库的函数分配，但同样受 `no_alloc` 约束，也计入 `alloc_stats`。
+     */
+    void *(*fn_malloc)(size_t size);
+    void *(*fn_realloc)(void *ptr, size_t size);
+    void  (*fn_free)(void *ptr);
+
+    /**
+     * \brief 内存分配统计，可为 NULL
+     *
+     * 使用此配置的调用每分配一次内存，都会累加其中的计数，便于在测试中断言某次调用分配了多少次内存。
+     * 计数不是线程安全的，在多个线程中共用配置时不应设置本字段。
+     */
+    struct k_printf_alloc_stats *alloc_stats;
+
+    /**
+     * \brief 禁止分配内存
+     *
+     * 若不为 0，使用此配置的调用在任何情况下都不会分配堆内存，适合在实时线程中使用。
+     * 原本需要分配内存的情形改为：
+     *
+     * - 缓存未命中时不编译格式字符串，直接解析（不影响结果）；
+     * - 其余情形视为出错，返回负值：
+     *   `k_asprintf` 总是失败；`k_fprintf` 的输出不能超过 1023 个字符；
+     *   交给 C `printf` 处理的格式说明符，经 `k_xprintf` 输出时不能超过 255 个字符，经 `k_dprintf` 输出时不能超过 1023 个字符；
+     *   `fn_reserve` 申请超过 256 个字符的临时空间时返回 NULL；
+     *   设置了 `auto_pad` 的格式说明符，经 `k_xprintf` 或 `k_dprintf`（右对齐时）输出时不能超过 255 个字符；
+     *   `k_sbprintf` 不能扩容，`k_arena_printf` 只能使用 arena 中已有的块。
+     *
+     * 写入 `char []` 的 `k_snprintf` 一族以及 `k_printf_len` 只在回调通过 `fn_reserve` 申请超过 256 个字符时才会失败，
+     * 内置的格式说明符不会申请这么多。
+     */
+    int no_alloc;
 };
 
-/** \brief 用于定义一对格式说明符与回调，仅用于 `k_printf_match_spec_helper` */
+/** \brief 用于定义一对格式说明符与回调，用于 `k_printf_match_spec_helper` 等匹配函数 */
 struct k_printf_spec_callback_tuple {
 
     /** \brief 格式说明符类型 */
@@ -205,6 +433,36 @@ struct k_printf_spec_callback_tuple {
 
     /** \brief 对应的回调函数 */
     k_printf_callback_fn fn_callback;
+
+    /** \brief 计算输出长度的回调，可为 NULL，仅在通过 `k_printf_config->fn_match_tuple` 匹配时使用 */
+    k_printf_measure_fn fn_measure;
+
+    /**
+     * \brief 实参取自实参数组的回调，可为 NULL，仅在通过 `k_printf_config->fn_match_tuple` 匹配时使用
+     *
+     * 若未提供，`k_snprintf_argv` 一族的函数遇到该格式说明符时视为出错。
+     */
+    k_printf_callback_argv_fn fn_callback_argv;
+
+    /**
+     * \brief 延迟格式化时捕获实参的回调，可为 NULL，仅在通过 `k_printf_config->fn_match_tuple` 匹配时使用
+     *
+     * 若未提供（或未提供 `fn_callback_argv`），`k_printf_defer` 遇到该格式说明符时视为出错。
+     */
+    k_printf_capture_fn fn_capture;
+
+    /**
+     * \brief 非 0 时由 `k_printf` 代为补齐最小宽度，仅在通过 `k_printf_config->fn_match_tuple` 匹配时使用
+     *
+     * `k_printf` 先读取 `*` 指定的最小宽度，再执行回调，最后按 `left_justified` 在回调的输出前或后补上空格。
+     * 回调收到的 `spec` 中 `use_min_width` 为 0，回调无需也无法自己补齐；其余修饰（包括 `zero_padding`）原样传给回调。
+     *
+     * 输出到 `char []` 或堆内存时，右对齐的空格是先补在后面，再把回调的输出原地右移得到的，不需要临时缓冲区。
+     * 截断时与先完整格式化再截断的结果一致。输出到其他地方时，回调的输出先暂存在栈上（过长时改用堆内存）。
+     *
+     * `fn_capture` 收到的仍是原本的 `spec`，若最小宽度由 `*` 指定，它应像往常一样捕获该实参。
+     */
+    int auto_pad;
 };
 
 /**
@@ -224,6 +482,81 @@ struct k_printf_spec_callback_tuple {
  */
 k_printf_callback_fn k_printf_match_spec_helper(const struct k_printf_spec_callback_tuple *tuples, const char **str);
 
+/** \brief 同 `k_printf_match_spec_helper`，但返回匹配到的配置项，用于 `k_printf_config->fn_match_tuple` */
+const struct k_printf_spec_callback_tuple *k_printf_match_tuple_helper(const struct k_printf_spec_callback_tuple *tuples, const char **str);
+
+struct k_printf_spec_trie;
+
+/**
+ * \brief 将一组格式说明符配置项构建成字典树，用于 `k_printf_match_spec_trie`
+ *
+ * `k_printf_match_spec_helper` 每次匹配都要顺序遍历所有配置项，
+ * 若你的格式说明符很多，可以先将这些配置项构建成字典树，再用 `k_printf_match_spec_trie` 匹配。
+ * 字典树的根节点是一张以类型名首字符为下标的跳转表，其余节点的子节点连续存放。
+ *
+ * 传递的 `tuples` 要求同 `k_printf_match_spec_helper`。
+ * 字典树会引用 `tuples` 中的配置项，所以在字典树被销毁前，`tuples` 必须保持有效。
+ * 若有多个配置项的类型名相同，则只有排在最前面的那个生效。
+ *
+ * \param tuples 格式说明符配置项数组，以 `{ NULL, NULL }` 结尾
+ * \return 若成功，返回字典树，不再使用时应调用 `k_printf_spec_trie_destroy` 销毁；若失败，返回 NULL。
+ */
+struct k_printf_spec_trie *k_printf_spec_trie_create(const struct k_printf_spec_callback_tuple *tuples);
+
+/** \brief 销毁字典树，若 `trie` 为 NULL 则什么也不做 */
+void k_printf_spec_trie_destroy(struct k_printf_spec_trie *trie);
+
+/**
+ * \brief 使用字典树匹配格式说明符，若匹配成功则移动字符串指针，并返回对应的回调
+ *
+ * 本函数可以替代 `k_printf_match_spec_helper` 来完成 `k_printf_config->fn_match_spec` 的实现，例如：
+ *
+ * ```C
+ * static struct k_printf_spec_trie *my_trie; // 程序启动时由 k_printf_spec_trie_create 创建
+ *
+ * static k_printf_callback_fn match_my_spec(const char **str) {
+ *     return k_printf_match_spec_trie(my_trie, str);
+ * }
+ * ```
+ *
+ * 与 `k_printf_match_spec_helper` 不同，本函数采用最长匹配：
+ * 假定 `%k` 和 `%kk` 都是你自定义的格式说明符，遇到 `%kk` 时总是匹配到 `%kk`，与配置项的顺序无关。
+ */
+k_printf_callback_fn k_printf_match_spec_trie(const struct k_printf_spec_trie *trie, const char **str);
+
+/** \brief 同 `k_printf_match_spec_trie`，但返回匹配到的配置项，用于 `k_printf_config->fn_match_tuple` */
+const struct k_printf_spec_callback_tuple *k_printf_match_tuple_trie(const struct k_printf_spec_trie *trie, const char **str);
+
+/**
+ * \brief 以最短往返形式输出 double 的回调
+ *
+ * 输出能被 `strtod` 精确还原为原值的最短十进制数字。
+ * 十进制指数在 [-4, 17) 内时使用定点表示，否则使用 `e` 表示，例如 `0.1`、`1e+17`。
+ * 支持宽度及 `-`、`+`、空格、`0` 标志，忽略精度。
+ *
+ * 该回调不会自动启用，需要把它注册为自定义格式说明符，例如：
+ *
+ * ```C
+ * struct k_printf_spec_callback_tuple tuples[] = {
+ *     { "Rg", k_printf_callback_double_shortest },
+ * };
+ * ```
+ *
+ * 之后 `k_printf(&config, "%Rg", 0.1)` 输出 `0.1`。
+ */
+void k_printf_callback_double_shortest(struct k_printf_buf *buf, const struct k_printf_spec *spec, va_list *args);
+
+/**
+ * \brief `k_printf_callback_double_shortest` 的实参数组版本，接受 `K_PRINTF_ARG_DOUBLE` 实参
+ *
+ * ```C
+ * struct k_printf_spec_callback_tuple tuples[] = {
+ *     { "Rg", k_printf_callback_double_shortest, NULL, k_printf_callback_argv_double_shortest },
+ * };
+ * ```
+ */
+void k_printf_callback_argv_double_shortest(struct k_printf_buf *buf, const struct k_printf_spec *spec, struct k_printf_args *args);
+
 /**
  * \defgroup k_printf
  *
@@ -237,11 +570,33 @@ k_printf_callback_fn k_printf_match_spec_helper(const struct k_printf_spec_callb
  * 只有 `n` 处在 int 所能表示的正数范围内时，`k_snprintf` 才会往缓冲区写入内容。
  * 使用 `k_sprintf` 等同于在使用 `k_snprintf` 且指定 `n` 为 INT_MAX。
  *
+ * `k_snprintf_trunc` 与 `k_snprintf` 类似，但缓冲区写满后立即停止格式化，
+ * 不再调用后续的回调，也不再计算完整输出的长度，适合只需要截断结果而不关心返回值的场景。
+ * 若输出被截断，返回 `n`（不小于 `n` 的返回值均表示被截断）；否则返回格式化后的字符串长度。
+ *
+ * `k_printf_len` 只计算格式化后的字符串长度，不产生任何输出。
+ * 整数与 `%s` 的长度直接算出，自定义格式说明符若（通过 `fn_match_tuple` 匹配到的）配置项提供了 `fn_measure` 也是如此，
+ * 其余格式说明符的输出被丢弃。`k_snprintf` 在 `n` 为 0 时等同于 `k_printf_len`。
+ *
+ * `k_fprintf` 先在内存中完成格式化，再调用一次 `fwrite` 写入文件，
+ * 因此同一次调用的输出不会与其他线程的输出交错。若格式化失败，则不写入任何内容。
+ *
+ * `k_dprintf` 绕过 stdio，直接写入文件描述符（仅 POSIX 平台提供）。
+ * 格式字符串中的字面量文本和 `%s` 的实参不会被拷贝，而是作为 `struct iovec` 片段，
+ * 与其余内容一起通过一次 `writev` 写出。
+ *
  * `k_asprintf` 使用 `malloc` 分配缓冲区来存储格式化后的字符串，
- * 通过 `get_s` 返回该字符串指针，由用户负责释放。
+ * 通过 `get_s` 返回该字符串指针，由用户负责释放。格式字符串只会被处理一遍，每个回调也只被调用一次。
+ *
+ * 支持 POSIX 位置参数，例如 `k_printf(&config, "%2$s %1$*3$d", 42, "x", 5)`，便于翻译后的文本调整实参顺序。
+ * 一个格式字符串中的格式说明符要么都使用位置参数（包括 `*m$` 形式的宽度与精度），要么都不使用，
+ * 被引用的序号必须从 1 开始连续，且不超过 64，否则视为出错。
+ * 自定义格式说明符使用位置参数时只占一个序号（无论它消耗多少实参），且其配置项必须提供 `fn_measure`，
+ * `k_printf` 借助它跳过该说明符的实参，从而定位后续的实参。
  *
  * \param config 本次输出使用的配置
  * \param file   将格式化字符串到写入 `FILE *`
+ * \param fd     将格式化字符串到写入文件描述符
  * \param buf    将格式化字符串到写入 `char []`
  * \param n      `char []` 缓冲区的长度
  * \param get_s  返回动态分配的字符串的指针
@@ -253,15 +608,534 @@ k_printf_callback_fn k_printf_match_spec_helper(const struct k_printf_spec_callb
  * @{
  */
 
-int k_fprintf  (const struct k_printf_config *config, FILE *file, const char *fmt, ...);
-int k_vfprintf (const struct k_printf_config *config, FILE *file, const char *fmt, va_list args);
-int k_sprintf  (const struct k_printf_config *config, char *buf, const char *fmt, ...);
-int k_vsprintf (const struct k_printf_config *config, char *buf, const char *fmt, va_list args);
-int k_snprintf (const struct k_printf_config *config, char *buf, size_t n, const char *fmt, ...);
-int k_vsnprintf(const struct k_printf_config *config, char *buf, size_t n, const char *fmt, va_list args);
-int k_asprintf (const struct k_printf_config *config, char **get_s, const char *fmt, ...);
-int k_vasprintf(const struct k_printf_config *config, char **get_s, const char *fmt, va_list args);
+int k_fprintf        (const struct k_printf_config *config, FILE *file, const char *fmt, ...);
+int k_vfprintf       (const struct k_printf_config *config, FILE *file, const char *fmt, va_list args);
+int k_sprintf        (const struct k_printf_config *config, char *buf, const char *fmt, ...);
+int k_vsprintf       (const struct k_printf_config *config, char *buf, const char *fmt, va_list args);
+int k_snprintf       (const struct k_printf_config *config, char *buf, size_t n, const char *fmt, ...);
+int k_vsnprintf      (const struct k_printf_config *config, char *buf, size_t n, const char *fmt, va_list args);
+int k_snprintf_trunc (const struct k_printf_config *config, char *buf, size_t n, const char *fmt, ...);
+int k_vsnprintf_trunc(const struct k_printf_config *config, char *buf, size_t n, const char *fmt, va_list args);
+int k_printf_len     (const struct k_printf_config *config, const char *fmt, ...);
+int k_vprintf_len    (const struct k_printf_config *config, const char *fmt, va_list args);
+int k_asprintf       (const struct k_printf_config *config, char **get_s, const char *fmt, ...);
+int k_vasprintf      (const struct k_printf_config *config, char **get_s, const char *fmt, va_list args);
+
+#if defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__))
+int k_dprintf        (const struct k_printf_config *config, int fd, const char *fmt, ...);
+int k_vdprintf       (const struct k_printf_config *config, int fd, const char *fmt, va_list args);
+#endif
+
+/** @} */
+
+/**
+ * \defgroup k_printf_strbuf
+ *
+ * \brief 可复用的字符串缓冲区
+ *
+ * `k_printf_strbuf` 持有一块用 `malloc` 分配的内存，记录已写入的长度与容量。
+ * `k_sbprintf` 将格式化结果追加到缓冲区末尾，空间不足时按两倍容量扩容。
+ * `k_printf_strbuf_clear` 只清空内容而保留内存，因此反复格式化时扩容的开销会被摊薄，
+ * 容量稳定后不再分配内存。每个线程可以各持有一个（例如 `_Thread_local`）缓冲区反复使用。
+ *
+ * ```C
+ * struct k_printf_strbuf sb = K_PRINTF_STRBUF_INIT;
+ * for (...) {
+ *     k_printf_strbuf_clear(&sb);
+ *     k_sbprintf(&config, &sb, "%d, %s\n", 1, "hello");
+ *     use(sb.data, sb.len);
+ * }
+ * k_printf_strbuf_free(&sb);
+ * ```
+ *
+ * 缓冲区中的字符串总以 '\0' 结尾（尚未分配内存时 `data` 为 NULL），总长度不超过 INT_MAX。
+ * 若 `k_sbprintf` 失败，本次追加的内容被丢弃，缓冲区保持调用前的内容（容量可能已增长）。
+ *
+ * 同一个缓冲区不能被多个线程同时使用。
+ *
+ * @{
+ */
+
+/** \brief 字符串缓冲区，零值（`K_PRINTF_STRBUF_INIT`）即为空缓冲区 */
+struct k_printf_strbuf {
+
+    /** \brief 字符串，以 '\0' 结尾。尚未分配内存时为 NULL */
+    char *data;
+
+    /** \brief 字符串长度（不含 '\0'） */
+    size_t len;
+
+    /** \brief 已分配的内存大小 */
+    size_t capacity;
+};
+
+/** \brief 空缓冲区的初始值 */
+#define K_PRINTF_STRBUF_INIT { NULL, 0, 0 }
+
+/** \brief 初始化为空缓冲区，不分配内存 */
+void k_printf_strbuf_init(struct k_printf_strbuf *sb);
+
+/** \brief 释放缓冲区的内存，之后缓冲区仍可作为空缓冲区使用 */
+void k_printf_strbuf_free(struct k_printf_strbuf *sb);
+
+/** \brief 清空缓冲区的内容，保留已分配的内存 */
+void k_printf_strbuf_clear(struct k_printf_strbuf *sb);
+
+/**
+ * \brief 在缓冲区末尾追加指定长度的字符串
+ *
+ * \return 若成功，返回 0；若失败，返回 -1，缓冲区保持不变。
+ */
+int k_printf_strbuf_append(struct k_printf_strbuf *sb, const char *str, size_t len);
+
+/**
+ * \brief 取出缓冲区中的字符串
+ *
+ * 返回的字符串由用户负责 `free`，缓冲区被重置为空缓冲区。
+ *
+ * \param get_len 返回字符串长度，可以为 NULL
+ * \return 若成功，返回字符串；若失败，返回 NULL，缓冲区保持不变。
+ */
+char *k_printf_strbuf_detach(struct k_printf_strbuf *sb, size_t *get_len);
+
+/**
+ * \brief 将格式化结果追加到缓冲区末尾
+ *
+ * \param config 本次输出使用的配置，若为 NULL 则使用默认配置
+ * \param sb     字符串缓冲区
+ * \param fmt    格式字符串
+ * \return 若成功，返回本次追加的字符串长度；若失败，返回 -1。
+ */
+int k_sbprintf (const struct k_printf_config *config, struct k_printf_strbuf *sb, const char *fmt, ...);
+int k_vsbprintf(const struct k_printf_config *config, struct k_printf_strbuf *sb, const char *fmt, va_list args);
+
+/** @} */
+
+/**
+ * \defgroup k_printf_arena
+ *
+ * \brief 在内存池中格式化
+ *
+ * 若一批字符串的生命周期相同（例如都在处理完一个请求后失效），可以将它们都格式化到同一个 arena 中，
+ * 最后一次性重置或销毁 arena，无需逐个 `free`。
+ *
+ * arena 按块向系统申请内存。`k_arena_printf` 直接在当前块的空闲尾部格式化，
+ * 写完后推进指针，不经过中间缓冲区，也不会为每个字符串单独 `malloc`。
+ * 当前块放不下时，另取一块不小于 `chunk_size`（且足以容纳该字符串）的新块，旧块剩余的空间不再使用。
+ *
+ * `k_printf_arena_reset` 使之前得到的所有字符串失效，但保留已申请的块供之后复用，
+ * 因此每个请求结束后重置 arena，容量稳定后不再分配内存。
+ *
+ * ```C
+ * struct k_printf_arena *arena = k_printf_arena_create(0);
+ * for (...) {
+ *     char *s1 = k_arena_printf(&config, arena, "%d, %s", 1, "hello");
+ *     char *s2 = k_arena_printf(&config, arena, "%d, %s", 2, "world");
+ *     ...
+ *     k_printf_arena_reset(arena);
+ * }
+ * k_printf_arena_destroy(arena);
+ * ```
+ *
+ * 同一个 arena 不能被多个线程同时使用。
+ *
+ * @{
+ */
+
+struct k_printf_arena;
+
+/**
+ * \brief 创建 arena
+ *
+ * \param chunk_size 每次向系统申请的块大小，若为 0 则使用默认值（4096）
+ * \return 若成功，返回 arena；若失败，返回 NULL。
+ */
+struct k_printf_arena *k_printf_arena_create(size_t chunk_size);
+
+/** \brief 销毁 arena，释放其全部内存。若 `arena` 为 NULL，则什么也不做 */
+void k_printf_arena_destroy(struct k_printf_arena *arena);
+
+/** \brief 使 arena 中的所有字符串失效，保留已申请的块供之后复用 */
+void k_printf_arena_reset(struct k_printf_arena *arena);
+
+/**
+ * \brief 将格式化结果写入 arena
+ *
+ * \param config 本次输出使用的配置，若为 NULL 则使用默认配置
+ * \param arena  arena
+ * \param fmt    格式字符串
+ * \return 若成功，返回以 '\0' 结尾的字符串，在 arena 被重置或销毁前有效；若失败，返回 NULL。
+ */
+char *k_arena_printf (const struct k_printf_config *config, struct k_printf_arena *arena, const char *fmt, ...);
+char *k_varena_printf(const struct k_printf_config *config, struct k_printf_arena *arena, const char *fmt, va_list args);
+
+/** @} */
+
+/**
+ * \defgroup k_printf_sink
+ *
+ * \brief 自定义输出目标
+ *
+ * 若想把格式化结果写入自己的目标（共享内存环形缓冲区、套接字缓冲区、压缩流等），
+ * 可以实现一个 `k_printf_sink`，再用 `k_xprintf` 输出，无需先用 `k_asprintf` 生成中间字符串再拷贝。
+ *
+ * 通常将 `k_printf_sink` 作为自定义结构体的第一个成员，在回调中将 `sink` 指针转换回自定义结构体：
+ *
+ * ```C
+ * struct my_sink {
+ *     struct k_printf_sink impl;
+ *     struct my_ring *ring;
+ * };
+ *
+ * static int my_sink_puts(struct k_printf_sink *sink, const char *str, size_t len) {
+ *     struct my_ring *ring = ((struct my_sink *)sink)->ring;
+ *     return my_ring_write(ring, str, len);
+ * }
+ *
+ * struct my_sink sink = { .impl = { .fn_puts = my_sink_puts }, .ring = ring };
+ * k_xprintf(&config, &sink.impl, "%d, %s\n", 1, "hello");
+ * ```
+ *
+ * @{
+ */
+
+/** \brief 自定义输出目标的操作接口 */
+struct k_printf_sink {
+
+    /**
+     * \brief 写入指定长度的字符串，必须提供
+     *
+     * \return 若成功，返回 0；若失败，返回非 0 值，之后 `k_xprintf` 不再写入任何内容。
+     */
+    int (*fn_puts)(struct k_printf_sink *sink, const char *str, size_t len);
+
+    /**
+     * \brief 预留可直接写入的空间，可以为 NULL
+     *
+     * 返回至少能容纳 `len` 个字符的可写空间，写完后 `k_xprintf` 会调用 `fn_commit` 提交实际写入的长度。
+     * 若暂时无法提供，返回 NULL，`k_xprintf` 会改用 `fn_puts`。
+     */
+    char *(*fn_reserve)(struct k_printf_sink *sink, size_t len);
+
+    /** \brief 提交 `fn_reserve` 预留的空间中实际写入的 `used` 个字符，提供了 `fn_reserve` 时必须提供 */
+    void (*fn_commit)(struct k_printf_sink *sink, size_t used);
+
+    /**
+     * \brief 格式化结束时调用，可以为 NULL
+     *
+     * \return 若成功，返回 0；若失败，返回非 0 值。
+     */
+    int (*fn_flush)(struct k_printf_sink *sink);
+
+    /** \brief 错误状态，非 0 表示输出途中出现错误。调用 `k_xprintf` 前应置为 0 */
+    int error;
+
+    /** \brief 累计写入的字符数量，由 `k_xprintf` 维护，多次调用时持续累加 */
+    unsigned long long count;
+};
+
+/**
+ * \brief 将格式化字符串写入自定义输出目标
+ *
+ * \return 若成功，返回本次写入的字符数量；若失败，返回 -1，并置 `sink->error` 为非 0 值。
+ *
+ * 即使本次写入的字符数量超出 int 的表示范围，也能得到正确的计数。
+ * 此时回调中读取到的 `k_printf_buf->n` 停留在 INT_MAX。
+ */
+long long k_xprintf (const struct k_printf_config *config, struct k_printf_sink *sink, const char *fmt, ...);
+long long k_vxprintf(const struct k_printf_config *config, struct k_printf_sink *sink, const char *fmt, va_list args);
+
+/** @} */
+
+/**
+ * \defgroup k_printf_argv
+ *
+ * \brief 以实参数组代替不定长参数列表
+ *
+ * 格式说明符按出现顺序依次取用 `argv` 中的实参，`*` 指定的最小宽度与精度也各占一个整数实参。
+ * 实参数组不会被修改，同一组实参可以反复输出，例如日志记录先保存实参，之后再按需渲染。
+ *
+ * ```C
+ * struct k_printf_arg argv[] = { k_printf_arg_int(1), k_printf_arg_str("hello") };
+ * k_snprintf_argv(&config, buf, sizeof(buf), "%d, %s\n", argv, 2);
+ * ```
+ *
+ * 实参不足、实参类型与格式说明符不符，或自定义格式说明符未提供 `fn_callback_argv` 时，视为出错。
+ * 多余的实参被忽略。格式说明符也可以使用位置参数 `%n$` 与 `*m$`，直接取用 `argv` 中对应序号的实参，
+ * 之后不带序号的格式说明符从该实参之后继续依次取用。`config` 为 NULL 时只支持 C `printf` 的格式说明符。
+ *
+ * @{
+ */
+
+/**
+ * \brief 同 `k_snprintf`，但实参取自实参数组
+ *
+ * \return 若成功，返回格式化后的字符串长度；若失败，返回负值。
+ */
+int k_snprintf_argv(const struct k_printf_config *config, char *buf, size_t n, const char *fmt,
+                    const struct k_printf_arg *argv, size_t argc);
+
+/** \brief 同 `k_xprintf`，但实参取自实参数组 */
+long long k_xprintf_argv(const struct k_printf_config *config, struct k_printf_sink *sink, const char *fmt,
+                         const struct k_printf_arg *argv, size_t argc);
+
+/**
+ * \brief 已拆分好的格式项，用于 `k_snprintf_items` 与 `k_xprintf_items`
+ *
+ * 字面量项的 `spec.type` 为 NULL，文本范围是 `[spec.start, spec.end)`，`%%` 应已替换为一个 `%`。
+ * 格式说明符项的 `spec` 与 `k_printf` 解析时得到的相同，`tuple` 为其配置项；`tuple` 为 NULL 时按 C `printf` 的格式说明符输出。
+ */
+struct k_printf_item {
+    struct k_printf_spec spec;
+    const struct k_printf_spec_callback_tuple *tuple;
+};
+
+/**
+ * \brief 同 `k_snprintf_argv`，但不解析格式字符串，而是依次输出 `items` 中的格式项
+ *
+ * 供格式字符串在编译期已被拆分的场合使用，例如 C++ 接口 `k_printf_cpp::format`。
+ * 格式说明符项的实参按出现顺序取用，自定义格式说明符调用 `tuple->fn_callback_argv`（并按 `auto_pad` 补齐最小宽度），
+ * 不经过 `config` 的匹配与缓存；`config` 只提供内存分配相关的配置，可以为 NULL。
+ */
+int k_snprintf_items(const struct k_printf_config *config, char *buf, size_t n,
+                     const struct k_printf_item *items, size_t item_num,
+                     const struct k_printf_arg *argv, size_t argc);
+
+/** \brief 同 `k_xprintf_argv`，但依次输出 `items` 中的格式项，见 `k_snprintf_items` */
+long long k_xprintf_items(const struct k_printf_config *config, struct k_printf_sink *sink,
+                          const struct k_printf_item *items, size_t item_num,
+                          const struct k_printf_arg *argv, size_t argc);
+
+/** @} */
+
+#if defined(__GNUC__) || defined(__clang__)
+
+/**
+ * \defgroup k_printf_defer
+ *
+ * \brief 延迟格式化
+ *
+ * 对延迟敏感的线程可以不做格式化，只用 `k_printf_defer` 捕获实参，放入无锁队列，
+ * 再由后台线程调用 `k_printf_queue_drain` 取出记录，格式化后写入自定义输出目标：
+ *
+ * ```C
+ * struct k_printf_queue *queue = k_printf_queue_create(1024, 256);
+ *
+ * // 任意线程
+ * k_printf_defer(&config, queue, "user %s, id %d\n", name, id);
+ *
+ * // 后台线程
+ * k_printf_queue_drain(queue, &sink.impl, SIZE_MAX);
+ * ```
+ *
+ * 队列由固定大小的槽位组成，每条记录占用一个槽位，保存 `config`、`fmt` 的指针与实参的紧凑编码。
+ * 整数、浮点数与指针按值保存，`%s` 的字符串被深拷贝（有精度时最多拷贝精度个字符），
+ * 自定义格式说明符通过其配置项的 `fn_capture` 保存实参，渲染时由 `fn_callback_argv` 输出。
+ * 因此 `config` 与 `fmt` 在记录被渲染前必须保持有效，通常它们是全局变量与字符串字面量。
+ * 渲染在消费者线程中进行，若 `config` 配置了缓存，该缓存也会被消费者线程使用。
+ *
+ * 不支持位置参数、`%n` 一族与 `%ls`。
+ *
+ * @{
+ */
+
+struct k_printf_queue;
+
+/**
+ * \brief 创建延迟格式化队列
+ *
+ * \param slot_num  槽位数量，向上取整到 2 的幂
+ * \param slot_size 每个槽位用于保存实参编码的字节数，例如一个 int 占 9 字节，一个字符串占其长度加 10 字节
+ * \return 若成功，返回队列，不再使用时应调用 `k_printf_queue_destroy` 销毁；若失败，返回 NULL。
+ */
+struct k_printf_queue *k_printf_queue_create(size_t slot_num, size_t slot_size);
+
+/** \brief 销毁队列，未渲染的记录被丢弃，若 `queue` 为 NULL 则什么也不做 */
+void k_printf_queue_destroy(struct k_printf_queue *queue);
+
+/**
+ * \brief 捕获实参并放入队列，可以在多个线程中同时调用
+ *
+ * \return 若成功，返回 0；若队列已满、实参编码超出槽位大小，或遇到无法延迟处理的格式说明符，返回 -1。
+ */
+int k_printf_defer (const struct k_printf_config *config, struct k_printf_queue *queue, const char *fmt, ...);
+int k_vprintf_defer(const struct k_printf_config *config, struct k_printf_queue *queue, const char *fmt, va_list args);
+
+/**
+ * \brief 按入队顺序取出最多 `max` 条记录，格式化后写入 `sink`，同一时刻只能有一个线程调用
+ *
+ * 每条记录的输出如同调用一次 `k_xprintf`。
+ *
+ * \return 渲染的记录数量，队列为空时返回 0
+ */
+size_t k_printf_queue_drain(struct k_printf_queue *queue, struct k_printf_sink *sink, size_t max);
+
+/** @} */
+
+#endif
+
+/**
+ * \defgroup k_printf_binlog
+ *
+ * \brief 二进制日志
+ *
+ * `k_printf_binlog` 不做格式化，只把格式 ID 与实参的紧凑编码写入自定义输出目标，
+ * 之后再用 `k_printf_binlog_decode`（或命令行工具 `k_printf_decode`）离线还原为文本：
+ *
+ * ```C
+ * struct k_printf_binlog *log = k_printf_binlog_create(&config, &sink.impl);
+ * k_printf_binlog(log, "user %s, id %d\n", name, id);
+ * k_printf_binlog_destroy(log);
+ *
+ * // 离线解码，使用相同的配置
+ * k_printf_binlog_decode(&config, data, len, &out.impl);
+ * ```
+ *
+ * 每个格式字符串以地址为键分配一个 ID，首次出现时写入一条格式定义记录，之后每条记录只含 ID 与实参。
+ * 整数与指针编码为 varint，浮点数保存原始字节，`%s` 的字符串保存长度与内容（有精度时最多保存精度个字符），
+ * 自定义格式说明符通过其配置项的 `fn_capture` 保存实参，解码时由 `fn_callback_argv` 输出。
+ * 因此 `fmt` 在写入端销毁前必须保持有效且内容不变，通常是字符串字面量。
+ *
+ * 浮点数按本机字节序保存，解码端的字节序与 `long double` 格式须与写入端一致。
+ * `%p` 还原出的是原来的地址值。不支持位置参数、`%n` 一族与 `%ls`。
+ *
+ * 解码时格式字符串与实参都来自数据本身。含有写入端不会产生的格式说明符（上述不支持的写法，
+ * 或配置中缺少 `fn_capture` 与 `fn_callback_argv` 的自定义格式说明符）的格式定义记录视为数据不合法。
+ * 自定义格式说明符的 `fn_callback_argv` 收到的指针实参同样来自数据，除了 `fn_capture` 保存的副本，不应解引用；
+ * 副本的内容同样来自数据，若数据可能损坏或不可信，不应依赖其中记录的长度等信息。
+ *
+ * 多个流首尾相接（例如同一个文件被多次追加写入）仍可以被正确解码。
+ *
+ * @{
+ */
+
+struct k_printf_binlog;
+
+/**
+ * \brief 创建二进制日志的写入端，同一写入端不能在多个线程中同时使用
+ *
+ * \param config 捕获实参时使用的配置，若为 NULL 则只支持 C `printf` 的格式说明符
+ * \param sink   输出目标，在写入端销毁前必须保持有效
+ * \return 若成功，返回写入端，不再使用时应调用 `k_printf_binlog_destroy` 销毁；若失败，返回 NULL。
+ */
+struct k_printf_binlog *k_printf_binlog_create(const struct k_printf_config *config, struct k_printf_sink *sink);
+
+/** \brief 销毁写入端，若 `log` 为 NULL 则什么也不做 */
+void k_printf_binlog_destroy(struct k_printf_binlog *log);
+
+/**
+ * \brief 写入一条二进制日志记录，每次调用结束时调用一次 `sink->fn_flush`
+ *
+ * \return 若成功，返回本次写入的字节数；若失败，返回 -1，输出出错时还会置 `sink->error` 为非 0 值。
+ */
+long long k_printf_binlog (struct k_printf_binlog *log, const char *fmt, ...);
+long long k_vprintf_binlog(struct k_printf_binlog *log, const char *fmt, va_list args);
+
+/**
+ * \brief 将内存中的二进制日志还原为文本，写入 `sink`，每条记录的输出如同调用一次 `k_xprintf`
+ *
+ * \param config 渲染时使用的配置，其中的自定义格式说明符应与写入时一致
+ * \return 若成功，返回解码的记录数量；若数据不合法或输出出错，返回 -1，此前的记录已经输出。
+ */
+long long k_printf_binlog_decode(const struct k_printf_config *config, const void *data, size_t len,
+                                 struct k_printf_sink *sink);
+
+/** @} */
+
+/**
+ * \defgroup k_printf_format
+ *
+ * \brief 预编译的格式字符串
+ *
+ * `k_printf` 每次输出都要扫描一遍格式字符串，提取并匹配其中的每个格式说明符。
+ * 若同一个格式字符串会被反复使用，可以先用 `k_printf_compile` 将其预编译，
+ * 之后再用 `k_printf_exec` 一族的函数输出，这些函数不再解析格式字符串，
+ * 只是依次写入字面量文本，以及调用编译时已匹配好的回调。
+ *
+ * 预编译的结果是不可变的，可以在多个线程中同时使用。
+ * 编译时会拷贝一份格式字符串，之后原格式字符串可以被修改或释放。
+ * 但编译时使用的 `config` 以及其匹配到的回调，在编译结果被释放前必须保持有效。
+ *
+ * 使用预编译格式的输出结果与直接使用 `k_printf` 一族的函数完全一致。
+ *
+ * @{
+ */
+
+struct k_printf_format;
+
+/**
+ * \brief 预编译格式字符串
+ *
+ * \param config 编译时使用的配置，若为 NULL 则使用默认配置
+ * \param fmt    格式字符串
+ * \return 若成功，返回预编译的格式，不再使用时应调用 `k_printf_format_free` 释放；若失败，返回 NULL。
+ */
+struct k_printf_format *k_printf_compile(const struct k_printf_config *config, const char *fmt);
+
+/** \brief 释放预编译的格式，若 `format` 为 NULL 则什么也不做 */
+void k_printf_format_free(struct k_printf_format *format);
+
+/**
+ * \brief 使用预编译的格式输出，用法同 `k_printf` 一族中对应的函数
+ *
+ * `k_printf_exec` 写入到标准输出流 `stdout`。
+ */
+int k_printf_exec       (const struct k_printf_format *format, ...);
+int k_fprintf_compiled  (const struct k_printf_format *format, FILE *file, ...);
+int k_vfprintf_compiled (const struct k_printf_format *format, FILE *file, va_list args);
+int k_snprintf_compiled (const struct k_printf_format *format, char *buf, size_t n, ...);
+int k_vsnprintf_compiled(const struct k_printf_format *format, char *buf, size_t n, va_list args);
+
+/** @} */
+
+/**
+ * \defgroup k_printf_cache
+ *
+ * \brief 格式字符串缓存
+ *
+ * 缓存以格式字符串的地址为键，保存其预编译结果，详见 `k_printf_config->cache`。
+ * 缓存容量有限，是直接映射的：每个地址只对应一个槽位，槽位被其他格式字符串占用时淘汰旧的结果。
+ *
+ * @{
+ */
+
+/** \brief 缓存的统计计数 */
+struct k_printf_cache_stats {
+
+    /** \brief 命中次数 */
+    unsigned long long hits;
+
+    /** \brief 未命中次数 */
+    unsigned long long misses;
+
+    /** \brief 淘汰次数 */
+    unsigned long long evictions;
+};
+
+/**
+ * \brief 创建格式字符串缓存
+ *
+ * \param capacity 缓存容量，会被向上取整为 2 的幂
+ * \return 若成功，返回创建的缓存，不再使用时应调用 `k_printf_cache_destroy` 销毁；若失败，返回 NULL。
+ */
+struct k_printf_cache *k_printf_cache_create(size_t capacity);
+
+/** \brief 销毁缓存，若 `cache` 为 NULL 则什么也不做。不能与使用此缓存的调用同时进行 */
+void k_printf_cache_destroy(struct k_printf_cache *cache);
+
+/** \brief 清空缓存中的所有预编译结果，统计计数保持不变。不能与使用此缓存的调用同时进行 */
+void k_printf_cache_clear(struct k_printf_cache *cache);
+
+/** \brief 启用或禁用缓存，禁用期间 `k_printf` 一族的函数直接解析格式字符串 */
+void k_printf_cache_set_enabled(struct k_printf_cache *cache, int enabled);
+
+/** \brief 获取缓存的统计计数 */
+void k_printf_cache_get_stats(const struct k_printf_cache *cache, struct k_printf_cache_stats *get_stats);
 
 /** @} */
 
+#ifdef __cplusplus
+}
 #endif
+
+#endif
\ No newline at end of file
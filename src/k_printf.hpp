@@ -0,0 +1,656 @@
+#ifndef K_PRINTF_HPP
+#define K_PRINTF_HPP
+
+#if __cplusplus < 202002L
+#error "k_printf.hpp requires C++20"
+#endif
+
+#include <array>
+#include <climits>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "k_printf.h"
+
+/**
+ * \brief `k_printf` 的 C++ 接口
+ *
+ * 全局命名空间中已有函数 `k_printf`，因此 C++ 接口放在命名空间 `k_printf_cpp` 中。
+ *
+ * 格式字符串作为模板实参传入，在编译期被解析：实参数量与格式说明符不符、实参类型与格式说明符不符、
+ * 或格式字符串不合法时，编译失败。实参在编译期确定类型后被转换为 `k_printf_arg`，不经过不定长参数列表。
+ * 格式字符串在编译期被拆分为字面量与格式说明符，运行期经 `k_xprintf_items` 一族的函数逐项输出，不再解析：
+ *
+ * ```C++
+ * using arr = k_printf_cpp::custom<"arr", 2>;
+ *
+ * k_printf_cpp::format<"%s = %arr\n", arr>(&config, &sink, name, data, 5);
+ * ```
+ *
+ * 自定义格式说明符须以 `custom` 声明其名称与消耗的实参数量，并在 `config` 中注册，
+ * 且提供 `fn_callback_argv`。编译期与 `k_printf_match_tuple_helper` 一样，按声明顺序匹配第一个名称相符的格式说明符，
+ * 传入 `spec_table` 时则与 `k_printf_match_tuple_trie` 一样采用最长匹配，`config` 的匹配结果应与之一致。
+ *
+ * 自定义格式说明符全部以 `spec` 或 `spec_table` 声明时，回调在编译期已知，格式项中直接记录其配置项，
+ * 运行期不经过 `config` 的匹配函数，也不查找缓存。只要有一个以 `custom` 声明，就无法在编译期得知其回调，
+ * 此时改为经 `k_xprintf_argv` 一族的函数输出，由 `config` 在运行期解析格式字符串；
+ * 格式字符串的地址在整个程序中唯一，若 `config` 配置了缓存，只在第一次输出时解析。
+ *
+ * 与 C 接口相比，这里的格式字符串更加严格：不支持位置参数，无法识别的格式说明符视为错误，
+ * 字面的 `%` 必须写作 `%%`。
+ */
+namespace k_printf_cpp {
+
+/** \brief 可以作为模板实参的字符串字面量 */
+template <std::size_t N>
+struct fixed_string {
+    char data[N] {};
+
+    consteval fixed_string(const char (&str)[N]) {
+        for (std::size_t i = 0; i < N; i++)
+            data[i] = str[i];
+    }
+
+    constexpr std::string_view view() const {
+        return std::string_view(data, N - 1);
+    }
+};
+
+/**
+ * \brief 声明一个自定义格式说明符
+ *
+ * \tparam Name 格式说明符的名称，例如 `"arr"`
+ * \tparam Argc 它消耗的实参数量。实参按类型转换为 `k_printf_arg`：有符号整数为 `K_PRINTF_ARG_INT`，
+ *              无符号整数为 `K_PRINTF_ARG_UINT`，浮点数为 `K_PRINTF_ARG_DOUBLE` 或 `K_PRINTF_ARG_LONG_DOUBLE`，
+ *              `char *` 与 `std::string` 为 `K_PRINTF_ARG_STR`，其他指针为 `K_PRINTF_ARG_PTR`。
+ */
+template <fixed_string Name, std::size_t Argc>
+struct custom {
+    static_assert(1 < sizeof(Name.data), "k_printf: the name of a format specifier must not be empty");
+
+    static constexpr std::string_view name = Name.view();
+    static constexpr std::size_t argc = Argc;
+};
+
+/**
+ * \brief 声明一个自定义格式说明符及其回调，用于 `spec_table`
+ *
+ * 各回调与 `AutoPad` 的含义见 `k_printf_spec_callback_tuple`，`Argc` 的含义见 `custom`。
+ */
+template <fixed_string Name, k_printf_callback_fn Callback, std::size_t Argc = 0,
+          k_printf_callback_argv_fn CallbackArgv = nullptr, k_printf_measure_fn Measure = nullptr,
+          k_printf_capture_fn Capture = nullptr, bool AutoPad = false>
+struct spec : custom<Name, Argc> {
+    static constexpr k_printf_spec_callback_tuple tuple { Name.data, Callback, Measure, CallbackArgv, Capture, AutoPad };
+};
+
+namespace detail {
+
+struct custom_info {
+    std::string_view name;
+    std::size_t argc;
+    const k_printf_spec_callback_tuple *tuple; /* 以 `spec` 声明时为其配置项，以 `custom` 声明时为 nullptr */
+    bool has_tuple;
+};
+
+inline constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+/* 字典树的节点，同 `k_printf_spec_trie`：每个节点的子节点连续存放，并按边上的字符升序排列 */
+struct trie_node {
+    std::size_t tuple;       /* 以该节点结尾的配置项下标，若没有则为 npos */
+    std::size_t first_child;
+    std::size_t child_num;
+    unsigned char ch;
+};
+
+/* 在编译期将类型名构建成字典树，`M` 为节点数量，即类型名的总长度加 1
+ *
+ * 算法同 `k_printf_spec_trie_create`：将类型名排序后按层次遍历建树，类型名相同时排在前面的生效。
+ */
+template <std::size_t M, std::size_t N>
+consteval std::array<trie_node, M> build_trie(const std::array<custom_info, N> &specs) {
+
+    std::array<std::size_t, N> sorted {};
+    for (std::size_t i = 0; i < N; i++)
+        sorted[i] = i;
+    for (std::size_t i = 1; i < N; i++) {
+        for (std::size_t j = i; 0 < j && specs[sorted[j]].name < specs[sorted[j - 1]].name; j--)
+            std::swap(sorted[j], sorted[j - 1]);
+    }
+
+    std::array<trie_node, M> nodes {};
+    std::array<std::size_t, M> depth_of {};
+    std::array<std::size_t, M> lo_of {};
+
+    /* 展开前，节点的 `child_num` 暂存着它在 `sorted` 中对应的一段的长度 */
+    nodes[0] = trie_node { npos, 0, N, '\0' };
+
+    std::size_t created = 1;
+    for (std::size_t idx = 0; idx < created; idx++) {
+        std::size_t depth = depth_of[idx];
+        std::size_t lo    = lo_of[idx];
+        std::size_t hi    = lo + nodes[idx].child_num;
+
+        auto name = [&](std::size_t k) { return specs[sorted[k]].name; };
+
+        nodes[idx].tuple = (0 != depth && lo < hi && name(lo).size() == depth) ? sorted[lo] : npos;
+        while (lo < hi && name(lo).size() == depth)
+            lo++;
+
+        nodes[idx].first_child = created;
+        nodes[idx].child_num   = 0;
+
+        while (lo < hi) {
+            unsigned char ch = static_cast<unsigned char>(name(lo)[depth]);
+
+            std::size_t end = lo + 1;
+            while (end < hi && static_cast<unsigned char>(name(end)[depth]) == ch)
+                end++;
+
+            nodes[created]    = trie_node { npos, 0, end - lo, ch };
+            depth_of[created] = depth + 1;
+            lo_of[created]    = lo;
+
+            created++;
+            nodes[idx].child_num++;
+            lo = end;
+        }
+    }
+
+    return nodes;
+}
+
+template <std::size_t N>
+consteval std::size_t trie_node_num(const std::array<custom_info, N> &specs) {
+    std::size_t num = 1;
+    for (const custom_info &info : specs)
+        num += info.name.size();
+    return num;
+}
+
+} // namespace detail
+
+/**
+ * \brief 在编译期由一组格式说明符生成的配置
+ *
+ * 与 `k_printf_spec_trie` 相同，格式说明符被构建成字典树，采用最长匹配，类型名相同时排在前面的生效。
+ * 不同的是字典树在编译期构建，匹配函数 `match_tuple` 被展开为逐层的字符比较，不再遍历节点数组：
+ *
+ * ```C++
+ * using my_specs = k_printf_cpp::spec_table<
+ *     k_printf_cpp::spec<"arr", arr_callback, 2, arr_callback_argv>,
+ *     k_printf_cpp::spec<"ip",  ip_callback,  1, ip_callback_argv>>;
+ *
+ * static const k_printf_config config = my_specs::config();
+ *
+ * k_printf(&config, "%arr %ip\n", data, 5, addr);
+ * k_printf_cpp::format<"%arr %ip\n", my_specs>(&config, &sink, data, 5, addr);
+ * ```
+ *
+ * 用于 `format` 时，编译期的解析同样采用最长匹配。
+ */
+template <class... Specs>
+struct spec_table {
+    static_assert(0 < sizeof...(Specs), "k_printf: a spec table needs at least one format specifier");
+
+    static constexpr std::array<detail::custom_info, sizeof...(Specs)> customs {
+        detail::custom_info { Specs::name, Specs::argc, &Specs::tuple, true }...
+    };
+
+    /** \brief 格式说明符配置项数组，以 `{ NULL, NULL }` 结尾，可用于 `k_printf_match_tuple_helper` 等函数 */
+    static constexpr k_printf_spec_callback_tuple tuples[] { Specs::tuple..., { nullptr, nullptr, nullptr, nullptr, nullptr, 0 } };
+
+    static constexpr auto trie = detail::build_trie<detail::trie_node_num(customs)>(customs);
+
+    /** \brief 用于 `k_printf_config->fn_match_tuple` */
+    static const k_printf_spec_callback_tuple *match_tuple(const char **str) {
+        return match_node<0>(*str, str, nullptr, nullptr);
+    }
+
+    /** \brief 用于 `k_printf_config->fn_match_spec` */
+    static k_printf_callback_fn match_spec(const char **str) {
+        const k_printf_spec_callback_tuple *tuple = match_tuple(str);
+        return (nullptr != tuple) ? tuple->fn_callback : nullptr;
+    }
+
+    /** \brief 使用该组格式说明符的配置，其他配置项为空 */
+    static constexpr k_printf_config config() {
+        k_printf_config config {};
+        config.fn_match_tuple = match_tuple;
+        return config;
+    }
+
+private:
+    /* 已匹配到节点 `I`，`s` 指向下一个字符；`matched` 为目前最长的匹配 */
+    template <std::size_t I>
+    static const k_printf_spec_callback_tuple *match_node(const char *s, const char **str,
+                                                          const k_printf_spec_callback_tuple *matched,
+                                                          const char *matched_end) {
+        if constexpr (detail::npos != trie[I].tuple) {
+            matched     = &tuples[trie[I].tuple];
+            matched_end = s;
+        }
+        return match_children<I>(s, str, matched, matched_end, std::make_index_sequence<trie[I].child_num> {});
+    }
+
+    template <std::size_t I, std::size_t... K>
+    static const k_printf_spec_callback_tuple *match_children(const char *s, const char **str,
+                                                              const k_printf_spec_callback_tuple *matched,
+                                                              const char *matched_end, std::index_sequence<K...>) {
+        [[maybe_unused]] const unsigned char ch = static_cast<unsigned char>(*s);
+        const k_printf_spec_callback_tuple *r = nullptr;
+
+        if (((trie[trie[I].first_child + K].ch == ch
+              && (r = match_node<trie[I].first_child + K>(s + 1, str, matched, matched_end), true)) || ...))
+            return r;
+
+        if (nullptr != matched)
+            *str = matched_end;
+        return matched;
+    }
+};
+
+namespace detail {
+
+/* 格式说明符期望的实参种类 */
+enum class arg_kind {
+    integer,       /* 整数，`%d`、`%c` 与 `*` 等 */
+    floating,      /* 浮点数，以 double 输出 */
+    long_floating, /* 浮点数，以 long double 输出 */
+    string,        /* 字符串，`%s` */
+    pointer,       /* 指针，`%p` 与 `%ls` */
+    int_pointer,   /* 指向整数的指针，`%n` 一族 */
+    custom_arg,    /* 自定义格式说明符的实参，按类型转换 */
+};
+
+consteval bool is_digit(char ch) {
+    return '0' <= ch && ch <= '9';
+}
+
+/* 解析 C `printf` 的长度修饰与转换说明符，返回实参种类，不合法时返回 false */
+consteval bool parse_c_std_spec(std::string_view fmt, std::size_t &i, arg_kind &kind) {
+
+    std::string_view length;
+    for (std::string_view mod : { "hh", "ll", "h", "l", "j", "z", "t", "L" }) {
+        if (fmt.substr(i).starts_with(mod)) {
+            length = mod;
+            break;
+        }
+    }
+    i += length.size();
+    if (fmt.size() <= i)
+        return false;
+
+    const char conv = fmt[i++];
+    const std::string_view ints = "diouxX";
+    const std::string_view floats = "eEfFgGaA";
+
+    if (std::string_view::npos != ints.find(conv)) {
+        kind = arg_kind::integer;
+        return "L" != length;
+    }
+    if ('n' == conv) {
+        kind = arg_kind::int_pointer;
+        return "L" != length;
+    }
+    if (std::string_view::npos != floats.find(conv)) {
+        kind = ("L" == length) ? arg_kind::long_floating : arg_kind::floating;
+        return length.empty() || "l" == length || "L" == length;
+    }
+    if ('c' == conv) {
+        kind = arg_kind::integer;
+        return length.empty() || "l" == length;
+    }
+    if ('s' == conv) {
+        kind = ("l" == length) ? arg_kind::pointer : arg_kind::string;
+        return length.empty() || "l" == length;
+    }
+    if ('p' == conv) {
+        kind = arg_kind::pointer;
+        return length.empty();
+    }
+    return false;
+}
+
+/* 解析十进制整数，超出 int 的部分截断为 INT_MAX，同 `extract_non_negative_int` */
+consteval int parse_int(std::string_view fmt, std::size_t &i) {
+    long long v = 0;
+    while (i < fmt.size() && is_digit(fmt[i])) {
+        v = v * 10 + (fmt[i++] - '0');
+        if (INT_MAX < v)
+            v = INT_MAX;
+    }
+    return static_cast<int>(v);
+}
+
+/* 解析格式字符串，依次写入每个实参的种类（`kinds` 可以为 nullptr），返回实参数量，不合法时返回 npos
+ *
+ * 自定义格式说明符默认按顺序取第一个匹配，`longest` 为 true 时取最长匹配。
+ * 若给出 `items`，还依次写入拆分出的格式项，其中的指针指向 `base`，即格式字符串在程序中的存储位置；
+ * 格式项的数量通过 `get_item_num`（可以为 nullptr）返回。
+ */
+consteval std::size_t parse_format(std::string_view fmt, const custom_info *customs, std::size_t custom_num,
+                                   bool longest, arg_kind *kinds, const char *base = nullptr,
+                                   k_printf_item *items = nullptr, std::size_t *get_item_num = nullptr) {
+
+    std::size_t argc = 0;
+    auto push = [&](arg_kind kind) {
+        if (nullptr != kinds)
+            kinds[argc] = kind;
+        argc++;
+    };
+
+    std::size_t item_num = 0;
+    auto push_item = [&](const k_printf_spec &spec, const k_printf_spec_callback_tuple *tuple) {
+        if (nullptr != items)
+            items[item_num] = k_printf_item { spec, tuple };
+        item_num++;
+    };
+
+    /* 字面量文本 `[literal, i)`，遇到格式说明符或 `%%` 时输出 */
+    std::size_t literal = 0;
+    auto push_literal = [&](std::size_t end) {
+        if (literal == end)
+            return;
+        k_printf_spec spec {};
+        if (nullptr != items) {
+            spec.start = base + literal;
+            spec.end   = base + end;
+        }
+        push_item(spec, nullptr);
+    };
+
+    std::size_t i = 0;
+    while (i < fmt.size()) {
+        if ('%' != fmt[i]) {
+            i++;
+            continue;
+        }
+
+        push_literal(i);
+        const std::size_t start = i++;
+
+        /* `%%` 输出第二个 `%`，它成为下一段字面量的开头 */
+        if (i < fmt.size() && '%' == fmt[i]) {
+            literal = i++;
+            continue;
+        }
+
+        /* 位置参数 `%n$` 与 `*m$` 不受支持 */
+        std::size_t j = i;
+        while (j < fmt.size() && is_digit(fmt[j]))
+            j++;
+        if (j < fmt.size() && '$' == fmt[j])
+            return npos;
+
+        k_printf_spec spec {};
+        spec.min_width = -1;
+        spec.precision = -1;
+
+        for (; i < fmt.size(); i++) {
+            if      ('-' == fmt[i]) spec.left_justified   = 1;
+            else if ('+' == fmt[i]) spec.sign_prepended   = 1;
+            else if (' ' == fmt[i]) spec.space_padded     = 1;
+            else if ('0' == fmt[i]) spec.zero_padding     = 1;
+            else if ('#' == fmt[i]) spec.alternative_form = 1;
+            else break;
+        }
+
+        if (i < fmt.size() && '*' == fmt[i]) {
+            i++;
+            spec.use_min_width = 1;
+            push(arg_kind::integer);
+        } else if (i < fmt.size() && is_digit(fmt[i])) {
+            spec.use_min_width = 1;
+            spec.min_width     = parse_int(fmt, i);
+        }
+
+        if (i < fmt.size() && '.' == fmt[i]) {
+            i++;
+            spec.use_precision = 1;
+            if (i < fmt.size() && '*' == fmt[i]) {
+                i++;
+                push(arg_kind::integer);
+            } else {
+                spec.precision = parse_int(fmt, i);
+            }
+        }
+
+        if (i < fmt.size() && '$' == fmt[i])
+            return npos;
+
+        const std::size_t type = i;
+
+        /* 与 `k_printf` 相同，先匹配自定义格式说明符 */
+        std::size_t matched = npos;
+        for (std::size_t k = 0; k < custom_num; k++) {
+            if ( ! fmt.substr(i).starts_with(customs[k].name))
+                continue;
+            if (npos == matched || (longest && customs[matched].name.size() < customs[k].name.size()))
+                matched = k;
+            if ( ! longest)
+                break;
+        }
+
+        if (npos != matched) {
+            i += customs[matched].name.size();
+            for (std::size_t k = 0; k < customs[matched].argc; k++)
+                push(arg_kind::custom_arg);
+        } else {
+            arg_kind kind = arg_kind::integer;
+            if ( ! parse_c_std_spec(fmt, i, kind))
+                return npos;
+            push(kind);
+        }
+
+        if (nullptr != items) {
+            spec.start = base + start;
+            spec.type  = base + type;
+            spec.end   = base + i;
+        }
+        push_item(spec, (npos != matched) ? customs[matched].tuple : nullptr);
+        literal = i;
+    }
+
+    push_literal(fmt.size());
+
+    if (nullptr != get_item_num)
+        *get_item_num = item_num;
+    return argc;
+}
+
+/* `format` 的 `Customs` 中每一项所声明的自定义格式说明符 */
+template <class T>
+consteval custom_info custom_info_of() {
+    if constexpr (requires { T::tuple; })
+        return custom_info { T::name, T::argc, &T::tuple, true };
+    else
+        return custom_info { T::name, T::argc, nullptr, false };
+}
+
+template <class T>
+struct custom_list {
+    static constexpr std::array<custom_info, 1> customs { custom_info_of<T>() };
+    static constexpr bool longest = false;
+};
+
+template <class... Specs>
+struct custom_list<spec_table<Specs...>> {
+    static constexpr std::array<custom_info, sizeof...(Specs)> customs = spec_table<Specs...>::customs;
+    static constexpr bool longest = true;
+};
+
+template <class... Customs>
+consteval auto join_customs() {
+    std::array<custom_info, (custom_list<Customs>::customs.size() + ... + 0)> customs {};
+    [[maybe_unused]] std::size_t i = 0;
+    ((void)[&] {
+        for (const custom_info &info : custom_list<Customs>::customs)
+            customs[i++] = info;
+    }(), ...);
+    return customs;
+}
+
+/* 格式字符串在编译期的解析结果，`Customs` 中有 `spec_table` 时采用最长匹配 */
+template <fixed_string Fmt, class... Customs>
+struct format_info {
+    static constexpr auto customs = join_customs<Customs...>();
+    static constexpr bool longest = (custom_list<Customs>::longest || ... || false);
+
+    static constexpr std::size_t parsed = parse_format(Fmt.view(), customs.data(), customs.size(), longest, nullptr);
+    static constexpr bool ok = npos != parsed;
+    static constexpr std::size_t argc = ok ? parsed : 0;
+
+    static constexpr std::array<arg_kind, argc> kinds = []() consteval {
+        std::array<arg_kind, argc> kinds {};
+        if constexpr (0 < argc)
+            parse_format(Fmt.view(), customs.data(), customs.size(), longest, kinds.data());
+        return kinds;
+    }();
+
+    /* 所有自定义格式说明符都以 `spec` 声明时，回调在编译期已知，运行期直接输出拆分好的格式项 */
+    static constexpr bool static_dispatch = []() consteval {
+        for (const custom_info &info : customs) {
+            if ( ! info.has_tuple)
+                return false;
+        }
+        return true;
+    }();
+
+    static constexpr std::size_t item_num = []() consteval {
+        std::size_t item_num = 0;
+        parse_format(Fmt.view(), customs.data(), customs.size(), longest, nullptr, nullptr, nullptr, &item_num);
+        return item_num;
+    }();
+
+    static constexpr std::array<k_printf_item, ok ? item_num : 0> items = []() consteval {
+        std::array<k_printf_item, ok ? item_num : 0> items {};
+        if constexpr (ok && 0 < item_num)
+            parse_format(Fmt.view(), customs.data(), customs.size(), longest, nullptr, Fmt.data, items.data());
+        return items;
+    }();
+};
+
+template <class T>
+inline constexpr bool is_string_v = std::is_same_v<T, const char *> || std::is_same_v<T, char *>
+                                 || std::is_same_v<T, std::string>;
+
+template <class T>
+inline constexpr bool is_pointer_v = std::is_same_v<T, std::nullptr_t>
+                                  || (std::is_pointer_v<T> && ! std::is_function_v<std::remove_pointer_t<T>>);
+
+template <arg_kind Kind, class T>
+inline constexpr bool accepts_v =
+    (arg_kind::integer == Kind)       ? std::is_integral_v<T> :
+    (arg_kind::floating == Kind)      ? std::is_floating_point_v<T> :
+    (arg_kind::long_floating == Kind) ? std::is_floating_point_v<T> :
+    (arg_kind::string == Kind)        ? is_string_v<T> || std::is_same_v<T, std::nullptr_t> :
+    (arg_kind::pointer == Kind)       ? is_pointer_v<T> :
+    (arg_kind::int_pointer == Kind)   ? std::is_pointer_v<T> && std::is_integral_v<std::remove_pointer_t<T>>
+                                        && ! std::is_const_v<std::remove_pointer_t<T>> :
+    std::is_arithmetic_v<T> || is_string_v<T> || is_pointer_v<T>;
+
+/* 按实参种类与类型，将实参转换为 `k_printf_arg` */
+template <arg_kind Kind, class T>
+void make_arg(k_printf_arg &arg, const T &v) {
+    static_assert(accepts_v<Kind, T>, "k_printf: argument type does not match its format specifier");
+
+    if constexpr (std::is_integral_v<T>) {
+        if constexpr (std::is_signed_v<T>) {
+            arg.type    = K_PRINTF_ARG_INT;
+            arg.value.i = static_cast<long long>(v);
+        } else {
+            arg.type    = K_PRINTF_ARG_UINT;
+            arg.value.u = static_cast<unsigned long long>(v);
+        }
+    } else if constexpr (std::is_floating_point_v<T>) {
+        if constexpr (arg_kind::long_floating == Kind
+                      || (arg_kind::custom_arg == Kind && std::is_same_v<T, long double>)) {
+            arg.type     = K_PRINTF_ARG_LONG_DOUBLE;
+            arg.value.ld = static_cast<long double>(v);
+        } else {
+            arg.type    = K_PRINTF_ARG_DOUBLE;
+            arg.value.d = static_cast<double>(v);
+        }
+    } else if constexpr (std::is_same_v<T, std::string>) {
+        arg.type    = K_PRINTF_ARG_STR;
+        arg.value.s = v.c_str();
+    } else if constexpr (arg_kind::string == Kind || (arg_kind::custom_arg == Kind && is_string_v<T>)) {
+        arg.type    = K_PRINTF_ARG_STR;
+        arg.value.s = v;
+    } else if constexpr (std::is_same_v<T, std::nullptr_t>) {
+        arg.type    = K_PRINTF_ARG_PTR;
+        arg.value.p = nullptr;
+    } else {
+        arg.type    = K_PRINTF_ARG_PTR;
+        arg.value.p = const_cast<void *>(static_cast<const volatile void *>(v));
+    }
+}
+
+template <class Info, std::size_t... I, class... Args>
+void make_args(k_printf_arg *argv, std::index_sequence<I...>, const Args &...args) {
+    (make_arg<Info::kinds[I], std::decay_t<const Args &>>(argv[I], args), ...);
+}
+
+template <class Info, class... Args>
+consteval bool check_args() {
+    static_assert(Info::ok, "k_printf: invalid format string");
+    static_assert( ! Info::ok || Info::argc == sizeof...(Args), "k_printf: argument count does not match the format string");
+    return true;
+}
+
+} // namespace detail
+
+/**
+ * \brief 将格式化字符串写入自定义输出目标，同 `k_xprintf`
+ *
+ * \tparam Fmt     格式字符串
+ * \tparam Customs 格式字符串中用到的自定义格式说明符，见 `custom`、`spec` 与 `spec_table`
+ * \param config   本次输出使用的配置，若为 NULL 则只支持 C `printf` 的格式说明符
+ * \return 若成功，返回本次写入的字符数量；若失败，返回 -1，并置 `sink->error` 为非 0 值。
+ */
+template <fixed_string Fmt, class... Customs, class... Args>
+long long format(const k_printf_config *config, k_printf_sink *sink, const Args &...args) {
+    using info = detail::format_info<Fmt, Customs...>;
+    static_assert(detail::check_args<info, Args...>());
+
+    if constexpr (info::ok && info::argc == sizeof...(Args)) {
+        k_printf_arg argv[sizeof...(Args) + 1];
+        detail::make_args<info>(argv, std::index_sequence_for<Args...> {}, args...);
+        if constexpr (info::static_dispatch)
+            return k_xprintf_items(config, sink, info::items.data(), info::items.size(), argv, sizeof...(Args));
+        else
+            return k_xprintf_argv(config, sink, Fmt.data, argv, sizeof...(Args));
+    } else {
+        return -1;
+    }
+}
+
+/**
+ * \brief 将格式化字符串写入 `buf`，同 `k_snprintf`
+ *
+ * \return 若成功，返回格式化后的字符串长度；若失败，返回负值。
+ */
+template <fixed_string Fmt, class... Customs, class... Args>
+int format_to(const k_printf_config *config, char *buf, std::size_t n, const Args &...args) {
+    using info = detail::format_info<Fmt, Customs...>;
+    static_assert(detail::check_args<info, Args...>());
+
+    if constexpr (info::ok && info::argc == sizeof...(Args)) {
+        k_printf_arg argv[sizeof...(Args) + 1];
+        detail::make_args<info>(argv, std::index_sequence_for<Args...> {}, args...);
+        if constexpr (info::static_dispatch)
+            return k_snprintf_items(config, buf, n, info::items.data(), info::items.size(), argv, sizeof...(Args));
+        else
+            return k_snprintf_argv(config, buf, n, Fmt.data, argv, sizeof...(Args));
+    } else {
+        return -1;
+    }
+}
+
+} // namespace k_printf_cpp
+
+#endif
@@ -0,0 +1,352 @@
+#if defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__))
+#define _POSIX_C_SOURCE 200809L /* fileno */
+#define HAVE_DPRINTF 1
+#endif
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "k_printf.h"
+
+/* 检查 `auto_pad` 格式说明符在各种输出目标与截断长度下的输出
+ *
+ * 自定义格式说明符的输出与等价的 C `printf` 格式说明符对比：
+ * `%k` 分两次调用 `fn_puts` 输出字符串，对应 `%s`；
+ * `%K` 通过 `fn_printf` 输出整数，对应 `%d`；
+ * `%r` 通过 `fn_reserve` 输出字符串，对应 `%s`。
+ * 对每个格式字符串，以 0 到完整长度之后若干字节的每个缓冲区长度调用 `k_snprintf` 与 `k_snprintf_trunc`，
+ * 比较写入的字节与返回值，并检查缓冲区之后的字节不被改动；再经 `k_xprintf` 与 `k_dprintf` 输出，
+ * 覆盖超过 256 个字符时的暂存路径。
+ */
+
+static void callback_k(struct k_printf_buf *buf, const struct k_printf_spec *spec, va_list *args) {
+    (void)spec;
+    const char *str = va_arg(*args, const char *);
+    size_t len = strlen(str);
+    buf->fn_puts(buf, str, len / 2);
+    buf->fn_puts(buf, str + len / 2, len - len / 2);
+}
+
+static int measure_k(const struct k_printf_spec *spec, va_list *args) {
+    (void)spec;
+    return (int)strlen(va_arg(*args, const char *));
+}
+
+static void callback_argv_k(struct k_printf_buf *buf, const struct k_printf_spec *spec, struct k_printf_args *args) {
+    (void)spec;
+    const struct k_printf_arg *arg = k_printf_args_next(args);
+    if (NULL == arg || K_PRINTF_ARG_STR != arg->type) {
+        buf->n = -1;
+        return;
+    }
+    buf->fn_puts(buf, arg->value.s, strlen(arg->value.s));
+}
+
+static void callback_K(struct k_printf_buf *buf, const struct k_printf_spec *spec, va_list *args) {
+    (void)spec;
+    buf->fn_printf(buf, "%d", va_arg(*args, int));
+}
+
+static void callback_r(struct k_printf_buf *buf, const struct k_printf_spec *spec, va_list *args) {
+    (void)spec;
+    const char *str = va_arg(*args, const char *);
+    size_t len = strlen(str);
+    char *dst = buf->fn_reserve(buf, len);
+    if (NULL == dst)
+        return;
+    memcpy(dst, str, len);
+    buf->fn_commit(buf, len);
+}
+
+static const struct k_printf_spec_callback_tuple tuples[] = {
+    { "k", callback_k, measure_k, callback_argv_k, NULL, 1 },
+    { "K", callback_K, NULL,      NULL,            NULL, 1 },
+    { "r", callback_r, NULL,      NULL,            NULL, 1 },
+    { NULL, NULL, NULL, NULL, NULL, 0 },
+};
+
+static const struct k_printf_spec_callback_tuple *match_tuple(const char **str) {
+    return k_printf_match_tuple_helper(tuples, str);
+}
+
+static struct k_printf_config config;
+
+static int check_num;
+static int fail_num;
+
+#define EXPECT_MAX 4096
+
+static void fail(const char *kfmt, const char *what, size_t n, const char *expect, long long expect_len,
+                 const char *actual, long long actual_len) {
+    if (++fail_num <= 50)
+        printf("FAIL \"%s\" %s n=%zu: expect %lld [%.80s], got %lld [%.80s]\n",
+               kfmt, what, n, expect_len, expect, actual_len, actual);
+}
+
+/* region [str_buf] */
+
+static void check_snprintf(const char *kfmt, const char *expect, int expect_len, va_list args) {
+
+    char actual[EXPECT_MAX + 16];
+    char truncated[EXPECT_MAX + 16];
+    size_t n_max = (size_t)expect_len + 3;
+
+    for (size_t n = 0; n <= n_max; n++) {
+        size_t keep = (n < (size_t)expect_len + 1) ? (n ? n - 1 : 0) : (size_t)expect_len;
+        memcpy(truncated, expect, keep);
+        truncated[keep] = '\0';
+
+        va_list args_copy;
+        memset(actual, '#', sizeof(actual));
+        va_copy(args_copy, args);
+        int len = k_vsnprintf(&config, (0 == n) ? NULL : actual, n, kfmt, args_copy);
+        va_end(args_copy);
+
+        check_num++;
+        if (len != expect_len || (0 != n && 0 != memcmp(actual, truncated, keep + 1)) ||
+            '#' != actual[(0 == n) ? 0 : n])
+            fail(kfmt, "k_snprintf", n, truncated, expect_len, actual, len);
+
+        if (0 == n)
+            continue;
+
+        memset(actual, '#', sizeof(actual));
+        va_copy(args_copy, args);
+        len = k_vsnprintf_trunc(&config, actual, n, kfmt, args_copy);
+        va_end(args_copy);
+
+        /* 被截断时返回值不小于 `n`，否则为完整长度 */
+        int len_ok = ((size_t)expect_len < n) ? (len == expect_len) : ((size_t)len >= n);
+        check_num++;
+        if ( ! len_ok || 0 != memcmp(actual, truncated, keep + 1) || '#' != actual[n])
+            fail(kfmt, "k_snprintf_trunc", n, truncated, expect_len, actual, len);
+    }
+}
+
+/* endregion */
+
+/* region [sink] */
+
+struct test_sink {
+    struct k_printf_sink impl;
+    char   data[EXPECT_MAX];
+    size_t len;
+    char   reserved[64];
+};
+
+static int test_sink_puts(struct k_printf_sink *sink, const char *str, size_t len) {
+    struct test_sink *s = (struct test_sink *)sink;
+    if (len > sizeof(s->data) - 1 - s->len)
+        return -1;
+    memcpy(s->data + s->len, str, len);
+    s->len += len;
+    s->data[s->len] = '\0';
+    return 0;
+}
+
+static char *test_sink_reserve(struct k_printf_sink *sink, size_t len) {
+    struct test_sink *s = (struct test_sink *)sink;
+    return (len <= sizeof(s->reserved)) ? s->reserved : NULL;
+}
+
+static void test_sink_commit(struct k_printf_sink *sink, size_t used) {
+    struct test_sink *s = (struct test_sink *)sink;
+    test_sink_puts(sink, s->reserved, used);
+}
+
+static void check_xprintf(const char *kfmt, const char *expect, int expect_len, int use_reserve, va_list args) {
+
+    static struct test_sink sink;
+    memset(&sink, 0, sizeof(sink));
+    sink.impl.fn_puts = test_sink_puts;
+    if (use_reserve) {
+        sink.impl.fn_reserve = test_sink_reserve;
+        sink.impl.fn_commit  = test_sink_commit;
+    }
+
+    va_list args_copy;
+    va_copy(args_copy, args);
+    long long len = k_vxprintf(&config, &sink.impl, kfmt, args_copy);
+    va_end(args_copy);
+
+    check_num++;
+    if (len != expect_len || 0 != strcmp(sink.data, expect))
+        fail(kfmt, use_reserve ? "k_xprintf (reserve)" : "k_xprintf", 0, expect, expect_len, sink.data, len);
+}
+
+/* endregion */
+
+/* region [fd] */
+
+#ifdef HAVE_DPRINTF
+static void check_dprintf(const char *kfmt, const char *expect, int expect_len, va_list args) {
+
+    FILE *file = tmpfile();
+    if (NULL == file) {
+        fail(kfmt, "tmpfile", 0, "", 0, "", 0);
+        return;
+    }
+
+    va_list args_copy;
+    va_copy(args_copy, args);
+    int len = k_vdprintf(&config, fileno(file), kfmt, args_copy);
+    va_end(args_copy);
+
+    static char actual[EXPECT_MAX];
+    rewind(file);
+    size_t read_len = fread(actual, 1, sizeof(actual) - 1, file);
+    actual[read_len] = '\0';
+    fclose(file);
+
+    check_num++;
+    if (len != expect_len || 0 != strcmp(actual, expect))
+        fail(kfmt, "k_dprintf", 0, expect, expect_len, actual, len);
+}
+#endif
+
+/* endregion */
+
+/* `kfmt` 使用自定义格式说明符，`cfmt` 是与之等价的 C `printf` 格式字符串，两者取用相同的实参 */
+static void check(const char *kfmt, const char *cfmt, ...) {
+
+    va_list args;
+    va_list args_copy;
+    va_start(args, cfmt);
+
+    static char expect[EXPECT_MAX];
+    va_copy(args_copy, args);
+    int expect_len = vsnprintf(expect, sizeof(expect), cfmt, args_copy);
+    va_end(args_copy);
+
+    if (expect_len < 0 || expect_len >= EXPECT_MAX) {
+        fail(kfmt, "vsnprintf", 0, "", 0, "", expect_len);
+        va_end(args);
+        return;
+    }
+
+    check_snprintf(kfmt, expect, expect_len, args);
+
+    va_copy(args_copy, args);
+    int len = k_vprintf_len(&config, kfmt, args_copy);
+    va_end(args_copy);
+    check_num++;
+    if (len != expect_len)
+        fail(kfmt, "k_printf_len", 0, expect, expect_len, "", len);
+
+    check_xprintf(kfmt, expect, expect_len, 0, args);
+    check_xprintf(kfmt, expect, expect_len, 1, args);
+#ifdef HAVE_DPRINTF
+    check_dprintf(kfmt, expect, expect_len, args);
+#endif
+
+    va_end(args);
+}
+
+static void check_argv(const char *kfmt, const char *expect, const struct k_printf_arg *argv, size_t argc) {
+
+    char actual[64];
+    int expect_len = (int)strlen(expect);
+
+    for (size_t n = 0; n <= (size_t)expect_len + 1; n++) {
+        memset(actual, '#', sizeof(actual));
+        int len = k_snprintf_argv(&config, (0 == n) ? NULL : actual, n, kfmt, argv, argc);
+
+        size_t keep = (n <= (size_t)expect_len) ? (n ? n - 1 : 0) : (size_t)expect_len;
+        check_num++;
+        if (len != expect_len || (0 != n && (0 != strncmp(actual, expect, keep) || '\0' != actual[keep])))
+            fail(kfmt, "k_snprintf_argv", n, expect, expect_len, actual, len);
+    }
+}
+
+/* `no_alloc` 时暂存区只有栈上的 256 个字符：回调的输出放得下时照常补齐，放不下时经 `k_xprintf` 与右对齐的 `k_dprintf` 输出视为出错 */
+static void check_no_alloc(const char *long_str) {
+
+    struct k_printf_config no_alloc_config = config;
+    no_alloc_config.no_alloc = 1;
+
+    static struct test_sink sink;
+    memset(&sink, 0, sizeof(sink));
+    sink.impl.fn_puts = test_sink_puts;
+
+    long long len = k_xprintf(&no_alloc_config, &sink.impl, "%400r|%-300K", "short", 7);
+    check_num++;
+    if (701 != len || 0 != strncmp(sink.data + 395, "short|7 ", 8))
+        fail("%400r|%-300K", "k_xprintf (no_alloc)", 0, "", 701, sink.data, len);
+
+    memset(&sink, 0, sizeof(sink));
+    sink.impl.fn_puts = test_sink_puts;
+    len = k_xprintf(&no_alloc_config, &sink.impl, "%-301k", long_str);
+    check_num++;
+    if (-1 != len)
+        fail("%-301k", "k_xprintf (no_alloc)", 0, "", -1, sink.data, len);
+
+    char out[400];
+    int n = k_snprintf(&no_alloc_config, out, sizeof(out), "%301k", long_str);
+    check_num++;
+    if (301 != n || ' ' != out[0] || 0 != strcmp(out + 1, long_str))
+        fail("%301k", "k_snprintf (no_alloc)", 0, "", 301, out, n);
+
+#ifdef HAVE_DPRINTF
+    FILE *file = tmpfile();
+    if (NULL == file) {
+        fail("%301k", "tmpfile", 0, "", 0, "", 0);
+        return;
+    }
+    n = k_dprintf(&no_alloc_config, fileno(file), "%301k", long_str);
+    check_num++;
+    if (-1 != n)
+        fail("%301k", "k_dprintf (no_alloc)", 0, "", -1, "", n);
+    n = k_dprintf(&no_alloc_config, fileno(file), "%-301k", long_str);
+    check_num++;
+    if (301 != n)
+        fail("%-301k", "k_dprintf (no_alloc)", 0, "", 301, "", n);
+    fclose(file);
+#endif
+}
+
+int main(void) {
+
+    config.fn_match_tuple = match_tuple;
+
+    static char long_str[3001];
+    memset(long_str, 'z', sizeof(long_str) - 1);
+
+    /* 静态宽度，右对齐与左对齐 */
+    check("[%k]", "[%s]", "hello");
+    check("[%10k]", "[%10s]", "hello");
+    check("[%-10k]", "[%-10s]", "hello");
+    check("[%3k]", "[%3s]", "too long");
+    check("a%12Kb%-9Kc", "a%12db%-9dc", 42, -7);
+    check("x%20ry%-20rz", "x%20sy%-20sz", "reserve", "reserve");
+    check("%5k%5k%-5k", "%5s%5s%-5s", "a", "bb", "ccc");
+
+    /* `*` 宽度，负值表示左对齐 */
+    check("[%*k|%-*k]", "[%*s|%-*s]", 8, "ab", 8, "cd");
+    check("[%*k]", "[%*s]", -7, "neg");
+    check("[%*K|%*r]", "[%*d|%*s]", -9, 5, 0, "zero");
+
+    /* 位置参数 */
+    check("[%2$*1$k|%3$-5k]", "[%2$*1$s|%3$-5s]", 7, "pos", "q");
+    check("[%2$*1$k]", "[%2$*1$s]", -6, "lft");
+
+    /* 超过 256 个字符，经过 `k_xprintf` 与 `k_dprintf` 的暂存路径 */
+    check("%300k|%-300k", "%300s|%-300s", "a", "b");
+    check("%*K|%-*r", "%*d|%-*s", 400, 1, 257, "r");
+    check("%3000k|%k", "%3000s|%s", long_str, "tail");
+
+    struct k_printf_arg argv[] = {
+        { .type = K_PRINTF_ARG_INT, .value.i = 9 },
+        { .type = K_PRINTF_ARG_STR, .value.s = "argv" },
+        { .type = K_PRINTF_ARG_STR, .value.s = "x" },
+    };
+    check_argv("[%*k|%-4k]", "[     argv|x   ]", argv, 3);
+    check_argv("[%2$*1$k]", "[     argv]", argv, 2);
+
+    static char staged_str[301];
+    memset(staged_str, 'y', sizeof(staged_str) - 1);
+    check_no_alloc(staged_str);
+
+    printf("auto_pad: %d checks, %d failures\n", check_num, fail_num);
+    return (0 == fail_num) ? 0 : 1;
+}
@@ -0,0 +1,377 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "k_printf.h"
+
+/* 检查二进制日志的编码与解码
+ *
+ * 每条记录经 `k_printf_binlog` 写入内存，再由 `k_printf_binlog_decode` 还原，与 `k_snprintf` 的输出对比，
+ * 覆盖所有会被捕获的实参类型、保存副本的 `%s`、自定义格式说明符，以及首尾相接的多个流。
+ * 另外构造截断、改写过的流与手工拼出的恶意流，检查解码端返回 -1，且不越界读写。
+ */
+
+/* 自定义格式说明符 `%v`：输出 `int` 数组 `{ len, v0, v1, ... }` 的内容，捕获时保存数组的副本 */
+static void callback_v(struct k_printf_buf *buf, const struct k_printf_spec *spec, va_list *args) {
+    (void)spec;
+    const int *v = va_arg(*args, const int *);
+    for (int i = 1; i <= v[0]; i++)
+        buf->fn_printf(buf, (1 == i) ? "%d" : ",%d", v[i]);
+}
+
+static void callback_argv_v(struct k_printf_buf *buf, const struct k_printf_spec *spec, struct k_printf_args *args) {
+    (void)spec;
+    const struct k_printf_arg *arg = k_printf_args_next(args);
+    if (NULL == arg || K_PRINTF_ARG_PTR != arg->type) {
+        buf->n = -1;
+        return;
+    }
+    const int *v = arg->value.p;
+    for (int i = 1; i <= v[0]; i++)
+        buf->fn_printf(buf, (1 == i) ? "%d" : ",%d", v[i]);
+}
+
+static int capture_v(struct k_printf_capture *cap, const struct k_printf_spec *spec, va_list *args) {
+    (void)spec;
+    const int *v = va_arg(*args, const int *);
+    return k_printf_capture_copy(cap, K_PRINTF_ARG_PTR, v, (size_t)(v[0] + 1) * sizeof(int));
+}
+
+/* 自定义格式说明符 `%w`：没有 `fn_capture`，写入端与解码端都应拒绝 */
+static void callback_w(struct k_printf_buf *buf, const struct k_printf_spec *spec, va_list *args) {
+    (void)spec;
+    buf->fn_printf(buf, "%d", va_arg(*args, int));
+}
+
+static const struct k_printf_spec_callback_tuple tuples[] = {
+    { "v", callback_v, NULL, callback_argv_v, capture_v, 0 },
+    { "w", callback_w, NULL, NULL,            NULL,      0 },
+    { NULL, NULL, NULL, NULL, NULL, 0 },
+};
+
+static const struct k_printf_spec_callback_tuple *match_tuple(const char **str) {
+    return k_printf_match_tuple_helper(tuples, str);
+}
+
+static struct k_printf_config config;
+
+static int check_num;
+static int fail_num;
+
+#define DATA_MAX 65536
+
+struct mem_sink {
+    struct k_printf_sink impl;
+    char   data[DATA_MAX];
+    size_t len;
+};
+
+static int mem_sink_puts(struct k_printf_sink *sink, const char *str, size_t len) {
+    struct mem_sink *s = (struct mem_sink *)sink;
+    if (len > sizeof(s->data) - 1 - s->len)
+        return -1;
+    memcpy(s->data + s->len, str, len);
+    s->len += len;
+    s->data[s->len] = '\0';
+    return 0;
+}
+
+static void mem_sink_init(struct mem_sink *sink) {
+    memset(sink, 0, sizeof(*sink));
+    sink->impl.fn_puts = mem_sink_puts;
+}
+
+/* 写入端与期望的解码结果，`round_trip` 逐条追加 */
+static struct mem_sink log_data;
+static struct mem_sink expect;
+static struct k_printf_binlog *log_writer;
+static long long record_num;
+
+static void fail(const char *fmt, const char *what, long long expect_n, const char *expect_str,
+                 long long actual_n, const char *actual_str) {
+    if (++fail_num <= 50)
+        printf("FAIL \"%s\" %s: expect %lld [%s], got %lld [%s]\n",
+               fmt, what, expect_n, expect_str, actual_n, actual_str);
+}
+
+static void round_trip(const char *fmt, ...) {
+
+    va_list args;
+    va_start(args, fmt);
+    long long n = k_vprintf_binlog(log_writer, fmt, args);
+    va_end(args);
+
+    check_num++;
+    if (n <= 0) {
+        fail(fmt, "k_printf_binlog", 1, "", n, "");
+        return;
+    }
+
+    va_start(args, fmt);
+    k_vxprintf(&config, &expect.impl, fmt, args);
+    va_end(args);
+    record_num++;
+}
+
+/* 解码 `log_data` 中的全部内容，与逐条调用 `k_xprintf` 的结果对比 */
+static void check_decode(const char *what) {
+
+    static struct mem_sink out;
+    mem_sink_init(&out);
+
+    long long n = k_printf_binlog_decode(&config, log_data.data, log_data.len, &out.impl);
+    check_num++;
+    if (n != record_num || out.len != expect.len || 0 != memcmp(out.data, expect.data, expect.len))
+        fail(what, "k_printf_binlog_decode", record_num, expect.data, n, out.data);
+}
+
+static void begin_stream(void) {
+    k_printf_binlog_destroy(log_writer);
+    log_writer = k_printf_binlog_create(&config, &log_data.impl);
+    if (NULL == log_writer) {
+        printf("FAIL k_printf_binlog_create\n");
+        exit(1);
+    }
+}
+
+/* region [round_trip] */
+
+static void test_types(void) {
+
+    static const int arr[] = { 3, 7, -8, 9 };
+    char volatile_str[] = "volatile";
+    int x = 0;
+
+    round_trip("int %d %i %+5d %-5d| %05d %.3d\n", 0, -1, 42, -42, 7, 8);
+    round_trip("int %hhd %hd %ld %lld %jd %zd %td\n", (signed char)-100, (short)-30000, -123456789L,
+               -1234567890123LL, (intmax_t)-99, (size_t)77, (ptrdiff_t)-66);
+    round_trip("uint %u %x %X %o %#x %#o %llu %hhu\n", 4000000000u, 0xbeefu, 0xbeefu, 8u, 255u, 8u,
+               18446744073709551615ULL, (unsigned char)255);
+    round_trip("char [%c] [%3c] [%-3c]\n", 'a', 'b', 'c');
+    round_trip("double %f %.2f %e %E %g %G %10.3f %-10.1e|\n", 3.25, -1.005, 12345.678, 0.00012, 1e20, 1e-20,
+               2.5, -7.75);
+    round_trip("double %a %A %f %f\n", 1.0, -0.5, 1.0 / 0.0, -1.0 / 0.0);
+    round_trip("long double %Lf %.3Le %Lg\n", (long double)1.5, (long double)-2.25, (long double)1e100);
+    round_trip("str [%s] [%10s] [%-10s] [%.3s] [%s]\n", "hello", "right", "left", "truncated", "");
+    round_trip("null [%s] [%.2s]\n", (const char *)NULL, (const char *)NULL);
+    round_trip("star [%*d] [%-*d] [%*s] [%.*s] [%*.*f]\n", 6, 1, 6, 2, -8, "neg", 2, "prec", 9, 3, 3.14159);
+    round_trip("ptr %p %p\n", (void *)&x, (void *)NULL);
+    round_trip("pct %%%d%%\n", 100);
+    round_trip("custom [%v] [%v]\n", arr, arr);
+    round_trip("literal only\n");
+
+    /* `%s` 保存的是副本，写入后改动原字符串不影响解码结果 */
+    round_trip("copy %s\n", volatile_str);
+    memcpy(volatile_str, "changed!", sizeof(volatile_str));
+
+    check_decode("types");
+}
+
+static void test_concat(void) {
+
+    /* 同一个格式字符串在每个流中重新分配 ID，首尾相接的流应逐个解码 */
+    for (int i = 0; i < 3; i++) {
+        begin_stream();
+        round_trip("stream %d %s\n", i, "a");
+        round_trip("only in stream %d\n", i);
+        round_trip("stream %d %s\n", i, "b");
+    }
+    check_decode("concat");
+}
+
+static void test_long_record(void) {
+
+    static char long_str[20000];
+    memset(long_str, 'L', sizeof(long_str) - 1);
+    round_trip("[%s]\n", long_str);
+    check_decode("long");
+}
+
+/* endregion */
+
+/* region [reject] */
+
+static void check_reject(const char *what, const void *data, size_t len) {
+
+    static struct mem_sink out;
+    mem_sink_init(&out);
+
+    long long n = k_printf_binlog_decode(&config, data, len, &out.impl);
+    check_num++;
+    if (-1 != n)
+        fail(what, "k_printf_binlog_decode", -1, "", n, out.data);
+}
+
+static void check_writer_reject(const char *fmt, ...) {
+
+    static struct mem_sink out;
+    mem_sink_init(&out);
+    struct k_printf_binlog *writer = k_printf_binlog_create(&config, &out.impl);
+
+    va_list args;
+    va_start(args, fmt);
+    long long n = k_vprintf_binlog(writer, fmt, args);
+    va_end(args);
+
+    k_printf_binlog_destroy(writer);
+    check_num++;
+    if (-1 != n)
+        fail(fmt, "k_printf_binlog", -1, "", n, "");
+}
+
+/* 手工拼出一个流：头部、一条格式定义记录，以及一条带有 `body` 的实参记录 */
+static size_t make_stream(unsigned char *dst, const char *fmt, const unsigned char *body, size_t body_len) {
+    size_t fmt_len = strlen(fmt);
+    size_t len = 0;
+    memcpy(dst, "KPB1", 4);
+    len += 4;
+    dst[len++] = 'F';
+    dst[len++] = 0;
+    dst[len++] = (unsigned char)fmt_len;
+    memcpy(dst + len, fmt, fmt_len);
+    len += fmt_len;
+    dst[len++] = 'R';
+    dst[len++] = 0;
+    dst[len++] = (unsigned char)body_len;
+    memcpy(dst + len, body, body_len);
+    return len + body_len;
+}
+
+static void test_hostile(void) {
+
+    /* 写入端不接受的格式字符串 */
+    int count = 0;
+    check_writer_reject("%n", &count);
+    check_writer_reject("%ls", L"wide");
+    check_writer_reject("%1$d", 1);
+    check_writer_reject("%w", 1);
+
+    /* 解码端同样拒绝这些格式定义记录，即使实参记录给出了可写的地址 */
+    static int target = 12345;
+    unsigned long long addr = (unsigned long long)(uintptr_t)&target;
+    unsigned char body[16];
+    size_t body_len = 0;
+    body[body_len++] = (unsigned char)K_PRINTF_ARG_PTR;
+    do {
+        body[body_len++] = (unsigned char)((addr & 0x7f) | ((addr > 0x7f) ? 0x80 : 0));
+        addr >>= 7;
+    } while (0 != addr);
+
+    static const char *const hostile_fmts[] = {
+        "%n", "abc%hhn", "%lln", "%ls", "%1$p", "%1$n", "%2$s %1$d", "%w", "%d%n",
+    };
+    unsigned char data[128];
+    for (size_t i = 0; i < sizeof(hostile_fmts) / sizeof(hostile_fmts[0]); i++) {
+        size_t len = make_stream(data, hostile_fmts[i], body, body_len);
+        check_reject(hostile_fmts[i], data, len);
+    }
+    check_num++;
+    if (12345 != target)
+        fail("%n", "target", 12345, "", target, "");
+
+    /* 实参类型与格式说明符不符 */
+    static const unsigned char str_as_int[] = { K_PRINTF_ARG_INT, 0x02 };
+    size_t len = make_stream(data, "%s", str_as_int, sizeof(str_as_int));
+    check_reject("%s given int", data, len);
+
+    /* 实参不足或多出的字节不构成完整实参 */
+    len = make_stream(data, "%d %d", str_as_int, sizeof(str_as_int));
+    check_reject("%d %d given one", data, len);
+    static const unsigned char bad_varint[] = { K_PRINTF_ARG_INT, 0x80 };
+    len = make_stream(data, "%d", bad_varint, sizeof(bad_varint));
+    check_reject("truncated varint", data, len);
+
+    /* 副本长度超出记录 */
+    static const unsigned char long_copy[] = { K_PRINTF_ARG_STR | 0x80, 0x7f, 'a' };
+    len = make_stream(data, "%s", long_copy, sizeof(long_copy));
+    check_reject("copy overrun", data, len);
+
+    /* 引用未定义的格式 ID、格式 ID 不连续、未知的记录类型、缺少头部 */
+    static const unsigned char undefined_id[] = { 'K', 'P', 'B', '1', 'R', 0x00, 0x00 };
+    check_reject("undefined id", undefined_id, sizeof(undefined_id));
+    static const unsigned char skipped_id[] = { 'K', 'P', 'B', '1', 'F', 0x01, 0x01, 'x' };
+    check_reject("skipped id", skipped_id, sizeof(skipped_id));
+    static const unsigned char unknown_kind[] = { 'K', 'P', 'B', '1', 'Z', 0x00, 0x00 };
+    check_reject("unknown kind", unknown_kind, sizeof(unknown_kind));
+    static const unsigned char no_magic[] = { 'F', 0x00, 0x01, 'x' };
+    check_reject("no magic", no_magic, sizeof(no_magic));
+
+    /* 新的流会清空格式表，之后不能再引用前一个流的格式 ID */
+    static const unsigned char stale_id[] = { 'K', 'P', 'B', '1', 'F', 0x00, 0x01, 'x', 'K', 'P', 'B', '1', 'R', 0x00, 0x00 };
+    check_reject("stale id", stale_id, sizeof(stale_id));
+}
+
+/* 把合法的流截断在每个位置，或逐字节改写，解码不应越界读写；截断在记录中间时应返回 -1 */
+static void test_corrupt(void) {
+
+    begin_stream();
+    /* 不含 `%v`：它的 `fn_callback_argv` 信任副本中记录的长度，见 k_printf.h 中 `k_printf_binlog` 的说明 */
+    round_trip("%d %s %f %p %.3s %Lg\n", -5, "text", 0.5, (void *)&log_data, "abcdef", (long double)2);
+    round_trip("%c|%-6s|%x\n", 'z', "pad", 255u);
+
+    static unsigned char data[DATA_MAX];
+    size_t len = log_data.len;
+    memcpy(data, log_data.data, len);
+
+    static struct mem_sink out;
+    for (size_t cut = 0; cut < len; cut++) {
+        mem_sink_init(&out);
+        long long n = k_printf_binlog_decode(&config, data, cut, &out.impl);
+        check_num++;
+        if (n < -1 || n > 2)
+            fail("truncated", "k_printf_binlog_decode", -1, "", n, out.data);
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        for (int bit = 0; bit < 8; bit++) {
+            unsigned char *copy = malloc(len);
+            memcpy(copy, data, len);
+            copy[i] ^= (unsigned char)(1u << bit);
+            mem_sink_init(&out);
+            /* 只检查不崩溃、不越界，结果可能合法也可能不合法 */
+            long long n = k_printf_binlog_decode(&config, copy, len, &out.impl);
+            check_num++;
+            if (n < -1 || n > 2)
+                fail("bit flip", "k_printf_binlog_decode", -1, "", n, out.data);
+            free(copy);
+        }
+    }
+}
+
+/* endregion */
+
+int main(void) {
+
+    config.fn_match_tuple = match_tuple;
+
+    mem_sink_init(&log_data);
+    mem_sink_init(&expect);
+    begin_stream();
+    test_types();
+
+    mem_sink_init(&log_data);
+    mem_sink_init(&expect);
+    record_num = 0;
+    test_concat();
+
+    mem_sink_init(&log_data);
+    mem_sink_init(&expect);
+    record_num = 0;
+    begin_stream();
+    test_long_record();
+
+    test_hostile();
+
+    mem_sink_init(&log_data);
+    mem_sink_init(&expect);
+    record_num = 0;
+    test_corrupt();
+
+    k_printf_binlog_destroy(log_writer);
+
+    printf("binlog: %d checks, %d failures\n", check_num, fail_num);
+    return (0 == fail_num) ? 0 : 1;
+}
@@ -0,0 +1,261 @@
+#if defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__))
+#define _POSIX_C_SOURCE 200809L /* pthread */
+#include <pthread.h>
+#endif
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "k_printf.h"
+
+/* 检查格式字符串缓存
+ *
+ * 单线程下检查命中、未命中与淘汰的计数，禁用开关，容量之外的格式字符串反复淘汰后缓存仍能命中，
+ * 回调中再次调用 `k_printf` 淘汰外层正在使用的预编译结果，以及禁止分配时的未命中。
+ * 在支持原子操作的编译器上，多个线程共用一个容量很小的缓存，检查输出与 `snprintf` 一致，计数不丢失。
+ */
+
+static struct k_printf_config config;
+
+static int check_num;
+static int fail_num;
+
+static void fail_n(const char *what, unsigned long long expect, unsigned long long actual) {
+    if (++fail_num <= 50)
+        printf("FAIL %s: expect %llu, got %llu\n", what, expect, actual);
+}
+
+static void check(const char *fmt, ...) {
+
+    char expect[256];
+    char actual[256];
+
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(expect, sizeof(expect), fmt, args);
+    va_end(args);
+
+    va_start(args, fmt);
+    k_vsnprintf(&config, actual, sizeof(actual), fmt, args);
+    va_end(args);
+
+    check_num++;
+    if (0 != strcmp(expect, actual) && ++fail_num <= 50)
+        printf("FAIL \"%s\": expect [%s], got [%s]\n", fmt, expect, actual);
+}
+
+static void check_stats(const char *what, unsigned long long hits, unsigned long long misses,
+                        unsigned long long evictions) {
+
+    struct k_printf_cache_stats stats;
+    k_printf_cache_get_stats(config.cache, &stats);
+
+    check_num++;
+    if (hits != stats.hits)
+        fail_n(what, hits, stats.hits);
+    check_num++;
+    if (misses != stats.misses)
+        fail_n(what, misses, stats.misses);
+    check_num++;
+    if (evictions != stats.evictions)
+        fail_n(what, evictions, stats.evictions);
+}
+
+/* 10 个不同地址的格式字符串，多于测试中缓存的容量 */
+static const char *const fmts[] = {
+    "a%d|%s\n", "b%d|%s\n", "c%d|%s\n", "d%d|%s\n", "e%d|%s\n",
+    "f%d|%s\n", "g%d|%s\n", "h%d|%s\n", "i%d|%s\n", "j%d|%s\n",
+};
+
+#define FMT_NUM (sizeof(fmts) / sizeof(fmts[0]))
+
+/* region [single] */
+
+static void test_counters(void) {
+
+    config.cache = k_printf_cache_create(64);
+
+    /* 第一次未命中，之后命中 */
+    check(fmts[0], 1, "x");
+    check_stats("first", 0, 1, 0);
+    for (int i = 0; i < 5; i++)
+        check(fmts[0], i, "y");
+    check_stats("repeat", 5, 1, 0);
+
+    /* 禁用期间不查找也不计数，重新启用后仍能命中原来的项 */
+    k_printf_cache_set_enabled(config.cache, 0);
+    check(fmts[0], 2, "off");
+    check(fmts[1], 2, "off");
+    check_stats("disabled", 5, 1, 0);
+    k_printf_cache_set_enabled(config.cache, 1);
+    check(fmts[0], 3, "on");
+    check_stats("enabled", 6, 1, 0);
+
+    /* 清空后重新编译，计数保持不变 */
+    k_printf_cache_clear(config.cache);
+    check(fmts[0], 4, "clear");
+    check_stats("clear", 6, 2, 0);
+
+    k_printf_cache_destroy(config.cache);
+    config.cache = NULL;
+}
+
+static void test_churn(void) {
+
+    /* 只有一个槽位，交替使用两个格式字符串时每次都淘汰 */
+    config.cache = k_printf_cache_create(1);
+
+    for (int i = 0; i < 1000; i++)
+        check(fmts[i % 2], i, "churn");
+    check_stats("churn", 0, 1000, 999);
+
+    /* 反复淘汰之后，缓存仍然接受新项并能命中 */
+    for (int i = 0; i < 10; i++)
+        check(fmts[2], i, "after");
+    check_stats("after churn", 9, 1001, 1000);
+
+    k_printf_cache_destroy(config.cache);
+
+    /* 容量大于 1 时，每个槽位都可能被淘汰，输出始终正确 */
+    config.cache = k_printf_cache_create(4);
+    for (int i = 0; i < 10000; i++)
+        check(fmts[(size_t)i * 7 % FMT_NUM], i, "mixed");
+
+    struct k_printf_cache_stats stats;
+    k_printf_cache_get_stats(config.cache, &stats);
+    check_num++;
+    if (10000 != stats.hits + stats.misses || 0 == stats.evictions || stats.misses <= stats.evictions)
+        fail_n("mixed", 10000, stats.hits + stats.misses);
+
+    k_printf_cache_destroy(config.cache);
+    config.cache = NULL;
+}
+
+/* 自定义格式说明符 `%R`：在回调中以同一个缓存格式化另一个格式字符串，淘汰外层正在使用的项 */
+static void callback_R(struct k_printf_buf *buf, const struct k_printf_spec *spec, va_list *args) {
+    (void)spec;
+    int depth = va_arg(*args, int);
+    char inner[64];
+    if (0 < depth)
+        k_snprintf(&config, inner, sizeof(inner), "<%R>", depth - 1);
+    else
+        k_snprintf(&config, inner, sizeof(inner), "leaf%d", depth);
+    buf->fn_puts(buf, inner, strlen(inner));
+}
+
+static const struct k_printf_spec_callback_tuple tuples[] = {
+    { "R", callback_R, NULL, NULL, NULL, 0 },
+    { NULL, NULL, NULL, NULL, NULL, 0 },
+};
+
+static const struct k_printf_spec_callback_tuple *match_tuple(const char **str) {
+    return k_printf_match_tuple_helper(tuples, str);
+}
+
+static void test_reentrant(void) {
+
+    config.cache          = k_printf_cache_create(1);
+    config.fn_match_tuple = match_tuple;
+
+    /* 外层项在回调中被淘汰，淘汰引发的回收不能释放它；在 AddressSanitizer 下运行可以发现释放后使用 */
+    for (int i = 0; i < 100; i++) {
+        char out[64];
+        k_snprintf(&config, out, sizeof(out), "[%R] after", 3);
+        check_num++;
+        if (0 != strcmp(out, "[<<<leaf0>>>] after") && ++fail_num <= 50)
+            printf("FAIL reentrant: got [%s]\n", out);
+    }
+
+    k_printf_cache_destroy(config.cache);
+    config.cache          = NULL;
+    config.fn_match_tuple = NULL;
+}
+
+static void test_no_alloc(void) {
+
+    config.cache    = k_printf_cache_create(4);
+    config.no_alloc = 1;
+
+    /* 禁止分配时未命中的格式字符串直接解析，不放入缓存 */
+    check(fmts[0], 1, "no_alloc");
+    check(fmts[0], 2, "no_alloc");
+    check_stats("no_alloc", 0, 2, 0);
+
+    config.no_alloc = 0;
+    check(fmts[0], 3, "alloc");
+    check(fmts[0], 4, "alloc");
+    check_stats("alloc", 1, 3, 0);
+
+    k_printf_cache_destroy(config.cache);
+    config.cache = NULL;
+}
+
+/* endregion */
+
+/* region [threads] */
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(_POSIX_C_SOURCE)
+#define TEST_THREADS 1
+
+#define THREAD_NUM 8
+#define CALL_NUM   20000
+
+static int thread_fail_num;
+
+static void *worker(void *arg) {
+    size_t t = (size_t)arg;
+    for (int i = 0; i < CALL_NUM; i++) {
+        const char *fmt = fmts[(t + (size_t)i) % FMT_NUM];
+        char expect[64];
+        char actual[64];
+        snprintf(expect, sizeof(expect), fmt, i, "thread");
+        k_snprintf(&config, actual, sizeof(actual), fmt, i, "thread");
+        if (0 != strcmp(expect, actual))
+            __atomic_fetch_add(&thread_fail_num, 1, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+static void test_threads(size_t capacity) {
+
+    config.cache = k_printf_cache_create(capacity);
+
+    pthread_t threads[THREAD_NUM];
+    for (size_t t = 0; t < THREAD_NUM; t++)
+        pthread_create(&threads[t], NULL, worker, (void *)t);
+    for (size_t t = 0; t < THREAD_NUM; t++)
+        pthread_join(threads[t], NULL);
+
+    check_num++;
+    if (0 != thread_fail_num)
+        fail_n("threads output", 0, (unsigned long long)thread_fail_num);
+
+    struct k_printf_cache_stats stats;
+    k_printf_cache_get_stats(config.cache, &stats);
+    check_num++;
+    if (THREAD_NUM * CALL_NUM != stats.hits + stats.misses)
+        fail_n("threads lookups", THREAD_NUM * CALL_NUM, stats.hits + stats.misses);
+
+    k_printf_cache_destroy(config.cache);
+    config.cache = NULL;
+}
+
+#endif
+
+/* endregion */
+
+int main(void) {
+
+    test_counters();
+    test_churn();
+    test_reentrant();
+    test_no_alloc();
+#if defined(TEST_THREADS)
+    test_threads(4);   /* 频繁淘汰 */
+    test_threads(64);  /* 基本都命中 */
+#endif
+
+    printf("cache: %d checks, %d failures\n", check_num, fail_num);
+    return (0 == fail_num) ? 0 : 1;
+}
@@ -0,0 +1,324 @@
+#if defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__))
+#define _POSIX_C_SOURCE 200809L /* pthread, sched_yield */
+#define HAVE_PTHREAD 1
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "k_printf.h"
+
+/* 检查延迟格式化队列
+ *
+ * 单线程下逐条对比 `k_printf_defer` 经 `k_printf_queue_drain` 渲染的结果与 `k_snprintf` 的输出，
+ * 覆盖队列已满、实参编码超出槽位、无法延迟处理的格式说明符（这些记录被丢弃，不阻塞之后的记录），
+ * 以及 `max` 限制与槽位的循环使用。
+ * 多线程下若干生产者与一个消费者同时运行，检查每条记录恰好渲染一次，且同一生产者的记录保持入队顺序。
+ */
+
+#if defined(__GNUC__) || defined(__clang__)
+
+static struct k_printf_config config;
+
+static int check_num;
+static int fail_num;
+
+static void fail(const char *what, const char *expect, const char *actual) {
+    if (++fail_num <= 50)
+        printf("FAIL %s: expect [%s], got [%s]\n", what, expect, actual);
+}
+
+static void fail_n(const char *what, long long expect, long long actual) {
+    if (++fail_num <= 50)
+        printf("FAIL %s: expect %lld, got %lld\n", what, expect, actual);
+}
+
+struct mem_sink {
+    struct k_printf_sink impl;
+    char   data[4096];
+    size_t len;
+};
+
+static int mem_sink_puts(struct k_printf_sink *sink, const char *str, size_t len) {
+    struct mem_sink *s = (struct mem_sink *)sink;
+    if (len > sizeof(s->data) - 1 - s->len)
+        return -1;
+    memcpy(s->data + s->len, str, len);
+    s->len += len;
+    s->data[s->len] = '\0';
+    return 0;
+}
+
+static void mem_sink_init(struct mem_sink *sink) {
+    memset(sink, 0, sizeof(*sink));
+    sink->impl.fn_puts = mem_sink_puts;
+}
+
+/* 期望的渲染结果，`defer_ok` 逐条追加 */
+static char expect[4096];
+static size_t expect_len;
+
+static void defer_ok(struct k_printf_queue *queue, const char *fmt, ...) {
+
+    va_list args;
+    va_start(args, fmt);
+    int r = k_vprintf_defer(&config, queue, fmt, args);
+    va_end(args);
+
+    check_num++;
+    if (0 != r) {
+        fail_n(fmt, 0, r);
+        return;
+    }
+
+    va_start(args, fmt);
+    int n = k_vsnprintf(&config, expect + expect_len, sizeof(expect) - expect_len, fmt, args);
+    va_end(args);
+    expect_len += (size_t)n;
+}
+
+static void defer_fail(struct k_printf_queue *queue, const char *fmt, ...) {
+
+    va_list args;
+    va_start(args, fmt);
+    int r = k_vprintf_defer(&config, queue, fmt, args);
+    va_end(args);
+
+    check_num++;
+    if (-1 != r)
+        fail_n(fmt, -1, r);
+}
+
+static void check_drain(struct k_printf_queue *queue, size_t max, size_t expect_num, const char *what) {
+
+    static struct mem_sink sink;
+    mem_sink_init(&sink);
+
+    size_t n = k_printf_queue_drain(queue, &sink.impl, max);
+    check_num++;
+    if (n != expect_num)
+        fail_n(what, (long long)expect_num, (long long)n);
+    check_num++;
+    if (sink.len != expect_len || 0 != memcmp(sink.data, expect, expect_len))
+        fail(what, expect, sink.data);
+
+    expect_len = 0;
+}
+
+/* region [single] */
+
+static void test_types(void) {
+
+    struct k_printf_queue *queue = k_printf_queue_create(16, 256);
+
+    char str[] = "original";
+    int x = 0;
+
+    defer_ok(queue, "int %d %+5d %-5d| %05lld %hhu %zx\n", -1, 42, -42, 7LL, (unsigned char)200, (size_t)255);
+    defer_ok(queue, "double %f %.3e %g %a %Lf\n", 3.25, 12345.678, 1e-20, 0.5, (long double)1.5);
+    defer_ok(queue, "str [%s] [%10s] [%.3s] [%s]\n", str, "right", "truncated", (const char *)NULL);
+    defer_ok(queue, "star [%*d] [%.*s] [%c] %p %%\n", -6, 1, 2, "prec", 'c', (void *)&x);
+
+    /* `%s` 被深拷贝，入队后改动原字符串不影响渲染结果 */
+    memcpy(str, "changed!", sizeof(str));
+
+    check_drain(queue, SIZE_MAX, 4, "types");
+    check_drain(queue, SIZE_MAX, 0, "empty");
+
+    k_printf_queue_destroy(queue);
+}
+
+static void test_full(void) {
+
+    struct k_printf_queue *queue = k_printf_queue_create(4, 64);
+
+    /* 队列满时入队失败，且不影响已入队的记录 */
+    for (int i = 0; i < 4; i++)
+        defer_ok(queue, "r%d ", i);
+    defer_fail(queue, "overflow %d", 4);
+
+    /* `max` 限制一次取出的数量，腾出的槽位可以再次使用 */
+    char all[64];
+    memcpy(all, expect, expect_len);
+    size_t all_len = expect_len;
+    expect_len = 6;
+    check_drain(queue, 2, 2, "max");
+    memcpy(expect, all + 6, all_len - 6);
+    expect_len = all_len - 6;
+
+    defer_ok(queue, "r%d ", 4);
+    defer_ok(queue, "r%d ", 5);
+    defer_fail(queue, "overflow %d", 6);
+    check_drain(queue, SIZE_MAX, 4, "wrap");
+
+    /* 绕过队列容量多圈 */
+    for (int round = 0; round < 10; round++) {
+        for (int i = 0; i < 3; i++)
+            defer_ok(queue, "%d.%d ", round, i);
+        check_drain(queue, SIZE_MAX, 3, "rounds");
+    }
+
+    k_printf_queue_destroy(queue);
+}
+
+static void test_discarded(void) {
+
+    struct k_printf_queue *queue = k_printf_queue_create(8, 32);
+
+    static char long_str[100];
+    memset(long_str, 'x', sizeof(long_str) - 1);
+    int count = 0;
+
+    /* 捕获失败的记录占用的槽位会被发布并跳过，之后的记录照常渲染 */
+    defer_ok(queue, "before %d\n", 1);
+    defer_fail(queue, "too long %s\n", long_str);
+    defer_fail(queue, "count %n\n", &count);
+    defer_fail(queue, "wide %ls\n", L"x");
+    defer_fail(queue, "positional %1$d\n", 1);
+    defer_ok(queue, "after %d\n", 2);
+
+    check_drain(queue, SIZE_MAX, 2, "discarded");
+
+    /* 被丢弃的记录仍然占用槽位，直到被取出 */
+    for (int i = 0; i < 8; i++)
+        defer_fail(queue, "too long %s\n", long_str);
+    defer_fail(queue, "full %d\n", 0);
+    check_drain(queue, SIZE_MAX, 0, "all discarded");
+    defer_ok(queue, "again %d\n", 3);
+    check_drain(queue, SIZE_MAX, 1, "again");
+
+    check_num++;
+    if (0 != count)
+        fail_n("%n", 0, count);
+
+    k_printf_queue_destroy(queue);
+}
+
+/* endregion */
+
+/* region [threads] */
+
+#if defined(HAVE_PTHREAD)
+
+#define PRODUCER_NUM 8
+#define RECORD_NUM   20000
+
+static struct k_printf_queue *mt_queue;
+static int producers_done; /* 已结束的生产者数量 */
+
+/* 每条记录的输出形如 "线程号 序号\n"，在 `fn_flush` 中解析 */
+struct check_sink {
+    struct k_printf_sink impl;
+    char line[64];
+    size_t len;
+    int next[PRODUCER_NUM];
+    long long bad;
+};
+
+static int check_sink_puts(struct k_printf_sink *sink, const char *str, size_t len) {
+    struct check_sink *s = (struct check_sink *)sink;
+    if (len > sizeof(s->line) - 1 - s->len)
+        return -1;
+    memcpy(s->line + s->len, str, len);
+    s->len += len;
+    return 0;
+}
+
+static int check_sink_flush(struct k_printf_sink *sink) {
+    struct check_sink *s = (struct check_sink *)sink;
+    s->line[s->len] = '\0';
+    s->len = 0;
+
+    int t, i;
+    if (2 != sscanf(s->line, "%d %d", &t, &i) || t < 0 || PRODUCER_NUM <= t || i != s->next[t]) {
+        s->bad++;
+        return 0;
+    }
+    s->next[t]++;
+    return 0;
+}
+
+static void *producer(void *arg) {
+    int t = (int)(size_t)arg;
+    for (int i = 0; i < RECORD_NUM; i++) {
+        while (0 != k_printf_defer(&config, mt_queue, "%d %d\n", t, i))
+            sched_yield();
+    }
+    __atomic_fetch_add(&producers_done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void test_threads(void) {
+
+    mt_queue = k_printf_queue_create(256, 64);
+
+    static struct check_sink sink;
+    memset(&sink, 0, sizeof(sink));
+    sink.impl.fn_puts  = check_sink_puts;
+    sink.impl.fn_flush = check_sink_flush;
+
+    pthread_t threads[PRODUCER_NUM];
+    for (int t = 0; t < PRODUCER_NUM; t++)
+        pthread_create(&threads[t], NULL, producer, (void *)(size_t)t);
+
+    /* 先确认生产者全部结束，再取一次为空，才说明已经取完 */
+    size_t total = 0;
+    for (;;) {
+        int done = (PRODUCER_NUM == __atomic_load_n(&producers_done, __ATOMIC_ACQUIRE));
+        size_t n = k_printf_queue_drain(mt_queue, &sink.impl, 64);
+        total += n;
+        if (0 == n) {
+            if (done)
+                break;
+            sched_yield();
+        }
+    }
+
+    for (int t = 0; t < PRODUCER_NUM; t++)
+        pthread_join(threads[t], NULL);
+
+    check_num++;
+    if (PRODUCER_NUM * RECORD_NUM != total)
+        fail_n("threads total", PRODUCER_NUM * RECORD_NUM, (long long)total);
+    check_num++;
+    if (0 != sink.bad)
+        fail_n("threads out of order", 0, sink.bad);
+    for (int t = 0; t < PRODUCER_NUM; t++) {
+        check_num++;
+        if (RECORD_NUM != sink.next[t])
+            fail_n("threads per producer", RECORD_NUM, sink.next[t]);
+    }
+
+    k_printf_queue_destroy(mt_queue);
+}
+
+#endif
+
+/* endregion */
+
+int main(void) {
+
+    test_types();
+    test_full();
+    test_discarded();
+#if defined(HAVE_PTHREAD)
+    test_threads();
+#endif
+
+    printf("defer: %d checks, %d failures\n", check_num, fail_num);
+    return (0 == fail_num) ? 0 : 1;
+}
+
+#else
+
+int main(void) {
+    printf("defer: skipped, k_printf_defer is not available\n");
+    return 0;
+}
+
+#endif
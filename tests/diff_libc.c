@@ -0,0 +1,359 @@
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <wchar.h>
+
+#include "k_printf.h"
+
+/* 以 C 标准库的 `snprintf` 为基准，对比 `k_printf` 对 C `printf` 格式说明符的输出
+ *
+ * 逐一组合标志、最小宽度（包括 `*` 与负的 `*`）、精度与长度修饰符，覆盖整数、浮点数、
+ * `%s`、`%c` 以及交给 C 标准库处理的 `%p`、`%a`、`%lc`、`%ls`、`long double` 等格式说明符。
+ * 每个组合都比较完整输出、若干截断长度下的输出与返回值，以及 `k_printf_len` 的结果。
+ * 只组合 C 标准定义了行为的写法，例如不给 `%s` 加 `0` 标志，不给 `%c` 加精度。
+ */
+
+static struct k_printf_config config;
+
+static int check_num;
+static int fail_num;
+
+static const int star_widths[]     = { -9, 0, 12 };
+static const int star_precisions[] = { -1, 0, 4 };
+
+#define ARRAY_LEN(a) (sizeof(a) / sizeof((a)[0]))
+
+static void report(const char *fmt, const char *what, size_t n, const char *expect, int expect_len,
+                   const char *actual, int actual_len) {
+    if (++fail_num <= 50)
+        printf("FAIL \"%s\" %s n=%zu: expect %d [%s], got %d [%s]\n",
+               fmt, what, n, expect_len, expect, actual_len, actual);
+}
+
+/* 以 `n` 字节的缓冲区对比 `vsnprintf` 与 `k_vsnprintf`，缓冲区之后的字节不应被改动 */
+static void diff_n(const char *fmt, size_t n, va_list args) {
+
+    char expect[1024];
+    char actual[1024];
+    memset(expect, '#', sizeof(expect));
+    memset(actual, '#', sizeof(actual));
+
+    va_list args_copy;
+    va_copy(args_copy, args);
+    int expect_len = vsnprintf(expect, n, fmt, args_copy);
+    va_end(args_copy);
+
+    va_copy(args_copy, args);
+    int actual_len = k_vsnprintf(&config, actual, n, fmt, args_copy);
+    va_end(args_copy);
+
+    check_num++;
+    if (expect_len != actual_len || 0 != memcmp(expect, actual, sizeof(expect))) {
+        expect[sizeof(expect) - 1] = '\0';
+        actual[sizeof(actual) - 1] = '\0';
+        report(fmt, "k_snprintf", n, (0 == n) ? "" : expect, expect_len, (0 == n) ? "" : actual, actual_len);
+    }
+}
+
+static void diff(const char *fmt, ...) {
+
+    va_list args;
+    va_list args_copy;
+    va_start(args, fmt);
+
+    char expect[1024];
+    va_copy(args_copy, args);
+    int expect_len = vsnprintf(expect, sizeof(expect), fmt, args_copy);
+    va_end(args_copy);
+
+    if (expect_len < 0 || (size_t)expect_len >= sizeof(expect)) {
+        va_end(args);
+        return;
+    }
+
+    diff_n(fmt, sizeof(expect), args);
+    diff_n(fmt, 0, args);
+    diff_n(fmt, (size_t)expect_len / 2 + 1, args);
+
+    va_copy(args_copy, args);
+    int len = k_vprintf_len(&config, fmt, args_copy);
+    va_end(args_copy);
+    check_num++;
+    if (len != expect_len)
+        report(fmt, "k_printf_len", 0, expect, expect_len, "", len);
+
+    va_end(args);
+}
+
+/* 按 `fmt` 中是否有 `*` 宽度与 `*` 精度，在值前面补上对应的 int 实参 */
+#define DIFF_STAR(fmt, star_width, star_precision, value)                             \
+    do {                                                                              \
+        if (star_width && star_precision) {                                           \
+            for (size_t w_ = 0; w_ < ARRAY_LEN(star_widths); w_++)                    \
+                for (size_t p_ = 0; p_ < ARRAY_LEN(star_precisions); p_++)            \
+                    diff(fmt, star_widths[w_], star_precisions[p_], value);           \
+        } else if (star_width) {                                                      \
+            for (size_t w_ = 0; w_ < ARRAY_LEN(star_widths); w_++)                    \
+                diff(fmt, star_widths[w_], value);                                    \
+        } else if (star_precision) {                                                  \
+            for (size_t p_ = 0; p_ < ARRAY_LEN(star_precisions); p_++)                \
+                diff(fmt, star_precisions[p_], value);                                \
+        } else {                                                                      \
+            diff(fmt, value);                                                         \
+        }                                                                             \
+    } while (0)
+
+/* region [format] */
+
+static const char *const widths[]     = { "", "1", "7", "23", "*" };
+static const char *const precisions[] = { "", ".", ".0", ".1", ".6", ".17", ".*" };
+
+struct spec_shape {
+    char fmt[64];
+    int  star_width;
+    int  star_precision;
+};
+
+/* 构造形如 `[%-+7.1lld]` 的格式字符串，`flag_mask` 的每一位对应 `flags` 中的一个标志 */
+static void make_shape(struct spec_shape *shape, unsigned flag_mask, const char *width,
+                       const char *precision, const char *length, char conversion) {
+
+    static const char flags[] = "-+ #0";
+
+    char *p = shape->fmt;
+    *p++ = '[';
+    *p++ = '%';
+    for (unsigned i = 0; i < sizeof(flags) - 1; i++)
+        if (flag_mask & (1u << i))
+            *p++ = flags[i];
+    p += sprintf(p, "%s%s%s%c]", width, precision, length, conversion);
+
+    shape->star_width     = ('*' == width[0]);
+    shape->star_precision = (0 == strcmp(precision, ".*"));
+}
+
+/* endregion */
+
+/* region [int] */
+
+static const long long int_values[] = {
+    0, 1, -1, 7, -42, 127, -128, 255, 300, 65535, -65536,
+    INT_MAX, INT_MIN, (long long)UINT_MAX, LLONG_MAX, LLONG_MIN,
+};
+
+static void diff_int_value(const struct spec_shape *shape, const char *length, char conversion, long long v) {
+
+    int is_signed = ('d' == conversion || 'i' == conversion);
+    const char *fmt = shape->fmt;
+    int sw = shape->star_width;
+    int sp = shape->star_precision;
+
+    if (0 == strcmp(length, "l")) {
+        if (is_signed) DIFF_STAR(fmt, sw, sp, (long)v);
+        else           DIFF_STAR(fmt, sw, sp, (unsigned long)v);
+    } else if (0 == strcmp(length, "ll")) {
+        if (is_signed) DIFF_STAR(fmt, sw, sp, (long long)v);
+        else           DIFF_STAR(fmt, sw, sp, (unsigned long long)v);
+    } else if (0 == strcmp(length, "j")) {
+        if (is_signed) DIFF_STAR(fmt, sw, sp, (intmax_t)v);
+        else           DIFF_STAR(fmt, sw, sp, (uintmax_t)v);
+    } else if (0 == strcmp(length, "z") || 0 == strcmp(length, "t")) {
+        if (is_signed) DIFF_STAR(fmt, sw, sp, (ptrdiff_t)v);
+        else           DIFF_STAR(fmt, sw, sp, (size_t)v);
+    } else {
+        /* 无修饰符与 `hh`、`h` 的实参都经过整数提升，以 int 传递 */
+        if (is_signed) DIFF_STAR(fmt, sw, sp, (int)v);
+        else           DIFF_STAR(fmt, sw, sp, (unsigned)v);
+    }
+}
+
+static void diff_int(void) {
+
+    static const char *const lengths[] = { "", "hh", "h", "l", "ll", "j", "z", "t" };
+    static const char conversions[] = "diuoxX";
+
+    for (const char *c = conversions; '\0' != *c; c++) {
+        /* `#` 只对 `o`、`x`、`X` 有定义 */
+        unsigned all_flags = ('o' == *c || 'x' == *c || 'X' == *c) ? 0x1f : 0x17;
+
+        for (unsigned flag_mask = 0; flag_mask <= 0x1f; flag_mask++) {
+            if (flag_mask & ~all_flags)
+                continue;
+            for (size_t w = 0; w < ARRAY_LEN(widths); w++)
+                for (size_t p = 0; p < ARRAY_LEN(precisions); p++)
+                    for (size_t l = 0; l < ARRAY_LEN(lengths); l++) {
+                        struct spec_shape shape;
+                        make_shape(&shape, flag_mask, widths[w], precisions[p], lengths[l], *c);
+                        for (size_t v = 0; v < ARRAY_LEN(int_values); v++)
+                            diff_int_value(&shape, lengths[l], *c, int_values[v]);
+                    }
+        }
+    }
+}
+
+/* endregion */
+
+/* region [double] */
+
+static void diff_double(void) {
+
+    const double values[] = {
+        0.0, -0.0, 1.0, -1.0, 0.1, 0.5, 1.5, 2.5, 9.5, 0.05, 99.999, -3.25e-10, 123456.789,
+        1e15, 1e16, 1e100, -1e-100, 1e-300, DBL_MAX, DBL_MIN, DBL_MIN / 1024, INFINITY, -INFINITY, NAN,
+    };
+    static const char *const lengths[] = { "", "L" };
+    static const char conversions[] = "eEfFgGaA";
+
+    for (const char *c = conversions; '\0' != *c; c++)
+        for (unsigned flag_mask = 0; flag_mask <= 0x1f; flag_mask++)
+            for (size_t w = 0; w < ARRAY_LEN(widths); w++)
+                for (size_t p = 0; p < ARRAY_LEN(precisions); p++)
+                    for (size_t l = 0; l < ARRAY_LEN(lengths); l++) {
+                        struct spec_shape shape;
+                        make_shape(&shape, flag_mask, widths[w], precisions[p], lengths[l], *c);
+                        const char *fmt = shape.fmt;
+                        int sw = shape.star_width;
+                        int sp = shape.star_precision;
+                        for (size_t v = 0; v < ARRAY_LEN(values); v++) {
+                            if ('L' == lengths[l][0])
+                                DIFF_STAR(fmt, sw, sp, (long double)values[v]);
+                            else
+                                DIFF_STAR(fmt, sw, sp, values[v]);
+                        }
+                    }
+}
+
+/* endregion */
+
+/* region [string] */
+
+/* `%s`、`%c`、`%p` 只有 `-` 标志有定义，`%c`、`%p` 也不接受精度 */
+static void diff_string(void) {
+
+    static const char *const strs[] = { "", "a", "hello", "hello, world with a longer tail" };
+    static const wchar_t *const wstrs[] = { L"", L"w", L"wide", L"wide string, longer than the widths" };
+    static const int chars[] = { 'a', 'Z', ' ', '%' };
+    int local = 0;
+    void *const ptrs[] = { NULL, &local, (void *)1, (void *)(uintptr_t)0xdeadbeef };
+
+    for (unsigned flag_mask = 0; flag_mask <= 1; flag_mask++)
+        for (size_t w = 0; w < ARRAY_LEN(widths); w++) {
+            for (size_t p = 0; p < ARRAY_LEN(precisions); p++) {
+                struct spec_shape s, ls;
+                make_shape(&s, flag_mask, widths[w], precisions[p], "", 's');
+                make_shape(&ls, flag_mask, widths[w], precisions[p], "l", 's');
+                for (size_t v = 0; v < ARRAY_LEN(strs); v++) {
+                    DIFF_STAR(s.fmt, s.star_width, s.star_precision, strs[v]);
+                    DIFF_STAR(ls.fmt, ls.star_width, ls.star_precision, wstrs[v]);
+                }
+#if defined(__GLIBC__)
+                /* `%s` 的实参为 NULL 时行为未定义，`k_printf` 与 glibc 一样输出 `(null)` */
+                DIFF_STAR(s.fmt, s.star_width, s.star_precision, (const char *)NULL);
+#endif
+            }
+
+            struct spec_shape c, lc, p;
+            make_shape(&c, flag_mask, widths[w], "", "", 'c');
+            make_shape(&lc, flag_mask, widths[w], "", "l", 'c');
+            make_shape(&p, flag_mask, widths[w], "", "", 'p');
+            for (size_t v = 0; v < ARRAY_LEN(chars); v++) {
+                DIFF_STAR(c.fmt, c.star_width, 0, chars[v]);
+                DIFF_STAR(lc.fmt, lc.star_width, 0, (wint_t)chars[v]);
+                DIFF_STAR(p.fmt, p.star_width, 0, ptrs[v]);
+            }
+        }
+}
+
+/* endregion */
+
+/* 多个格式说明符与字面量混合，检查格式说明符之间的实参不会错位 */
+static void diff_mixed(void) {
+    int local = 0;
+    diff("%%|%c%%%s%%%d%%", 'x', "y", 1);
+    diff("%s %d %f %c %p %5s %La %lc %ls\n", "mix", 42, 0.125, 'q', (void *)&local, "ab", 3.0L, (wint_t)L'w', L"wide");
+    diff("%*d|%-*.*s|%c|%.*Lf|%*.*a", 6, -17, 10, 3, "alice", 'x', 2, 2.5L, -12, 3, 0.1);
+    diff("%lf|%10.3lf|%-+lg", 2.0, -0.5, 1e-5);
+    diff("%hhd %hu %ld %llx %jd %zu %td %#o %#X", 300, 65537, -5L, 0xdeadbeefcafeULL, (intmax_t)-9, (size_t)7, (ptrdiff_t)-3, 8u, 255u);
+    diff("no specifiers at all, just a literal that is long enough to cross a vector boundary or two");
+}
+
+/* region [positional] */
+
+/* 位置参数不合法时 `k_snprintf` 应返回负值，且不改动缓冲区之后的字节
+ *
+ * 实参取自实参数组时允许混用位置参数与顺序参数，见 `k_snprintf_argv`，不在此检查。
+ */
+static void reject(const char *fmt, ...) {
+
+    char actual[64];
+    memset(actual, '#', sizeof(actual));
+    actual[sizeof(actual) - 1] = '\0';
+
+    va_list args;
+    va_start(args, fmt);
+    int len = k_vsnprintf(&config, actual, 16, fmt, args);
+    va_end(args);
+
+    check_num++;
+    if (0 <= len || '#' != actual[16])
+        report(fmt, "k_snprintf (reject)", 16, "", -1, actual, len);
+}
+
+#define ARGS8(b) (b) + 1, (b) + 2, (b) + 3, (b) + 4, (b) + 5, (b) + 6, (b) + 7, (b) + 8
+#define ARGS64   ARGS8(0), ARGS8(8), ARGS8(16), ARGS8(24), ARGS8(32), ARGS8(40), ARGS8(48), ARGS8(56)
+
+/* 引用 `first` 到 `last` 的每个序号，以 "%n$d" 的形式倒序排列 */
+static void make_pos_fmt(char *fmt, int first, int last) {
+    for (int i = last; first <= i; i--)
+        fmt += sprintf(fmt, "%%%d$d,", i);
+}
+
+static void diff_positional(void) {
+
+    int local = 0;
+
+    /* 调整顺序、`*m$` 宽度与精度、同一序号被多次引用 */
+    diff("%2$s %1$*3$d", 42, "x", 5);
+    diff("%2$s %1$*3$d", 42, "x", -5);
+    diff("%3$s|%1$s|%2$s|%1$s", "one", "two", "three");
+    diff("%1$*2$.*3$f|%4$-*2$s|%5$c", 3.14159, 10, 3, "left", 'z');
+    diff("%4$Lf %3$lld %2$hhd %1$p", (void *)&local, 300, -123456789012LL, 2.5L);
+    diff("%2$lc %1$ls %3$a", L"wide", (wint_t)L'w', 0.1);
+    diff("%%%1$d%%%2$s%%", 7, "pct");
+    diff("%1$s%1$s%1$s", "again");
+
+    /* 最多 64 个序号 */
+    char fmt[1024];
+    make_pos_fmt(fmt, 1, 64);
+    diff(fmt, ARGS64);
+
+    /* 不合法的写法 */
+    reject("%1$d %d", 1, 2);             /* 先位置参数，后顺序参数 */
+    reject("%d %1$d", 1, 2);             /* 先顺序参数，后位置参数 */
+    reject("%1$*d", 1, 2);               /* `*` 没有写成 `*m$` */
+    reject("%1$.*d", 1, 2);
+    reject("%1$d %3$d", 1, 2, 3);        /* 序号 2 没有被引用 */
+    reject("%1$d %1$s", 1);              /* 同一序号的类型不一致 */
+    reject("%1$*1$s", 1);
+    make_pos_fmt(fmt, 1, 65);
+    reject(fmt, ARGS64, 65);             /* 超过 64 个序号 */
+}
+
+/* endregion */
+
+int main(void) {
+
+    diff_int();
+    diff_double();
+    diff_string();
+    diff_mixed();
+    diff_positional();
+
+    printf("diff_libc: %d checks, %d failures\n", check_num, fail_num);
+    return (0 == fail_num) ? 0 : 1;
+}
@@ -0,0 +1,183 @@
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+#include "k_printf.hpp"
+
+/* 对比 C++ 接口与 C 接口的输出
+ *
+ * `k_printf_cpp::format_to` 与 `k_printf_cpp::format` 在编译期拆分格式字符串，运行期直接输出格式项；
+ * 以同样的配置与实参调用 `k_snprintf`，两者的输出与返回值应完全一致，截断时也是如此。
+ * 覆盖 C `printf` 的格式说明符、`spec_table` 中的自定义格式说明符（包括 `auto_pad` 与 `*` 宽度），
+ * 以及以 `custom` 声明、运行期经配置匹配的自定义格式说明符。
+ */
+
+namespace {
+
+int check_num;
+int fail_num;
+
+/* `%arr`：输出 int 数组，消耗数组指针与长度两个实参 */
+void arr_callback(k_printf_buf *buf, const k_printf_spec *spec, va_list *args) {
+    (void)spec;
+    const int *v = va_arg(*args, const int *);
+    int n = va_arg(*args, int);
+    for (int i = 0; i < n; i++)
+        buf->fn_printf(buf, (0 == i) ? "%d" : ",%d", v[i]);
+}
+
+void arr_callback_argv(k_printf_buf *buf, const k_printf_spec *spec, k_printf_args *args) {
+    (void)spec;
+    const k_printf_arg *v = k_printf_args_next(args);
+    const k_printf_arg *n = k_printf_args_next(args);
+    if (nullptr == v || nullptr == n || K_PRINTF_ARG_PTR != v->type || K_PRINTF_ARG_INT != n->type) {
+        buf->n = -1;
+        return;
+    }
+    const int *a = static_cast<const int *>(v->value.p);
+    for (long long i = 0; i < n->value.i; i++)
+        buf->fn_printf(buf, (0 == i) ? "%d" : ",%d", a[i]);
+}
+
+/* `%ar`：与 `%arr` 共享前缀，用于检查最长匹配 */
+void ar_callback(k_printf_buf *buf, const k_printf_spec *spec, va_list *args) {
+    (void)spec;
+    buf->fn_printf(buf, "<%d>", va_arg(*args, int));
+}
+
+void ar_callback_argv(k_printf_buf *buf, const k_printf_spec *spec, k_printf_args *args) {
+    (void)spec;
+    const k_printf_arg *arg = k_printf_args_next(args);
+    if (nullptr == arg || K_PRINTF_ARG_INT != arg->type) {
+        buf->n = -1;
+        return;
+    }
+    buf->fn_printf(buf, "<%lld>", arg->value.i);
+}
+
+/* `%up`：由 `k_printf` 补齐最小宽度，输出大写的字符串 */
+void up_put(k_printf_buf *buf, const char *s) {
+    for (; '\0' != *s; s++) {
+        char ch = ('a' <= *s && *s <= 'z') ? static_cast<char>(*s - 'a' + 'A') : *s;
+        buf->fn_puts(buf, &ch, 1);
+    }
+}
+
+void up_callback(k_printf_buf *buf, const k_printf_spec *spec, va_list *args) {
+    (void)spec;
+    up_put(buf, va_arg(*args, const char *));
+}
+
+void up_callback_argv(k_printf_buf *buf, const k_printf_spec *spec, k_printf_args *args) {
+    (void)spec;
+    const k_printf_arg *arg = k_printf_args_next(args);
+    if (nullptr == arg || K_PRINTF_ARG_STR != arg->type) {
+        buf->n = -1;
+        return;
+    }
+    up_put(buf, arg->value.s);
+}
+
+int up_measure(const k_printf_spec *spec, va_list *args) {
+    (void)spec;
+    return static_cast<int>(std::strlen(va_arg(*args, const char *)));
+}
+
+using arr = k_printf_cpp::spec<"arr", arr_callback, 2, arr_callback_argv>;
+using ar  = k_printf_cpp::spec<"ar",  ar_callback,  1, ar_callback_argv>;
+using up  = k_printf_cpp::spec<"up",  up_callback,  1, up_callback_argv, up_measure, nullptr, true>;
+
+using specs = k_printf_cpp::spec_table<arr, ar, up>;
+
+const k_printf_config config = specs::config();
+
+struct mem_sink {
+    k_printf_sink impl;
+    char data[512];
+    std::size_t len;
+};
+
+int mem_sink_puts(k_printf_sink *sink, const char *str, std::size_t len) {
+    mem_sink *s = reinterpret_cast<mem_sink *>(sink);
+    if (len > sizeof(s->data) - 1 - s->len)
+        return -1;
+    std::memcpy(s->data + s->len, str, len);
+    s->len += len;
+    s->data[s->len] = '\0';
+    return 0;
+}
+
+void report(const char *fmt, const char *what, std::size_t n, const char *expect, long long expect_len,
+            const char *actual, long long actual_len) {
+    if (++fail_num <= 50)
+        std::printf("FAIL \"%s\" %s n=%zu: expect %lld [%s], got %lld [%s]\n",
+                    fmt, what, n, expect_len, expect, actual_len, actual);
+}
+
+/* 以 `Fmt` 与 `args` 分别调用 C++ 与 C 接口，在完整、为 0 与截断的缓冲区长度下对比 */
+template <k_printf_cpp::fixed_string Fmt, class... Customs, class... Args>
+void check(const Args &...args) {
+
+    char expect[512];
+    int expect_len = k_snprintf(&config, expect, sizeof(expect), Fmt.data, args...);
+
+    for (std::size_t n : { sizeof(expect), std::size_t(0), std::size_t(expect_len / 2 + 1) }) {
+        char want[512];
+        char got[512];
+        std::memset(want, '#', sizeof(want));
+        std::memset(got, '#', sizeof(got));
+
+        int want_len = k_snprintf(&config, want, n, Fmt.data, args...);
+        int got_len  = k_printf_cpp::format_to<Fmt, Customs...>(&config, got, n, args...);
+
+        check_num++;
+        if (want_len != got_len || 0 != std::memcmp(want, got, sizeof(want))) {
+            want[sizeof(want) - 1] = '\0';
+            got[sizeof(got) - 1]   = '\0';
+            report(Fmt.data, "format_to", n, (0 == n) ? "" : want, want_len, (0 == n) ? "" : got, got_len);
+        }
+    }
+
+    mem_sink sink {};
+    sink.impl.fn_puts = mem_sink_puts;
+    long long len = k_printf_cpp::format<Fmt, Customs...>(&config, &sink.impl, args...);
+
+    check_num++;
+    if (expect_len != len || 0 != std::strcmp(expect, sink.data))
+        report(Fmt.data, "format", 0, expect, expect_len, sink.data, len);
+}
+
+} // namespace
+
+int main() {
+
+    int local = 0;
+    static const int data[] = { 3, 1, 4, 1, 5 };
+
+    /* C `printf` 的格式说明符 */
+    check<"plain literal">();
+    check<"%d|%5d|%-5d|%05d|%+d|% d|%.3d|%*d|%-*d|%.*d">(42, -42, 42, -42, 42, 42, 7, 6, 1, 6, 2, 3, 9);
+    check<"%u %x %X %#x %o %#o %hhu %hd %ld %lld %jd %zu %td">(
+        4000000000u, 0xbeefu, 0xbeefu, 255u, 8u, 8u, static_cast<unsigned char>(200), static_cast<short>(-3),
+        -5L, -1234567890123LL, static_cast<intmax_t>(-9), static_cast<std::size_t>(7), static_cast<std::ptrdiff_t>(-3));
+    check<"%f %.2f %10.3f %-10.1e| %g %G %a %Lf %.3Le">(3.25, -1.005, 2.5, -7.75, 1e20, 1e-20, 0.5,
+                                                        static_cast<long double>(1.5), static_cast<long double>(-2.25));
+    check<"%*.*f|%-*.*e|%.0f|%#.0f">(12, 3, 3.14159, 12, 2, 2.5, 0.5, 1.0);
+    check<"[%s] [%10s] [%-10s] [%.3s] [%*s] [%.*s]">("hello", "right", "left", "truncated", -8, "neg", 2, "prec");
+    check<"[%c] [%3c] [%-3c] %p %p">('a', 'b', 'c', static_cast<void *>(&local), nullptr);
+    check<"%%|%d%%|%%%s%%|%%">(1, "pct");
+
+    /* `spec_table` 中的自定义格式说明符，最长匹配、`auto_pad` 与 `*` 宽度 */
+    check<"%arr|%ar|%arrr", specs>(data, 5, 7, data, 2);
+    check<"[%up] [%10up] [%-10up] [%*up] [%*up]", specs>("ab", "cd", "ef", 8, "gh", -8, "ij");
+    check<"%s=%arr (%d) %5.1f%%", specs>("k", data, 3, 10, 99.5);
+
+    /* 单独以 `spec` 声明，不经过 `spec_table` */
+    check<"%up|%ar|%5up", up, ar>("spec", 1, "ab");
+
+    /* 以 `custom` 声明的格式说明符在运行期经配置匹配，输出应相同 */
+    check<"%arr|%up|%d", k_printf_cpp::custom<"arr", 2>, k_printf_cpp::custom<"up", 1>>(data, 4, "mix", 5);
+
+    std::printf("format_cpp: %d checks, %d failures\n", check_num, fail_num);
+    return (0 == fail_num) ? 0 : 1;
+}
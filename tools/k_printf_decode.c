@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "k_printf.h"
+
+/* 将 `k_printf_binlog` 写出的二进制日志还原为文本，输出到标准输出流
+ *
+ * 用法：k_printf_decode [FILE]，省略 FILE 时从标准输入读取。
+ *
+ * 本工具使用默认配置，只能还原 C `printf` 的格式说明符。
+ * 若日志中有自定义格式说明符，应仿照本文件，以写入时的配置调用 `k_printf_binlog_decode`。
+ */
+
+static int stdout_puts(struct k_printf_sink *sink, const char *str, size_t len) {
+    (void)sink;
+    return (len == fwrite(str, 1, len, stdout)) ? 0 : -1;
+}
+
+/* 读入整个文件，失败时返回 NULL */
+static char *read_all(FILE *file, size_t *get_len) {
+
+    size_t len = 0;
+    size_t capacity = 64 * 1024;
+    char *data = malloc(capacity);
+    if (NULL == data)
+        return NULL;
+
+    for (;;) {
+        len += fread(data + len, 1, capacity - len, file);
+        if (len < capacity)
+            break;
+
+        char *tmp = realloc(data, capacity * 2);
+        if (NULL == tmp) {
+            free(data);
+            return NULL;
+        }
+        data = tmp;
+        capacity *= 2;
+    }
+
+    if (ferror(file)) {
+        free(data);
+        return NULL;
+    }
+
+    *get_len = len;
+    return data;
+}
+
+int main(int argc, char **argv) {
+
+    if (2 < argc) {
+        fprintf(stderr, "usage: %s [FILE]\n", argv[0]);
+        return 2;
+    }
+
+    FILE *file = stdin;
+    if (2 == argc && 0 != strcmp(argv[1], "-")) {
+        file = fopen(argv[1], "rb");
+        if (NULL == file) {
+            perror(argv[1]);
+            return 1;
+        }
+    }
+
+    size_t len;
+    char *data = read_all(file, &len);
+    if (stdin != file)
+        fclose(file);
+
+    if (NULL == data) {
+        fprintf(stderr, "%s: failed to read input\n", argv[0]);
+        return 1;
+    }
+
+    struct k_printf_sink sink = { .fn_puts = stdout_puts };
+    long long r = k_printf_binlog_decode(NULL, data, len, &sink);
+    free(data);
+
+    if (0 != fflush(stdout) || r < 0) {
+        fprintf(stderr, "%s: malformed binary log or write error\n", argv[0]);
+        return 1;
+    }
+
+    return 0;
+}